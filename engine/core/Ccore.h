@@ -3,5 +3,32 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "graphics/ogl_fw/glslprogram.h"
+#include "graphics/ogl_fw/streaming_buffer.h"
+#include "graphics/ogl_fw/async_shader_compiler.h"
+#include "graphics/ogl_fw/shader_variants.h"
+#include "graphics/ogl_fw/indirect_draw.h"
+#include "graphics/ogl_fw/buffer_suballocator.h"
+#include "graphics/ogl_fw/render_commands.h"
+#include "graphics/ogl_fw/hiz_culling.h"
+#include "graphics/ogl_fw/impostor.h"
 #include "graphics/camera.h"
+#include "graphics/culling.h"
+#include "terrain/quadtree.h"
+#include "terrain/heightfield.h"
+#include "terrain/tile_cache.h"
+#include "terrain/vertex_packing.h"
+#include "terrain/patch_generator.h"
+#include "terrain/terrain_renderer.h"
+#include "terrain/scatter.h"
+#include "atmosphere/atmosphere.h"
+#include "atmosphere/atmosphere_renderer.h"
+#include "ocean/fft.h"
+#include "ocean/ocean.h"
+#include "noise/noise.h"
+#include "jobs/job_system.h"
+#include "sim/triple_buffer.h"
+#include "sim/sim_thread.h"
+#include "file_watcher.h"
+#include "file_io.h"
+#include "profiler/profiler.h"
 #endif
\ No newline at end of file
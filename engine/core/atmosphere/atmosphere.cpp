@@ -0,0 +1,728 @@
+#include "atmosphere.h"
+
+#include "../hash.h"
+#include "../file_io.h"
+#include "../profiler/profiler.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+
+using namespace Continuum;
+using namespace Continuum::Atmosphere;
+
+uint64_t atmosphere_params_t::hash(void) const
+{
+	// hashed field by field, padding bytes must not leak into the key
+	const float values[] = {
+		this->bottom_radius, this->top_radius,
+		this->solar_irradiance.x, this->solar_irradiance.y, this->solar_irradiance.z, this->sun_angular_radius,
+		this->rayleigh_scattering.x, this->rayleigh_scattering.y, this->rayleigh_scattering.z, this->rayleigh_scale_height,
+		this->mie_scattering.x, this->mie_scattering.y, this->mie_scattering.z,
+		this->mie_extinction.x, this->mie_extinction.y, this->mie_extinction.z, this->mie_scale_height, this->mie_phase_g,
+		this->ozone_absorption.x, this->ozone_absorption.y, this->ozone_absorption.z, this->ozone_altitude, this->ozone_width,
+		this->ground_albedo.x, this->ground_albedo.y, this->ground_albedo.z, this->mu_s_min
+	};
+	return Hash::fnv1a_64(values, sizeof(values), Hash::k_fnv1a_offset);
+}
+
+/// Bruneton's functions.glsl in double precision, see shader/atmosphere/atmosphere.glsl for the GPU side
+namespace AtmosphereDetail
+{
+	using glm::dvec3;
+	using glm::dvec4;
+	using tables_t = atmosphere_tables_t;
+
+	static constexpr double k_pi = 3.14159265358979323846;
+	static constexpr uint32_t k_transmittance_samples = 500;
+	static constexpr uint32_t k_scattering_samples = 50;
+	/// sphere directions of the multiple scattering transfer, 8 x 8 stratified
+	static constexpr uint32_t k_multiple_scattering_directions = 8;
+	static constexpr uint32_t k_multiple_scattering_samples = 20;
+	static constexpr uint32_t k_irradiance_theta = 16;
+
+	struct model_t
+	{
+		double bottom = 0.0;
+		double top = 0.0;
+		/// distance from the ground to the top boundary along the horizon
+		double horizon = 0.0;
+		double mu_s_min = 0.0;
+		double sun_angular_radius = 0.0;
+		double mie_g = 0.0;
+		double rayleigh_scale_height = 0.0;
+		double mie_scale_height = 0.0;
+		double ozone_altitude = 0.0;
+		double ozone_half_width = 0.0;
+		dvec3 solar = dvec3(0.0);
+		dvec3 rayleigh = dvec3(0.0);
+		dvec3 mie_scattering = dvec3(0.0);
+		dvec3 mie_extinction = dvec3(0.0);
+		dvec3 absorption = dvec3(0.0);
+		dvec3 ground_albedo = dvec3(0.0);
+		const tables_t* tables = NULL;
+	public:
+		model_t(const atmosphere_params_t& params, const tables_t& tables_) :
+			bottom(params.bottom_radius), top(params.top_radius),
+			horizon(std::sqrt(double(params.top_radius) * params.top_radius - double(params.bottom_radius) * params.bottom_radius)),
+			mu_s_min(params.mu_s_min), sun_angular_radius(params.sun_angular_radius), mie_g(params.mie_phase_g),
+			rayleigh_scale_height(params.rayleigh_scale_height), mie_scale_height(params.mie_scale_height),
+			ozone_altitude(params.ozone_altitude), ozone_half_width(0.5 * params.ozone_width),
+			solar(params.solar_irradiance), rayleigh(params.rayleigh_scattering), mie_scattering(params.mie_scattering),
+			mie_extinction(params.mie_extinction), absorption(params.ozone_absorption), ground_albedo(params.ground_albedo),
+			tables(&tables_)
+		{
+		}
+	};
+
+	static inline double clamp_cosine(const double mu) { return std::clamp(mu, -1.0, 1.0); }
+	static inline double clamp_distance(const double d) { return std::max(d, 0.0); }
+	static inline double safe_sqrt(const double a) { return std::sqrt(std::max(a, 0.0)); }
+	static inline double clamp_radius(const model_t& m, const double r) { return std::clamp(r, m.bottom, m.top); }
+	static inline dvec3 exp3(const dvec3& v) { return dvec3(std::exp(v.x), std::exp(v.y), std::exp(v.z)); }
+	static inline double smoothstep(const double e0, const double e1, const double x)
+	{
+		const double t = std::clamp((x - e0) / (e1 - e0), 0.0, 1.0);
+		return t * t * (3.0 - 2.0 * t);
+	}
+
+	static inline double distance_to_top(const model_t& m, const double r, const double mu)
+	{
+		return clamp_distance(-r * mu + safe_sqrt(r * r * (mu * mu - 1.0) + m.top * m.top));
+	}
+	static inline double distance_to_bottom(const model_t& m, const double r, const double mu)
+	{
+		return clamp_distance(-r * mu - safe_sqrt(r * r * (mu * mu - 1.0) + m.bottom * m.bottom));
+	}
+	static inline bool intersects_ground(const model_t& m, const double r, const double mu)
+	{
+		return mu < 0.0 && r * r * (mu * mu - 1.0) + m.bottom * m.bottom >= 0.0;
+	}
+	static inline double distance_to_nearest(const model_t& m, const double r, const double mu, const bool ground)
+	{
+		return ground ? distance_to_bottom(m, r, mu) : distance_to_top(m, r, mu);
+	}
+
+	static inline double rayleigh_density(const model_t& m, const double altitude) { return std::exp(-altitude / m.rayleigh_scale_height); }
+	static inline double mie_density(const model_t& m, const double altitude) { return std::exp(-altitude / m.mie_scale_height); }
+	static inline double ozone_density(const model_t& m, const double altitude)
+	{
+		return std::max(0.0, 1.0 - std::abs(altitude - m.ozone_altitude) / m.ozone_half_width);
+	}
+	static inline dvec3 extinction_at(const model_t& m, const double altitude)
+	{
+		return m.rayleigh * rayleigh_density(m, altitude) + m.mie_extinction * mie_density(m, altitude) + m.absorption * ozone_density(m, altitude);
+	}
+	static inline dvec3 scattering_at(const model_t& m, const double altitude)
+	{
+		return m.rayleigh * rayleigh_density(m, altitude) + m.mie_scattering * mie_density(m, altitude);
+	}
+
+	static inline double rayleigh_phase(const double nu) { return 3.0 / (16.0 * k_pi) * (1.0 + nu * nu); }
+	static inline double mie_phase(const double g, const double nu)
+	{
+		const double k = 3.0 / (8.0 * k_pi) * (1.0 - g * g) / (2.0 + g * g);
+		return k * (1.0 + nu * nu) / std::pow(1.0 + g * g - 2.0 * g * nu, 1.5);
+	}
+
+	/// texel centres map to 0 and 1, so that the ends of the range are not filtered with a clamped border
+	static inline double coord_from_unit(const double x, const uint32_t size) { return 0.5 / size + x * (1.0 - 1.0 / size); }
+	static inline double unit_from_coord(const double u, const uint32_t size) { return (u - 0.5 / size) / (1.0 - 1.0 / size); }
+
+	/// GL_LINEAR with GL_CLAMP_TO_EDGE
+	static dvec4 sample_2d(const std::vector<glm::vec4>& data, const uint32_t width, const uint32_t height, const double u, const double v)
+	{
+		const double x = std::clamp(u * width - 0.5, 0.0, double(width - 1));
+		const double y = std::clamp(v * height - 0.5, 0.0, double(height - 1));
+		const uint32_t x0 = static_cast<uint32_t>(x), y0 = static_cast<uint32_t>(y);
+		const uint32_t x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+		const double fx = x - x0, fy = y - y0;
+		const dvec4 a = glm::mix(dvec4(data[size_t(y0) * width + x0]), dvec4(data[size_t(y0) * width + x1]), fx);
+		const dvec4 b = glm::mix(dvec4(data[size_t(y1) * width + x0]), dvec4(data[size_t(y1) * width + x1]), fx);
+		return glm::mix(a, b, fy);
+	}
+
+	static dvec4 sample_3d(const std::vector<glm::vec4>& data, const uint32_t width, const uint32_t height, const uint32_t depth,
+		const double u, const double v, const double w)
+	{
+		const double z = std::clamp(w * depth - 0.5, 0.0, double(depth - 1));
+		const uint32_t z0 = static_cast<uint32_t>(z);
+		const uint32_t z1 = std::min(z0 + 1, depth - 1);
+		const size_t slice = size_t(width) * height;
+		const auto layer = [&](const uint32_t layer_index) {
+			const double x = std::clamp(u * width - 0.5, 0.0, double(width - 1));
+			const double y = std::clamp(v * height - 0.5, 0.0, double(height - 1));
+			const uint32_t x0 = static_cast<uint32_t>(x), y0 = static_cast<uint32_t>(y);
+			const uint32_t x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+			const double fx = x - x0, fy = y - y0;
+			const glm::vec4* base = data.data() + slice * layer_index;
+			const dvec4 a = glm::mix(dvec4(base[size_t(y0) * width + x0]), dvec4(base[size_t(y0) * width + x1]), fx);
+			const dvec4 b = glm::mix(dvec4(base[size_t(y1) * width + x0]), dvec4(base[size_t(y1) * width + x1]), fx);
+			return glm::mix(a, b, fy);
+		};
+		return glm::mix(layer(z0), layer(z1), z - z0);
+	}
+
+	// --- transmittance
+
+	static dvec3 integrate_transmittance_to_top(const model_t& m, const double r, const double mu)
+	{
+		const double dx = distance_to_top(m, r, mu) / k_transmittance_samples;
+		dvec3 optical_depth = dvec3(0.0);
+		for (uint32_t i = 0; i <= k_transmittance_samples; ++i)
+		{
+			const double d = i * dx;
+			const double r_i = std::sqrt(d * d + 2.0 * r * mu * d + r * r);
+			const double weight = i == 0 || i == k_transmittance_samples ? 0.5 : 1.0;
+			optical_depth += extinction_at(m, r_i - m.bottom) * (weight * dx);
+		}
+		return exp3(-optical_depth);
+	}
+
+	static void transmittance_uv(const model_t& m, const double r, const double mu, double& u, double& v)
+	{
+		const double rho = safe_sqrt(r * r - m.bottom * m.bottom);
+		const double d = distance_to_top(m, r, mu);
+		const double d_min = m.top - r;
+		const double d_max = rho + m.horizon;
+		u = coord_from_unit((d - d_min) / (d_max - d_min), tables_t::k_transmittance_width);
+		v = coord_from_unit(rho / m.horizon, tables_t::k_transmittance_height);
+	}
+
+	static void transmittance_r_mu(const model_t& m, const double u, const double v, double& r, double& mu)
+	{
+		const double x_mu = unit_from_coord(u, tables_t::k_transmittance_width);
+		const double x_r = unit_from_coord(v, tables_t::k_transmittance_height);
+		const double rho = m.horizon * x_r;
+		r = std::sqrt(rho * rho + m.bottom * m.bottom);
+		const double d_min = m.top - r;
+		const double d_max = rho + m.horizon;
+		const double d = d_min + x_mu * (d_max - d_min);
+		mu = d == 0.0 ? 1.0 : clamp_cosine((m.horizon * m.horizon - rho * rho - d * d) / (2.0 * r * d));
+	}
+
+	static inline dvec3 transmittance_to_top(const model_t& m, const double r, const double mu)
+	{
+		double u = 0.0, v = 0.0;
+		transmittance_uv(m, r, mu, u, v);
+		return dvec3(sample_2d(m.tables->transmittance, tables_t::k_transmittance_width, tables_t::k_transmittance_height, u, v));
+	}
+
+	/// between the point at r, mu and the one d further along the ray
+	static dvec3 transmittance_along(const model_t& m, const double r, const double mu, const double d, const bool ground)
+	{
+		const double r_d = clamp_radius(m, std::sqrt(d * d + 2.0 * r * mu * d + r * r));
+		const double mu_d = clamp_cosine((r * mu + d) / r_d);
+		if (ground) return glm::min(transmittance_to_top(m, r_d, -mu_d) / transmittance_to_top(m, r, -mu), dvec3(1.0));
+		return glm::min(transmittance_to_top(m, r, mu) / transmittance_to_top(m, r_d, mu_d), dvec3(1.0));
+	}
+
+	/// the visible fraction of the sun disk fades out as it sets behind the planet
+	static dvec3 transmittance_to_sun(const model_t& m, const double r, const double mu_s)
+	{
+		const double sin_h = m.bottom / r;
+		const double cos_h = -std::sqrt(std::max(1.0 - sin_h * sin_h, 0.0));
+		return transmittance_to_top(m, r, mu_s) * smoothstep(-sin_h * m.sun_angular_radius, sin_h * m.sun_angular_radius, mu_s - cos_h);
+	}
+
+	// --- multiple scattering transfer
+
+	static void multiple_scattering_uv(const model_t& m, const double r, const double mu_s, double& u, double& v)
+	{
+		u = coord_from_unit(mu_s * 0.5 + 0.5, tables_t::k_multiple_scattering_size);
+		v = coord_from_unit((r - m.bottom) / (m.top - m.bottom), tables_t::k_multiple_scattering_size);
+	}
+
+	static inline dvec3 multiple_scattering(const model_t& m, const double r, const double mu_s)
+	{
+		double u = 0.0, v = 0.0;
+		multiple_scattering_uv(m, r, mu_s, u, v);
+		return dvec3(sample_2d(m.tables->multiple_scattering, tables_t::k_multiple_scattering_size, tables_t::k_multiple_scattering_size, u, v));
+	}
+
+	/// Psi_ms of Hillaire's "A Scalable and Production Ready Sky and Atmosphere Rendering Technique": second order
+	/// light reaching a point from every direction for a unit sun, times 1 / (1 - f_ms), the geometric series of
+	/// the fraction f_ms every further order transfers, assuming isotropic phase past the second order
+	static dvec3 integrate_multiple_scattering(const model_t& m, const double r, const double mu_s)
+	{
+		const dvec3 position = dvec3(0.0, 0.0, r);
+		const dvec3 sun = dvec3(safe_sqrt(1.0 - mu_s * mu_s), 0.0, mu_s);
+		const uint32_t n = k_multiple_scattering_directions;
+		const double isotropic = 1.0 / (4.0 * k_pi);
+
+		dvec3 second_order = dvec3(0.0);
+		dvec3 transfer = dvec3(0.0);
+		for (uint32_t j = 0; j < n; ++j)
+		{
+			const double cos_theta = 1.0 - 2.0 * (j + 0.5) / n;
+			const double sin_theta = safe_sqrt(1.0 - cos_theta * cos_theta);
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				const double phi = 2.0 * k_pi * (i + 0.5) / n;
+				const dvec3 dir = dvec3(std::cos(phi) * sin_theta, std::sin(phi) * sin_theta, cos_theta);
+				const bool ground = intersects_ground(m, r, cos_theta);
+				const double length = distance_to_nearest(m, r, cos_theta, ground);
+				const double dt = length / k_multiple_scattering_samples;
+
+				dvec3 light = dvec3(0.0), fraction = dvec3(0.0), throughput = dvec3(1.0);
+				for (uint32_t s = 0; s < k_multiple_scattering_samples; ++s)
+				{
+					const dvec3 p = position + dir * ((s + 0.5) * dt);
+					const double r_p = glm::length(p);
+					const double altitude = r_p - m.bottom;
+					const dvec3 sigma_s = scattering_at(m, altitude);
+					const dvec3 sigma_t = extinction_at(m, altitude);
+					const dvec3 step = exp3(-sigma_t * dt);
+					// analytic integral of the throughput over the step, per channel
+					dvec3 segment = dvec3(0.0);
+					for (int c = 0; c < 3; ++c) segment[c] = sigma_t[c] > 0.0 ? sigma_s[c] * (1.0 - step[c]) / sigma_t[c] : sigma_s[c] * dt;
+					light += throughput * segment * transmittance_to_sun(m, r_p, glm::dot(p, sun) / r_p) * isotropic;
+					fraction += throughput * segment;
+					throughput *= step;
+				}
+				if (ground)
+				{
+					const dvec3 p = position + dir * length;
+					const double mu_g = glm::dot(p, sun) / glm::length(p);
+					light += throughput * transmittance_to_sun(m, m.bottom, mu_g) * std::max(mu_g, 0.0) * m.ground_albedo / k_pi;
+				}
+				second_order += light;
+				transfer += fraction;
+			}
+		}
+		// uniform directions, the integrals against the isotropic phase are plain averages
+		const double weight = 1.0 / (n * n);
+		second_order *= weight;
+		transfer *= weight;
+		return second_order / (dvec3(1.0) - glm::min(transfer, dvec3(0.999)));
+	}
+
+	// --- scattering
+
+	static void scattering_uvwz(const model_t& m, const double r, const double mu, const double mu_s, const double nu, const bool ground, dvec4& uvwz)
+	{
+		const double rho = safe_sqrt(r * r - m.bottom * m.bottom);
+		const double u_r = coord_from_unit(rho / m.horizon, tables_t::k_scattering_r);
+
+		const double r_mu = r * mu;
+		const double discriminant = r_mu * r_mu - r * r + m.bottom * m.bottom;
+		double u_mu = 0.0;
+		if (ground)
+		{
+			const double d = -r_mu - safe_sqrt(discriminant);
+			const double d_min = r - m.bottom;
+			const double d_max = rho;
+			u_mu = 0.5 - 0.5 * coord_from_unit(d_max == d_min ? 0.0 : (d - d_min) / (d_max - d_min), tables_t::k_scattering_mu / 2);
+		}
+		else
+		{
+			const double d = -r_mu + safe_sqrt(discriminant + m.horizon * m.horizon);
+			const double d_min = m.top - r;
+			const double d_max = rho + m.horizon;
+			u_mu = 0.5 + 0.5 * coord_from_unit((d - d_min) / (d_max - d_min), tables_t::k_scattering_mu / 2);
+		}
+
+		const double d = distance_to_top(m, m.bottom, mu_s);
+		const double d_min = m.top - m.bottom;
+		const double d_max = m.horizon;
+		const double a = (d - d_min) / (d_max - d_min);
+		const double big_d = distance_to_top(m, m.bottom, m.mu_s_min);
+		const double big_a = (big_d - d_min) / (d_max - d_min);
+		const double u_mu_s = coord_from_unit(std::max(1.0 - a / big_a, 0.0) / (1.0 + a), tables_t::k_scattering_mu_s);
+
+		uvwz = dvec4((nu + 1.0) * 0.5, u_mu_s, u_mu, u_r);
+	}
+
+	static void scattering_texel_params(const model_t& m, const uint32_t x, const uint32_t y, const uint32_t z,
+		double& r, double& mu, double& mu_s, double& nu, bool& ground)
+	{
+		const double u_nu = double(x / tables_t::k_scattering_mu_s) / (tables_t::k_scattering_nu - 1);
+		const double u_mu_s = (double(x % tables_t::k_scattering_mu_s) + 0.5) / tables_t::k_scattering_mu_s;
+		const double u_mu = (y + 0.5) / tables_t::k_scattering_mu;
+		const double u_r = (z + 0.5) / tables_t::k_scattering_r;
+
+		const double rho = m.horizon * unit_from_coord(u_r, tables_t::k_scattering_r);
+		r = std::sqrt(rho * rho + m.bottom * m.bottom);
+
+		if (u_mu < 0.5)
+		{
+			const double d_min = r - m.bottom;
+			const double d_max = rho;
+			const double d = d_min + (d_max - d_min) * unit_from_coord(1.0 - 2.0 * u_mu, tables_t::k_scattering_mu / 2);
+			mu = d == 0.0 ? -1.0 : clamp_cosine(-(rho * rho + d * d) / (2.0 * r * d));
+			ground = true;
+		}
+		else
+		{
+			const double d_min = m.top - r;
+			const double d_max = rho + m.horizon;
+			const double d = d_min + (d_max - d_min) * unit_from_coord(2.0 * u_mu - 1.0, tables_t::k_scattering_mu / 2);
+			mu = d == 0.0 ? 1.0 : clamp_cosine((m.horizon * m.horizon - rho * rho - d * d) / (2.0 * r * d));
+			ground = false;
+		}
+
+		const double x_mu_s = unit_from_coord(u_mu_s, tables_t::k_scattering_mu_s);
+		const double d_min = m.top - m.bottom;
+		const double d_max = m.horizon;
+		const double big_d = distance_to_top(m, m.bottom, m.mu_s_min);
+		const double big_a = (big_d - d_min) / (d_max - d_min);
+		const double a = (big_a - x_mu_s * big_a) / (1.0 + x_mu_s * big_a);
+		const double d = d_min + std::min(a, big_a) * (d_max - d_min);
+		mu_s = d == 0.0 ? 1.0 : clamp_cosine((m.horizon * m.horizon - d * d) / (2.0 * m.bottom * d));
+
+		// nu is only free within the range the two other angles allow
+		const double spread = std::sqrt((1.0 - mu * mu) * (1.0 - mu_s * mu_s));
+		nu = std::clamp(u_nu * 2.0 - 1.0, mu * mu_s - spread, mu * mu_s + spread);
+	}
+
+	/// rgb: single Rayleigh plus multiple scattering over the Rayleigh phase, a: single Mie red
+	static dvec4 integrate_scattering(const model_t& m, const double r, const double mu, const double mu_s, const double nu, const bool ground)
+	{
+		const double dx = distance_to_nearest(m, r, mu, ground) / k_scattering_samples;
+		dvec3 rayleigh_sum = dvec3(0.0), mie_sum = dvec3(0.0), multiple_sum = dvec3(0.0);
+		for (uint32_t i = 0; i <= k_scattering_samples; ++i)
+		{
+			const double d = i * dx;
+			const double r_d = clamp_radius(m, std::sqrt(d * d + 2.0 * r * mu * d + r * r));
+			const double mu_s_d = clamp_cosine((r * mu_s + d * nu) / r_d);
+			const double altitude = r_d - m.bottom;
+			const double weight = i == 0 || i == k_scattering_samples ? 0.5 : 1.0;
+			const dvec3 view = transmittance_along(m, r, mu, d, ground) * weight;
+			const dvec3 lit = view * transmittance_to_sun(m, r_d, mu_s_d);
+			rayleigh_sum += lit * rayleigh_density(m, altitude);
+			mie_sum += lit * mie_density(m, altitude);
+			multiple_sum += view * scattering_at(m, altitude) * multiple_scattering(m, r_d, mu_s_d);
+		}
+		const dvec3 rayleigh = rayleigh_sum * dx * m.solar * m.rayleigh;
+		const dvec3 mie = mie_sum * dx * m.solar * m.mie_scattering;
+		const dvec3 multiple = multiple_sum * dx * m.solar;
+		return dvec4(rayleigh + multiple / rayleigh_phase(nu), mie.x);
+	}
+
+	static dvec4 lookup_scattering(const model_t& m, const double r, const double mu, const double mu_s, const double nu, const bool ground)
+	{
+		dvec4 uvwz = dvec4(0.0);
+		scattering_uvwz(m, r, mu, mu_s, nu, ground, uvwz);
+		const double tex_coord_x = uvwz.x * (tables_t::k_scattering_nu - 1);
+		const double tex_x = std::floor(tex_coord_x);
+		const double t = tex_coord_x - tex_x;
+		const auto sample = [&](const double slice) {
+			return sample_3d(m.tables->scattering, tables_t::k_scattering_width, tables_t::k_scattering_mu, tables_t::k_scattering_r,
+				(slice + uvwz.y) / tables_t::k_scattering_nu, uvwz.z, uvwz.w);
+		};
+		return glm::mix(sample(tex_x), sample(std::min(tex_x + 1.0, double(tables_t::k_scattering_nu - 1))), t);
+	}
+
+	/// Mie rgb from the red channel stored in a, assuming Mie and Rayleigh keep the same ratio across channels
+	static inline dvec3 extrapolated_mie(const model_t& m, const dvec4& scattering)
+	{
+		if (scattering.x <= 0.0) return dvec3(0.0);
+		return dvec3(scattering) * (scattering.w / scattering.x) * (m.rayleigh.x / m.mie_scattering.x) * (m.mie_scattering / m.rayleigh);
+	}
+
+	static inline dvec3 scattered_radiance(const model_t& m, const dvec4& scattering, const double nu)
+	{
+		return dvec3(scattering) * rayleigh_phase(nu) + extrapolated_mie(m, scattering) * mie_phase(m.mie_g, nu);
+	}
+
+	// --- irradiance
+
+	static dvec3 integrate_indirect_irradiance(const model_t& m, const double r, const double mu_s)
+	{
+		const double d_theta = k_pi / (2.0 * k_irradiance_theta);
+		const double d_phi = k_pi / k_irradiance_theta;
+		const dvec3 sun = dvec3(safe_sqrt(1.0 - mu_s * mu_s), 0.0, mu_s);
+		dvec3 result = dvec3(0.0);
+		for (uint32_t j = 0; j < k_irradiance_theta; ++j)
+		{
+			const double theta = (j + 0.5) * d_theta;
+			for (uint32_t i = 0; i < 2 * k_irradiance_theta; ++i)
+			{
+				const double phi = (i + 0.5) * d_phi;
+				const dvec3 dir = dvec3(std::cos(phi) * std::sin(theta), std::sin(phi) * std::sin(theta), std::cos(theta));
+				const double nu = glm::dot(dir, sun);
+				const dvec4 scattering = lookup_scattering(m, r, dir.z, mu_s, nu, false);
+				result += scattered_radiance(m, scattering, nu) * (dir.z * d_theta * d_phi * std::sin(theta));
+			}
+		}
+		return result;
+	}
+
+	static void run_rows(Jobs::job_system_t* jobs, const uint32_t rows, const std::function<void(uint32_t, uint32_t)>& fn)
+	{
+		if (jobs != NULL)
+		{
+			Jobs::job_counter_t done;
+			jobs->parallel_for(rows, 1, fn, &done);
+			jobs->wait(done);
+		}
+		else
+		{
+			fn(0, rows);
+		}
+	}
+
+	static inline double elapsed_ms(const std::chrono::high_resolution_clock::time_point& from)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - from).count();
+	}
+
+	static inline glm::vec4 to_texel(const dvec3& v) { return glm::vec4(float(v.x), float(v.y), float(v.z), 0.0f); }
+
+	static inline uint32_t payload_checksum(const atmosphere_tables_t& tables)
+	{
+		return FileIO::payload_checksum({
+			{ tables.transmittance.data(), tables.transmittance.size() * sizeof(glm::vec4) },
+			{ tables.multiple_scattering.data(), tables.multiple_scattering.size() * sizeof(glm::vec4) },
+			{ tables.scattering.data(), tables.scattering.size() * sizeof(glm::vec4) },
+			{ tables.irradiance.data(), tables.irradiance.size() * sizeof(glm::vec4) } });
+	}
+
+	static atmosphere_file_header_t make_header(const atmosphere_params_t& params)
+	{
+		atmosphere_file_header_t header = {};
+		header.params_hash = params.hash();
+		header.transmittance_width = tables_t::k_transmittance_width;
+		header.transmittance_height = tables_t::k_transmittance_height;
+		header.scattering_r = tables_t::k_scattering_r;
+		header.scattering_mu = tables_t::k_scattering_mu;
+		header.scattering_mu_s = tables_t::k_scattering_mu_s;
+		header.scattering_nu = tables_t::k_scattering_nu;
+		header.irradiance_width = tables_t::k_irradiance_width;
+		header.irradiance_height = tables_t::k_irradiance_height;
+		header.multiple_scattering_size = tables_t::k_multiple_scattering_size;
+		return header;
+	}
+
+	static void resize_tables(atmosphere_tables_t& tables)
+	{
+		tables.transmittance.assign(size_t(tables_t::k_transmittance_width) * tables_t::k_transmittance_height, glm::vec4(0.0f));
+		tables.multiple_scattering.assign(size_t(tables_t::k_multiple_scattering_size) * tables_t::k_multiple_scattering_size, glm::vec4(0.0f));
+		tables.scattering.assign(size_t(tables_t::k_scattering_width) * tables_t::k_scattering_mu * tables_t::k_scattering_r, glm::vec4(0.0f));
+		tables.irradiance.assign(size_t(tables_t::k_irradiance_width) * tables_t::k_irradiance_height, glm::vec4(0.0f));
+	}
+}
+
+void Atmosphere::bake_tables(const atmosphere_params_t& params, atmosphere_tables_t& tables, Jobs::job_system_t* jobs, atmosphere_bake_stats_t* stats)
+{
+	using namespace AtmosphereDetail;
+	CONTINUUM_PROFILE_SCOPE("atmosphere_bake");
+
+	if (!(params.top_radius > params.bottom_radius) || params.bottom_radius <= 0.0f)
+	{
+		throw AtmosphereException("atmosphere top radius must exceed a positive bottom radius");
+	}
+
+	atmosphere_bake_stats_t timings = {};
+	const auto start = std::chrono::high_resolution_clock::now();
+	resize_tables(tables);
+	const model_t m(params, tables);
+
+	// every stage only reads the tables of the stages before it
+	auto stage = std::chrono::high_resolution_clock::now();
+	run_rows(jobs, tables_t::k_transmittance_height, [&](const uint32_t begin, const uint32_t end) {
+		for (uint32_t y = begin; y < end; ++y)
+		{
+			for (uint32_t x = 0; x < tables_t::k_transmittance_width; ++x)
+			{
+				double r = 0.0, mu = 0.0;
+				transmittance_r_mu(m, (x + 0.5) / tables_t::k_transmittance_width, (y + 0.5) / tables_t::k_transmittance_height, r, mu);
+				tables.transmittance[size_t(y) * tables_t::k_transmittance_width + x] = to_texel(integrate_transmittance_to_top(m, r, mu));
+			}
+		}
+	});
+	timings.transmittance_ms = elapsed_ms(stage);
+
+	stage = std::chrono::high_resolution_clock::now();
+	run_rows(jobs, tables_t::k_multiple_scattering_size, [&](const uint32_t begin, const uint32_t end) {
+		const uint32_t size = tables_t::k_multiple_scattering_size;
+		for (uint32_t y = begin; y < end; ++y)
+		{
+			const double r = m.bottom + (m.top - m.bottom) * unit_from_coord((y + 0.5) / size, size);
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				const double mu_s = unit_from_coord((x + 0.5) / size, size) * 2.0 - 1.0;
+				tables.multiple_scattering[size_t(y) * size + x] = to_texel(integrate_multiple_scattering(m, clamp_radius(m, r), clamp_cosine(mu_s)));
+			}
+		}
+	});
+	timings.multiple_scattering_ms = elapsed_ms(stage);
+
+	stage = std::chrono::high_resolution_clock::now();
+	run_rows(jobs, tables_t::k_scattering_r * tables_t::k_scattering_mu, [&](const uint32_t begin, const uint32_t end) {
+		for (uint32_t row = begin; row < end; ++row)
+		{
+			const uint32_t y = row % tables_t::k_scattering_mu;
+			const uint32_t z = row / tables_t::k_scattering_mu;
+			for (uint32_t x = 0; x < tables_t::k_scattering_width; ++x)
+			{
+				double r = 0.0, mu = 0.0, mu_s = 0.0, nu = 0.0;
+				bool ground = false;
+				scattering_texel_params(m, x, y, z, r, mu, mu_s, nu, ground);
+				const dvec4 s = integrate_scattering(m, r, mu, mu_s, nu, ground);
+				tables.scattering[size_t(row) * tables_t::k_scattering_width + x] = glm::vec4(float(s.x), float(s.y), float(s.z), float(s.w));
+			}
+		}
+	});
+	timings.scattering_ms = elapsed_ms(stage);
+
+	stage = std::chrono::high_resolution_clock::now();
+	run_rows(jobs, tables_t::k_irradiance_height, [&](const uint32_t begin, const uint32_t end) {
+		for (uint32_t y = begin; y < end; ++y)
+		{
+			const double r = m.bottom + (m.top - m.bottom) * unit_from_coord((y + 0.5) / tables_t::k_irradiance_height, tables_t::k_irradiance_height);
+			for (uint32_t x = 0; x < tables_t::k_irradiance_width; ++x)
+			{
+				const double mu_s = unit_from_coord((x + 0.5) / tables_t::k_irradiance_width, tables_t::k_irradiance_width) * 2.0 - 1.0;
+				tables.irradiance[size_t(y) * tables_t::k_irradiance_width + x] = to_texel(integrate_indirect_irradiance(m, clamp_radius(m, r), clamp_cosine(mu_s)));
+			}
+		}
+	});
+	timings.irradiance_ms = elapsed_ms(stage);
+
+	timings.total_ms = elapsed_ms(start);
+	if (stats != NULL) *stats = timings;
+}
+
+bool Atmosphere::save_tables(const std::string& path, const atmosphere_params_t& params, const atmosphere_tables_t& tables)
+{
+	if (tables.empty()) return false;
+	atmosphere_file_header_t header = AtmosphereDetail::make_header(params);
+	header.checksum = AtmosphereDetail::payload_checksum(tables);
+
+	return FileIO::write_file_atomic(path, {
+		{ &header, sizeof(header) },
+		{ tables.transmittance.data(), tables.transmittance.size() * sizeof(glm::vec4) },
+		{ tables.multiple_scattering.data(), tables.multiple_scattering.size() * sizeof(glm::vec4) },
+		{ tables.scattering.data(), tables.scattering.size() * sizeof(glm::vec4) },
+		{ tables.irradiance.data(), tables.irradiance.size() * sizeof(glm::vec4) } });
+}
+
+bool Atmosphere::load_tables(const std::string& path, const atmosphere_params_t& params, atmosphere_tables_t& tables)
+{
+	std::ifstream in_file(path, std::ios::in | std::ios::binary);
+	if (!in_file) return false;
+
+	const atmosphere_file_header_t expected = AtmosphereDetail::make_header(params);
+	atmosphere_file_header_t header = {};
+	in_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	const bool valid_header = in_file
+		&& header.magic == expected.magic && header.version == expected.version && header.header_size == expected.header_size
+		&& header.params_hash == expected.params_hash
+		&& header.transmittance_width == expected.transmittance_width && header.transmittance_height == expected.transmittance_height
+		&& header.scattering_r == expected.scattering_r && header.scattering_mu == expected.scattering_mu
+		&& header.scattering_mu_s == expected.scattering_mu_s && header.scattering_nu == expected.scattering_nu
+		&& header.irradiance_width == expected.irradiance_width && header.irradiance_height == expected.irradiance_height
+		&& header.multiple_scattering_size == expected.multiple_scattering_size;
+	if (!valid_header) return false;
+
+	atmosphere_tables_t loaded;
+	AtmosphereDetail::resize_tables(loaded);
+	for (std::vector<glm::vec4>* table : { &loaded.transmittance, &loaded.multiple_scattering, &loaded.scattering, &loaded.irradiance })
+	{
+		in_file.read(reinterpret_cast<char*>(table->data()), std::streamsize(table->size() * sizeof(glm::vec4)));
+	}
+	// a longer file is as suspect as a shorter one
+	if (!in_file || in_file.peek() != std::ifstream::traits_type::eof()) return false;
+	if (header.checksum != AtmosphereDetail::payload_checksum(loaded)) return false;
+
+	tables = std::move(loaded);
+	return true;
+}
+
+glm::vec3 Atmosphere::sky_radiance(const atmosphere_params_t& params, const atmosphere_tables_t& tables, const glm::vec3& camera,
+	const glm::vec3& view_dir, const glm::vec3& sun_dir, glm::vec3* transmittance)
+{
+	using namespace AtmosphereDetail;
+	const model_t m(params, tables);
+
+	dvec3 position = dvec3(camera);
+	const dvec3 view = dvec3(view_dir);
+	const dvec3 sun = dvec3(sun_dir);
+	double r = glm::length(position);
+	double r_mu = glm::dot(position, view);
+	const double discriminant = r_mu * r_mu - r * r + m.top * m.top;
+	if (transmittance != NULL) *transmittance = glm::vec3(1.0f);
+
+	// from space, start where the ray enters the atmosphere
+	if (r > m.top)
+	{
+		if (discriminant < 0.0 || r_mu > 0.0) return glm::vec3(0.0f);
+		const double entry = -r_mu - std::sqrt(discriminant);
+		position += view * entry;
+		r = m.top;
+		r_mu += entry;
+	}
+
+	const double mu = r_mu / r;
+	const double mu_s = glm::dot(position, sun) / r;
+	const double nu = glm::dot(view, sun);
+	const bool ground = intersects_ground(m, r, mu);
+	if (transmittance != NULL) *transmittance = ground ? glm::vec3(0.0f) : glm::vec3(transmittance_to_top(m, r, mu));
+
+	return glm::vec3(scattered_radiance(m, lookup_scattering(m, r, mu, mu_s, nu, ground), nu));
+}
+
+glm::vec3 Atmosphere::sky_radiance_reference(const atmosphere_params_t& params, const atmosphere_tables_t& tables, const glm::vec3& camera,
+	const glm::vec3& view_dir, const glm::vec3& sun_dir, const uint32_t view_steps, const uint32_t sun_steps)
+{
+	using namespace AtmosphereDetail;
+	const model_t m(params, tables);
+
+	dvec3 position = dvec3(camera);
+	const dvec3 view = dvec3(view_dir);
+	const dvec3 sun = dvec3(sun_dir);
+	double r = glm::length(position);
+	double r_mu = glm::dot(position, view);
+	const double discriminant = r_mu * r_mu - r * r + m.top * m.top;
+	if (r > m.top)
+	{
+		if (discriminant < 0.0 || r_mu > 0.0) return glm::vec3(0.0f);
+		const double entry = -r_mu - std::sqrt(discriminant);
+		position += view * entry;
+		r = m.top;
+		r_mu += entry;
+	}
+
+	const double mu = r_mu / r;
+	const bool ground = intersects_ground(m, r, mu);
+	const double dt = distance_to_nearest(m, r, mu, ground) / std::max<uint32_t>(view_steps, 1);
+	const double nu = glm::dot(view, sun);
+	const double phase_r = rayleigh_phase(nu);
+	const double phase_m = mie_phase(m.mie_g, nu);
+
+	dvec3 radiance = dvec3(0.0);
+	dvec3 optical_depth = dvec3(0.0);
+	for (uint32_t i = 0; i < view_steps; ++i)
+	{
+		const dvec3 p = position + view * ((i + 0.5) * dt);
+		const double r_p = glm::length(p);
+		const double altitude = r_p - m.bottom;
+		const double mu_s = glm::dot(p, sun) / r_p;
+		// midpoint optical depth up to the sample
+		const dvec3 sigma_t = extinction_at(m, altitude);
+		const dvec3 view_transmittance = exp3(-(optical_depth + sigma_t * (0.5 * dt)));
+		optical_depth += sigma_t * dt;
+
+		dvec3 sun_transmittance = dvec3(0.0);
+		if (!intersects_ground(m, r_p, mu_s))
+		{
+			const double ds = distance_to_top(m, r_p, mu_s) / std::max<uint32_t>(sun_steps, 1);
+			dvec3 sun_depth = dvec3(0.0);
+			for (uint32_t j = 0; j < sun_steps; ++j)
+			{
+				const dvec3 q = p + sun * ((j + 0.5) * ds);
+				sun_depth += extinction_at(m, glm::length(q) - m.bottom) * ds;
+			}
+			sun_transmittance = exp3(-sun_depth);
+		}
+
+		const dvec3 single = (m.rayleigh * (rayleigh_density(m, altitude) * phase_r) + m.mie_scattering * (mie_density(m, altitude) * phase_m)) * sun_transmittance;
+		const dvec3 multiple = scattering_at(m, altitude) * multiple_scattering(m, r_p, mu_s);
+		radiance += view_transmittance * (single + multiple) * dt;
+	}
+	return glm::vec3(radiance * m.solar);
+}
@@ -0,0 +1,137 @@
+#ifndef ATMOSPHERE_H
+#define ATMOSPHERE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../jobs/job_system.h"
+
+namespace Continuum {
+
+	namespace Atmosphere {
+
+		struct AtmosphereException : public std::runtime_error {
+			AtmosphereException(const std::string& msg) :
+				std::runtime_error(msg) {}
+		};
+
+		/// Planet atmosphere, lengths in metres and coefficients per metre, colours at 680, 550 and 440 nm.
+		/// The defaults are the Earth of Bruneton's 2017 reference implementation.
+		struct atmosphere_params_t
+		{
+			float bottom_radius = 6360000.0f;
+			float top_radius = 6420000.0f;
+			/// solar irradiance at the top of the atmosphere
+			glm::vec3 solar_irradiance = glm::vec3(1.474f, 1.8504f, 1.91198f);
+			float sun_angular_radius = 0.004675f;
+			glm::vec3 rayleigh_scattering = glm::vec3(5.802e-6f, 13.558e-6f, 33.1e-6f);
+			float rayleigh_scale_height = 8000.0f;
+			glm::vec3 mie_scattering = glm::vec3(3.996e-6f, 3.996e-6f, 3.996e-6f);
+			glm::vec3 mie_extinction = glm::vec3(4.44e-6f, 4.44e-6f, 4.44e-6f);
+			float mie_scale_height = 1200.0f;
+			float mie_phase_g = 0.8f;
+			/// ozone, a tent-shaped layer centred at ozone_altitude
+			glm::vec3 ozone_absorption = glm::vec3(0.650e-6f, 1.881e-6f, 0.085e-6f);
+			float ozone_altitude = 25000.0f;
+			float ozone_width = 30000.0f;
+			glm::vec3 ground_albedo = glm::vec3(0.1f, 0.1f, 0.1f);
+			/// cosine of the lowest sun the scattering table covers, 102 degrees from the zenith
+			float mu_s_min = -0.2f;
+		public:
+			/// cache key of the baked tables
+			uint64_t hash(void) const;
+		};
+
+		/// Precomputed tables in Bruneton's parametrization, RGBA float texels laid out as their textures.
+		/// scattering packs the 4D (r, mu, mu_s, nu) table into a 3D texture of nu * mu_s, mu, r texels; rgb holds
+		/// single Rayleigh plus all multiple scattering divided by the Rayleigh phase, a the red channel of single Mie.
+		struct atmosphere_tables_t
+		{
+			static constexpr uint32_t k_transmittance_width = 256;
+			static constexpr uint32_t k_transmittance_height = 64;
+			static constexpr uint32_t k_scattering_r = 32;
+			static constexpr uint32_t k_scattering_mu = 128;
+			static constexpr uint32_t k_scattering_mu_s = 32;
+			static constexpr uint32_t k_scattering_nu = 8;
+			static constexpr uint32_t k_scattering_width = k_scattering_nu * k_scattering_mu_s;
+			static constexpr uint32_t k_irradiance_width = 64;
+			static constexpr uint32_t k_irradiance_height = 16;
+			/// isotropic multiple scattering transfer over (mu_s, r), see bake_tables()
+			static constexpr uint32_t k_multiple_scattering_size = 32;
+
+			std::vector<glm::vec4> transmittance;
+			std::vector<glm::vec4> multiple_scattering;
+			std::vector<glm::vec4> scattering;
+			/// indirect (sky) irradiance on a horizontal surface, the direct sun is evaluated analytically
+			std::vector<glm::vec4> irradiance;
+		public:
+			inline bool empty(void) const { return this->scattering.empty(); }
+			inline uint64_t get_bytes(void) const
+			{
+				return uint64_t(this->transmittance.size() + this->multiple_scattering.size() + this->scattering.size() + this->irradiance.size()) * sizeof(glm::vec4);
+			}
+		};
+
+		struct atmosphere_bake_stats_t
+		{
+			double transmittance_ms = 0.0;
+			double multiple_scattering_ms = 0.0;
+			double scattering_ms = 0.0;
+			double irradiance_ms = 0.0;
+			double total_ms = 0.0;
+		};
+
+		/// on-disk tables: this header followed by the four tables in atmosphere_tables_t order
+		struct atmosphere_file_header_t
+		{
+			static constexpr uint32_t k_magic = 0x4D544143; // "CATM"
+			static constexpr uint16_t k_version = 1;
+
+			uint32_t magic = k_magic;
+			uint16_t version = k_version;
+			uint16_t header_size = sizeof(atmosphere_file_header_t);
+			uint64_t params_hash = 0;
+			uint16_t transmittance_width = 0;
+			uint16_t transmittance_height = 0;
+			uint16_t scattering_r = 0;
+			uint16_t scattering_mu = 0;
+			uint16_t scattering_mu_s = 0;
+			uint16_t scattering_nu = 0;
+			uint16_t irradiance_width = 0;
+			uint16_t irradiance_height = 0;
+			uint16_t multiple_scattering_size = 0;
+			uint16_t reserved = 0;
+			/// low 32 bits of the FNV-1a hash of the payload
+			uint32_t checksum = 0;
+		};
+		static_assert(sizeof(atmosphere_file_header_t) == 40, "atmosphere header layout is part of the file format");
+
+		/// Bakes every table, rows spread over the job system when one is given. Higher scattering orders are not
+		/// iterated order by order: a small table of the isotropic transfer of all orders past the first (Hillaire 2020)
+		/// is baked first and integrated along each view ray together with single scattering.
+		void bake_tables(const atmosphere_params_t& params, atmosphere_tables_t& tables, Jobs::job_system_t* jobs = NULL, atmosphere_bake_stats_t* stats = NULL);
+
+		/// written to a temporary next to path and renamed; false when the file could not be written
+		bool save_tables(const std::string& path, const atmosphere_params_t& params, const atmosphere_tables_t& tables);
+		/// false when the file is missing, truncated, corrupt, or was baked for other parameters or table sizes
+		bool load_tables(const std::string& path, const atmosphere_params_t& params, atmosphere_tables_t& tables);
+
+		/// CPU mirror of GetSkyRadiance in shader/atmosphere/atmosphere.glsl: radiance along view_dir from camera
+		/// (planet-centred), the sun disk excluded. transmittance receives that of the ray to the top of the atmosphere.
+		glm::vec3 sky_radiance(const atmosphere_params_t& params, const atmosphere_tables_t& tables, const glm::vec3& camera,
+			const glm::vec3& view_dir, const glm::vec3& sun_dir, glm::vec3* transmittance = NULL);
+
+		/// Brute-force reference for sky_radiance(): the view ray is ray marched in view_steps with a nested march
+		/// of sun_steps towards the sun per sample, only the multiple scattering transfer table is used.
+		glm::vec3 sky_radiance_reference(const atmosphere_params_t& params, const atmosphere_tables_t& tables, const glm::vec3& camera,
+			const glm::vec3& view_dir, const glm::vec3& sun_dir, const uint32_t view_steps = 64, const uint32_t sun_steps = 32);
+
+	}
+
+}
+#endif
@@ -0,0 +1,251 @@
+#include "atmosphere_renderer.h"
+
+#include "../profiler/profiler.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+
+using namespace Continuum;
+using namespace Continuum::Atmosphere;
+using namespace Continuum::Graphics::UniformLiterals;
+
+namespace AtmosphereRendererDetail
+{
+	static constexpr GLuint k_params_binding = 1;
+	/// the tables take units 0..3 in atmosphere.glsl
+	static constexpr GLuint k_depth_unit = 4;
+
+	static inline void copy4(float* dst, const glm::vec3& v, const float w)
+	{
+		dst[0] = v.x;
+		dst[1] = v.y;
+		dst[2] = v.z;
+		dst[3] = w;
+	}
+
+	static inline double elapsed_ms(const std::chrono::high_resolution_clock::time_point& from)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - from).count();
+	}
+
+	static GLuint create_texture_2d(const GLenum internal_format, const uint32_t width, const uint32_t height, const std::vector<glm::vec4>& texels)
+	{
+		GLuint texture = 0;
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, 1, internal_format, GLsizei(width), GLsizei(height));
+		glTextureSubImage2D(texture, 0, 0, 0, GLsizei(width), GLsizei(height), GL_RGBA, GL_FLOAT, texels.data());
+		return texture;
+	}
+}
+
+gpu_atmosphere_params_t Atmosphere::make_gpu_atmosphere_params(const atmosphere_params_t& params)
+{
+	using AtmosphereRendererDetail::copy4;
+	gpu_atmosphere_params_t gpu = {};
+	copy4(gpu.solar_irradiance, params.solar_irradiance, params.sun_angular_radius);
+	copy4(gpu.rayleigh_scattering, params.rayleigh_scattering, params.rayleigh_scale_height);
+	copy4(gpu.mie_scattering, params.mie_scattering, params.mie_scale_height);
+	copy4(gpu.mie_extinction, params.mie_extinction, params.mie_phase_g);
+	copy4(gpu.ozone_absorption, params.ozone_absorption, params.ozone_altitude);
+	copy4(gpu.ground_albedo, params.ground_albedo, params.ozone_width);
+	const double horizon = std::sqrt(double(params.top_radius) * params.top_radius - double(params.bottom_radius) * params.bottom_radius);
+	gpu.radii[0] = params.bottom_radius;
+	gpu.radii[1] = params.top_radius;
+	gpu.radii[2] = float(horizon);
+	gpu.radii[3] = params.mu_s_min;
+	return gpu;
+}
+
+atmosphere_renderer_t::atmosphere_renderer_t(const atmosphere_renderer_settings_t& settings, Jobs::job_system_t* jobs) :
+	settings_(settings), jobs_(jobs)
+{
+}
+
+atmosphere_renderer_t::~atmosphere_renderer_t()
+{
+	release();
+}
+
+void atmosphere_renderer_t::release(void)
+{
+	for (GLuint& texture : this->textures_)
+	{
+		if (texture != 0) glDeleteTextures(1, &texture);
+		texture = 0;
+	}
+	if (this->params_buffer_ != 0) glDeleteBuffers(1, &this->params_buffer_);
+	if (this->vao_ != 0) glDeleteVertexArrays(1, &this->vao_);
+	this->params_buffer_ = 0;
+	this->vao_ = 0;
+	this->program_.reset();
+	this->reference_program_.reset();
+}
+
+std::string atmosphere_renderer_t::get_cache_path(void) const
+{
+	if (this->settings_.cache_directory.empty()) return std::string();
+	char name[32] = {};
+	snprintf(name, sizeof(name), "%016llx.catm", static_cast<unsigned long long>(this->settings_.params.hash()));
+	return (std::filesystem::path(this->settings_.cache_directory) / name).string();
+}
+
+void atmosphere_renderer_t::prepare_tables(void)
+{
+	this->stats_ = {};
+	const std::string path = get_cache_path();
+	if (!path.empty())
+	{
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		this->stats_.loaded_from_cache = load_tables(path, this->settings_.params, this->tables_);
+		this->stats_.load_ms = AtmosphereRendererDetail::elapsed_ms(t0);
+		if (this->stats_.loaded_from_cache) return;
+	}
+
+	bake_tables(this->settings_.params, this->tables_, this->jobs_, &this->stats_.bake);
+	if (!path.empty())
+	{
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		if (!save_tables(path, this->settings_.params, this->tables_))
+		{
+			fprintf(stderr, "Atmosphere: could not store the tables in %s\n", path.c_str());
+		}
+		this->stats_.store_ms = AtmosphereRendererDetail::elapsed_ms(t0);
+	}
+}
+
+void atmosphere_renderer_t::upload_tables(void)
+{
+	using namespace AtmosphereRendererDetail;
+	using tables_t = atmosphere_tables_t;
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	// transmittance is divided by itself along rays, it keeps full precision
+	this->textures_[0] = create_texture_2d(GL_RGBA32F, tables_t::k_transmittance_width, tables_t::k_transmittance_height, this->tables_.transmittance);
+	this->textures_[1] = create_texture_2d(GL_RGBA16F, tables_t::k_multiple_scattering_size, tables_t::k_multiple_scattering_size, this->tables_.multiple_scattering);
+	glCreateTextures(GL_TEXTURE_3D, 1, &this->textures_[2]);
+	glTextureStorage3D(this->textures_[2], 1, GL_RGBA16F, tables_t::k_scattering_width, tables_t::k_scattering_mu, tables_t::k_scattering_r);
+	glTextureSubImage3D(this->textures_[2], 0, 0, 0, 0, tables_t::k_scattering_width, tables_t::k_scattering_mu, tables_t::k_scattering_r,
+		GL_RGBA, GL_FLOAT, this->tables_.scattering.data());
+	this->textures_[3] = create_texture_2d(GL_RGBA16F, tables_t::k_irradiance_width, tables_t::k_irradiance_height, this->tables_.irradiance);
+
+	for (const GLuint texture : this->textures_)
+	{
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+	this->stats_.texture_bytes = uint64_t(tables_t::k_transmittance_width) * tables_t::k_transmittance_height * 16
+		+ (uint64_t(tables_t::k_multiple_scattering_size) * tables_t::k_multiple_scattering_size
+			+ uint64_t(tables_t::k_scattering_width) * tables_t::k_scattering_mu * tables_t::k_scattering_r
+			+ uint64_t(tables_t::k_irradiance_width) * tables_t::k_irradiance_height) * 8;
+
+	const gpu_atmosphere_params_t params = make_gpu_atmosphere_params(this->settings_.params);
+	glCreateBuffers(1, &this->params_buffer_);
+	glNamedBufferStorage(this->params_buffer_, sizeof(params), &params, 0);
+	// the upload is asynchronous, the time measured is the driver's copy of the texels
+	this->stats_.upload_ms = elapsed_ms(t0);
+}
+
+bool atmosphere_renderer_t::init(const std::string& shader_root)
+{
+	release();
+
+	auto program = std::make_unique<Graphics::glsl_program_t>();
+	try
+	{
+		program->compile_shader((shader_root + "/atmosphere/sky.vert").c_str());
+		program->compile_shader((shader_root + "/atmosphere/sky.frag").c_str());
+		program->link();
+	}
+	catch (const Graphics::GLSLProgramException& e)
+	{
+		fprintf(stderr, "Atmosphere: sky program failed: %s\n", e.what());
+		return false;
+	}
+	this->inv_view_proj_ = program->get_uniform<glm::mat4>("inv_view_proj"_uniform);
+	this->camera_ = program->get_uniform<glm::vec3>("camera"_uniform);
+	this->sun_direction_ = program->get_uniform<glm::vec3>("sun_direction"_uniform);
+	this->exposure_ = program->get_uniform<float>("exposure"_uniform);
+	this->program_ = std::move(program);
+
+	auto reference_program = std::make_unique<Graphics::glsl_program_t>();
+	try
+	{
+		reference_program->compile_shader((shader_root + "/atmosphere/sky.vert").c_str());
+		reference_program->compile_shader((shader_root + "/atmosphere/sky_reference.frag").c_str());
+		reference_program->link();
+		this->reference_inv_view_proj_ = reference_program->get_uniform<glm::mat4>("inv_view_proj"_uniform);
+		this->reference_camera_ = reference_program->get_uniform<glm::vec3>("camera"_uniform);
+		this->reference_sun_direction_ = reference_program->get_uniform<glm::vec3>("sun_direction"_uniform);
+		this->reference_exposure_ = reference_program->get_uniform<float>("exposure"_uniform);
+		this->reference_view_steps_ = reference_program->get_uniform<GLint>("view_steps"_uniform);
+		this->reference_sun_steps_ = reference_program->get_uniform<GLint>("sun_steps"_uniform);
+		this->reference_program_ = std::move(reference_program);
+	}
+	catch (const Graphics::GLSLProgramException& e)
+	{
+		fprintf(stderr, "Atmosphere: reference program unavailable: %s\n", e.what());
+	}
+
+	prepare_tables();
+	upload_tables();
+	glCreateVertexArrays(1, &this->vao_);
+	return true;
+}
+
+/// both passes replace the sky and blend over geometry with dual-source weights
+void atmosphere_renderer_t::bind(void)
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, AtmosphereRendererDetail::k_params_binding, this->params_buffer_);
+	for (GLuint unit = 0; unit < 4; ++unit) glBindTextureUnit(unit, this->textures_[unit]);
+	glBindVertexArray(this->vao_);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_SRC1_COLOR);
+}
+
+void atmosphere_renderer_t::draw(const glm::vec3& camera, const glm::mat4& view, const glm::mat4& proj, const glm::vec3& sun_dir, const GLuint depth_texture)
+{
+	if (this->program_ == NULL) return;
+	CONTINUUM_PROFILE_GPU_SCOPE("atmosphere_draw");
+
+	bind();
+	glBindTextureUnit(AtmosphereRendererDetail::k_depth_unit, depth_texture);
+	this->program_->use();
+	this->program_->set_uniform(this->inv_view_proj_, glm::inverse(proj * glm::mat4(glm::mat3(view))));
+	this->program_->set_uniform(this->camera_, camera);
+	this->program_->set_uniform(this->sun_direction_, glm::normalize(sun_dir));
+	this->program_->set_uniform(this->exposure_, this->settings_.exposure);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void atmosphere_renderer_t::draw_reference(const glm::vec3& camera, const glm::mat4& view, const glm::mat4& proj, const glm::vec3& sun_dir,
+	const uint32_t view_steps, const uint32_t sun_steps)
+{
+	if (this->reference_program_ == NULL) return;
+	CONTINUUM_PROFILE_GPU_SCOPE("atmosphere_reference");
+
+	bind();
+	this->reference_program_->use();
+	this->reference_program_->set_uniform(this->reference_inv_view_proj_, glm::inverse(proj * glm::mat4(glm::mat3(view))));
+	this->reference_program_->set_uniform(this->reference_camera_, camera);
+	this->reference_program_->set_uniform(this->reference_sun_direction_, glm::normalize(sun_dir));
+	this->reference_program_->set_uniform(this->reference_exposure_, this->settings_.exposure);
+	this->reference_program_->set_uniform(this->reference_view_steps_, GLint(std::max<uint32_t>(view_steps, 1)));
+	this->reference_program_->set_uniform(this->reference_sun_steps_, GLint(std::max<uint32_t>(sun_steps, 1)));
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,111 @@
+#ifndef ATMOSPHERE_RENDERER_H
+#define ATMOSPHERE_RENDERER_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "atmosphere.h"
+#include "../graphics/ogl_fw/glslprogram.h"
+#include "../jobs/job_system.h"
+
+namespace Continuum {
+
+	namespace Atmosphere {
+
+		struct atmosphere_renderer_settings_t
+		{
+			atmosphere_params_t params = {};
+			/// baked tables are stored as <directory>/<params hash>.catm, empty bakes on every init()
+			std::string cache_directory = "atmosphere_cache";
+			float exposure = 10.0f;
+		};
+
+		struct atmosphere_renderer_stats_t
+		{
+			bool loaded_from_cache = false;
+			/// zero when the tables came from the cache
+			atmosphere_bake_stats_t bake = {};
+			/// reading and validating the cache file, also when it was rejected
+			double load_ms = 0.0;
+			double store_ms = 0.0;
+			double upload_ms = 0.0;
+			uint64_t texture_bytes = 0;
+		};
+
+		/// mirrors AtmosphereParams in shader/atmosphere/atmosphere.glsl (std140)
+		struct gpu_atmosphere_params_t
+		{
+			float solar_irradiance[4];
+			float rayleigh_scattering[4];
+			float mie_scattering[4];
+			float mie_extinction[4];
+			float ozone_absorption[4];
+			float ground_albedo[4];
+			float radii[4];
+		};
+
+		gpu_atmosphere_params_t make_gpu_atmosphere_params(const atmosphere_params_t& params);
+
+		/// Sky and aerial perspective from precomputed scattering tables. init() loads the tables from the cache
+		/// or bakes and stores them; draw() is a single full-screen pass over the lit scene.
+		struct atmosphere_renderer_t
+		{
+			atmosphere_renderer_t(const atmosphere_renderer_settings_t& settings, Jobs::job_system_t* jobs = NULL);
+			~atmosphere_renderer_t();
+			atmosphere_renderer_t(const atmosphere_renderer_t&) = delete;
+			atmosphere_renderer_t& operator=(const atmosphere_renderer_t&) = delete;
+		public:
+			/// false when the sky program fails; the reference program is optional
+			bool init(const std::string& shader_root);
+			/// Sky where depth_texture holds 1, aerial perspective over the rest. camera is planet-centred; view and
+			/// proj are the ones the scene was drawn with, only the rotation of view is used. Changes the blend state.
+			void draw(const glm::vec3& camera, const glm::mat4& view, const glm::mat4& proj, const glm::vec3& sun_dir, const GLuint depth_texture);
+			/// sky only, ray marched without the scattering tables; what draw() is measured against
+			void draw_reference(const glm::vec3& camera, const glm::mat4& view, const glm::mat4& proj, const glm::vec3& sun_dir,
+				const uint32_t view_steps = 32, const uint32_t sun_steps = 16);
+		public:
+			inline const atmosphere_params_t& get_params(void) const { return this->settings_.params; }
+			inline const atmosphere_tables_t& get_tables(void) const { return this->tables_; }
+			inline const atmosphere_renderer_stats_t& get_stats(void) const { return this->stats_; }
+			inline bool is_reference_available(void) const { return this->reference_program_ != NULL; }
+			/// empty without a cache directory
+			std::string get_cache_path(void) const;
+		private:
+			void prepare_tables(void);
+			void upload_tables(void);
+			void bind(void);
+			void release(void);
+		private:
+			atmosphere_renderer_settings_t settings_;
+			Jobs::job_system_t* jobs_ = NULL;
+			atmosphere_renderer_stats_t stats_;
+			atmosphere_tables_t tables_;
+
+			std::unique_ptr<Graphics::glsl_program_t> program_;
+			std::unique_ptr<Graphics::glsl_program_t> reference_program_;
+			Graphics::uniform_t<glm::mat4> inv_view_proj_;
+			Graphics::uniform_t<glm::vec3> camera_;
+			Graphics::uniform_t<glm::vec3> sun_direction_;
+			Graphics::uniform_t<float> exposure_;
+			Graphics::uniform_t<glm::mat4> reference_inv_view_proj_;
+			Graphics::uniform_t<glm::vec3> reference_camera_;
+			Graphics::uniform_t<glm::vec3> reference_sun_direction_;
+			Graphics::uniform_t<float> reference_exposure_;
+			Graphics::uniform_t<GLint> reference_view_steps_;
+			Graphics::uniform_t<GLint> reference_sun_steps_;
+			/// transmittance, multiple scattering, scattering, irradiance
+			GLuint textures_[4] = {};
+			GLuint params_buffer_ = 0;
+			GLuint vao_ = 0;
+		};
+
+	}
+
+}
+#endif
@@ -0,0 +1,122 @@
+#include "file_io.h"
+
+#include "hash.h"
+
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Continuum;
+
+namespace FileIODetail
+{
+	inline unsigned long long process_id(void)
+	{
+#ifdef _WIN32
+		return static_cast<unsigned long long>(_getpid());
+#else
+		return static_cast<unsigned long long>(getpid());
+#endif
+	}
+
+	/// pushes what the C runtime and the OS buffered for file to the disk
+	inline bool flush_to_disk(FILE* file)
+	{
+		if (fflush(file) != 0) return false;
+#ifdef _WIN32
+		return _commit(_fileno(file)) == 0;
+#else
+		return fsync(fileno(file)) == 0;
+#endif
+	}
+
+	/// makes a rename inside directory durable; a no-op where directories cannot be opened (Windows)
+	inline void flush_directory(const std::filesystem::path& directory)
+	{
+#ifndef _WIN32
+		const int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+		if (fd < 0) return;
+		fsync(fd);
+		close(fd);
+#else
+		(void)directory;
+#endif
+	}
+}
+
+bool FileIO::write_file_atomic(const std::string& path, std::initializer_list<file_span_t> spans)
+{
+	std::error_code ec = {};
+	const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+	if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+
+	// process and thread, so that neither another thread nor another process writing the same path shares the temporary
+	char suffix[64] = {};
+	snprintf(suffix, sizeof(suffix), ".%llx.%016llx.tmp", FileIODetail::process_id(),
+		static_cast<unsigned long long>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+	const std::string temp_path = path + suffix;
+
+	FILE* file = fopen(temp_path.c_str(), "wb");
+	if (file == NULL) return false;
+	bool ok = true;
+	for (const file_span_t& span : spans)
+	{
+		if (span.size > 0 && fwrite(span.data, 1, span.size, file) != span.size) ok = false;
+	}
+	// the data has to be on disk before the rename is, or a crash can leave path naming an empty file
+	ok = ok && FileIODetail::flush_to_disk(file);
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+	FileIODetail::flush_directory(parent);
+	return true;
+}
+
+uint32_t FileIO::payload_checksum(std::initializer_list<file_span_t> spans)
+{
+	uint64_t h = Hash::k_fnv1a_offset;
+	for (const file_span_t& span : spans) h = Hash::fnv1a_64(span.data, span.size, h);
+	return static_cast<uint32_t>(h);
+}
+
+void FileIO::write_json_string(FILE* file, const char* text)
+{
+	fputc('"', file);
+	for (const char* c = text; *c != '\0'; ++c)
+	{
+		const unsigned char ch = static_cast<unsigned char>(*c);
+		switch (ch)
+		{
+		case '"': fputs("\\\"", file); break;
+		case '\\': fputs("\\\\", file); break;
+		case '\n': fputs("\\n", file); break;
+		case '\t': fputs("\\t", file); break;
+		case '\r': fputs("\\r", file); break;
+		case '\b': fputs("\\b", file); break;
+		case '\f': fputs("\\f", file); break;
+		default:
+			if (ch < 0x20) fprintf(file, "\\u%04x", ch);
+			else fputc(ch, file);
+			break;
+		}
+	}
+	fputc('"', file);
+}
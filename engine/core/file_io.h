@@ -0,0 +1,34 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <initializer_list>
+
+namespace Continuum {
+
+	namespace FileIO {
+
+		struct file_span_t
+		{
+			const void* data;
+			size_t size;
+		};
+
+		/// writes the spans back to back into a temporary next to path, flushes it to disk and renames it over path
+		/// (then flushes the directory), so a crash or a concurrent reader never sees a truncated file; missing parent
+		/// directories are created. Temporaries are named per process and thread, two writers of the same path each
+		/// rename a complete file. false leaves path untouched
+		bool write_file_atomic(const std::string& path, std::initializer_list<file_span_t> spans);
+		/// low 32 bits of FNV-1a over the spans in order, the payload checksum the cache file headers store
+		uint32_t payload_checksum(std::initializer_list<file_span_t> spans);
+
+		/// writes text as a quoted JSON string, escaping quotes, backslashes and control characters
+		void write_json_string(FILE* file, const char* text);
+
+	}
+
+}
+#endif
@@ -0,0 +1,112 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+using namespace Continuum;
+
+file_watcher_t::file_watcher_t(const std::string& root, const std::chrono::milliseconds poll_interval)
+	: root_(root)
+	, poll_interval_(poll_interval)
+	, last_scan_(std::chrono::steady_clock::now())
+{
+#if defined(__linux__)
+	this->fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (this->fd_ >= 0)
+	{
+		std::error_code ec = {};
+		add_watch(root);
+		for (auto it = std::filesystem::recursive_directory_iterator(root, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+		{
+			if (it->is_directory(ec)) add_watch(it->path());
+		}
+		return;
+	}
+#endif
+	// baseline for the polling fallback
+	scan(NULL);
+}
+
+file_watcher_t::~file_watcher_t()
+{
+#if defined(__linux__)
+	if (this->fd_ >= 0) close(this->fd_);
+#endif
+}
+
+std::vector<std::string> file_watcher_t::poll(void)
+{
+	std::vector<std::string> changed = {};
+
+#if defined(__linux__)
+	if (this->fd_ >= 0)
+	{
+		alignas(inotify_event) char buffer[4096];
+		while (true)
+		{
+			const ssize_t length = read(this->fd_, buffer, sizeof(buffer));
+			if (length <= 0) break; // EAGAIN, nothing pending
+
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+
+				const auto dir = this->watches_.find(event->wd);
+				if (dir == this->watches_.end() || event->len == 0) continue;
+
+				const std::filesystem::path path = dir->second / event->name;
+				if (event->mask & IN_ISDIR)
+				{
+					if (event->mask & (IN_CREATE | IN_MOVED_TO)) add_watch(path);
+					continue;
+				}
+				changed.push_back(path.generic_string());
+			}
+		}
+		std::sort(changed.begin(), changed.end());
+		changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+		return changed;
+	}
+#endif
+
+	const auto now = std::chrono::steady_clock::now();
+	if (now - this->last_scan_ < this->poll_interval_) return changed;
+	this->last_scan_ = now;
+	scan(&changed);
+	return changed;
+}
+
+void file_watcher_t::add_watch(const std::filesystem::path& directory)
+{
+#if defined(__linux__)
+	// editors either rewrite in place (close-write) or write a temporary file and rename it (moved-to)
+	const int wd = inotify_add_watch(this->fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (wd >= 0) this->watches_[wd] = directory;
+#else
+	(void)directory;
+#endif
+}
+
+void file_watcher_t::scan(std::vector<std::string>* changed)
+{
+	std::error_code ec = {};
+	for (auto it = std::filesystem::recursive_directory_iterator(this->root_, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+	{
+		if (!it->is_regular_file(ec)) continue;
+
+		const std::string path = it->path().generic_string();
+		const std::filesystem::file_time_type mtime = it->last_write_time(ec);
+		const auto known = this->mtimes_.find(path);
+		if (known == this->mtimes_.end() || known->second != mtime)
+		{
+			if (changed != NULL && known != this->mtimes_.end()) changed->push_back(path);
+			this->mtimes_[path] = mtime;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <filesystem>
+
+namespace Continuum {
+
+	/// Reports files written under a directory tree. Uses inotify on Linux, elsewhere it falls back to
+	/// comparing modification times at most every poll_interval. poll() never blocks.
+	struct file_watcher_t
+	{
+		explicit file_watcher_t(const std::string& root, const std::chrono::milliseconds poll_interval = std::chrono::milliseconds(500));
+		~file_watcher_t();
+		file_watcher_t(const file_watcher_t&) = delete;
+		file_watcher_t& operator=(const file_watcher_t&) = delete;
+	public:
+		/// files created, written or moved into the tree since the last call, each reported once
+		std::vector<std::string> poll(void);
+		inline bool is_native(void) const { return this->fd_ >= 0; }
+		inline const std::string& get_root(void) const { return this->root_; }
+	private:
+		void add_watch(const std::filesystem::path& directory);
+		void scan(std::vector<std::string>* changed);
+	private:
+		std::string root_;
+		int fd_ = -1;
+		std::map<int, std::filesystem::path> watches_;
+		std::chrono::milliseconds poll_interval_;
+		std::chrono::steady_clock::time_point last_scan_;
+		std::map<std::string, std::filesystem::file_time_type> mtimes_;
+	};
+
+}
+#endif
@@ -38,6 +38,10 @@ namespace Continuum {
 		public:
 			virtual glm::mat4 get_view_matrix() const = 0;
 			virtual glm::vec3 get_position() const = 0;
+			/// planet-scale scenes keep world positions in double and draw relative to the camera: offsets from
+			/// get_world_position() are taken in double, rounded to float, and rotated by get_view_rotation()
+			virtual glm::dvec3 get_world_position() const { return glm::dvec3(get_position()); }
+			virtual glm::mat4 get_view_rotation() const { return glm::mat4(glm::mat3(get_view_matrix())); }
 		};
 
 		struct camera_t final
@@ -50,6 +54,8 @@ namespace Continuum {
 		public:
 			inline glm::mat4 get_view_matrix() const { return positioner_->get_view_matrix(); }
 			inline glm::vec3 get_position() const { return positioner_->get_position(); }
+			inline glm::dvec3 get_world_position() const { return positioner_->get_world_position(); }
+			inline glm::mat4 get_view_rotation() const { return positioner_->get_view_rotation(); }
 		private:
 			const CameraPositionerInterface* positioner_; 
 		};
@@ -58,7 +64,7 @@ namespace Continuum {
 		{
 			OrbCameraPositioner() = default;
 			OrbCameraPositioner(const glm::vec3& camera_pos, const glm::vec3& target, const glm::vec3& up)
-				: camera_position_(camera_pos)
+				: camera_position_(glm::dvec3(camera_pos))
 				, camera_orientation_(glm::lookAt(camera_pos, target, up))
 				, up_(up)
 			{}
@@ -107,32 +113,42 @@ namespace Continuum {
 					if (glm::length(this->move_speed_) > max_speed) this->move_speed_ = glm::normalize(this->move_speed_) * max_speed;
 				}
 
-				this->camera_position_ += this->move_speed_ * static_cast<float>(delta_sec);
+				this->camera_position_ += glm::dvec3(this->move_speed_) * delta_sec;
 			}
 		public:
 			virtual glm::mat4 get_view_matrix() const override
 			{
-				const glm::mat4 t = glm::translate(glm::mat4(1.0f), -this->camera_position_);
+				const glm::mat4 t = glm::translate(glm::mat4(1.0f), -glm::vec3(this->camera_position_));
 				const glm::mat4 r = glm::mat4_cast(this->camera_orientation_);
 				return r * t;
 			}
 			virtual glm::vec3 get_position() const override
 			{
-				return this->camera_position_;
+				return glm::vec3(this->camera_position_);
 			}
+			virtual glm::dvec3 get_world_position() const override { return this->camera_position_; }
+			virtual glm::mat4 get_view_rotation() const override { return glm::mat4_cast(this->camera_orientation_); }
 		public:
-			void set_position(const glm::vec3& camera_pos) { this->camera_position_ = camera_pos; }
+			void set_position(const glm::vec3& camera_pos) { this->camera_position_ = glm::dvec3(camera_pos); }
+			inline void set_world_position(const glm::dvec3& camera_pos) { this->camera_position_ = camera_pos; }
+			inline glm::quat get_orientation(void) const { return this->camera_orientation_; }
+			inline void set_orientation(const glm::quat& orientation) { this->camera_orientation_ = orientation; }
 			void reset_mouse_position(const glm::vec2& mouse_pos) { this->mouse_position_ = mouse_pos; };
 			void set_up_vector(const glm::vec3& up)
 			{
-				const glm::mat4 view = get_view_matrix();
+				const glm::mat4 view = get_view_rotation();
 				const glm::vec3 dir = -glm::vec3(view[0][2], view[1][2], view[2][2]);
-				this->camera_orientation_ = glm::lookAt(this->camera_position_, this->camera_position_ + dir, up);
+				this->camera_orientation_ = glm::lookAt(glm::vec3(0.0f), dir, up);
 			}
 			inline void look_at(const glm::vec3& camera_pos, const glm::vec3& target, const glm::vec3& up) {
-				this->camera_position_ = camera_pos;
+				this->camera_position_ = glm::dvec3(camera_pos);
 				this->camera_orientation_ = glm::lookAt(camera_pos, target, up);
 			}
+			/// the direction is taken in double, only the rotation ends up in float
+			inline void look_at(const glm::dvec3& camera_pos, const glm::dvec3& target, const glm::vec3& up) {
+				this->camera_position_ = camera_pos;
+				this->camera_orientation_ = glm::lookAt(glm::vec3(0.0f), glm::vec3(target - camera_pos), up);
+			}
 		public:
 			struct movement_t
 			{
@@ -153,7 +169,8 @@ namespace Continuum {
 			float fast_coef_ = 10.0f;
 		private:
 			glm::vec2 mouse_position_ = glm::vec2(0);
-			glm::vec3 camera_position_ = glm::vec3(0.0f, 10.0f, 10.0f);
+			/// double, float would round to half a metre at planet radius
+			glm::dvec3 camera_position_ = glm::dvec3(0.0, 10.0, 10.0);
 			glm::quat camera_orientation_ = glm::quat(glm::vec3(0));
 			glm::vec3 move_speed_ = glm::vec3(0.0f);
 			glm::vec3 up_ = glm::vec3(0.0f, 0.0f, 1.0f);
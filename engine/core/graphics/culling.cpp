@@ -0,0 +1,229 @@
+#include "culling.h"
+
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <algorithm>
+
+using namespace Continuum;
+using namespace Continuum::Graphics;
+
+frustum_t frustum_t::from_matrix(const glm::mat4& view_proj)
+{
+	const glm::mat4& m = view_proj;
+	const glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	frustum_t frustum = {};
+	frustum.planes[0] = row3 + row0;
+	frustum.planes[1] = row3 - row0;
+	frustum.planes[2] = row3 + row1;
+	frustum.planes[3] = row3 - row1;
+	frustum.planes[4] = row3 + row2;
+	frustum.planes[5] = row3 - row2;
+	for (glm::vec4& plane : frustum.planes)
+	{
+		const float length = glm::length(glm::vec3(plane));
+		// an infinite (or float-collapsed) far plane rejects nothing
+		plane = length > 1e-6f ? plane / length : glm::vec4(0.0f, 0.0f, 0.0f, FLT_MAX);
+	}
+	return frustum;
+}
+
+size_t CullingDetail::cull_scalar(const bounding_spheres_t& spheres, const frustum_t& frustum, const horizon_terms_t& horizon,
+	const size_t begin, const size_t end, uint32_t* out, uint32_t& frustum_culled, uint32_t& horizon_culled)
+{
+	size_t written = 0;
+	for (size_t i = begin; i < end; ++i)
+	{
+		const float x = spheres.x[i];
+		const float y = spheres.y[i];
+		const float z = spheres.z[i];
+		const float r = spheres.radius[i];
+
+		bool inside = true;
+		for (const glm::vec4& p : frustum.planes)
+		{
+			const float dist = p.x * x + p.y * y + p.z * z + p.w;
+			inside = inside && (dist >= -r);
+		}
+		if (!inside)
+		{
+			++frustum_culled;
+			continue;
+		}
+
+		if (horizon.enabled)
+		{
+			// past the horizon plane: dot(P, C) / |C| + r < R^2 / |C|
+			const float pc = x * horizon.c.x + y * horizon.c.y + z * horizon.c.z;
+			const bool beyond = pc + r * horizon.d < horizon.radius_sq;
+
+			// inside the tangent cone by at least r: v_par * R - |v_perp| * h >= r * |C|
+			const float vx = x - horizon.c.x;
+			const float vy = y - horizon.c.y;
+			const float vz = z - horizon.c.z;
+			const float v_sq = vx * vx + vy * vy + vz * vz;
+			const float v_par = -(vx * horizon.c.x + vy * horizon.c.y + vz * horizon.c.z) / horizon.d;
+			const float v_perp = std::sqrt(std::max(v_sq - v_par * v_par, 0.0f));
+			const bool in_cone = v_par * horizon.radius - v_perp * horizon.h >= r * horizon.d;
+
+			if (beyond && in_cone)
+			{
+				++horizon_culled;
+				continue;
+			}
+		}
+
+		out[written++] = static_cast<uint32_t>(i);
+	}
+	return written;
+}
+
+void Graphics::cull_spheres(const bounding_spheres_t& spheres, const frustum_t& frustum, const horizon_occluder_t* horizon,
+	std::vector<uint32_t>& visible, cull_stats_t* stats)
+{
+	cull_spheres(spheres, frustum, horizon, visible, stats, Simd::detect());
+}
+
+void Graphics::cull_spheres(const bounding_spheres_t& spheres, const frustum_t& frustum, const horizon_occluder_t* horizon,
+	std::vector<uint32_t>& visible, cull_stats_t* stats, const Simd::SimdLevel level)
+{
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	CullingDetail::horizon_terms_t terms = {};
+	if (horizon != NULL)
+	{
+		const float d_sq = glm::dot(horizon->camera_pos, horizon->camera_pos);
+		const float r_sq = horizon->planet_radius * horizon->planet_radius;
+		// below the surface nothing is behind the horizon
+		terms.enabled = d_sq > r_sq;
+		terms.c = horizon->camera_pos;
+		terms.d = std::sqrt(d_sq);
+		terms.h = terms.enabled ? std::sqrt(d_sq - r_sq) : 0.0f;
+		terms.radius = horizon->planet_radius;
+		terms.radius_sq = r_sq;
+	}
+
+	const size_t count = spheres.size();
+	visible.resize(count);
+	uint32_t frustum_culled = 0;
+	uint32_t horizon_culled = 0;
+	size_t written = 0;
+	size_t done = 0;
+
+#if CONTINUUM_SIMD_X86
+	if (std::min(level, Simd::detect()) >= Simd::SimdLevel::AVX2)
+	{
+		done = count & ~size_t(7);
+		written = CullingDetail::cull_avx2(spheres, frustum, terms, 0, done, visible.data(), frustum_culled, horizon_culled);
+	}
+#endif
+	(void)level;
+	written += CullingDetail::cull_scalar(spheres, frustum, terms, done, count, visible.data() + written, frustum_culled, horizon_culled);
+	visible.resize(written);
+
+	if (stats != NULL)
+	{
+		const auto t1 = std::chrono::high_resolution_clock::now();
+		stats->tested = static_cast<uint32_t>(count);
+		stats->visible = static_cast<uint32_t>(written);
+		stats->frustum_culled = frustum_culled;
+		stats->horizon_culled = horizon_culled;
+		stats->ns_per_sphere = count > 0 ? std::chrono::duration<double, std::nano>(t1 - t0).count() / double(count) : 0.0;
+	}
+}
+
+void hiz_pyramid_t::build(const float* depth, const uint32_t depth_width, const uint32_t depth_height)
+{
+	this->width = depth_width;
+	this->height = depth_height;
+	this->levels.clear();
+	if (depth_width == 0 || depth_height == 0) return;
+
+	uint32_t level_count = 1;
+	while ((std::max(depth_width, depth_height) >> level_count) > 0) ++level_count;
+	this->levels.resize(level_count);
+	this->levels[0].assign(depth, depth + size_t(depth_width) * depth_height);
+
+	for (uint32_t level = 1; level < level_count; ++level)
+	{
+		const uint32_t in_width = get_level_width(level - 1);
+		const uint32_t in_height = get_level_height(level - 1);
+		const uint32_t out_width = get_level_width(level);
+		const uint32_t out_height = get_level_height(level);
+		const std::vector<float>& in = this->levels[level - 1];
+		std::vector<float>& out = this->levels[level];
+		out.resize(size_t(out_width) * out_height);
+
+		for (uint32_t y = 0; y < out_height; ++y)
+		{
+			// the last texel of an odd level also takes the row or column left over below it
+			const uint32_t y_end = std::min((y == out_height - 1 && (in_height & 1) != 0) ? 2 * y + 3 : 2 * y + 2, in_height);
+			for (uint32_t x = 0; x < out_width; ++x)
+			{
+				const uint32_t x_end = std::min((x == out_width - 1 && (in_width & 1) != 0) ? 2 * x + 3 : 2 * x + 2, in_width);
+				float farthest = 0.0f;
+				for (uint32_t sy = std::min(2 * y, in_height - 1); sy < y_end; ++sy)
+				{
+					for (uint32_t sx = std::min(2 * x, in_width - 1); sx < x_end; ++sx) farthest = std::max(farthest, in[size_t(sy) * in_width + sx]);
+				}
+				out[size_t(y) * out_width + x] = farthest;
+			}
+		}
+	}
+}
+
+bool Graphics::hiz_occluded(const hiz_pyramid_t& pyramid, const glm::mat4& view_proj, const glm::vec3& center, const float radius)
+{
+	if (pyramid.levels.empty()) return false;
+
+	glm::vec3 lo = glm::vec3(FLT_MAX);
+	glm::vec3 hi = glm::vec3(-FLT_MAX);
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const glm::vec3 corner = center + radius * glm::vec3((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f);
+		const glm::vec4 clip = view_proj * glm::vec4(corner, 1.0f);
+		// in front of the near plane the rectangle is unbounded
+		if (clip.w <= 0.0f || clip.z < -clip.w) return false;
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		lo = glm::min(lo, ndc);
+		hi = glm::max(hi, ndc);
+	}
+	if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f) return false;
+
+	const int32_t w = int32_t(pyramid.width);
+	const int32_t h = int32_t(pyramid.height);
+	const int32_t x0 = std::clamp(int32_t(std::floor((lo.x * 0.5f + 0.5f) * float(w))), 0, w - 1);
+	const int32_t x1 = std::clamp(int32_t(std::floor((hi.x * 0.5f + 0.5f) * float(w))), 0, w - 1);
+	const int32_t y0 = std::clamp(int32_t(std::floor((lo.y * 0.5f + 0.5f) * float(h))), 0, h - 1);
+	const int32_t y1 = std::clamp(int32_t(std::floor((hi.y * 0.5f + 0.5f) * float(h))), 0, h - 1);
+
+	uint32_t level = 0;
+	while (level + 1 < pyramid.get_level_count() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) ++level;
+	const uint32_t last_x = pyramid.get_level_width(level) - 1;
+	const uint32_t last_y = pyramid.get_level_height(level) - 1;
+	const uint32_t tx0 = std::min(uint32_t(x0) >> level, last_x);
+	const uint32_t tx1 = std::min(uint32_t(x1) >> level, last_x);
+	const uint32_t ty0 = std::min(uint32_t(y0) >> level, last_y);
+	const uint32_t ty1 = std::min(uint32_t(y1) >> level, last_y);
+	const float farthest = std::max(std::max(pyramid.fetch(level, tx0, ty0), pyramid.fetch(level, tx1, ty0)),
+		std::max(pyramid.fetch(level, tx0, ty1), pyramid.fetch(level, tx1, ty1)));
+
+	return lo.z * 0.5f + 0.5f > farthest;
+}
+
+void Graphics::cull_occluded(const bounding_spheres_t& spheres, const hiz_pyramid_t& pyramid, const glm::mat4& view_proj,
+	std::vector<uint32_t>& visible, cull_stats_t* stats)
+{
+	size_t written = 0;
+	for (const uint32_t index : visible)
+	{
+		const glm::vec3 center = glm::vec3(spheres.x[index], spheres.y[index], spheres.z[index]);
+		if (!hiz_occluded(pyramid, view_proj, center, spheres.radius[index])) visible[written++] = index;
+	}
+	if (stats != NULL) stats->occlusion_culled = static_cast<uint32_t>(visible.size() - written);
+	visible.resize(written);
+}
@@ -0,0 +1,118 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "../simd.h"
+
+namespace Continuum {
+
+	namespace Graphics {
+
+		/// bounding spheres in structure-of-arrays form, tested 8 at a time by the AVX2 path
+		struct bounding_spheres_t
+		{
+			std::vector<float> x;
+			std::vector<float> y;
+			std::vector<float> z;
+			std::vector<float> radius;
+		public:
+			inline void clear(void) { x.clear(); y.clear(); z.clear(); radius.clear(); }
+			inline void reserve(const size_t count) { x.reserve(count); y.reserve(count); z.reserve(count); radius.reserve(count); }
+			inline void push_back(const glm::vec3& center, const float r) { x.push_back(center.x); y.push_back(center.y); z.push_back(center.z); radius.push_back(r); }
+			inline size_t size(void) const { return x.size(); }
+		};
+
+		struct frustum_t
+		{
+			/// left, right, bottom, top, near, far; xyz is the inward unit normal, w the distance
+			glm::vec4 planes[6] = {};
+		public:
+			/// Gribb/Hartmann extraction from proj * view
+			static frustum_t from_matrix(const glm::mat4& view_proj);
+		};
+
+		/// planet horizon occlusion: anything inside the cone from the camera tangent to the planet and
+		/// past the horizon plane is hidden by the planet itself
+		struct horizon_occluder_t
+		{
+			/// camera position relative to the planet center
+			glm::vec3 camera_pos = glm::vec3(0.0f);
+			float planet_radius = 0.0f;
+		};
+
+		struct cull_stats_t
+		{
+			uint32_t tested = 0;
+			uint32_t visible = 0;
+			uint32_t frustum_culled = 0;
+			uint32_t horizon_culled = 0;
+			/// cull_occluded() only
+			uint32_t occlusion_culled = 0;
+			double ns_per_sphere = 0.0;
+		};
+
+		/// Hierarchical-Z pyramid of a depth buffer (window depth, 0 near, 1 far), the farthest depth per texel.
+		/// Level sizes halve rounding down like a GL mip chain; odd levels fold their last row and column into
+		/// the texels next to them, so pixel p of level 0 always lies in texel min(p >> l, size_l - 1) of level l.
+		/// CPU reference of shader/culling/hiz_build.cs.
+		struct hiz_pyramid_t
+		{
+			uint32_t width = 0;
+			uint32_t height = 0;
+			std::vector<std::vector<float>> levels;
+		public:
+			void build(const float* depth, const uint32_t depth_width, const uint32_t depth_height);
+			inline uint32_t get_level_count(void) const { return static_cast<uint32_t>(levels.size()); }
+			inline uint32_t get_level_width(const uint32_t level) const { return std::max(this->width >> level, 1u); }
+			inline uint32_t get_level_height(const uint32_t level) const { return std::max(this->height >> level, 1u); }
+			inline float fetch(const uint32_t level, const uint32_t x, const uint32_t y) const { return this->levels[level][size_t(y) * get_level_width(level) + x]; }
+		};
+
+		/// True when the sphere is certainly hidden in the depth the pyramid was built from: the nearest depth of
+		/// its bounding box lies behind the farthest depth over the box's screen rectangle, read from the level
+		/// where the rectangle spans at most 2x2 texels. view_proj is what that depth was rendered with; boxes
+		/// reaching past the near plane or entirely off screen are never occluded.
+		/// CPU reference of shader/culling/hiz_cull.cs.
+		bool hiz_occluded(const hiz_pyramid_t& pyramid, const glm::mat4& view_proj, const glm::vec3& center, const float radius);
+		/// drops the entries of visible whose spheres are occluded, in order; sets stats->occlusion_culled
+		void cull_occluded(const bounding_spheres_t& spheres, const hiz_pyramid_t& pyramid, const glm::mat4& view_proj,
+			std::vector<uint32_t>& visible, cull_stats_t* stats = NULL);
+
+		/// writes the indices of the spheres passing the frustum and (optional) horizon test into visible, in order
+		void cull_spheres(const bounding_spheres_t& spheres, const frustum_t& frustum, const horizon_occluder_t* horizon,
+			std::vector<uint32_t>& visible, cull_stats_t* stats = NULL);
+		void cull_spheres(const bounding_spheres_t& spheres, const frustum_t& frustum, const horizon_occluder_t* horizon,
+			std::vector<uint32_t>& visible, cull_stats_t* stats, const Simd::SimdLevel level);
+
+		namespace CullingDetail {
+			/// precomputed horizon terms shared by the scalar and AVX2 kernels
+			struct horizon_terms_t
+			{
+				bool enabled = false;
+				glm::vec3 c = glm::vec3(0.0f);
+				/// |c|, sqrt(|c|^2 - R^2), R, R^2
+				float d = 0.0f;
+				float h = 0.0f;
+				float radius = 0.0f;
+				float radius_sq = 0.0f;
+			};
+
+			/// range [begin, end), returns the number of indices written to out; counts go to the culled counters
+			size_t cull_scalar(const bounding_spheres_t& spheres, const frustum_t& frustum, const horizon_terms_t& horizon,
+				const size_t begin, const size_t end, uint32_t* out, uint32_t& frustum_culled, uint32_t& horizon_culled);
+#if CONTINUUM_SIMD_X86
+			size_t cull_avx2(const bounding_spheres_t& spheres, const frustum_t& frustum, const horizon_terms_t& horizon,
+				const size_t begin, const size_t end, uint32_t* out, uint32_t& frustum_culled, uint32_t& horizon_culled);
+#endif
+		}
+
+	}
+
+}
+#endif
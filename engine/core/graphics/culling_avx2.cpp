@@ -0,0 +1,90 @@
+// Compiled with AVX2 enabled (see CMakeLists.txt), only called after Simd::detect() reported support.
+#include "culling.h"
+
+#if CONTINUUM_SIMD_X86
+
+#include <immintrin.h>
+
+using namespace Continuum::Graphics;
+
+size_t CullingDetail::cull_avx2(const bounding_spheres_t& spheres, const frustum_t& frustum, const horizon_terms_t& horizon,
+	const size_t begin, const size_t end, uint32_t* out, uint32_t& frustum_culled, uint32_t& horizon_culled)
+{
+	__m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		plane_x[p] = _mm256_set1_ps(frustum.planes[p].x);
+		plane_y[p] = _mm256_set1_ps(frustum.planes[p].y);
+		plane_z[p] = _mm256_set1_ps(frustum.planes[p].z);
+		plane_w[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+	const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 cx = _mm256_set1_ps(horizon.c.x);
+	const __m256 cy = _mm256_set1_ps(horizon.c.y);
+	const __m256 cz = _mm256_set1_ps(horizon.c.z);
+	const __m256 d = _mm256_set1_ps(horizon.d);
+	const __m256 h = _mm256_set1_ps(horizon.h);
+	const __m256 radius = _mm256_set1_ps(horizon.radius);
+	const __m256 radius_sq = _mm256_set1_ps(horizon.radius_sq);
+
+	size_t written = 0;
+	for (size_t i = begin; i < end; i += 8)
+	{
+		const __m256 x = _mm256_loadu_ps(spheres.x.data() + i);
+		const __m256 y = _mm256_loadu_ps(spheres.y.data() + i);
+		const __m256 z = _mm256_loadu_ps(spheres.z.data() + i);
+		const __m256 r = _mm256_loadu_ps(spheres.radius.data() + i);
+		const __m256 neg_r = _mm256_xor_ps(r, sign_mask);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m256 dist = _mm256_mul_ps(plane_x[p], x);
+			dist = _mm256_add_ps(dist, _mm256_mul_ps(plane_y[p], y));
+			dist = _mm256_add_ps(dist, _mm256_mul_ps(plane_z[p], z));
+			dist = _mm256_add_ps(dist, plane_w[p]);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, neg_r, _CMP_GE_OQ));
+		}
+		const int inside_bits = _mm256_movemask_ps(inside);
+
+		int visible_bits = inside_bits;
+		if (horizon.enabled && inside_bits != 0)
+		{
+			__m256 pc = _mm256_mul_ps(x, cx);
+			pc = _mm256_add_ps(pc, _mm256_mul_ps(y, cy));
+			pc = _mm256_add_ps(pc, _mm256_mul_ps(z, cz));
+			const __m256 beyond = _mm256_cmp_ps(_mm256_add_ps(pc, _mm256_mul_ps(r, d)), radius_sq, _CMP_LT_OQ);
+
+			const __m256 vx = _mm256_sub_ps(x, cx);
+			const __m256 vy = _mm256_sub_ps(y, cy);
+			const __m256 vz = _mm256_sub_ps(z, cz);
+			__m256 v_sq = _mm256_mul_ps(vx, vx);
+			v_sq = _mm256_add_ps(v_sq, _mm256_mul_ps(vy, vy));
+			v_sq = _mm256_add_ps(v_sq, _mm256_mul_ps(vz, vz));
+			__m256 vc = _mm256_mul_ps(vx, cx);
+			vc = _mm256_add_ps(vc, _mm256_mul_ps(vy, cy));
+			vc = _mm256_add_ps(vc, _mm256_mul_ps(vz, cz));
+			const __m256 v_par = _mm256_div_ps(_mm256_xor_ps(vc, sign_mask), d);
+			const __m256 v_perp = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(v_sq, _mm256_mul_ps(v_par, v_par)), zero));
+			const __m256 cone = _mm256_sub_ps(_mm256_mul_ps(v_par, radius), _mm256_mul_ps(v_perp, h));
+			const __m256 in_cone = _mm256_cmp_ps(cone, _mm256_mul_ps(r, d), _CMP_GE_OQ);
+
+			const int occluded_bits = _mm256_movemask_ps(_mm256_and_ps(beyond, in_cone)) & inside_bits;
+			visible_bits = inside_bits & ~occluded_bits;
+		}
+
+		// compact the surviving lanes into the output list; the write is unconditional, only the cursor moves
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			const int bit = (visible_bits >> lane) & 1;
+			out[written] = static_cast<uint32_t>(i + lane);
+			written += static_cast<size_t>(bit);
+			frustum_culled += static_cast<uint32_t>(((inside_bits >> lane) & 1) ^ 1);
+			horizon_culled += static_cast<uint32_t>(((inside_bits & ~visible_bits) >> lane) & 1);
+		}
+	}
+	return written;
+}
+
+#endif
@@ -0,0 +1,309 @@
+#include "async_shader_compiler.h"
+
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+using namespace Continuum;
+using namespace Continuum::Graphics;
+
+static std::string normalize_path(const std::string& path)
+{
+	return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+async_shader_compiler_t::async_shader_compiler_t(Jobs::job_system_t* jobs, const shader_link_context_t& link_context)
+	: jobs_(jobs)
+{
+	// let the driver use as many compiler threads as it likes
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xffffffffu);
+		this->parallel_compile_ = true;
+	}
+	else if (GLEW_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(0xffffffffu);
+		this->parallel_compile_ = true;
+	}
+	else if (link_context.is_valid())
+	{
+		this->link_thread_ = std::thread([this, link_context]() { link_thread_main(link_context); });
+	}
+}
+
+async_shader_compiler_t::~async_shader_compiler_t()
+{
+	// a link in progress finishes, queued ones are dropped with the rest
+	if (this->link_thread_.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->link_mutex_);
+			this->link_stop_ = true;
+		}
+		this->link_wake_.notify_one();
+		this->link_thread_.join();
+	}
+	for (std::unique_ptr<build_t>& build : this->builds_)
+	{
+		if (this->jobs_ != NULL) this->jobs_->wait(build->read_done);
+		release(*build);
+	}
+	this->builds_.clear();
+}
+
+void async_shader_compiler_t::watch_program(glsl_program_t& program, const std::vector<std::string>& files, const shader_permutation_t& permutation)
+{
+	std::vector<std::string> normalized = {};
+	for (const std::string& file : files) normalized.push_back(normalize_path(file));
+	// the program was just built from these files, reading them once more only collects the includes
+	std::vector<std::string> includes = {};
+	std::string source = {};
+	for (const std::string& file : files) GLSLUtils::read_file(file.c_str(), source, &includes);
+	this->watched_.push_back({ &program, normalized, permutation, includes });
+}
+
+void async_shader_compiler_t::notify_file_changed(const std::string& path)
+{
+	const std::string normalized = normalize_path(path);
+	for (const watched_t& watched : this->watched_)
+	{
+		const bool source = std::find(watched.files.begin(), watched.files.end(), normalized) != watched.files.end();
+		if (source || std::find(watched.includes.begin(), watched.includes.end(), normalized) != watched.includes.end())
+		{
+			request_build(*watched.program, watched.files, watched.permutation);
+		}
+	}
+}
+
+void async_shader_compiler_t::request_build(glsl_program_t& program, const std::vector<std::string>& files, const shader_permutation_t& permutation)
+{
+	// a newer edit wins even if the older build happens to finish later
+	for (std::unique_ptr<build_t>& build : this->builds_)
+	{
+		if (build->program == &program) build->superseded = true;
+	}
+
+	std::unique_ptr<build_t> build = std::make_unique<build_t>();
+	build->program = &program;
+	build->files = files;
+	build->permutation = permutation;
+
+	build_t* target = build.get();
+	if (this->jobs_ != NULL) this->jobs_->submit([target]() { read_sources(*target); }, &build->read_done);
+	else read_sources(*target);
+
+	this->builds_.push_back(std::move(build));
+	++this->stats_.queued;
+}
+
+void async_shader_compiler_t::update(void)
+{
+	for (size_t i = 0; i < this->builds_.size();)
+	{
+		build_t& build = *this->builds_[i];
+		bool done = false;
+
+		if (build.state == build_t::READING && build.read_done.is_done())
+		{
+			// an edit can add or drop includes, follow what the sources pull in now; a missing include is listed too,
+			// so creating it triggers the next build
+			if (!build.superseded)
+			{
+				for (watched_t& watched : this->watched_)
+				{
+					if (watched.program == build.program && watched.files == build.files) watched.includes = build.includes;
+				}
+			}
+			if (!build.read_error.empty() || build.superseded)
+			{
+				if (!build.superseded)
+				{
+					std::cout << build.read_error << std::endl;
+					++this->stats_.failed;
+				}
+				else ++this->stats_.superseded;
+				done = true;
+			}
+			else if (has_link_thread())
+			{
+				build.state = build_t::LINKING;
+				{
+					std::lock_guard<std::mutex> lock(this->link_mutex_);
+					this->link_queue_.push_back(&build);
+				}
+				this->link_wake_.notify_one();
+			}
+			else
+			{
+				start_compile(build);
+			}
+		}
+		else if (build.state == build_t::LINKING && is_link_complete(build))
+		{
+			finish(build);
+			done = true;
+		}
+
+		if (done)
+		{
+			release(build);
+			this->builds_.erase(this->builds_.begin() + i);
+		}
+		else ++i;
+	}
+}
+
+void async_shader_compiler_t::read_sources(build_t& build)
+{
+	try
+	{
+		for (const std::string& file : build.files)
+		{
+			std::string source = {};
+			if (!GLSLUtils::read_file(file.c_str(), source, &build.includes))
+			{
+				build.read_error = "Unable to open: " + file;
+				return;
+			}
+			build.types.push_back(GLSLUtils::get_shader_type(file.c_str()));
+			build.sources.push_back(build.permutation.apply(source));
+		}
+	}
+	catch (const GLSLProgramException& e)
+	{
+		build.read_error = e.what();
+	}
+}
+
+void async_shader_compiler_t::link_thread_main(const shader_link_context_t& link_context)
+{
+	link_context.make_current();
+	for (;;)
+	{
+		build_t* build = NULL;
+		{
+			std::unique_lock<std::mutex> lock(this->link_mutex_);
+			this->link_wake_.wait(lock, [this]() { return this->link_stop_ || !this->link_queue_.empty(); });
+			if (this->link_stop_) break;
+			build = this->link_queue_.front();
+			this->link_queue_.pop_front();
+		}
+
+		// the status queries block this thread only
+		start_compile(*build);
+		glGetProgramiv(build->handle, GL_LINK_STATUS, &build->link_status);
+		if (build->link_status == GL_FALSE) build->link_log = get_failure_log(*build);
+		build->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+		build->linked.store(true, std::memory_order_release);
+	}
+	if (link_context.release_current != nullptr) link_context.release_current();
+}
+
+void async_shader_compiler_t::start_compile(build_t& build) const
+{
+	build.handle = glCreateProgram();
+	for (size_t i = 0; i < build.sources.size(); ++i)
+	{
+		const GLuint shader = glCreateShader(build.types[i]);
+		const char* c_code = build.sources[i].c_str();
+		glShaderSource(shader, 1, &c_code, NULL);
+		glCompileShader(shader);
+		glAttachShader(build.handle, shader);
+		build.shaders.push_back(shader);
+	}
+	// issued right away, compile errors surface as a link failure and are reported per stage in finish()
+	glLinkProgram(build.handle);
+	build.state = build_t::LINKING;
+}
+
+bool async_shader_compiler_t::is_link_complete(build_t& build) const
+{
+	if (this->parallel_compile_)
+	{
+		GLint complete = GL_FALSE;
+		glGetProgramiv(build.handle, GL_COMPLETION_STATUS_KHR, &complete);
+		return complete == GL_TRUE;
+	}
+	if (has_link_thread())
+	{
+		if (!build.linked.load(std::memory_order_acquire)) return false;
+		// the worker's context flushed the program, this one may use it once the fence has passed
+		return glClientWaitSync(build.fence, 0, 0) != GL_TIMEOUT_EXPIRED;
+	}
+	// no extension and no link thread: the status query may block, give the driver a frame of head start
+	return ++build.frames_waited > 1;
+}
+
+std::string async_shader_compiler_t::get_failure_log(const build_t& build)
+{
+	std::string msg = "Shader hot reload failed, keeping the previous program.\n";
+	for (size_t i = 0; i < build.shaders.size(); ++i)
+	{
+		GLint compiled = GL_FALSE;
+		glGetShaderiv(build.shaders[i], GL_COMPILE_STATUS, &compiled);
+		if (compiled == GL_TRUE) continue;
+
+		GLint length = 0;
+		glGetShaderiv(build.shaders[i], GL_INFO_LOG_LENGTH, &length);
+		msg += build.files[i] + ": shader compilation failed.\n";
+		if (length > 0)
+		{
+			std::string log(length, ' ');
+			glGetShaderInfoLog(build.shaders[i], length, NULL, &log[0]);
+			msg += log;
+		}
+	}
+
+	GLint length = 0;
+	glGetProgramiv(build.handle, GL_INFO_LOG_LENGTH, &length);
+	if (length > 0)
+	{
+		std::string log(length, ' ');
+		glGetProgramInfoLog(build.handle, length, NULL, &log[0]);
+		msg += "Program link failed:\n" + log;
+	}
+	return msg;
+}
+
+void async_shader_compiler_t::finish(build_t& build)
+{
+	// the link thread has queried the status already, the build is only here once it is known
+	GLint link_status = build.link_status;
+	if (!has_link_thread()) glGetProgramiv(build.handle, GL_LINK_STATUS, &link_status);
+
+	if (link_status == GL_FALSE)
+	{
+		std::cout << (has_link_thread() ? build.link_log : get_failure_log(build)) << std::endl;
+		++this->stats_.failed;
+		return;
+	}
+
+	if (build.superseded)
+	{
+		++this->stats_.superseded;
+		return;
+	}
+
+	for (const GLuint shader : build.shaders)
+	{
+		glDetachShader(build.handle, shader);
+		glDeleteShader(shader);
+	}
+	build.shaders.clear();
+
+	build.program->adopt_linked_handle(build.handle);
+	build.handle = 0;
+	++this->stats_.completed;
+}
+
+void async_shader_compiler_t::release(build_t& build) const
+{
+	for (const GLuint shader : build.shaders) glDeleteShader(shader);
+	build.shaders.clear();
+	if (build.handle != 0) glDeleteProgram(build.handle);
+	build.handle = 0;
+	if (build.fence != 0) glDeleteSync(build.fence);
+	build.fence = 0;
+}
@@ -0,0 +1,127 @@
+#ifndef ASYNC_SHADER_COMPILER_H
+#define ASYNC_SHADER_COMPILER_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "glslprogram.h"
+#include "../../jobs/job_system.h"
+
+namespace Continuum {
+
+    namespace Graphics {
+
+        struct async_shader_compiler_stats_t
+        {
+            uint32_t queued = 0;
+            uint32_t completed = 0;
+            uint32_t failed = 0;
+            /// builds replaced by a newer build of the same program before they finished
+            uint32_t superseded = 0;
+        };
+
+        /// A context sharing objects with the render context, for linking on a thread of the compiler's own:
+        /// make_current is called once on that thread (a hidden GLFW window created with the main one as share),
+        /// release_current before it exits.
+        struct shader_link_context_t
+        {
+            std::function<void(void)> make_current;
+            std::function<void(void)> release_current;
+        public:
+            inline bool is_valid(void) const { return this->make_current != nullptr; }
+        };
+
+        /// Builds programs in the background and swaps them into their glsl_program_t once linked.
+        /// Sources are read on the job system, compiles go through GL_KHR_parallel_shader_compile when the driver
+        /// exposes it and are polled with GL_COMPLETION_STATUS_KHR, so update() never waits on the compiler.
+        /// Without the extension, builds are compiled and linked on a worker thread in link_context, which also
+        /// takes the blocking status queries; update() only polls the fence the worker leaves behind. Without
+        /// either, update() queries the link status a frame after issuing it, which may stall on slow links.
+        /// The old program stays in use until its replacement is ready; a build that fails keeps it.
+        struct async_shader_compiler_t
+        {
+            explicit async_shader_compiler_t(Jobs::job_system_t* jobs = NULL, const shader_link_context_t& link_context = shader_link_context_t());
+            ~async_shader_compiler_t();
+            async_shader_compiler_t(const async_shader_compiler_t&) = delete;
+            async_shader_compiler_t& operator=(const async_shader_compiler_t&) = delete;
+        public:
+            /// rebuilds program whenever notify_file_changed() reports one of its files or a file they #include, with the
+            /// same permutation; the includes are rescanned on every rebuild
+            void watch_program(glsl_program_t& program, const std::vector<std::string>& files, const shader_permutation_t& permutation = shader_permutation_t());
+            void notify_file_changed(const std::string& path);
+            void request_build(glsl_program_t& program, const std::vector<std::string>& files, const shader_permutation_t& permutation = shader_permutation_t());
+            /// once per frame: starts compiles whose sources are loaded, adopts finished programs
+            void update(void);
+        public:
+            inline bool has_parallel_compile(void) const { return this->parallel_compile_; }
+            /// builds link on the worker thread, update() never queries a status that could block
+            inline bool has_link_thread(void) const { return this->link_thread_.joinable(); }
+            inline uint32_t get_in_flight(void) const { return static_cast<uint32_t>(this->builds_.size()); }
+            inline const async_shader_compiler_stats_t& get_stats(void) const { return this->stats_; }
+        private:
+            struct build_t
+            {
+                enum StateType { READING, LINKING };
+                glsl_program_t* program = NULL;
+                std::vector<std::string> files;
+                shader_permutation_t permutation;
+                std::vector<std::string> sources;
+                std::vector<std::string> includes;
+                std::vector<GLSLShader::GLSLShaderType> types;
+                Jobs::job_counter_t read_done;
+                std::string read_error;
+                StateType state = READING;
+                std::vector<GLuint> shaders;
+                GLuint handle = 0;
+                uint32_t frames_waited = 0;
+                bool superseded = false;
+                /// link thread only: set once the worker has linked, with the status, the log and a fence after it
+                std::atomic<bool> linked = false;
+                GLint link_status = GL_FALSE;
+                std::string link_log;
+                GLsync fence = 0;
+            };
+        private:
+            static void read_sources(build_t& build);
+            static std::string get_failure_log(const build_t& build);
+            void link_thread_main(const shader_link_context_t& link_context);
+            void start_compile(build_t& build) const;
+            bool is_link_complete(build_t& build) const;
+            void finish(build_t& build);
+            void release(build_t& build) const;
+        private:
+            Jobs::job_system_t* jobs_;
+            bool parallel_compile_ = false;
+            std::vector<std::unique_ptr<build_t>> builds_;
+            struct watched_t
+            {
+                glsl_program_t* program = NULL;
+                std::vector<std::string> files;
+                shader_permutation_t permutation;
+                /// what files pulled in when last read, normalized like files
+                std::vector<std::string> includes;
+            };
+            std::vector<watched_t> watched_;
+            async_shader_compiler_stats_t stats_;
+
+            std::thread link_thread_;
+            std::mutex link_mutex_;
+            std::condition_variable link_wake_;
+            std::deque<build_t*> link_queue_;
+            bool link_stop_ = false;
+        };
+
+    }
+
+}
+#endif
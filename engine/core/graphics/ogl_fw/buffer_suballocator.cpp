@@ -0,0 +1,486 @@
+#include "buffer_suballocator.h"
+
+#include <bit>
+#include <algorithm>
+
+using namespace Continuum::Graphics;
+
+tlsf_allocator_t::tlsf_allocator_t(const uint32_t granules)
+{
+	reset(granules);
+}
+
+void tlsf_allocator_t::reset(const uint32_t granules)
+{
+	this->blocks_.clear();
+	this->recycled_.clear();
+	this->fl_bitmap_ = 0;
+	for (uint32_t fl = 0; fl < k_fl_count; ++fl)
+	{
+		this->sl_bitmap_[fl] = 0;
+		for (uint32_t sl = 0; sl < k_sl_count; ++sl) this->heads_[fl][sl] = k_invalid;
+	}
+	this->capacity_ = granules;
+	this->free_granules_ = 0;
+	this->free_block_count_ = 0;
+	if (granules == 0) return;
+
+	const uint32_t block = new_block();
+	this->blocks_[block].offset = 0;
+	this->blocks_[block].size = granules;
+	this->free_granules_ = granules;
+	insert_free(block);
+}
+
+void tlsf_allocator_t::mapping(const uint32_t size, uint32_t& fl, uint32_t& sl)
+{
+	// first level is the power of two, second level splits it linearly into k_sl_count classes;
+	// sizes below k_sl_count get an exact class each in level 0
+	if (size < k_sl_count)
+	{
+		fl = 0;
+		sl = size;
+		return;
+	}
+	const uint32_t log2 = static_cast<uint32_t>(std::bit_width(size)) - 1;
+	sl = (size >> (log2 - k_sl_log2)) - k_sl_count;
+	fl = log2 - k_sl_log2 + 1;
+}
+
+uint32_t tlsf_allocator_t::new_block(void)
+{
+	if (!this->recycled_.empty())
+	{
+		const uint32_t block = this->recycled_.back();
+		this->recycled_.pop_back();
+		this->blocks_[block] = block_t{};
+		this->blocks_[block].alive = true;
+		return block;
+	}
+	this->blocks_.push_back(block_t{});
+	this->blocks_.back().alive = true;
+	return static_cast<uint32_t>(this->blocks_.size() - 1);
+}
+
+void tlsf_allocator_t::insert_free(const uint32_t block)
+{
+	uint32_t fl = 0, sl = 0;
+	mapping(this->blocks_[block].size, fl, sl);
+
+	block_t& b = this->blocks_[block];
+	b.free = true;
+	b.prev_free = k_invalid;
+	b.next_free = this->heads_[fl][sl];
+	if (b.next_free != k_invalid) this->blocks_[b.next_free].prev_free = block;
+	this->heads_[fl][sl] = block;
+	this->fl_bitmap_ |= 1u << fl;
+	this->sl_bitmap_[fl] |= 1u << sl;
+	++this->free_block_count_;
+}
+
+void tlsf_allocator_t::remove_free(const uint32_t block)
+{
+	uint32_t fl = 0, sl = 0;
+	mapping(this->blocks_[block].size, fl, sl);
+
+	block_t& b = this->blocks_[block];
+	if (b.prev_free != k_invalid) this->blocks_[b.prev_free].next_free = b.next_free;
+	else this->heads_[fl][sl] = b.next_free;
+	if (b.next_free != k_invalid) this->blocks_[b.next_free].prev_free = b.prev_free;
+	b.prev_free = k_invalid;
+	b.next_free = k_invalid;
+	b.free = false;
+
+	if (this->heads_[fl][sl] == k_invalid)
+	{
+		this->sl_bitmap_[fl] &= ~(1u << sl);
+		if (this->sl_bitmap_[fl] == 0) this->fl_bitmap_ &= ~(1u << fl);
+	}
+	--this->free_block_count_;
+}
+
+uint32_t tlsf_allocator_t::find_free(const uint32_t size) const
+{
+	// round up to the next class so that any block found there is large enough
+	uint32_t rounded = size;
+	if (size >= k_sl_count)
+	{
+		const uint32_t log2 = static_cast<uint32_t>(std::bit_width(size)) - 1;
+		rounded = size + (1u << (log2 - k_sl_log2)) - 1;
+		if (rounded < size) rounded = size;
+	}
+
+	uint32_t fl = 0, sl = 0;
+	mapping(rounded, fl, sl);
+	if (fl < k_fl_count)
+	{
+		uint32_t sl_map = this->sl_bitmap_[fl] & (~0u << sl);
+		if (sl_map == 0)
+		{
+			const uint32_t fl_map = fl + 1 < k_fl_count ? this->fl_bitmap_ & (~0u << (fl + 1)) : 0;
+			if (fl_map != 0)
+			{
+				fl = static_cast<uint32_t>(std::countr_zero(fl_map));
+				sl_map = this->sl_bitmap_[fl];
+			}
+		}
+		if (sl_map != 0) return this->heads_[fl][std::countr_zero(sl_map)];
+	}
+
+	// the exact class may still hold a block that fits even though the rounded class is empty
+	mapping(size, fl, sl);
+	for (uint32_t block = this->heads_[fl][sl]; block != k_invalid; block = this->blocks_[block].next_free)
+	{
+		if (this->blocks_[block].size >= size) return block;
+	}
+	return k_invalid;
+}
+
+uint32_t tlsf_allocator_t::allocate(const uint32_t granules)
+{
+	const uint32_t size = std::max<uint32_t>(granules, 1);
+	const uint32_t block = find_free(size);
+	if (block == k_invalid) return k_invalid;
+
+	remove_free(block);
+	if (this->blocks_[block].size > size)
+	{
+		// split, the remainder goes back into the free lists
+		const uint32_t rest = new_block();
+		block_t& b = this->blocks_[block];
+		block_t& r = this->blocks_[rest];
+		r.offset = b.offset + size;
+		r.size = b.size - size;
+		r.prev_phys = block;
+		r.next_phys = b.next_phys;
+		if (b.next_phys != k_invalid) this->blocks_[b.next_phys].prev_phys = rest;
+		b.next_phys = rest;
+		b.size = size;
+		insert_free(rest);
+	}
+	this->free_granules_ -= size;
+	return block;
+}
+
+void tlsf_allocator_t::free(const uint32_t block)
+{
+	uint32_t current = block;
+	this->free_granules_ += this->blocks_[current].size;
+
+	// merge with the physical neighbours
+	const uint32_t next = this->blocks_[current].next_phys;
+	if (next != k_invalid && this->blocks_[next].free)
+	{
+		remove_free(next);
+		block_t& b = this->blocks_[current];
+		b.size += this->blocks_[next].size;
+		b.next_phys = this->blocks_[next].next_phys;
+		if (b.next_phys != k_invalid) this->blocks_[b.next_phys].prev_phys = current;
+		this->blocks_[next].alive = false;
+		this->recycled_.push_back(next);
+	}
+	const uint32_t prev = this->blocks_[current].prev_phys;
+	if (prev != k_invalid && this->blocks_[prev].free)
+	{
+		remove_free(prev);
+		block_t& p = this->blocks_[prev];
+		p.size += this->blocks_[current].size;
+		p.next_phys = this->blocks_[current].next_phys;
+		if (p.next_phys != k_invalid) this->blocks_[p.next_phys].prev_phys = prev;
+		this->blocks_[current].alive = false;
+		this->recycled_.push_back(current);
+		current = prev;
+	}
+	insert_free(current);
+}
+
+uint32_t tlsf_allocator_t::get_largest_free(void) const
+{
+	if (this->fl_bitmap_ == 0) return 0;
+
+	const uint32_t fl = 31 - static_cast<uint32_t>(std::countl_zero(this->fl_bitmap_));
+	const uint32_t sl = 31 - static_cast<uint32_t>(std::countl_zero(this->sl_bitmap_[fl]));
+	uint32_t largest = 0;
+	for (uint32_t block = this->heads_[fl][sl]; block != k_invalid; block = this->blocks_[block].next_free)
+	{
+		largest = std::max(largest, this->blocks_[block].size);
+	}
+	return largest;
+}
+
+buffer_suballocator_t::buffer_suballocator_t(const buffer_suballocator_settings_t& settings)
+	: settings_(settings)
+{
+	uint32_t granularity = std::max<uint32_t>(settings.granularity, 16);
+	if (!settings.cpu_only)
+	{
+		GLint alignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		granularity = std::max<uint32_t>(granularity, static_cast<uint32_t>(alignment));
+	}
+	this->granularity_ = std::bit_ceil(granularity);
+
+	this->settings_.slab_slot_count = std::clamp<uint32_t>(settings.slab_slot_count, 1, 64);
+	this->settings_.frames_in_flight = std::max<uint32_t>(settings.frames_in_flight, 1);
+	this->slab_slot_size_ = (settings.slab_slot_size + this->granularity_ - 1) / this->granularity_ * this->granularity_;
+}
+
+buffer_suballocator_t::~buffer_suballocator_t()
+{
+	if (this->settings_.cpu_only) return;
+
+	for (pending_batch_t& batch : this->pending_)
+	{
+		if (batch.fence != NULL) glDeleteSync(batch.fence);
+	}
+	for (arena_t& arena : this->arenas_)
+	{
+		if (arena.buffer != 0) glDeleteBuffers(1, &arena.buffer);
+	}
+}
+
+bool buffer_suballocator_t::add_arena(const uint64_t min_size)
+{
+	if (this->arenas_.size() >= this->settings_.max_arenas) return false;
+
+	const uint64_t g = this->granularity_;
+	const uint64_t size = (std::max(this->settings_.arena_size, min_size) + g - 1) / g * g;
+	if (size / g > UINT32_MAX) return false;
+
+	arena_t arena;
+	arena.size = size;
+	arena.tlsf.reset(static_cast<uint32_t>(size / g));
+	if (!this->settings_.cpu_only)
+	{
+		glCreateBuffers(1, &arena.buffer);
+		if (arena.buffer == 0) throw BufferSuballocatorException("Unable to create suballocator arena.");
+		glNamedBufferStorage(arena.buffer, static_cast<GLsizeiptr>(size), NULL, this->settings_.storage_flags);
+	}
+	this->arenas_.push_back(std::move(arena));
+	return true;
+}
+
+gpu_allocation_t buffer_suballocator_t::allocate_block(const uint64_t size)
+{
+	const uint64_t g = this->granularity_;
+	const uint64_t granules = (size + g - 1) / g;
+	if (granules > UINT32_MAX) return {};
+
+	for (uint32_t pass = 0; pass < 2; ++pass)
+	{
+		for (uint32_t i = 0; i < this->arenas_.size(); ++i)
+		{
+			arena_t& arena = this->arenas_[i];
+			const uint32_t block = arena.tlsf.allocate(static_cast<uint32_t>(granules));
+			if (block == tlsf_allocator_t::k_invalid) continue;
+
+			gpu_allocation_t allocation;
+			allocation.buffer = arena.buffer;
+			allocation.offset = uint64_t(arena.tlsf.get_offset(block)) * g;
+			allocation.size = size;
+			allocation.arena = i;
+			allocation.block = block;
+			return allocation;
+		}
+		// nothing fits in the existing arenas, grow once and retry
+		if (pass == 0 && !add_arena(size)) break;
+	}
+	return {};
+}
+
+gpu_allocation_t buffer_suballocator_t::allocate_slot(const uint64_t size)
+{
+	if (this->partial_slabs_.empty())
+	{
+		const gpu_allocation_t block = allocate_block(uint64_t(this->slab_slot_size_) * this->settings_.slab_slot_count);
+		if (!block.is_valid()) return {};
+
+		uint32_t index = 0;
+		if (!this->free_slabs_.empty())
+		{
+			index = this->free_slabs_.back();
+			this->free_slabs_.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(this->slabs_.size());
+			this->slabs_.emplace_back();
+		}
+
+		slab_t& slab = this->slabs_[index];
+		slab.arena = block.arena;
+		slab.block = block.block;
+		slab.offset = block.offset;
+		slab.free_mask = this->settings_.slab_slot_count == 64 ? ~0ull : (1ull << this->settings_.slab_slot_count) - 1;
+		slab.used = 0;
+		slab.partial = true;
+		this->partial_slabs_.push_back(index);
+	}
+
+	const uint32_t index = this->partial_slabs_.back();
+	slab_t& slab = this->slabs_[index];
+	const uint32_t slot = static_cast<uint32_t>(std::countr_zero(slab.free_mask));
+	slab.free_mask &= slab.free_mask - 1;
+	++slab.used;
+	if (slab.free_mask == 0)
+	{
+		slab.partial = false;
+		this->partial_slabs_.pop_back();
+	}
+
+	gpu_allocation_t allocation;
+	allocation.buffer = this->arenas_[slab.arena].buffer;
+	allocation.offset = slab.offset + uint64_t(slot) * this->slab_slot_size_;
+	allocation.size = size;
+	allocation.arena = slab.arena;
+	allocation.block = index;
+	allocation.slot = slot;
+	return allocation;
+}
+
+gpu_allocation_t buffer_suballocator_t::allocate(const uint64_t size)
+{
+	const uint64_t request = std::max<uint64_t>(size, 1);
+
+	// only requests that fill more than half a slot use the slabs, smaller ones would waste most of it
+	const bool use_slab = this->slab_slot_size_ > 0 && request <= this->slab_slot_size_ && request * 2 > this->slab_slot_size_;
+	const gpu_allocation_t allocation = use_slab ? allocate_slot(request) : allocate_block(request);
+	if (!allocation.is_valid())
+	{
+		++this->failed_allocations_;
+		return allocation;
+	}
+
+	++this->allocations_;
+	this->requested_bytes_ += allocation.size;
+	this->allocated_bytes_ += use_slab ? this->slab_slot_size_
+		: uint64_t(this->arenas_[allocation.arena].tlsf.get_size(allocation.block)) * this->granularity_;
+	return allocation;
+}
+
+void buffer_suballocator_t::free(const gpu_allocation_t& allocation)
+{
+	if (!allocation.is_valid()) return;
+	this->freed_this_frame_.push_back(allocation);
+}
+
+void buffer_suballocator_t::release(const gpu_allocation_t& allocation)
+{
+	this->requested_bytes_ -= allocation.size;
+
+	if (allocation.slot == UINT32_MAX)
+	{
+		tlsf_allocator_t& tlsf = this->arenas_[allocation.arena].tlsf;
+		this->allocated_bytes_ -= uint64_t(tlsf.get_size(allocation.block)) * this->granularity_;
+		tlsf.free(allocation.block);
+		return;
+	}
+
+	this->allocated_bytes_ -= this->slab_slot_size_;
+	slab_t& slab = this->slabs_[allocation.block];
+	slab.free_mask |= 1ull << allocation.slot;
+	--slab.used;
+
+	if (slab.used == 0)
+	{
+		// empty slabs go back to the arena so that their space can serve any size
+		if (slab.partial)
+		{
+			std::vector<uint32_t>::iterator it = std::find(this->partial_slabs_.begin(), this->partial_slabs_.end(), allocation.block);
+			*it = this->partial_slabs_.back();
+			this->partial_slabs_.pop_back();
+		}
+		slab.partial = false;
+		this->arenas_[slab.arena].tlsf.free(slab.block);
+		this->free_slabs_.push_back(allocation.block);
+	}
+	else if (!slab.partial)
+	{
+		slab.partial = true;
+		this->partial_slabs_.push_back(allocation.block);
+	}
+}
+
+void buffer_suballocator_t::begin_frame(void)
+{
+	// fences signal in submission order, stop at the first batch still in flight
+	while (!this->pending_.empty())
+	{
+		pending_batch_t& batch = this->pending_.front();
+		bool ready = false;
+		if (this->settings_.cpu_only)
+		{
+			ready = this->frame_ >= batch.retire_frame;
+		}
+		else
+		{
+			const GLenum result = glClientWaitSync(batch.fence, 0, 0);
+			ready = result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+		}
+		if (!ready) break;
+
+		for (const gpu_allocation_t& allocation : batch.allocations) release(allocation);
+		if (batch.fence != NULL) glDeleteSync(batch.fence);
+		this->pending_.pop_front();
+	}
+}
+
+void buffer_suballocator_t::end_frame(void)
+{
+	if (!this->freed_this_frame_.empty())
+	{
+		pending_batch_t batch;
+		batch.allocations.swap(this->freed_this_frame_);
+		batch.retire_frame = this->frame_ + this->settings_.frames_in_flight;
+		if (!this->settings_.cpu_only) batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		this->pending_.push_back(std::move(batch));
+	}
+	++this->frame_;
+}
+
+void buffer_suballocator_t::upload(const gpu_allocation_t& allocation, const void* data, const uint64_t size, const uint64_t offset) const
+{
+	if (this->settings_.cpu_only || !allocation.is_valid()) return;
+	glNamedBufferSubData(allocation.buffer, static_cast<GLintptr>(allocation.offset + offset), static_cast<GLsizeiptr>(size), data);
+}
+
+buffer_suballocator_stats_t buffer_suballocator_t::get_stats(void) const
+{
+	buffer_suballocator_stats_t stats;
+	const uint64_t g = this->granularity_;
+
+	uint64_t contiguous_free = 0;
+	stats.arenas = static_cast<uint32_t>(this->arenas_.size());
+	for (const arena_t& arena : this->arenas_)
+	{
+		const uint64_t largest = uint64_t(arena.tlsf.get_largest_free()) * g;
+		stats.arena_bytes += arena.size;
+		stats.free_bytes += uint64_t(arena.tlsf.get_free()) * g;
+		stats.free_blocks += arena.tlsf.get_free_block_count();
+		stats.largest_free_block = std::max(stats.largest_free_block, largest);
+		contiguous_free += largest;
+	}
+	for (const slab_t& slab : this->slabs_)
+	{
+		if (slab.used == 0) continue;
+		++stats.slabs;
+		stats.slab_slots_used += slab.used;
+		stats.slab_slots_total += this->settings_.slab_slot_count;
+	}
+	for (const pending_batch_t& batch : this->pending_)
+	{
+		stats.pending_frees += static_cast<uint32_t>(batch.allocations.size());
+		for (const gpu_allocation_t& allocation : batch.allocations) stats.pending_free_bytes += allocation.size;
+	}
+	for (const gpu_allocation_t& allocation : this->freed_this_frame_)
+	{
+		++stats.pending_frees;
+		stats.pending_free_bytes += allocation.size;
+	}
+	stats.requested_bytes = this->requested_bytes_;
+	stats.allocated_bytes = this->allocated_bytes_;
+	stats.allocations = this->allocations_;
+	stats.failed_allocations = this->failed_allocations_;
+	stats.fragmentation = stats.free_bytes > 0 ? 1.0 - double(contiguous_free) / double(stats.free_bytes) : 0.0;
+	return stats;
+}
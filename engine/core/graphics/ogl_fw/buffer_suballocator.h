@@ -0,0 +1,190 @@
+#ifndef BUFFER_SUBALLOCATOR_H
+#define BUFFER_SUBALLOCATOR_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <stdexcept>
+
+namespace Continuum {
+
+    namespace Graphics {
+
+        struct BufferSuballocatorException : public std::runtime_error {
+            BufferSuballocatorException(const std::string& msg) :
+                std::runtime_error(msg) {}
+        };
+
+        /// Two-level segregated fit allocator over an abstract range of granules, O(1) allocate and free.
+        /// Pure bookkeeping, no GL, so it can be exercised on the CPU alone.
+        struct tlsf_allocator_t
+        {
+            static constexpr uint32_t k_invalid = UINT32_MAX;
+            static constexpr uint32_t k_sl_log2 = 4;
+            static constexpr uint32_t k_sl_count = 1u << k_sl_log2;
+            static constexpr uint32_t k_fl_count = 32;
+        public:
+            explicit tlsf_allocator_t(const uint32_t granules = 0);
+            void reset(const uint32_t granules);
+            /// returns a block id, k_invalid when no free block is large enough
+            uint32_t allocate(const uint32_t granules);
+            void free(const uint32_t block);
+        public:
+            inline uint32_t get_offset(const uint32_t block) const { return this->blocks_[block].offset; }
+            inline uint32_t get_size(const uint32_t block) const { return this->blocks_[block].size; }
+            inline uint32_t get_capacity(void) const { return this->capacity_; }
+            inline uint32_t get_free(void) const { return this->free_granules_; }
+            inline uint32_t get_free_block_count(void) const { return this->free_block_count_; }
+            uint32_t get_largest_free(void) const;
+        private:
+            struct block_t
+            {
+                uint32_t offset = 0;
+                uint32_t size = 0;
+                uint32_t prev_phys = k_invalid;
+                uint32_t next_phys = k_invalid;
+                uint32_t prev_free = k_invalid;
+                uint32_t next_free = k_invalid;
+                bool free = false;
+                bool alive = false;
+            };
+            static void mapping(const uint32_t size, uint32_t& fl, uint32_t& sl);
+            uint32_t new_block(void);
+            void insert_free(const uint32_t block);
+            void remove_free(const uint32_t block);
+            uint32_t find_free(const uint32_t size) const;
+        private:
+            std::vector<block_t> blocks_;
+            std::vector<uint32_t> recycled_;
+            uint32_t fl_bitmap_ = 0;
+            uint32_t sl_bitmap_[k_fl_count] = {};
+            uint32_t heads_[k_fl_count][k_sl_count] = {};
+            uint32_t capacity_ = 0;
+            uint32_t free_granules_ = 0;
+            uint32_t free_block_count_ = 0;
+        };
+
+        struct buffer_suballocator_settings_t
+        {
+            /// bytes per arena, larger requests get an arena of their own size
+            uint64_t arena_size = 64ull * 1024 * 1024;
+            uint32_t max_arenas = 8;
+            /// allocation granularity, raised to the SSBO offset alignment when running on GL
+            uint32_t granularity = 256;
+            /// slot size of the slab class, sized for a terrain patch; 0 disables slabs
+            uint32_t slab_slot_size = 33 * 33 * 32;
+            uint32_t slab_slot_count = 64;
+            GLbitfield storage_flags = GL_DYNAMIC_STORAGE_BIT;
+            uint32_t frames_in_flight = 3;
+            /// no GL calls: arenas have no buffer and frees retire after frames_in_flight end_frame()s
+            bool cpu_only = false;
+        };
+
+        struct gpu_allocation_t
+        {
+            GLuint buffer = 0;
+            uint64_t offset = 0;
+            uint64_t size = 0;
+            uint32_t arena = UINT32_MAX;
+            /// tlsf block, or slab index for slot allocations
+            uint32_t block = UINT32_MAX;
+            uint32_t slot = UINT32_MAX;
+        public:
+            inline bool is_valid(void) const { return this->arena != UINT32_MAX; }
+        };
+
+        struct buffer_suballocator_stats_t
+        {
+            uint32_t arenas = 0;
+            uint64_t arena_bytes = 0;
+            /// bytes requested by live allocations and bytes they actually occupy after rounding
+            uint64_t requested_bytes = 0;
+            uint64_t allocated_bytes = 0;
+            uint64_t free_bytes = 0;
+            uint64_t largest_free_block = 0;
+            uint32_t free_blocks = 0;
+            uint32_t slabs = 0;
+            uint32_t slab_slots_used = 0;
+            uint32_t slab_slots_total = 0;
+            uint32_t pending_frees = 0;
+            uint64_t pending_free_bytes = 0;
+            uint64_t allocations = 0;
+            uint64_t failed_allocations = 0;
+            /// 1 - sum of each arena's largest free block / free bytes, 0 when every arena's free space is contiguous
+            double fragmentation = 0.0;
+        };
+
+        /// Suballocates patch-sized and general ranges out of a few immutable glNamedBufferStorage arenas,
+        /// so streaming meshes never creates or deletes buffers. Requests near the slab slot size come from
+        /// fixed-size slabs, everything else from a TLSF allocator per arena. free() only queues the range;
+        /// it is recycled once the fence of the frame that freed it has signalled.
+        struct buffer_suballocator_t
+        {
+            explicit buffer_suballocator_t(const buffer_suballocator_settings_t& settings = buffer_suballocator_settings_t());
+            ~buffer_suballocator_t();
+            buffer_suballocator_t(const buffer_suballocator_t&) = delete;
+            buffer_suballocator_t& operator=(const buffer_suballocator_t&) = delete;
+        public:
+            /// invalid allocation when the arena budget is exhausted
+            gpu_allocation_t allocate(const uint64_t size);
+            void free(const gpu_allocation_t& allocation);
+            /// recycles ranges whose fences have signalled, never waits
+            void begin_frame(void);
+            /// fences the ranges freed during this frame
+            void end_frame(void);
+            /// upload helper for GL_DYNAMIC_STORAGE_BIT arenas
+            void upload(const gpu_allocation_t& allocation, const void* data, const uint64_t size, const uint64_t offset = 0) const;
+        public:
+            buffer_suballocator_stats_t get_stats(void) const;
+            inline uint32_t get_granularity(void) const { return this->granularity_; }
+            inline const buffer_suballocator_settings_t& get_settings(void) const { return this->settings_; }
+        private:
+            struct arena_t
+            {
+                GLuint buffer = 0;
+                uint64_t size = 0;
+                tlsf_allocator_t tlsf;
+            };
+            struct slab_t
+            {
+                uint32_t arena = 0;
+                uint32_t block = 0;
+                uint64_t offset = 0;
+                uint64_t free_mask = 0;
+                uint32_t used = 0;
+                bool partial = false;
+            };
+            struct pending_batch_t
+            {
+                std::vector<gpu_allocation_t> allocations;
+                GLsync fence = NULL;
+                uint64_t retire_frame = 0;
+            };
+            gpu_allocation_t allocate_block(const uint64_t size);
+            gpu_allocation_t allocate_slot(const uint64_t size);
+            void release(const gpu_allocation_t& allocation);
+            bool add_arena(const uint64_t min_size);
+        private:
+            buffer_suballocator_settings_t settings_;
+            uint32_t granularity_ = 256;
+            uint32_t slab_slot_size_ = 0;
+            std::vector<arena_t> arenas_;
+            std::vector<slab_t> slabs_;
+            std::vector<uint32_t> free_slabs_;
+            std::vector<uint32_t> partial_slabs_;
+            std::vector<gpu_allocation_t> freed_this_frame_;
+            std::deque<pending_batch_t> pending_;
+            uint64_t frame_ = 0;
+            uint64_t requested_bytes_ = 0;
+            uint64_t allocated_bytes_ = 0;
+            uint64_t allocations_ = 0;
+            uint64_t failed_allocations_ = 0;
+        };
+
+    }
+
+}
+#endif
@@ -6,7 +6,16 @@
 #include <iostream>
 #include <sys/stat.h>
 #include <vector>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <stdlib.h>
 
+#include "../../hash.h"
+#include "../../file_io.h"
+
+using namespace Continuum;
 using namespace Continuum::Graphics;
 
 namespace GLSLShaderInfo {
@@ -29,9 +38,117 @@ namespace GLSLShaderInfo {
 		{".cs",   GLSLShader::GLSLShaderType::COMPUTE},
 		{ ".cs.glsl",   GLSLShader::GLSLShaderType::COMPUTE }
 	};
+
+	std::string binary_cache_directory = {};
+	program_binary_cache_stats_t binary_cache_stats = {};
+
+	struct program_binary_header_t
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t length;
+	};
+	const uint32_t binary_magic = 0x43504243; // "CPBC"
+	const uint32_t binary_version = 1;
+}
+
+shader_permutation_t& shader_permutation_t::define(const std::string& name, const std::string& value)
+{
+	const auto it = std::lower_bound(this->defines_.begin(), this->defines_.end(), name,
+		[](const std::pair<std::string, std::string>& define, const std::string& key) { return define.first < key; });
+	if (it != this->defines_.end() && it->first == name) it->second = value;
+	else this->defines_.insert(it, { name, value });
+	return *this;
+}
+
+shader_permutation_t& shader_permutation_t::define(const std::string& name, const int value)
+{
+	return define(name, std::to_string(value));
+}
+
+shader_permutation_t& shader_permutation_t::define(const std::string& name, const uint32_t value)
+{
+	return define(name, std::to_string(value) + "u");
+}
+
+static std::string format_float(const float value)
+{
+	char text[32] = {};
+	for (int digits = 6; digits <= 9; ++digits)
+	{
+		snprintf(text, sizeof(text), "%.*g", digits, value);
+		if (strtof(text, NULL) == value) break;
+	}
+	std::string str = text;
+	// 2 would be an int literal in GLSL
+	if (str.find_first_of(".eEn") == std::string::npos) str += ".0";
+	return str;
+}
+
+shader_permutation_t& shader_permutation_t::define(const std::string& name, const float value)
+{
+	return define(name, format_float(value));
+}
+
+shader_permutation_t& shader_permutation_t::define(const std::string& name, const glm::vec4& value)
+{
+	return define(name, "vec4(" + format_float(value.x) + ", " + format_float(value.y) + ", " + format_float(value.z) + ", " + format_float(value.w) + ")");
+}
+
+uint64_t shader_permutation_t::get_hash(void) const
+{
+	uint64_t hash = Hash::k_fnv1a_offset;
+	for (const std::pair<std::string, std::string>& define : this->defines_)
+	{
+		// the separators keep ("AB", "") and ("A", "B") apart
+		hash = Hash::fnv1a_64(define.first, hash);
+		hash = Hash::fnv1a_64(std::string_view("="), hash);
+		hash = Hash::fnv1a_64(define.second, hash);
+		hash = Hash::fnv1a_64(std::string_view(";"), hash);
+	}
+	return hash;
+}
+
+std::string shader_permutation_t::apply(const std::string& source) const
+{
+	if (this->defines_.empty()) return source;
+
+	std::string block = {};
+	for (const std::pair<std::string, std::string>& define : this->defines_)
+	{
+		block += "#define " + define.first;
+		if (!define.second.empty()) block += " " + define.second;
+		block += "\n";
+	}
+
+	// #version has to stay the first directive; everything in front of it is comments and blank lines
+	size_t line_start = 0;
+	uint32_t line_number = 1;
+	while (line_start < source.size())
+	{
+		const size_t line_end = source.find('\n', line_start);
+		const size_t start = source.find_first_not_of(" \t", line_start);
+		if (start != std::string::npos && start < line_end && source.compare(start, 8, "#version") == 0)
+		{
+			if (line_end == std::string::npos) return source + "\n" + block + "#line " + std::to_string(line_number + 1) + "\n";
+			return source.substr(0, line_end + 1) + block + "#line " + std::to_string(line_number + 1) + "\n" + source.substr(line_end + 1);
+		}
+		if (line_end == std::string::npos) break;
+		line_start = line_end + 1;
+		++line_number;
+	}
+	return block + "#line 1\n" + source;
+}
+
+static uint32_t next_program_id(void)
+{
+	static std::atomic<uint32_t> counter = 0;
+	return counter.fetch_add(1, std::memory_order_relaxed) + 1;
 }
 
-glsl_program_t::glsl_program_t() : handle(0), linked(false)
+glsl_program_t::glsl_program_t() : handle(0), linked(false), program_id(next_program_id())
 {
 }
 
@@ -46,22 +163,20 @@ glsl_program_t::~glsl_program_t()
 
 void glsl_program_t::compile_shader(const char* file_name)
 {
-	const std::string ext = GLSLUtils::get_file_extension(file_name);
-	GLSLShader::GLSLShaderType type = GLSLShader::GLSLShaderType::VERTEX;
-	const auto it = GLSLShaderInfo::extensions.find(ext);
-	if (it != GLSLShaderInfo::extensions.end())
-	{
-		type = it->second;
-	}
-	else
-	{
-		std::string msg = "Unrecognized extension: " + ext;
-		throw GLSLProgramException(msg);
-	}
-	compile_shader(file_name, type);
+	compile_shader(file_name, GLSLUtils::get_shader_type(file_name));
 }
 
 void glsl_program_t::compile_shader(const char* file_name, const GLSLShader::GLSLShaderType type)
+{
+	compile_shader(file_name, type, shader_permutation_t());
+}
+
+void glsl_program_t::compile_shader(const char* file_name, const shader_permutation_t& permutation)
+{
+	compile_shader(file_name, GLSLUtils::get_shader_type(file_name), permutation);
+}
+
+void glsl_program_t::compile_shader(const char* file_name, const GLSLShader::GLSLShaderType type, const shader_permutation_t& permutation)
 {
 	if (!GLSLUtils::file_exists(file_name))
 	{
@@ -77,19 +192,20 @@ void glsl_program_t::compile_shader(const char* file_name, const GLSLShader::GLS
 		}
 	}
 
-	std::ifstream in_file(file_name, std::ios::in);
-	if (!in_file)
+	std::string code = {};
+	if (!GLSLUtils::read_file(file_name, code))
 	{
 		std::string msg = std::string("Unable to open: ") + file_name;
 		throw GLSLProgramException(msg);
 	}
 
-	// Get file contents
-	std::stringstream code = {};
-	code << in_file.rdbuf();
-	in_file.close();
+	compile_shader(permutation.apply(code), type, file_name);
+}
 
-	compile_shader(code.str(), type, file_name);
+void glsl_program_t::compile_shader(const std::string& shader_source, const GLSLShader::GLSLShaderType type, const shader_permutation_t& permutation,
+	const char* file_name)
+{
+	compile_shader(permutation.apply(shader_source), type, file_name);
 }
 
 void glsl_program_t::compile_shader(const std::string& shader_source, const GLSLShader::GLSLShaderType type, const char* file_name)
@@ -102,6 +218,18 @@ void glsl_program_t::compile_shader(const std::string& shader_source, const GLSL
 		}
 	}
 
+	if (!GLSLShaderInfo::binary_cache_directory.empty())
+	{
+		// compiled in link() if the binary cache misses
+		pending_stages.push_back({ type, shader_source, file_name != NULL ? file_name : "" });
+		return;
+	}
+
+	compile_stage(shader_source, type, file_name);
+}
+
+void glsl_program_t::compile_stage(const std::string& shader_source, const GLSLShader::GLSLShaderType type, const char* file_name)
+{
 	GLuint shader_handle = glCreateShader(type);
 
 	const char* c_code = shader_source.c_str();
@@ -147,6 +275,46 @@ void glsl_program_t::link(void)
 	if (linked) return;
 	if (handle <= 0) throw GLSLProgramException("Program has not been compiled.");
 
+	if (pending_stages.empty())
+	{
+		link_program();
+		return;
+	}
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+	const uint64_t key = get_binary_cache_key();
+
+	if (load_program_binary(key))
+	{
+		pending_stages.clear();
+		find_uniform_locations();
+		linked = true;
+
+		const auto t1 = std::chrono::high_resolution_clock::now();
+		++GLSLShaderInfo::binary_cache_stats.hits;
+		GLSLShaderInfo::binary_cache_stats.load_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+		return;
+	}
+
+	++GLSLShaderInfo::binary_cache_stats.misses;
+
+	const std::vector<pending_stage_t> stages = std::move(pending_stages);
+	pending_stages.clear();
+	for (const pending_stage_t& stage : stages)
+	{
+		compile_stage(stage.source, stage.type, stage.file_name.empty() ? NULL : stage.file_name.c_str());
+	}
+
+	glProgramParameteri(handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	link_program();
+	save_program_binary(key);
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	GLSLShaderInfo::binary_cache_stats.compile_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void glsl_program_t::link_program(void)
+{
 	glLinkProgram(handle);
 
 	GLint link_status = {};
@@ -219,6 +387,19 @@ bool glsl_program_t::is_linked(void) const
 	return linked;
 }
 
+void glsl_program_t::adopt_linked_handle(const GLuint program)
+{
+	if (handle > 0)
+	{
+		detach_delete_shader_objects();
+		glDeleteProgram(handle);
+	}
+	handle = program;
+	linked = true;
+	pending_stages.clear();
+	find_uniform_locations();
+}
+
 void glsl_program_t::bind_attrib_loc(const GLuint location, const char* name) const
 {
 	glBindAttribLocation(handle, location, name);
@@ -292,25 +473,33 @@ void glsl_program_t::find_uniform_locations(void)
 {
 	uniform_locations.clear();
 
-	GLint num_uniforms = 0;
-
-#ifdef WIN32
 	// For OpenGL 4.3 and above, use glGetProgramResource
+	GLint num_uniforms = 0;
 	glGetProgramInterfaceiv(handle, GL_UNIFORM, GL_ACTIVE_RESOURCES, &num_uniforms);
+	uniform_locations.reserve(static_cast<size_t>(num_uniforms));
+
 	GLenum properties[4] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_BLOCK_INDEX };
+	std::string name = {};
 	for (GLint i = 0; i < num_uniforms; ++i)
 	{
 		GLint results[4] = {};
 		glGetProgramResourceiv(handle, GL_UNIFORM, i, 4, properties, 4, NULL, results);
 
 		if (results[3] != -1) continue; // Skip uniforms in blocks
-		GLint name_buff_size = results[0] + 1;
-		char* name = new char[name_buff_size];
-		glGetProgramResourceName(handle, GL_UNIFORM, i, name_buff_size, NULL, name);
-		uniform_locations[name] = results[2];
-		delete[] name;
+		name.resize(results[0] + 1);
+		GLsizei length = 0;
+		glGetProgramResourceName(handle, GL_UNIFORM, i, static_cast<GLsizei>(name.size()), &length, &name[0]);
+		name.resize(length);
+		uniform_locations.insert(Hash::fnv1a_64(name), results[2]);
+
+		// arrays are reported as "name[0]", make the bare name resolve as well
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		{
+			uniform_locations.insert(Hash::fnv1a_64(std::string_view(name).substr(0, name.size() - 3)), results[2]);
+		}
 	}
-#endif 
+
+	refresh_uniform_slots();
 }
 
 void glsl_program_t::print_active_uniforms(void) const
@@ -433,16 +622,147 @@ const char* glsl_program_t::get_attrib_type_string_form(const GLenum type) const
 
 GLint glsl_program_t::get_uniform_location(const char* name)
 {
-	const auto pos = uniform_locations.find(name);
+	return get_uniform_location(uniform_name_t{ Hash::fnv1a_64(std::string_view(name)), name });
+}
+
+GLint glsl_program_t::get_uniform_location(const uniform_name_t& name)
+{
+	GLint loc = -1;
+	if (uniform_locations.find(name.hash, loc)) return loc;
+
+	// not reported by reflection (or not linked yet), ask the driver once and remember the answer
+	loc = glGetUniformLocation(handle, name.name);
+	uniform_locations.insert(name.hash, loc);
+	return loc;
+}
+
+uint32_t glsl_program_t::get_uniform_slot(const uniform_name_t& name)
+{
+	for (uint32_t slot = 0; slot < uniform_slot_names.size(); ++slot)
+	{
+		if (uniform_slot_names[slot].first == name.hash) return slot;
+	}
+
+	uniform_slot_names.push_back({ name.hash, std::string(name.name) });
+	uniform_slots.push_back(get_uniform_location(name));
+	return static_cast<uint32_t>(uniform_slots.size() - 1);
+}
+
+void glsl_program_t::refresh_uniform_slots(void)
+{
+	for (size_t slot = 0; slot < uniform_slot_names.size(); ++slot)
+	{
+		const std::pair<uint64_t, std::string>& entry = uniform_slot_names[slot];
+		uniform_slots[slot] = get_uniform_location(uniform_name_t{ entry.first, entry.second.c_str() });
+	}
+}
+
+void glsl_program_t::set_binary_cache_directory(const std::string& directory)
+{
+	GLSLShaderInfo::binary_cache_directory = directory;
+	if (directory.empty()) return;
+
+	std::error_code ec = {};
+	std::filesystem::create_directories(directory, ec);
+	if (ec) GLSLShaderInfo::binary_cache_directory.clear();
+}
+
+const program_binary_cache_stats_t& glsl_program_t::get_binary_cache_stats(void)
+{
+	return GLSLShaderInfo::binary_cache_stats;
+}
+
+uint64_t glsl_program_t::get_binary_cache_key(void) const
+{
+	// binaries are only valid for the driver that produced them
+	uint64_t key = Hash::k_fnv1a_offset;
+	const GLenum driver_strings[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (const GLenum name : driver_strings)
+	{
+		const GLubyte* str = glGetString(name);
+		if (str != NULL) key = Hash::fnv1a_64(reinterpret_cast<const char*>(str), key);
+	}
+
+	// injected defines are part of the stage sources
+	for (const pending_stage_t& stage : pending_stages)
+	{
+		key = Hash::fnv1a_64(&stage.type, sizeof(stage.type), key);
+		key = Hash::fnv1a_64(stage.source, key);
+	}
+	return key;
+}
+
+static std::string get_binary_cache_path(const uint64_t key)
+{
+	char name[32] = {};
+	snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+	return GLSLShaderInfo::binary_cache_directory + "/" + name;
+}
+
+bool glsl_program_t::load_program_binary(const uint64_t key)
+{
+	GLint num_formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+	if (num_formats <= 0) return false;
+
+	const std::string path = get_binary_cache_path(key);
+	std::ifstream in_file(path, std::ios::in | std::ios::binary);
+	if (!in_file) return false;
+
+	GLSLShaderInfo::program_binary_header_t header = {};
+	in_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!in_file || header.magic != GLSLShaderInfo::binary_magic || header.version != GLSLShaderInfo::binary_version || header.key != key)
+	{
+		return false;
+	}
+
+	// the length comes from disk, it has to account for exactly the rest of the file before anything is allocated
+	std::error_code ec = {};
+	const uintmax_t file_size = std::filesystem::file_size(path, ec);
+	if (ec || header.length == 0 || file_size != sizeof(header) + uintmax_t(header.length)) return false;
 
-	if (pos == uniform_locations.end())
+	std::vector<char> binary(header.length);
+	in_file.read(binary.data(), header.length);
+	if (!in_file) return false;
+	in_file.close();
+
+	glProgramBinary(handle, header.format, binary.data(), static_cast<GLsizei>(header.length));
+
+	GLint link_status = {};
+	glGetProgramiv(handle, GL_LINK_STATUS, &link_status);
+	if (link_status == 0)
 	{
-		const GLint loc = glGetUniformLocation(handle, name);
-		uniform_locations[name] = loc;
-		return loc;
+		// stale binary, it gets replaced after compiling from source
+		++GLSLShaderInfo::binary_cache_stats.rejected;
+		return false;
 	}
+	return true;
+}
+
+void glsl_program_t::save_program_binary(const uint64_t key) const
+{
+	GLint num_formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+	if (num_formats <= 0) return;
+
+	GLint length = 0;
+	glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(handle, length, &written, &format, binary.data());
+	if (written <= 0) return;
 
-	return pos->second;
+	GLSLShaderInfo::program_binary_header_t header = {};
+	header.magic = GLSLShaderInfo::binary_magic;
+	header.version = GLSLShaderInfo::binary_version;
+	header.key = key;
+	header.format = format;
+	header.length = static_cast<uint32_t>(written);
+
+	FileIO::write_file_atomic(get_binary_cache_path(key), { { &header, sizeof(header) }, { binary.data(), size_t(written) } });
 }
 
 void glsl_program_t::detach_delete_shader_objects(void)
@@ -467,6 +787,56 @@ bool GLSLUtils::file_exists(const std::string& file_name)
 	return (0 == ret);
 }
 
+GLSLShader::GLSLShaderType GLSLUtils::get_shader_type(const char* file_name)
+{
+	const std::string ext = GLSLUtils::get_file_extension(file_name);
+	const auto it = GLSLShaderInfo::extensions.find(ext);
+	if (it == GLSLShaderInfo::extensions.end())
+	{
+		std::string msg = "Unrecognized extension: " + ext;
+		throw GLSLProgramException(msg);
+	}
+	return it->second;
+}
+
+static bool read_file_expanded(const std::filesystem::path& path, std::string& contents, std::vector<std::string>* includes, const uint32_t depth)
+{
+	std::ifstream in_file(path, std::ios::in);
+	if (!in_file) return false;
+
+	std::stringstream code = {};
+	std::string line;
+	uint32_t line_number = 0;
+	while (std::getline(in_file, line))
+	{
+		++line_number;
+		const size_t start = line.find_first_not_of(" \t");
+		if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+		{
+			const size_t open = line.find('"', start + 8);
+			const size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+			// includes nest a few levels at most, deeper means a cycle
+			if (close == std::string::npos || depth >= 8) return false;
+
+			const std::filesystem::path include_path = path.parent_path() / line.substr(open + 1, close - open - 1);
+			if (includes != NULL) includes->push_back(include_path.lexically_normal().generic_string());
+			std::string included;
+			if (!read_file_expanded(include_path, included, includes, depth + 1)) return false;
+			// restores the includer's numbering for compile errors
+			code << included << "\n#line " << (line_number + 1) << "\n";
+			continue;
+		}
+		code << line << "\n";
+	}
+	contents = code.str();
+	return true;
+}
+
+bool GLSLUtils::read_file(const char* file_name, std::string& contents, std::vector<std::string>* includes)
+{
+	return read_file_expanded(std::filesystem::path(file_name), contents, includes, 0);
+}
+
 std::string GLSLUtils::get_file_extension(const char* file_name)
 {
 	std::string name_str(file_name);
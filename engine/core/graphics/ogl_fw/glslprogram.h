@@ -6,9 +6,14 @@
 #include <glm/glm.hpp>
 #// #include <cglm/cglm.h>
 
+#include <stdint.h>
 #include <string>
 #include <map>
+#include <vector>
 #include <stdexcept>
+#include <type_traits>
+
+#include "uniform_table.h"
 
 namespace Continuum {
 
@@ -36,6 +41,53 @@ namespace Continuum {
             };
         }
 
+        namespace GLSLUtils {
+            /// stage from the file extension (see the table in glslprogram.cpp), throws for unknown extensions
+            GLSLShader::GLSLShaderType get_shader_type(const char* file_name);
+            /// `#include "file"` lines are replaced by that file, resolved next to the including one; false if any file is missing.
+            /// includes, when given, receives the normalized path of every file pulled in, nested ones too
+            bool read_file(const char* file_name, std::string& contents, std::vector<std::string>* includes = NULL);
+        }
+
+        /// #defines injected right after a shader's #version line, so that one source compiles into specialised
+        /// variants with the feature switches and constants folded away. A define without a value is a switch
+        /// for #ifdef, valued ones stand in for constants. Kept sorted by name: equal sets hash and compare
+        /// equal whatever order they were defined in.
+        struct shader_permutation_t
+        {
+        public:
+            /// redefining a name replaces its value
+            shader_permutation_t& define(const std::string& name, const std::string& value = std::string());
+            shader_permutation_t& define(const std::string& name, const int value);
+            /// written with the u suffix, for comparisons against GLSL uints
+            shader_permutation_t& define(const std::string& name, const uint32_t value);
+            /// shortest decimal that reads back as the same float, always with a decimal point
+            shader_permutation_t& define(const std::string& name, const float value);
+            shader_permutation_t& define(const std::string& name, const glm::vec4& value);
+        public:
+            inline bool empty(void) const { return this->defines_.empty(); }
+            inline size_t size(void) const { return this->defines_.size(); }
+            inline bool operator==(const shader_permutation_t& other) const { return this->defines_ == other.defines_; }
+            uint64_t get_hash(void) const;
+            /// source with the defines after #version (or in front when it has none), followed by a #line
+            /// directive so that compile errors keep the source's line numbers
+            std::string apply(const std::string& source) const;
+        private:
+            std::vector<std::pair<std::string, std::string>> defines_;
+        };
+
+        struct program_binary_cache_stats_t
+        {
+            uint32_t hits = 0;
+            uint32_t misses = 0;
+            /// cached binaries the driver refused (driver update, different GPU), recompiled
+            uint32_t rejected = 0;
+            /// time spent creating programs from cached binaries
+            double load_ms = 0.0;
+            /// time spent compiling and linking programs that missed the cache
+            double compile_ms = 0.0;
+        };
+
         struct glsl_program_t
         {
             glsl_program_t();
@@ -46,12 +98,19 @@ namespace Continuum {
             void compile_shader(const char* file_name);
             void compile_shader(const char* file_name, const GLSLShader::GLSLShaderType type);
             void compile_shader(const std::string& shader_source, const GLSLShader::GLSLShaderType type, const char* file_name = NULL);
+            /// the same with the permutation's defines injected into the source
+            void compile_shader(const char* file_name, const shader_permutation_t& permutation);
+            void compile_shader(const char* file_name, const GLSLShader::GLSLShaderType type, const shader_permutation_t& permutation);
+            void compile_shader(const std::string& shader_source, const GLSLShader::GLSLShaderType type, const shader_permutation_t& permutation,
+                const char* file_name = NULL);
         public:
             void link(void);
             void validate(void) const;
             void use(void) const;
             GLint get_handle(void) const;
             bool is_linked(void) const;
+            /// takes ownership of an already linked program object and drops the current one (hot reload)
+            void adopt_linked_handle(const GLuint program);
         public:
             void bind_attrib_loc(const GLuint location, const char* name) const;
             void bind_frag_data_loc(const GLuint location, const char* name) const;
@@ -66,19 +125,79 @@ namespace Continuum {
             void set_uniform(const char* name, const int val);
             void set_uniform(const char* name, const bool val);
             void set_uniform(const char* name, const GLuint val);
+        public:
+            /// resolves a uniform once; the handle stays valid across relinks
+            template<typename T>
+            uniform_t<T> get_uniform(const uniform_name_t& name)
+            {
+                uniform_t<T> uniform = {};
+                uniform.slot = get_uniform_slot(name);
+                uniform.program = program_id;
+                return uniform;
+            }
+            /// an unresolved handle, or one resolved on another program, is ignored like a missing uniform
+            template<typename T>
+            inline void set_uniform(const uniform_t<T> uniform, const std::type_identity_t<T>& val) const
+            {
+                if (uniform.program != program_id || !uniform.is_valid()) return;
+                upload_uniform(uniform_slots[uniform.slot], val);
+            }
+            /// hashed lookup without string construction, for "name"_uniform literals
+            template<typename T>
+            inline void set_uniform(const uniform_name_t& name, const T& val)
+            {
+                upload_uniform(get_uniform_location(name), val);
+            }
         public:
             void find_uniform_locations(void);
+        public:
+            /// Enables the on-disk program binary cache for programs linked afterwards, an empty string disables it.
+            /// While enabled, compile_shader only records the sources; link() first tries the cached binary,
+            /// keyed by the stage sources and the driver vendor/renderer/version, and compiles on a miss.
+            static void set_binary_cache_directory(const std::string& directory);
+            static const program_binary_cache_stats_t& get_binary_cache_stats(void);
             void print_active_uniforms(void) const;
             void print_active_uniform_blocks(void) const;
             void print_active_attribs(void) const;
             const char* get_attrib_type_string_form(const GLenum type) const;
         private:
             GLint get_uniform_location(const char* name);
+            GLint get_uniform_location(const uniform_name_t& name);
+            uint32_t get_uniform_slot(const uniform_name_t& name);
+            void refresh_uniform_slots(void);
+            static inline void upload_uniform(const GLint loc, const float val) { glUniform1f(loc, val); }
+            static inline void upload_uniform(const GLint loc, const int val) { glUniform1i(loc, val); }
+            static inline void upload_uniform(const GLint loc, const bool val) { glUniform1i(loc, val); }
+            static inline void upload_uniform(const GLint loc, const GLuint val) { glUniform1ui(loc, val); }
+            static inline void upload_uniform(const GLint loc, const glm::vec2& v) { glUniform2f(loc, v.x, v.y); }
+            static inline void upload_uniform(const GLint loc, const glm::ivec2& v) { glUniform2i(loc, v.x, v.y); }
+            static inline void upload_uniform(const GLint loc, const glm::vec3& v) { glUniform3f(loc, v.x, v.y, v.z); }
+            static inline void upload_uniform(const GLint loc, const glm::vec4& v) { glUniform4f(loc, v.x, v.y, v.z, v.w); }
+            static inline void upload_uniform(const GLint loc, const glm::mat3& m) { glUniformMatrix3fv(loc, 1, GL_FALSE, &m[0][0]); }
+            static inline void upload_uniform(const GLint loc, const glm::mat4& m) { glUniformMatrix4fv(loc, 1, GL_FALSE, &m[0][0]); }
             void detach_delete_shader_objects(void);
+            void compile_stage(const std::string& shader_source, const GLSLShader::GLSLShaderType type, const char* file_name);
+            void link_program(void);
+            uint64_t get_binary_cache_key(void) const;
+            bool load_program_binary(const uint64_t key);
+            void save_program_binary(const uint64_t key) const;
+        private:
+            struct pending_stage_t
+            {
+                GLSLShader::GLSLShaderType type;
+                std::string source;
+                std::string file_name;
+            };
         private:
             GLuint handle;
             bool linked;
-            std::map<std::string, GLint> uniform_locations;
+            /// process-unique and never reused, unlike GL program names; tags the uniform_t handles this program hands out
+            const uint32_t program_id;
+            uniform_table_t uniform_locations;
+            /// locations behind uniform_t handles, re-resolved by name after every link
+            std::vector<GLint> uniform_slots;
+            std::vector<std::pair<uint64_t, std::string>> uniform_slot_names;
+            std::vector<pending_stage_t> pending_stages;
         };
 
     }
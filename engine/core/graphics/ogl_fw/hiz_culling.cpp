@@ -0,0 +1,206 @@
+#include "hiz_culling.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+
+using namespace Continuum::Graphics;
+using namespace Continuum::Graphics::UniformLiterals;
+
+namespace HiZDetail
+{
+	/// work group edge of hiz_build.cs, and size of hiz_cull.cs
+	static constexpr uint32_t k_build_group_size = 8;
+	static constexpr uint32_t k_cull_group_size = 64;
+	static constexpr GLuint k_instances_binding = 8;
+	static constexpr GLuint k_commands_binding = 9;
+	static constexpr GLuint k_source_matrices_binding = 10;
+	static constexpr GLuint k_matrices_binding = 11;
+	static constexpr GLuint k_counters_binding = 12;
+	static constexpr GLuint k_texture_unit = 0;
+	static constexpr GLsizeiptr k_counters_size = 4 * sizeof(uint32_t);
+}
+
+hiz_culler_t::~hiz_culler_t()
+{
+	release();
+	if (this->counters_ != 0) glDeleteBuffers(1, &this->counters_);
+	for (GLsync fence : this->counter_fences_)
+	{
+		if (fence != 0) glDeleteSync(fence);
+	}
+}
+
+void hiz_culler_t::release(void)
+{
+	if (this->depth_ != 0) glDeleteTextures(1, &this->depth_);
+	if (this->pyramid_ != 0) glDeleteTextures(1, &this->pyramid_);
+	this->depth_ = 0;
+	this->pyramid_ = 0;
+	this->width_ = 0;
+	this->height_ = 0;
+	this->level_count_ = 0;
+	this->has_pyramid_ = false;
+}
+
+bool hiz_culler_t::init(const std::string& shader_root)
+{
+	auto build_program = std::make_unique<glsl_program_t>();
+	auto cull_program = std::make_unique<glsl_program_t>();
+	try
+	{
+		build_program->compile_shader((shader_root + "/culling/hiz_build.cs").c_str());
+		build_program->link();
+		cull_program->compile_shader((shader_root + "/culling/hiz_cull.cs").c_str());
+		cull_program->link();
+	}
+	catch (const GLSLProgramException& e)
+	{
+		fprintf(stderr, "Hi-Z: occlusion culling unavailable: %s\n", e.what());
+		return false;
+	}
+
+	this->build_level_ = build_program->get_uniform<GLuint>("level"_uniform);
+	this->build_in_size_ = build_program->get_uniform<glm::ivec2>("in_size"_uniform);
+	this->build_out_size_ = build_program->get_uniform<glm::ivec2>("out_size"_uniform);
+	this->cull_instance_count_ = cull_program->get_uniform<GLuint>("instance_count"_uniform);
+	this->cull_view_proj_ = cull_program->get_uniform<glm::mat4>("view_proj"_uniform);
+	this->cull_hiz_view_proj_ = cull_program->get_uniform<glm::mat4>("hiz_view_proj"_uniform);
+	this->cull_hiz_offset_ = cull_program->get_uniform<glm::vec3>("hiz_offset"_uniform);
+	this->cull_hiz_size_ = cull_program->get_uniform<glm::ivec2>("hiz_size"_uniform);
+	this->cull_hiz_levels_ = cull_program->get_uniform<int>("hiz_levels"_uniform);
+	this->build_program_ = std::move(build_program);
+	this->cull_program_ = std::move(cull_program);
+
+	if (this->counters_ == 0)
+	{
+		glCreateBuffers(1, &this->counters_);
+		glNamedBufferStorage(this->counters_, k_counter_frames * HiZDetail::k_counters_size, NULL, GL_DYNAMIC_STORAGE_BIT);
+		const GLuint zero = 0;
+		glClearNamedBufferData(this->counters_, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	}
+	return true;
+}
+
+void hiz_culler_t::allocate(const uint32_t width, const uint32_t height)
+{
+	release();
+
+	this->width_ = width;
+	this->height_ = height;
+	this->level_count_ = 1;
+	while ((std::max(width, height) >> this->level_count_) > 0) ++this->level_count_;
+
+	// the depth buffer can't be read by a shader, it is copied into a texture first
+	glCreateTextures(GL_TEXTURE_2D, 1, &this->depth_);
+	glTextureStorage2D(this->depth_, 1, GL_DEPTH_COMPONENT32F, GLsizei(width), GLsizei(height));
+	glTextureParameteri(this->depth_, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(this->depth_, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &this->pyramid_);
+	glTextureStorage2D(this->pyramid_, GLsizei(this->level_count_), GL_R32F, GLsizei(width), GLsizei(height));
+	glTextureParameteri(this->pyramid_, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(this->pyramid_, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void hiz_culler_t::begin_frame(void)
+{
+	if (this->counters_ == 0) return;
+
+	// the frame that just ended is fenced; the one before it had a whole frame to finish, reading its slot only
+	// once the fence says so keeps glGetNamedBufferSubData from waiting on the GPU
+	const uint32_t ended = this->frame_ % k_counter_frames;
+	if (this->counter_fences_[ended] != 0) glDeleteSync(this->counter_fences_[ended]);
+	this->counter_fences_[ended] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	const uint32_t previous = (this->frame_ + k_counter_frames - 1) % k_counter_frames;
+	uint32_t counters[4] = {};
+	GLsync& fence = this->counter_fences_[previous];
+	if (fence != 0)
+	{
+		const GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			glGetNamedBufferSubData(this->counters_, GLintptr(previous) * HiZDetail::k_counters_size, HiZDetail::k_counters_size, counters);
+		}
+		else ++this->stats_.dropped_frames;
+		glDeleteSync(fence);
+		fence = 0;
+	}
+	this->stats_.tested = counters[0];
+	this->stats_.visible = counters[1];
+	this->stats_.frustum_culled = counters[2];
+	this->stats_.occlusion_culled = counters[3];
+
+	// the slot after the ended one held the frame read a call ago, it is free for the frame starting now
+	++this->frame_;
+	const GLuint zero = 0;
+	glClearNamedBufferSubData(this->counters_, GL_R32UI, GLintptr(this->frame_ % k_counter_frames) * HiZDetail::k_counters_size, HiZDetail::k_counters_size,
+		GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+}
+
+void hiz_culler_t::build(const uint32_t width, const uint32_t height, const glm::mat4& view_proj, const glm::dvec3& origin)
+{
+	if (!is_available() || width == 0 || height == 0) return;
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	if (width != this->width_ || height != this->height_) allocate(width, height);
+	glCopyTextureSubImage2D(this->depth_, 0, 0, 0, 0, 0, GLsizei(width), GLsizei(height));
+
+	this->build_program_->use();
+	glBindTextureUnit(HiZDetail::k_texture_unit, this->depth_);
+	for (uint32_t level = 0; level < this->level_count_; ++level)
+	{
+		const glm::ivec2 in_size = glm::ivec2(std::max(width >> (level > 0 ? level - 1 : 0), 1u), std::max(height >> (level > 0 ? level - 1 : 0), 1u));
+		const glm::ivec2 out_size = glm::ivec2(std::max(width >> level, 1u), std::max(height >> level, 1u));
+		glBindImageTexture(0, this->pyramid_, GLint(level > 0 ? level - 1 : 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, this->pyramid_, GLint(level), GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		this->build_program_->set_uniform(this->build_level_, level);
+		this->build_program_->set_uniform(this->build_in_size_, in_size);
+		this->build_program_->set_uniform(this->build_out_size_, out_size);
+		glDispatchCompute((GLuint(out_size.x) + HiZDetail::k_build_group_size - 1) / HiZDetail::k_build_group_size,
+			(GLuint(out_size.y) + HiZDetail::k_build_group_size - 1) / HiZDetail::k_build_group_size, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	this->pyramid_view_proj_ = view_proj;
+	this->pyramid_origin_ = origin;
+	this->has_pyramid_ = true;
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	this->stats_.build_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void hiz_culler_t::cull(const hiz_cull_job_t& job)
+{
+	assert(is_available());
+	if (job.instance_count == 0) return;
+
+	this->cull_program_->use();
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, HiZDetail::k_instances_binding, job.instances.buffer, job.instances.offset, job.instances.size);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, HiZDetail::k_commands_binding, job.commands.buffer, job.commands.offset, job.commands.size);
+	if (job.matrices.size > 0)
+	{
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, HiZDetail::k_source_matrices_binding, job.source_matrices.buffer, job.source_matrices.offset, job.source_matrices.size);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, HiZDetail::k_matrices_binding, job.matrices.buffer, job.matrices.offset, job.matrices.size);
+	}
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, HiZDetail::k_counters_binding, this->counters_,
+		GLintptr(this->frame_ % k_counter_frames) * HiZDetail::k_counters_size, HiZDetail::k_counters_size);
+
+	this->cull_program_->set_uniform(this->cull_instance_count_, job.instance_count);
+	this->cull_program_->set_uniform(this->cull_view_proj_, job.view_proj);
+	this->cull_program_->set_uniform(this->cull_hiz_levels_, this->has_pyramid_ ? int(this->level_count_) : 0);
+	if (this->has_pyramid_)
+	{
+		// the pyramid was rendered around its own origin, the offset is taken in double
+		this->cull_program_->set_uniform(this->cull_hiz_view_proj_, this->pyramid_view_proj_);
+		this->cull_program_->set_uniform(this->cull_hiz_offset_, glm::vec3(job.origin - this->pyramid_origin_));
+		this->cull_program_->set_uniform(this->cull_hiz_size_, glm::ivec2(int(this->width_), int(this->height_)));
+		glBindTextureUnit(HiZDetail::k_texture_unit, this->pyramid_);
+	}
+
+	glDispatchCompute((job.instance_count + HiZDetail::k_cull_group_size - 1) / HiZDetail::k_cull_group_size, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
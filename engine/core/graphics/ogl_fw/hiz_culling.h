@@ -0,0 +1,133 @@
+#ifndef HIZ_CULLING_H
+#define HIZ_CULLING_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+#include "glslprogram.h"
+
+namespace Continuum {
+
+    namespace Graphics {
+
+        /// mirrors CullInstance in shader/culling/hiz_cull.cs (std430)
+        struct gpu_cull_instance_t
+        {
+            static constexpr uint32_t k_no_matrix = 0xffffffffu;
+            /// xyz centre relative to the job's origin, w radius
+            float sphere[4];
+            /// the draw_elements_indirect_command_t the instance is counted into
+            uint32_t command;
+            /// source matrix, copied to the command's base_instance + slot; k_no_matrix for commands drawing one instance of their own
+            uint32_t matrix;
+            uint32_t pad[2];
+        };
+
+        struct buffer_range_t
+        {
+            GLuint buffer = 0;
+            GLintptr offset = 0;
+            GLsizeiptr size = 0;
+        };
+
+        /// One cull() dispatch. The commands are uploaded with instance_count 0 and base_instance pointing at
+        /// room for all of their instances in matrices; the matrix ranges are only needed by instances carrying one.
+        struct hiz_cull_job_t
+        {
+            buffer_range_t instances;
+            uint32_t instance_count = 0;
+            buffer_range_t commands;
+            buffer_range_t source_matrices;
+            buffer_range_t matrices;
+            /// this frame's view and projection, relative to origin
+            glm::mat4 view_proj = glm::mat4(1.0f);
+            glm::dvec3 origin = glm::dvec3(0.0);
+        };
+
+        struct hiz_cull_stats_t
+        {
+            uint32_t tested = 0;
+            uint32_t visible = 0;
+            uint32_t frustum_culled = 0;
+            uint32_t occlusion_culled = 0;
+            /// frames whose counters the GPU had not written yet when begin_frame() came to read them; such a frame
+            /// reports zero counts instead of waiting
+            uint64_t dropped_frames = 0;
+            /// CPU time of the last build(): the depth copy and one dispatch per level
+            double build_ms = 0.0;
+        };
+
+        /// GPU occlusion culling against a hierarchical-Z pyramid (see Graphics::hiz_pyramid_t, the CPU reference).
+        /// After a frame's opaque draws build() turns its depth into the pyramid; the next frame's cull() tests
+        /// instance spheres against it and compacts the survivors into multi-draw indirect commands. Objects
+        /// appearing from behind an occluder show up one frame late, a camera cut should call reset().
+        /// Dispatches change the program, SSBO bindings 8-12 and texture unit 0: a render_state_tracker_t has to be
+        /// invalidated afterwards.
+        struct hiz_culler_t
+        {
+            hiz_culler_t() = default;
+            ~hiz_culler_t();
+            hiz_culler_t(const hiz_culler_t&) = delete;
+            hiz_culler_t& operator=(const hiz_culler_t&) = delete;
+        public:
+            /// false when the compute programs fail, callers keep drawing without cull()
+            bool init(const std::string& shader_root);
+            /// Once per frame: fences the frame that ended and clears this frame's counters. The counters of the frame
+            /// before that are read back only if its fence has signalled, never stalling on the GPU.
+            void begin_frame(void);
+            /// Builds the pyramid from the depth of the bound read framebuffer. view_proj and origin are what that
+            /// depth was rendered with; the pyramid keeps them for the next frame's cull().
+            void build(const uint32_t width, const uint32_t height, const glm::mat4& view_proj, const glm::dvec3& origin);
+            /// frustum and occlusion test, then the barrier for the indirect draw reading the commands
+            void cull(const hiz_cull_job_t& job);
+            inline void reset(void) { this->has_pyramid_ = false; }
+        public:
+            inline bool is_available(void) const { return this->cull_program_ != NULL; }
+            inline bool has_pyramid(void) const { return this->has_pyramid_; }
+            inline GLuint get_pyramid_texture(void) const { return this->pyramid_; }
+            inline uint32_t get_level_count(void) const { return this->level_count_; }
+            /// counters of the frame before the one the last begin_frame() ended
+            inline const hiz_cull_stats_t& get_stats(void) const { return this->stats_; }
+        private:
+            void allocate(const uint32_t width, const uint32_t height);
+            void release(void);
+        private:
+            std::unique_ptr<glsl_program_t> build_program_;
+            std::unique_ptr<glsl_program_t> cull_program_;
+            uniform_t<GLuint> build_level_;
+            uniform_t<glm::ivec2> build_in_size_;
+            uniform_t<glm::ivec2> build_out_size_;
+            uniform_t<GLuint> cull_instance_count_;
+            uniform_t<glm::mat4> cull_view_proj_;
+            uniform_t<glm::mat4> cull_hiz_view_proj_;
+            uniform_t<glm::vec3> cull_hiz_offset_;
+            uniform_t<glm::ivec2> cull_hiz_size_;
+            uniform_t<int> cull_hiz_levels_;
+
+            GLuint depth_ = 0;
+            GLuint pyramid_ = 0;
+            uint32_t width_ = 0;
+            uint32_t height_ = 0;
+            uint32_t level_count_ = 0;
+            bool has_pyramid_ = false;
+            glm::mat4 pyramid_view_proj_ = glm::mat4(1.0f);
+            glm::dvec3 pyramid_origin_ = glm::dvec3(0.0);
+
+            /// k_counter_frames slots of tested, visible, frustum_culled, occlusion_culled, each fenced after its frame
+            static constexpr uint32_t k_counter_frames = 3;
+            GLuint counters_ = 0;
+            GLsync counter_fences_[k_counter_frames] = {};
+            uint32_t frame_ = 0;
+            hiz_cull_stats_t stats_;
+        };
+
+    }
+
+}
+#endif
@@ -0,0 +1,405 @@
+#include "impostor.h"
+
+#include "../../hash.h"
+#include "../../file_io.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+using namespace Continuum;
+using namespace Continuum::Graphics;
+using namespace Continuum::Graphics::UniformLiterals;
+
+namespace ImpostorDetail
+{
+	static inline glm::vec2 sign_not_zero(const glm::vec2& v)
+	{
+		return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	static inline uint32_t payload_checksum(const impostor_atlas_t& atlas)
+	{
+		return FileIO::payload_checksum({ { atlas.albedo.data(), atlas.albedo.size() }, { atlas.normal_depth.data(), atlas.normal_depth.size() } });
+	}
+
+	static inline double elapsed_ms(const std::chrono::high_resolution_clock::time_point& from)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - from).count();
+	}
+
+	static std::string cache_path(const std::string& directory, const uint64_t key)
+	{
+		char name[40] = {};
+		snprintf(name, sizeof(name), "impostor_%016llx.bin", static_cast<unsigned long long>(key));
+		return (std::filesystem::path(directory) / name).string();
+	}
+}
+
+glm::vec2 Octahedral::encode(const glm::vec3& direction)
+{
+	glm::vec2 p = glm::vec2(direction.x, direction.z) / (std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z));
+	if (direction.y < 0.0f) p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * ImpostorDetail::sign_not_zero(p);
+	return p * 0.5f + 0.5f;
+}
+
+glm::vec3 Octahedral::decode(const glm::vec2& uv)
+{
+	glm::vec2 p = uv * 2.0f - 1.0f;
+	const float y = 1.0f - std::fabs(p.x) - std::fabs(p.y);
+	if (y < 0.0f) p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * ImpostorDetail::sign_not_zero(p);
+	return glm::normalize(glm::vec3(p.x, y, p.y));
+}
+
+void Octahedral::frame_basis(const glm::vec3& direction, glm::vec3& right, glm::vec3& up)
+{
+	const glm::vec3 reference = std::fabs(direction.y) < 0.999f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+	right = glm::normalize(glm::cross(reference, direction));
+	up = glm::cross(direction, right);
+}
+
+uint64_t Graphics::impostor_key(const mesh_pool_t& pool, const uint32_t mesh, const impostor_settings_t& settings)
+{
+	const mesh_range_t& range = pool.get_mesh(mesh);
+	const uint32_t fields[] = { impostor_file_header_t::k_version, settings.grid, settings.view_size };
+	uint64_t h = Hash::fnv1a_64(fields, sizeof(fields), Hash::k_fnv1a_offset);
+	h = Hash::fnv1a_64(pool.get_vertices().data() + range.base_vertex, size_t(range.vertex_count) * sizeof(mesh_vertex_t), h);
+	return Hash::fnv1a_64(pool.get_indices().data() + range.first_index, size_t(range.index_count) * sizeof(uint32_t), h);
+}
+
+bool Graphics::save_impostor(const std::string& path, const impostor_atlas_t& atlas)
+{
+	if (atlas.empty()) return false;
+	impostor_file_header_t header = {};
+	header.grid = atlas.grid;
+	header.key = atlas.key;
+	header.view_size = atlas.view_size;
+	header.checksum = ImpostorDetail::payload_checksum(atlas);
+	for (int i = 0; i < 4; ++i) header.bounds[i] = atlas.bounds[i];
+
+	return FileIO::write_file_atomic(path, {
+		{ &header, sizeof(header) },
+		{ atlas.albedo.data(), atlas.albedo.size() },
+		{ atlas.normal_depth.data(), atlas.normal_depth.size() } });
+}
+
+bool Graphics::load_impostor(const std::string& path, const uint64_t key, impostor_atlas_t& atlas)
+{
+	std::ifstream in_file(path, std::ios::in | std::ios::binary);
+	if (!in_file) return false;
+
+	const impostor_file_header_t expected = {};
+	impostor_file_header_t header = {};
+	in_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	const bool valid_header = in_file
+		&& header.magic == expected.magic && header.version == expected.version && header.header_size == expected.header_size
+		&& header.key == key && header.grid > 0 && header.grid <= 64 && header.view_size > 0 && header.view_size <= 1024;
+	if (!valid_header) return false;
+
+	// the header alone may ask for gigabytes, the file has to actually hold them before anything is allocated;
+	// a longer file is as suspect as a shorter one
+	const size_t size = size_t(header.grid) * header.view_size;
+	const size_t bytes = size * size * 4;
+	std::error_code ec = {};
+	const uintmax_t file_size = std::filesystem::file_size(path, ec);
+	if (ec || file_size != sizeof(header) + 2 * uintmax_t(bytes)) return false;
+
+	impostor_atlas_t loaded;
+	loaded.key = header.key;
+	loaded.grid = header.grid;
+	loaded.view_size = header.view_size;
+	loaded.bounds = glm::vec4(header.bounds[0], header.bounds[1], header.bounds[2], header.bounds[3]);
+	loaded.albedo.resize(bytes);
+	loaded.normal_depth.resize(bytes);
+	in_file.read(reinterpret_cast<char*>(loaded.albedo.data()), std::streamsize(bytes));
+	in_file.read(reinterpret_cast<char*>(loaded.normal_depth.data()), std::streamsize(bytes));
+	// the size check above does not hold against a file replaced in between
+	if (!in_file || in_file.peek() != std::ifstream::traits_type::eof()) return false;
+	if (header.checksum != ImpostorDetail::payload_checksum(loaded)) return false;
+
+	atlas = std::move(loaded);
+	return true;
+}
+
+impostor_baker_t::~impostor_baker_t()
+{
+	release();
+}
+
+void impostor_baker_t::release(void)
+{
+	if (this->framebuffer_ != 0) glDeleteFramebuffers(1, &this->framebuffer_);
+	if (this->albedo_ != 0) glDeleteTextures(1, &this->albedo_);
+	if (this->normal_depth_ != 0) glDeleteTextures(1, &this->normal_depth_);
+	if (this->depth_ != 0) glDeleteRenderbuffers(1, &this->depth_);
+	this->framebuffer_ = 0;
+	this->albedo_ = 0;
+	this->normal_depth_ = 0;
+	this->depth_ = 0;
+	this->size_ = 0;
+}
+
+bool impostor_baker_t::init(const std::string& shader_root)
+{
+	auto program = std::make_unique<glsl_program_t>();
+	try
+	{
+		program->compile_shader((shader_root + "/impostor/impostor_bake.vert").c_str());
+		program->compile_shader((shader_root + "/impostor/impostor_bake.frag").c_str());
+		program->link();
+	}
+	catch (const GLSLProgramException& e)
+	{
+		fprintf(stderr, "Impostors: bake program unavailable: %s\n", e.what());
+		return false;
+	}
+	this->view_proj_ = program->get_uniform<glm::mat4>("view_proj"_uniform);
+	this->program_ = std::move(program);
+	return true;
+}
+
+void impostor_baker_t::allocate(const uint32_t size)
+{
+	release();
+	this->size_ = size;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &this->albedo_);
+	glTextureStorage2D(this->albedo_, 1, GL_RGBA8, GLsizei(size), GLsizei(size));
+	glCreateTextures(GL_TEXTURE_2D, 1, &this->normal_depth_);
+	glTextureStorage2D(this->normal_depth_, 1, GL_RGBA8, GLsizei(size), GLsizei(size));
+	glCreateRenderbuffers(1, &this->depth_);
+	glNamedRenderbufferStorage(this->depth_, GL_DEPTH_COMPONENT24, GLsizei(size), GLsizei(size));
+
+	glCreateFramebuffers(1, &this->framebuffer_);
+	glNamedFramebufferTexture(this->framebuffer_, GL_COLOR_ATTACHMENT0, this->albedo_, 0);
+	glNamedFramebufferTexture(this->framebuffer_, GL_COLOR_ATTACHMENT1, this->normal_depth_, 0);
+	glNamedFramebufferRenderbuffer(this->framebuffer_, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->depth_);
+	const GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glNamedFramebufferDrawBuffers(this->framebuffer_, 2, buffers);
+}
+
+void impostor_baker_t::bake(const mesh_pool_t& pool, const uint32_t mesh, const impostor_settings_t& settings, impostor_atlas_t& atlas)
+{
+	const uint32_t grid = std::max<uint32_t>(settings.grid, 1);
+	const uint32_t view_size = std::max<uint32_t>(settings.view_size, 1);
+	const mesh_range_t& range = pool.get_mesh(mesh);
+	atlas.key = impostor_key(pool, mesh, settings);
+	atlas.grid = grid;
+	atlas.view_size = view_size;
+	atlas.bounds = range.bounds;
+	atlas.albedo.clear();
+	atlas.normal_depth.clear();
+	if (this->program_ == NULL) return;
+
+	const uint32_t size = grid * view_size;
+	if (size != this->size_) allocate(size);
+
+	GLint previous_framebuffer = 0;
+	GLint previous_viewport[4] = {};
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+	glGetIntegerv(GL_VIEWPORT, previous_viewport);
+	const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->framebuffer_);
+	glEnable(GL_DEPTH_TEST);
+	// nothing covered: no coverage, a normal facing the view and the depth of the centre plane
+	const float clear_albedo[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const float clear_normal_depth[4] = { 0.5f, 0.5f, 1.0f, 0.5f };
+	glClearNamedFramebufferfv(this->framebuffer_, GL_COLOR, 0, clear_albedo);
+	glClearNamedFramebufferfv(this->framebuffer_, GL_COLOR, 1, clear_normal_depth);
+	glClearNamedFramebufferfi(this->framebuffer_, GL_DEPTH_STENCIL, 0, 1.0f, 0);
+
+	this->program_->use();
+	pool.bind();
+	const glm::vec3 center = glm::vec3(range.bounds);
+	const float radius = std::max(range.bounds.w, 1e-6f);
+	// orthographic across the bounding sphere, the depth range spans it front to back
+	const glm::mat4 proj = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius);
+	for (uint32_t j = 0; j < grid; ++j)
+	{
+		for (uint32_t i = 0; i < grid; ++i)
+		{
+			const glm::vec3 direction = Octahedral::decode((glm::vec2(float(i), float(j)) + 0.5f) / float(grid));
+			glm::vec3 right, up;
+			Octahedral::frame_basis(direction, right, up);
+			const glm::mat4 view = glm::lookAt(center + direction * radius, center, up);
+			this->program_->set_uniform(this->view_proj_, proj * view);
+			glViewport(GLint(i * view_size), GLint(j * view_size), GLsizei(view_size), GLsizei(view_size));
+			glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(range.index_count), GL_UNSIGNED_INT,
+				reinterpret_cast<const void*>(size_t(range.first_index) * sizeof(uint32_t)), range.base_vertex);
+		}
+	}
+
+	const size_t bytes = size_t(size) * size * 4;
+	atlas.albedo.resize(bytes);
+	atlas.normal_depth.resize(bytes);
+	glGetTextureImage(this->albedo_, 0, GL_RGBA, GL_UNSIGNED_BYTE, GLsizei(bytes), atlas.albedo.data());
+	glGetTextureImage(this->normal_depth_, 0, GL_RGBA, GL_UNSIGNED_BYTE, GLsizei(bytes), atlas.normal_depth.data());
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previous_framebuffer));
+	glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+	if (!depth_test) glDisable(GL_DEPTH_TEST);
+}
+
+impostor_set_t::~impostor_set_t()
+{
+	release();
+}
+
+void impostor_set_t::release(void)
+{
+	if (this->albedo_ != 0) glDeleteTextures(1, &this->albedo_);
+	if (this->normal_depth_ != 0) glDeleteTextures(1, &this->normal_depth_);
+	if (this->table_ != 0) glDeleteBuffers(1, &this->table_);
+	this->albedo_ = 0;
+	this->normal_depth_ = 0;
+	this->table_ = 0;
+}
+
+bool impostor_set_t::init(const std::string& shader_root)
+{
+	if (!this->baker_.init(shader_root)) return false;
+	auto program = std::make_unique<glsl_program_t>();
+	try
+	{
+		program->compile_shader((shader_root + "/impostor/impostor.vert").c_str());
+		program->compile_shader((shader_root + "/impostor/impostor.frag").c_str());
+		program->link();
+	}
+	catch (const GLSLProgramException& e)
+	{
+		fprintf(stderr, "Impostors: draw program unavailable: %s\n", e.what());
+		return false;
+	}
+	this->program_ = std::move(program);
+	return true;
+}
+
+void impostor_set_t::build(mesh_pool_t& pool, const std::vector<uint32_t>& meshes, const impostor_settings_t& settings, const std::string& cache_directory)
+{
+	release();
+	this->atlases_.clear();
+	this->layers_.assign(pool.get_mesh_count(), -1);
+	this->stats_ = impostor_stats_t();
+	if (this->program_ == NULL || meshes.empty()) return;
+
+	for (const uint32_t mesh : meshes)
+	{
+		if (mesh >= pool.get_mesh_count() || this->layers_[mesh] >= 0) continue;
+		this->layers_[mesh] = int32_t(this->atlases_.size());
+		this->atlases_.emplace_back();
+		impostor_atlas_t& atlas = this->atlases_.back();
+
+		const uint64_t key = impostor_key(pool, mesh, settings);
+		const std::string path = cache_directory.empty() ? std::string() : ImpostorDetail::cache_path(cache_directory, key);
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		if (!path.empty() && load_impostor(path, key, atlas))
+		{
+			++this->stats_.loaded;
+			this->stats_.load_ms += ImpostorDetail::elapsed_ms(t0);
+			continue;
+		}
+		this->baker_.bake(pool, mesh, settings, atlas);
+		++this->stats_.baked;
+		this->stats_.bake_ms += ImpostorDetail::elapsed_ms(t0);
+		if (!path.empty() && !save_impostor(path, atlas)) fprintf(stderr, "Impostors: cannot write %s\n", path.c_str());
+	}
+
+	// one layer per mesh, every atlas was baked with the same settings
+	const uint32_t size = this->atlases_[0].get_size();
+	const GLsizei layers = GLsizei(this->atlases_.size());
+	std::vector<gpu_impostor_t> table(this->atlases_.size());
+	for (GLuint* texture : { &this->albedo_, &this->normal_depth_ })
+	{
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, texture);
+		glTextureStorage3D(*texture, 1, GL_RGBA8, GLsizei(size), GLsizei(size), layers);
+		// views are packed edge to edge, filtering or mipmaps would bleed between them
+		glTextureParameteri(*texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(*texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(*texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(*texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	for (size_t layer = 0; layer < this->atlases_.size(); ++layer)
+	{
+		const impostor_atlas_t& atlas = this->atlases_[layer];
+		if (atlas.get_size() == size && !atlas.empty())
+		{
+			glTextureSubImage3D(this->albedo_, 0, 0, 0, GLint(layer), GLsizei(size), GLsizei(size), 1, GL_RGBA, GL_UNSIGNED_BYTE, atlas.albedo.data());
+			glTextureSubImage3D(this->normal_depth_, 0, 0, 0, GLint(layer), GLsizei(size), GLsizei(size), 1, GL_RGBA, GL_UNSIGNED_BYTE, atlas.normal_depth.data());
+		}
+		for (int i = 0; i < 4; ++i) table[layer].bounds[i] = atlas.bounds[i];
+		table[layer].grid[0] = float(atlas.grid);
+	}
+	glCreateBuffers(1, &this->table_);
+	glNamedBufferStorage(this->table_, GLsizeiptr(table.size() * sizeof(gpu_impostor_t)), table.data(), 0);
+
+	// the billboard corners, impostor.vert spans them over the chosen view
+	const mesh_vertex_t quad[4] = {
+		{ { -1.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } },
+		{ { 1.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f } },
+		{ { 1.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f } },
+		{ { -1.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f } }
+	};
+	const uint32_t quad_indices[6] = { 0, 1, 2, 2, 3, 0 };
+	this->quad_mesh_ = pool.add_mesh(quad, 4, quad_indices, 6);
+	pool.commit();
+}
+
+void impostor_set_t::split(const mesh_pool_t& pool, const draw_list_t& list, const glm::vec3& camera, const impostor_lod_t& lod,
+	draw_list_t& meshes, draw_list_t& impostors)
+{
+	meshes.clear();
+	impostors.clear();
+	this->stats_.mesh_instances = 0;
+	this->stats_.impostor_instances = 0;
+	this->stats_.faded_instances = 0;
+	this->stats_.triangles = 0;
+
+	const uint64_t quad_triangles = this->atlases_.empty() ? 0 : pool.get_mesh(this->quad_mesh_).index_count / 3;
+	for (size_t instance = 0; instance < list.size(); ++instance)
+	{
+		const uint32_t mesh = list.get_mesh(instance);
+		const glm::mat4& model = list.get_model(instance);
+		const int32_t layer = get_layer(mesh);
+		const glm::vec4& bounds = pool.get_mesh(mesh).bounds;
+
+		// 0 draws the mesh alone, 1 the impostor alone
+		float fade = 0.0f;
+		if (layer >= 0)
+		{
+			const float distance = glm::length(glm::vec3(model * glm::vec4(glm::vec3(bounds), 1.0f)) - camera);
+			fade = lod.fade > 0.0f ? glm::clamp((distance - lod.distance) / lod.fade, 0.0f, 1.0f) : (distance >= lod.distance ? 1.0f : 0.0f);
+		}
+
+		if (fade < 1.0f)
+		{
+			glm::mat4 mesh_model = model;
+			mesh_model[0][3] = fade;
+			meshes.add(mesh, mesh_model);
+			++this->stats_.mesh_instances;
+			this->stats_.triangles += pool.get_mesh(mesh).index_count / 3;
+		}
+		if (fade > 0.0f)
+		{
+			glm::mat4 impostor_model = model;
+			impostor_model[0][3] = fade;
+			impostor_model[1][3] = float(layer);
+			impostors.add(this->quad_mesh_, impostor_model);
+			++this->stats_.impostor_instances;
+			this->stats_.triangles += quad_triangles;
+		}
+		if (fade > 0.0f && fade < 1.0f) ++this->stats_.faded_instances;
+	}
+}
+
+void impostor_set_t::bind(void) const
+{
+	glBindTextureUnit(k_albedo_unit, this->albedo_);
+	glBindTextureUnit(k_normal_depth_unit, this->normal_depth_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, k_table_binding, this->table_);
+}
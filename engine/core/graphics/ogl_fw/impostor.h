@@ -0,0 +1,184 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glslprogram.h"
+#include "indirect_draw.h"
+
+namespace Continuum {
+
+    namespace Graphics {
+
+        /// Octahedral mapping of view directions onto [0, 1]^2, mirrored by shader/impostor/impostor.glsl.
+        /// The upper hemisphere (y > 0) fills the inner diamond, the lower one the folded corners.
+        namespace Octahedral {
+            glm::vec2 encode(const glm::vec3& direction);
+            glm::vec3 decode(const glm::vec2& uv);
+            /// image axes of the view looking along -direction
+            void frame_basis(const glm::vec3& direction, glm::vec3& right, glm::vec3& up);
+        }
+
+        struct impostor_settings_t
+        {
+            /// views per atlas side, grid^2 directions over the whole sphere
+            uint32_t grid = 8;
+            /// texels per view side
+            uint32_t view_size = 64;
+        };
+
+        /// One baked mesh: grid x grid orthographic views, view (i, j) looking along -decode((i + 0.5, j + 0.5) / grid)
+        /// at the mesh's bounding sphere. albedo is RGBA8 with coverage in alpha; normal_depth holds the mesh-space
+        /// normal as n * 0.5 + 0.5 and the depth across the sphere, 0 on the side facing the view.
+        struct impostor_atlas_t
+        {
+            uint64_t key = 0;
+            uint32_t grid = 0;
+            uint32_t view_size = 0;
+            glm::vec4 bounds = glm::vec4(0.0f);
+            std::vector<uint8_t> albedo;
+            std::vector<uint8_t> normal_depth;
+        public:
+            inline uint32_t get_size(void) const { return this->grid * this->view_size; }
+            inline bool empty(void) const { return this->albedo.empty(); }
+        };
+
+        /// mirrors Impostor in shader/impostor/impostor.vert (std430)
+        struct gpu_impostor_t
+        {
+            float bounds[4];
+            /// grid, then padding
+            float grid[4];
+        };
+
+        /// on-disk layout of a cached atlas, followed by the albedo and normal_depth payloads
+        struct impostor_file_header_t
+        {
+            static constexpr uint32_t k_magic = 0x504D4943; // "CIMP"
+            /// also part of the cache key, bump it when the bake shaders change what they write
+            static constexpr uint32_t k_version = 1;
+
+            uint32_t magic = k_magic;
+            uint32_t version = k_version;
+            uint32_t header_size = sizeof(impostor_file_header_t);
+            uint32_t grid = 0;
+            uint64_t key = 0;
+            uint32_t view_size = 0;
+            /// low 32 bits of the FNV-1a hash of the payload
+            uint32_t checksum = 0;
+            float bounds[4] = {};
+        };
+
+        /// cache key of a bake: the mesh's vertices and indices, the settings and the bake version
+        uint64_t impostor_key(const mesh_pool_t& pool, const uint32_t mesh, const impostor_settings_t& settings);
+        /// written to a temporary name and renamed, like the atmosphere tables
+        bool save_impostor(const std::string& path, const impostor_atlas_t& atlas);
+        /// false unless the file holds a complete, intact bake with this key
+        bool load_impostor(const std::string& path, const uint64_t key, impostor_atlas_t& atlas);
+
+        /// Renders the views of a mesh from a committed pool into an offscreen atlas and reads it back. Changes the
+        /// program, the VAO and SSBO binding 1 behind a render_state_tracker_t's back; the framebuffer and viewport
+        /// are restored.
+        struct impostor_baker_t
+        {
+            impostor_baker_t() = default;
+            ~impostor_baker_t();
+            impostor_baker_t(const impostor_baker_t&) = delete;
+            impostor_baker_t& operator=(const impostor_baker_t&) = delete;
+        public:
+            /// false when the bake programs fail
+            bool init(const std::string& shader_root);
+            void bake(const mesh_pool_t& pool, const uint32_t mesh, const impostor_settings_t& settings, impostor_atlas_t& atlas);
+        private:
+            void allocate(const uint32_t size);
+            void release(void);
+        private:
+            std::unique_ptr<glsl_program_t> program_;
+            uniform_t<glm::mat4> view_proj_;
+            GLuint framebuffer_ = 0;
+            GLuint albedo_ = 0;
+            GLuint normal_depth_ = 0;
+            GLuint depth_ = 0;
+            uint32_t size_ = 0;
+        };
+
+        /// Distance where meshes give way to impostors; over the fade both are drawn, dithered into each other.
+        struct impostor_lod_t
+        {
+            float distance = 10.0f;
+            float fade = 2.0f;
+        };
+
+        struct impostor_stats_t
+        {
+            /// build(): meshes baked, or read from the disk cache
+            uint32_t baked = 0;
+            uint32_t loaded = 0;
+            double bake_ms = 0.0;
+            double load_ms = 0.0;
+            /// last split(): instances drawn as meshes, as impostors, as both, and the triangles of it all
+            uint32_t mesh_instances = 0;
+            uint32_t impostor_instances = 0;
+            uint32_t faded_instances = 0;
+            uint64_t triangles = 0;
+        };
+
+        /// Impostors of a set of meshes in two texture arrays, one layer per mesh. split() moves the far instances
+        /// of a draw list to billboards drawn with get_program() through indirect_renderer_t. Instances fading between
+        /// the two carry the fade in model[0][3] of both copies; the mesh copy needs the IMPOSTOR_FADE permutation of
+        /// mesh.vert and mesh.frag, which restores the matrix and discards the impostor's half of the dither.
+        struct impostor_set_t
+        {
+            static constexpr GLuint k_table_binding = 3;
+            static constexpr GLuint k_albedo_unit = 4;
+            static constexpr GLuint k_normal_depth_unit = 5;
+
+            impostor_set_t() = default;
+            ~impostor_set_t();
+            impostor_set_t(const impostor_set_t&) = delete;
+            impostor_set_t& operator=(const impostor_set_t&) = delete;
+        public:
+            /// false when the bake or draw programs fail, callers keep drawing meshes
+            bool init(const std::string& shader_root);
+            /// Bakes every mesh, or loads it from cache_directory when a bake of the same geometry and settings is
+            /// there (empty: no disk cache). The pool must be committed; the billboard quad is added and the pool
+            /// committed again.
+            void build(mesh_pool_t& pool, const std::vector<uint32_t>& meshes, const impostor_settings_t& settings, const std::string& cache_directory);
+            /// camera in the space of the model matrices
+            void split(const mesh_pool_t& pool, const draw_list_t& list, const glm::vec3& camera, const impostor_lod_t& lod,
+                draw_list_t& meshes, draw_list_t& impostors);
+            /// the atlases and the impostor table, right before the draws: texture units are not tracked
+            void bind(void) const;
+        public:
+            inline bool is_available(void) const { return this->program_ != NULL; }
+            inline glsl_program_t& get_program(void) { return *this->program_; }
+            inline const impostor_stats_t& get_stats(void) const { return this->stats_; }
+            inline const impostor_atlas_t& get_atlas(const uint32_t layer) const { return this->atlases_[layer]; }
+            /// layer of the mesh's impostor, -1 when it has none
+            inline int32_t get_layer(const uint32_t mesh) const { return mesh < this->layers_.size() ? this->layers_[mesh] : -1; }
+        private:
+            void release(void);
+        private:
+            impostor_baker_t baker_;
+            std::unique_ptr<glsl_program_t> program_;
+            std::vector<impostor_atlas_t> atlases_;
+            std::vector<int32_t> layers_;
+            uint32_t quad_mesh_ = 0;
+            GLuint albedo_ = 0;
+            GLuint normal_depth_ = 0;
+            GLuint table_ = 0;
+            impostor_stats_t stats_;
+        };
+
+    }
+
+}
+#endif
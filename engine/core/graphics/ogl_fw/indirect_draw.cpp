@@ -0,0 +1,292 @@
+#include "indirect_draw.h"
+
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+
+using namespace Continuum::Graphics;
+
+mesh_pool_t::~mesh_pool_t()
+{
+	release();
+}
+
+void mesh_pool_t::release(void)
+{
+	if (this->vao_ != 0) glDeleteVertexArrays(1, &this->vao_);
+	if (this->vertex_buffer_ != 0) glDeleteBuffers(1, &this->vertex_buffer_);
+	if (this->index_buffer_ != 0) glDeleteBuffers(1, &this->index_buffer_);
+	this->vao_ = 0;
+	this->vertex_buffer_ = 0;
+	this->index_buffer_ = 0;
+}
+
+uint32_t mesh_pool_t::add_mesh(const mesh_vertex_t* vertices, const size_t vertex_count, const uint32_t* indices, const size_t index_count)
+{
+	mesh_range_t mesh = {};
+	mesh.first_index = static_cast<uint32_t>(this->indices_.size());
+	mesh.index_count = static_cast<uint32_t>(index_count);
+	mesh.base_vertex = static_cast<int32_t>(this->vertices_.size());
+	mesh.vertex_count = static_cast<uint32_t>(vertex_count);
+
+	// centred on the box, not the tightest sphere but close for the boxy meshes this holds
+	glm::vec3 lo = glm::vec3(FLT_MAX);
+	glm::vec3 hi = glm::vec3(-FLT_MAX);
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		const glm::vec3 p = glm::vec3(vertices[v].p[0], vertices[v].p[1], vertices[v].p[2]);
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	const glm::vec3 center = vertex_count > 0 ? 0.5f * (lo + hi) : glm::vec3(0.0f);
+	float radius_sq = 0.0f;
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		const glm::vec3 d = glm::vec3(vertices[v].p[0], vertices[v].p[1], vertices[v].p[2]) - center;
+		radius_sq = std::max(radius_sq, glm::dot(d, d));
+	}
+	mesh.bounds = glm::vec4(center, std::sqrt(radius_sq));
+
+	this->vertices_.insert(this->vertices_.end(), vertices, vertices + vertex_count);
+	this->indices_.insert(this->indices_.end(), indices, indices + index_count);
+	this->meshes_.push_back(mesh);
+	return static_cast<uint32_t>(this->meshes_.size() - 1);
+}
+
+void mesh_pool_t::commit(void)
+{
+	release();
+	if (this->vertices_.empty() || this->indices_.empty()) return;
+
+	glCreateBuffers(1, &this->vertex_buffer_);
+	glNamedBufferStorage(this->vertex_buffer_, static_cast<GLsizeiptr>(this->vertices_.size() * sizeof(mesh_vertex_t)), this->vertices_.data(), 0);
+
+	glCreateBuffers(1, &this->index_buffer_);
+	glNamedBufferStorage(this->index_buffer_, static_cast<GLsizeiptr>(this->indices_.size() * sizeof(uint32_t)), this->indices_.data(), 0);
+
+	// no attributes, vertices are pulled from the SSBO; the VAO only carries the element buffer
+	glCreateVertexArrays(1, &this->vao_);
+	glVertexArrayElementBuffer(this->vao_, this->index_buffer_);
+}
+
+void mesh_pool_t::bind(void) const
+{
+	glBindVertexArray(this->vao_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->vertex_buffer_);
+}
+
+uint64_t draw_list_t::count_triangles(const mesh_pool_t& pool) const
+{
+	uint64_t triangles = 0;
+	for (const uint32_t mesh : this->meshes_) triangles += pool.get_mesh(mesh).index_count / 3;
+	return triangles;
+}
+
+void draw_list_t::build(const mesh_pool_t& pool, std::vector<draw_elements_indirect_command_t>& commands, std::vector<glm::mat4>& matrices,
+	std::vector<uint32_t>* command_meshes) const
+{
+	// counting sort by mesh, the offsets double as base_instance
+	const uint32_t mesh_count = pool.get_mesh_count();
+	std::vector<uint32_t> offsets(size_t(mesh_count) + 1, 0);
+	for (const uint32_t mesh : this->meshes_) ++offsets[mesh + 1];
+	for (uint32_t mesh = 0; mesh < mesh_count; ++mesh) offsets[mesh + 1] += offsets[mesh];
+
+	commands.clear();
+	if (command_meshes != NULL) command_meshes->clear();
+	for (uint32_t mesh = 0; mesh < mesh_count; ++mesh)
+	{
+		const uint32_t instances = offsets[mesh + 1] - offsets[mesh];
+		if (instances == 0) continue;
+
+		const mesh_range_t& range = pool.get_mesh(mesh);
+		commands.push_back({ range.index_count, instances, range.first_index, range.base_vertex, offsets[mesh] });
+		if (command_meshes != NULL) command_meshes->push_back(mesh);
+	}
+
+	matrices.resize(this->models_.size());
+	for (size_t i = 0; i < this->meshes_.size(); ++i)
+	{
+		matrices[offsets[this->meshes_[i]]++] = this->models_[i];
+	}
+}
+
+indirect_renderer_t::indirect_renderer_t(const GLsizeiptr region_size, const uint32_t frames_in_flight)
+	: ring_(GL_SHADER_STORAGE_BUFFER, region_size, frames_in_flight)
+{
+}
+
+void indirect_renderer_t::begin_frame(void)
+{
+	this->ring_.begin_frame();
+	this->frame_stats_ = {};
+}
+
+void indirect_renderer_t::end_frame(void)
+{
+	this->ring_.end_frame();
+}
+
+void indirect_renderer_t::draw(const mesh_pool_t& pool, const draw_list_t& list, const DrawPath::DrawPathType path)
+{
+	if (list.size() == 0) return;
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	list.build(pool, this->commands_, this->matrices_);
+
+	pool.bind();
+	this->ring_.bind_range(2, this->ring_.push(this->matrices_.data(), this->matrices_.size()));
+
+	uint32_t draw_calls = 0;
+	if (path == DrawPath::MULTI_DRAW_INDIRECT)
+	{
+		const streaming_allocation_t commands = this->ring_.push(this->commands_.data(), this->commands_.size());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->ring_.get_handle());
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(commands.offset),
+			static_cast<GLsizei>(this->commands_.size()), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		draw_calls = 1;
+	}
+	else
+	{
+		for (const draw_elements_indirect_command_t& command : this->commands_)
+		{
+			const void* first_index = reinterpret_cast<const void*>(uintptr_t(command.first_index) * sizeof(uint32_t));
+			for (GLuint instance = 0; instance < command.instance_count; ++instance)
+			{
+				glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, static_cast<GLsizei>(command.count), GL_UNSIGNED_INT,
+					first_index, 1, command.base_vertex, command.base_instance + instance);
+			}
+			draw_calls += command.instance_count;
+		}
+	}
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	this->frame_stats_.draw_calls += draw_calls;
+	this->frame_stats_.instances += static_cast<uint32_t>(list.size());
+	this->frame_stats_.submit_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void indirect_renderer_t::record(render_command_list_t& command_list, const uint64_t key, const GLuint program, const mesh_pool_t& pool,
+	const draw_list_t& list, const DrawPath::DrawPathType path)
+{
+	if (list.size() == 0) return;
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	list.build(pool, this->commands_, this->matrices_);
+
+	const streaming_allocation_t matrices = this->ring_.push(this->matrices_.data(), this->matrices_.size());
+	const buffer_binding_t bindings[2] = {
+		{ GL_SHADER_STORAGE_BUFFER, 1, pool.get_vertex_buffer(), 0, 0 },
+		{ GL_SHADER_STORAGE_BUFFER, 2, this->ring_.get_handle(), matrices.offset, matrices.size },
+	};
+
+	render_packet_t packet;
+	packet.program = program;
+	packet.vao = pool.get_vao();
+
+	uint32_t draw_calls = 0;
+	if (path == DrawPath::MULTI_DRAW_INDIRECT)
+	{
+		const streaming_allocation_t commands = this->ring_.push(this->commands_.data(), this->commands_.size());
+		packet.type = DrawCommand::MULTI_ELEMENTS_INDIRECT;
+		packet.indirect_buffer = this->ring_.get_handle();
+		packet.indirect_offset = commands.offset;
+		packet.draw_count = static_cast<uint32_t>(this->commands_.size());
+		command_list.add(key, packet, bindings, 2);
+		draw_calls = 1;
+	}
+	else
+	{
+		// every packet carries its full state, the tracker drops all but the first set of bindings
+		packet.type = DrawCommand::ELEMENTS;
+		for (const draw_elements_indirect_command_t& command : this->commands_)
+		{
+			packet.count = command.count;
+			packet.first = command.first_index;
+			packet.base_vertex = command.base_vertex;
+			for (GLuint instance = 0; instance < command.instance_count; ++instance)
+			{
+				packet.base_instance = command.base_instance + instance;
+				command_list.add(key, packet, bindings, 2);
+			}
+			draw_calls += command.instance_count;
+		}
+	}
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	this->frame_stats_.draw_calls += draw_calls;
+	this->frame_stats_.instances += static_cast<uint32_t>(list.size());
+	this->frame_stats_.submit_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void indirect_renderer_t::record_culled(render_command_list_t& command_list, const uint64_t key, const GLuint program, const mesh_pool_t& pool,
+	const draw_list_t& list, hiz_culler_t& culler, const glm::mat4& view_proj, const glm::dvec3& origin)
+{
+	if (list.size() == 0) return;
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	list.build(pool, this->commands_, this->matrices_, &this->command_meshes_);
+
+	// one sphere per instance, in command order; the commands start empty and the culler fills them
+	this->cull_instances_.resize(this->matrices_.size());
+	const glm::vec3 offset = glm::vec3(origin);
+	for (size_t c = 0; c < this->commands_.size(); ++c)
+	{
+		draw_elements_indirect_command_t& command = this->commands_[c];
+		const glm::vec4 bounds = pool.get_mesh(this->command_meshes_[c]).bounds;
+		for (uint32_t i = command.base_instance; i < command.base_instance + command.instance_count; ++i)
+		{
+			const glm::mat4& model = this->matrices_[i];
+			const glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(bounds), 1.0f)) - offset;
+			const float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+			gpu_cull_instance_t& instance = this->cull_instances_[i];
+			instance.sphere[0] = center.x;
+			instance.sphere[1] = center.y;
+			instance.sphere[2] = center.z;
+			instance.sphere[3] = bounds.w * scale;
+			instance.command = static_cast<uint32_t>(c);
+			instance.matrix = i;
+			instance.pad[0] = instance.pad[1] = 0;
+		}
+		command.instance_count = 0;
+	}
+
+	const GLuint ring = this->ring_.get_handle();
+	const streaming_allocation_t source_matrices = this->ring_.push(this->matrices_.data(), this->matrices_.size());
+	const streaming_allocation_t matrices = this->ring_.allocate(source_matrices.size);
+	const streaming_allocation_t instances = this->ring_.push(this->cull_instances_.data(), this->cull_instances_.size());
+	const streaming_allocation_t commands = this->ring_.push(this->commands_.data(), this->commands_.size());
+
+	hiz_cull_job_t job;
+	job.instances = { ring, instances.offset, instances.size };
+	job.instance_count = static_cast<uint32_t>(this->cull_instances_.size());
+	job.commands = { ring, commands.offset, commands.size };
+	job.source_matrices = { ring, source_matrices.offset, source_matrices.size };
+	job.matrices = { ring, matrices.offset, matrices.size };
+	job.view_proj = view_proj;
+	job.origin = origin;
+	culler.cull(job);
+
+	const buffer_binding_t bindings[2] = {
+		{ GL_SHADER_STORAGE_BUFFER, 1, pool.get_vertex_buffer(), 0, 0 },
+		{ GL_SHADER_STORAGE_BUFFER, 2, ring, matrices.offset, matrices.size },
+	};
+	render_packet_t packet;
+	packet.program = program;
+	packet.vao = pool.get_vao();
+	packet.type = DrawCommand::MULTI_ELEMENTS_INDIRECT;
+	packet.indirect_buffer = ring;
+	packet.indirect_offset = commands.offset;
+	packet.draw_count = static_cast<uint32_t>(this->commands_.size());
+	command_list.add(key, packet, bindings, 2);
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	this->frame_stats_.draw_calls += 1;
+	this->frame_stats_.instances += static_cast<uint32_t>(list.size());
+	this->frame_stats_.submit_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
@@ -0,0 +1,153 @@
+#ifndef INDIRECT_DRAW_H
+#define INDIRECT_DRAW_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "streaming_buffer.h"
+#include "render_commands.h"
+#include "hiz_culling.h"
+
+namespace Continuum {
+
+    namespace Graphics {
+
+        /// matches `struct Vertex` in the shaders, pulled from the Vertices SSBO (binding 1) by gl_VertexID
+        struct mesh_vertex_t
+        {
+            float p[3];
+            float n[3];
+            float tc[2];
+        };
+
+        /// layout fixed by GL for glMultiDrawElementsIndirect
+        struct draw_elements_indirect_command_t
+        {
+            GLuint count;
+            GLuint instance_count;
+            GLuint first_index;
+            GLint base_vertex;
+            GLuint base_instance;
+        };
+
+        struct mesh_range_t
+        {
+            uint32_t first_index = 0;
+            uint32_t index_count = 0;
+            int32_t base_vertex = 0;
+            uint32_t vertex_count = 0;
+            /// bounding sphere in mesh space, xyz centre and w radius
+            glm::vec4 bounds = glm::vec4(0.0f);
+        };
+
+        /// Every mesh packed into one vertex SSBO and one index buffer, so a single draw can reach all of them.
+        struct mesh_pool_t
+        {
+            mesh_pool_t() = default;
+            ~mesh_pool_t();
+            mesh_pool_t(const mesh_pool_t&) = delete;
+            mesh_pool_t& operator=(const mesh_pool_t&) = delete;
+        public:
+            /// returns the mesh id, indices are relative to the mesh's own vertices
+            uint32_t add_mesh(const mesh_vertex_t* vertices, const size_t vertex_count, const uint32_t* indices, const size_t index_count);
+            /// uploads everything added so far into immutable storage, replacing earlier buffers
+            void commit(void);
+            /// binds the VAO carrying the index buffer and the vertex SSBO at binding 1
+            void bind(void) const;
+        public:
+            inline const mesh_range_t& get_mesh(const uint32_t mesh) const { return this->meshes_[mesh]; }
+            inline uint32_t get_mesh_count(void) const { return static_cast<uint32_t>(this->meshes_.size()); }
+            /// CPU copies of everything added, indices relative to their mesh's base_vertex
+            inline const std::vector<mesh_vertex_t>& get_vertices(void) const { return this->vertices_; }
+            inline const std::vector<uint32_t>& get_indices(void) const { return this->indices_; }
+            inline GLuint get_vertex_buffer(void) const { return this->vertex_buffer_; }
+            inline GLuint get_index_buffer(void) const { return this->index_buffer_; }
+            inline GLuint get_vao(void) const { return this->vao_; }
+        private:
+            void release(void);
+        private:
+            std::vector<mesh_vertex_t> vertices_;
+            std::vector<uint32_t> indices_;
+            std::vector<mesh_range_t> meshes_;
+            GLuint vertex_buffer_ = 0;
+            GLuint index_buffer_ = 0;
+            GLuint vao_ = 0;
+        };
+
+        /// Instances of one material queued for a frame.
+        struct draw_list_t
+        {
+        public:
+            inline void clear(void) { this->meshes_.clear(); this->models_.clear(); }
+            inline void add(const uint32_t mesh, const glm::mat4& model) { this->meshes_.push_back(mesh); this->models_.push_back(model); }
+            inline size_t size(void) const { return this->meshes_.size(); }
+            inline uint32_t get_mesh(const size_t instance) const { return this->meshes_[instance]; }
+            inline const glm::mat4& get_model(const size_t instance) const { return this->models_[instance]; }
+            /// triangles of every instance, what the list costs in vertex processing
+            uint64_t count_triangles(const mesh_pool_t& pool) const;
+            /// groups instances by mesh into one command each; matrices come out in command order so that
+            /// base_instance + gl_InstanceID indexes in_ModelMatrices. command_meshes receives the mesh of every command.
+            void build(const mesh_pool_t& pool, std::vector<draw_elements_indirect_command_t>& commands, std::vector<glm::mat4>& matrices,
+                std::vector<uint32_t>* command_meshes = NULL) const;
+        private:
+            std::vector<uint32_t> meshes_;
+            std::vector<glm::mat4> models_;
+        };
+
+        namespace DrawPath {
+            enum DrawPathType
+            {
+                MULTI_DRAW_INDIRECT = 0,
+                /// one glDraw* per instance, kept as the baseline
+                PER_INSTANCE = 1
+            };
+        }
+
+        struct draw_submit_stats_t
+        {
+            uint32_t draw_calls = 0;
+            uint32_t instances = 0;
+            /// CPU time from building the commands to the last GL call, or to the last recorded packet
+            double submit_ms = 0.0;
+        };
+
+        /// Streams commands and model matrices through a fenced ring and submits a draw list per material.
+        struct indirect_renderer_t
+        {
+            explicit indirect_renderer_t(const GLsizeiptr region_size = 8 * 1024 * 1024, const uint32_t frames_in_flight = 3);
+        public:
+            void begin_frame(void);
+            void end_frame(void);
+            /// binds the matrices at SSBO binding 2, the caller has the program in use
+            void draw(const mesh_pool_t& pool, const draw_list_t& list, const DrawPath::DrawPathType path);
+            /// the same draws recorded into a command list under one key instead of issued; the list has to
+            /// execute before end_frame() as the commands and matrices live in this frame's ring region
+            void record(render_command_list_t& command_list, const uint64_t key, const GLuint program, const mesh_pool_t& pool,
+                const draw_list_t& list, const DrawPath::DrawPathType path);
+            /// Multi-draw recorded with the instances culled on the GPU first: the culler tests every instance's
+            /// bounding sphere against view_proj and its Hi-Z pyramid and compacts the visible ones into the commands
+            /// and matrices the draw reads. Matrices are in world space, origin is where view_proj is centred.
+            void record_culled(render_command_list_t& command_list, const uint64_t key, const GLuint program, const mesh_pool_t& pool,
+                const draw_list_t& list, hiz_culler_t& culler, const glm::mat4& view_proj, const glm::dvec3& origin = glm::dvec3(0.0));
+        public:
+            /// totals since begin_frame()
+            inline const draw_submit_stats_t& get_frame_stats(void) const { return this->frame_stats_; }
+            inline const streaming_buffer_stats_t& get_ring_stats(void) const { return this->ring_.get_stats(); }
+        private:
+            streaming_buffer_t ring_;
+            std::vector<draw_elements_indirect_command_t> commands_;
+            std::vector<glm::mat4> matrices_;
+            std::vector<uint32_t> command_meshes_;
+            std::vector<gpu_cull_instance_t> cull_instances_;
+            draw_submit_stats_t frame_stats_;
+        };
+
+    }
+
+}
+#endif
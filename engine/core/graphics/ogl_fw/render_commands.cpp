@@ -0,0 +1,178 @@
+#include "render_commands.h"
+
+using namespace Continuum::Graphics;
+
+void render_state_tracker_t::invalidate(void)
+{
+	this->program_known_ = false;
+	this->vao_known_ = false;
+	this->indirect_buffer_known_ = false;
+	this->blend_known_ = false;
+	for (uint32_t i = 0; i < k_max_indexed_bindings; ++i)
+	{
+		this->uniform_bindings_[i].known = false;
+		this->storage_bindings_[i].known = false;
+	}
+}
+
+void render_state_tracker_t::use_program(const GLuint program)
+{
+	if (skip(this->program_known_ && this->program_ == program)) return;
+	glUseProgram(program);
+	this->program_ = program;
+	this->program_known_ = true;
+}
+
+void render_state_tracker_t::bind_vertex_array(const GLuint vao)
+{
+	if (skip(this->vao_known_ && this->vao_ == vao)) return;
+	glBindVertexArray(vao);
+	this->vao_ = vao;
+	this->vao_known_ = true;
+}
+
+void render_state_tracker_t::bind_buffer(const GLenum target, const GLuint buffer)
+{
+	if (target != GL_DRAW_INDIRECT_BUFFER)
+	{
+		skip(false);
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (skip(this->indirect_buffer_known_ && this->indirect_buffer_ == buffer)) return;
+	glBindBuffer(target, buffer);
+	this->indirect_buffer_ = buffer;
+	this->indirect_buffer_known_ = true;
+}
+
+render_state_tracker_t::indexed_binding_t* render_state_tracker_t::find_binding(const GLenum target, const GLuint index)
+{
+	if (index >= k_max_indexed_bindings) return NULL;
+	if (target == GL_UNIFORM_BUFFER) return &this->uniform_bindings_[index];
+	if (target == GL_SHADER_STORAGE_BUFFER) return &this->storage_bindings_[index];
+	return NULL;
+}
+
+void render_state_tracker_t::bind_buffer_range(const buffer_binding_t& binding)
+{
+	indexed_binding_t* tracked = find_binding(binding.target, binding.index);
+	const bool redundant = tracked != NULL && tracked->known && tracked->buffer == binding.buffer
+		&& tracked->offset == binding.offset && tracked->size == binding.size;
+	if (skip(redundant)) return;
+
+	if (binding.size == 0) glBindBufferBase(binding.target, binding.index, binding.buffer);
+	else glBindBufferRange(binding.target, binding.index, binding.buffer, binding.offset, binding.size);
+	if (tracked != NULL)
+	{
+		tracked->buffer = binding.buffer;
+		tracked->offset = binding.offset;
+		tracked->size = binding.size;
+		tracked->known = true;
+	}
+}
+
+void render_state_tracker_t::set_blend(const blend_state_t& blend)
+{
+	if (skip(this->blend_known_ && this->blend_ == blend)) return;
+	// one call each way: enabling and the factors are counted as a single change
+	if (blend.enabled)
+	{
+		if (!this->blend_known_ || !this->blend_.enabled) glEnable(GL_BLEND);
+		glBlendFunc(blend.src, blend.dst);
+	}
+	else
+	{
+		glDisable(GL_BLEND);
+	}
+	this->blend_ = blend;
+	this->blend_known_ = true;
+}
+
+void render_command_list_t::clear(void)
+{
+	this->entries_.clear();
+	this->packets_.clear();
+	this->bindings_.clear();
+}
+
+void render_command_list_t::add(const uint64_t key, const render_packet_t& packet, const buffer_binding_t* bindings, const uint32_t binding_count)
+{
+	stored_packet_t stored = { packet, static_cast<uint32_t>(this->bindings_.size()), binding_count };
+	if (binding_count > 0) this->bindings_.insert(this->bindings_.end(), bindings, bindings + binding_count);
+	this->entries_.push_back({ key, static_cast<uint32_t>(this->packets_.size()) });
+	this->packets_.push_back(stored);
+}
+
+void render_command_list_t::sort(void)
+{
+	const size_t n = this->entries_.size();
+	if (n < 2) return;
+	this->scratch_.resize(n);
+
+	// all eight histograms in one pass over the keys
+	uint32_t counts[8][256] = {};
+	for (const entry_t& entry : this->entries_)
+	{
+		for (uint32_t byte = 0; byte < 8; ++byte) ++counts[byte][(entry.key >> (byte * 8)) & 0xff];
+	}
+
+	entry_t* src = this->entries_.data();
+	entry_t* dst = this->scratch_.data();
+	for (uint32_t byte = 0; byte < 8; ++byte)
+	{
+		// a byte shared by every key leaves the order as it is, typically the pass and program bytes
+		const uint32_t shift = byte * 8;
+		if (counts[byte][(src[0].key >> shift) & 0xff] == n) continue;
+
+		uint32_t offsets[256];
+		uint32_t sum = 0;
+		for (uint32_t digit = 0; digit < 256; ++digit)
+		{
+			offsets[digit] = sum;
+			sum += counts[byte][digit];
+		}
+		for (size_t i = 0; i < n; ++i) dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+		std::swap(src, dst);
+	}
+	if (src != this->entries_.data()) this->entries_.swap(this->scratch_);
+}
+
+void render_command_list_t::execute(render_state_tracker_t& state) const
+{
+	execute(state, 0, UINT32_MAX);
+}
+
+void render_command_list_t::execute(render_state_tracker_t& state, const uint32_t first_pass, const uint32_t last_pass) const
+{
+	for (const entry_t& entry : this->entries_)
+	{
+		const uint32_t pass = SortKey::get_pass(entry.key);
+		if (pass < first_pass || pass > last_pass) continue;
+		const stored_packet_t& stored = this->packets_[entry.packet];
+		const render_packet_t& packet = stored.packet;
+
+		state.use_program(packet.program);
+		state.bind_vertex_array(packet.vao);
+		state.set_blend(packet.blend);
+		for (uint32_t i = 0; i < stored.binding_count; ++i) state.bind_buffer_range(this->bindings_[stored.first_binding + i]);
+
+		switch (packet.type)
+		{
+		case DrawCommand::ARRAYS:
+			glDrawArraysInstancedBaseInstance(packet.mode, static_cast<GLint>(packet.first), static_cast<GLsizei>(packet.count),
+				static_cast<GLsizei>(packet.instance_count), packet.base_instance);
+			break;
+		case DrawCommand::ELEMENTS:
+			glDrawElementsInstancedBaseVertexBaseInstance(packet.mode, static_cast<GLsizei>(packet.count), GL_UNSIGNED_INT,
+				reinterpret_cast<const void*>(uintptr_t(packet.first) * sizeof(uint32_t)), static_cast<GLsizei>(packet.instance_count),
+				packet.base_vertex, packet.base_instance);
+			break;
+		case DrawCommand::MULTI_ELEMENTS_INDIRECT:
+			state.bind_buffer(GL_DRAW_INDIRECT_BUFFER, packet.indirect_buffer);
+			glMultiDrawElementsIndirect(packet.mode, GL_UNSIGNED_INT, reinterpret_cast<const void*>(packet.indirect_offset),
+				static_cast<GLsizei>(packet.draw_count), 0);
+			break;
+		}
+		state.count_draw();
+	}
+}
@@ -0,0 +1,206 @@
+#ifndef RENDER_COMMANDS_H
+#define RENDER_COMMANDS_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+namespace Continuum {
+
+    namespace Graphics {
+
+        namespace RenderPass {
+            enum RenderPassType
+            {
+                SOLID = 0,
+                SKY = 1,
+                /// sorted back to front, record with 1 - depth
+                TRANSLUCENT = 2,
+                OVERLAY = 3
+            };
+        }
+
+        /// 64-bit draw order, most significant first: pass (4 bits), program (12), material (16), depth (32).
+        /// Sorting by key groups draws by program, then material, then front to back within each pass.
+        namespace SortKey {
+
+            static constexpr uint32_t k_pass_shift = 60;
+            static constexpr uint32_t k_program_shift = 48;
+            static constexpr uint32_t k_material_shift = 32;
+
+            /// program and material are small ids, GL program names are fine; depth is clamped to [0, 1]
+            static inline uint64_t make(const uint32_t pass, const uint32_t program, const uint32_t material, const float depth)
+            {
+                const double quantized = std::floor(double(std::clamp(depth, 0.0f, 1.0f)) * double(UINT32_MAX) + 0.5);
+                return (uint64_t(pass & 0xf) << k_pass_shift) | (uint64_t(program & 0xfff) << k_program_shift)
+                    | (uint64_t(material & 0xffff) << k_material_shift) | uint64_t(quantized);
+            }
+
+            static inline uint32_t get_pass(const uint64_t key) { return uint32_t(key >> k_pass_shift); }
+            static inline uint32_t get_program(const uint64_t key) { return uint32_t(key >> k_program_shift) & 0xfff; }
+            static inline uint32_t get_material(const uint64_t key) { return uint32_t(key >> k_material_shift) & 0xffff; }
+
+        }
+
+        struct blend_state_t
+        {
+            bool enabled = false;
+            GLenum src = GL_ONE;
+            GLenum dst = GL_ZERO;
+        public:
+            inline bool operator==(const blend_state_t& other) const
+            {
+                return this->enabled == other.enabled && (!this->enabled || (this->src == other.src && this->dst == other.dst));
+            }
+            inline bool operator!=(const blend_state_t& other) const { return !(*this == other); }
+        public:
+            static inline blend_state_t opaque(void) { return blend_state_t(); }
+            static inline blend_state_t alpha(void) { return { true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA }; }
+        };
+
+        /// indexed buffer binding; size 0 binds the whole buffer (glBindBufferBase)
+        struct buffer_binding_t
+        {
+            GLenum target = GL_UNIFORM_BUFFER;
+            GLuint index = 0;
+            GLuint buffer = 0;
+            GLintptr offset = 0;
+            GLsizeiptr size = 0;
+        };
+
+        struct render_state_stats_t
+        {
+            uint32_t draws = 0;
+            /// program, VAO, buffer and blend calls that reached GL
+            uint32_t issued = 0;
+            /// the same calls skipped because GL already had that state
+            uint32_t elided = 0;
+        };
+
+        /// Shadow of the GL state the command list touches, redundant changes never reach the driver.
+        /// Code binding state behind its back (the terrain and atmosphere renderers) has to be followed by
+        /// invalidate(), which makes the next change of every state go through.
+        struct render_state_tracker_t
+        {
+            static constexpr uint32_t k_max_indexed_bindings = 16;
+        public:
+            render_state_tracker_t() { invalidate(); }
+        public:
+            void invalidate(void);
+            inline void reset_stats(void) { this->stats_ = {}; }
+            inline const render_state_stats_t& get_stats(void) const { return this->stats_; }
+            inline void count_draw(void) { ++this->stats_.draws; }
+        public:
+            void use_program(const GLuint program);
+            void bind_vertex_array(const GLuint vao);
+            /// non-indexed binding, only GL_DRAW_INDIRECT_BUFFER is tracked
+            void bind_buffer(const GLenum target, const GLuint buffer);
+            /// UBO and SSBO bindings below k_max_indexed_bindings are tracked, others always go through
+            void bind_buffer_range(const buffer_binding_t& binding);
+            void set_blend(const blend_state_t& blend);
+        private:
+            struct indexed_binding_t
+            {
+                GLuint buffer = 0;
+                GLintptr offset = 0;
+                GLsizeiptr size = 0;
+                bool known = false;
+            };
+            inline bool skip(const bool redundant)
+            {
+                if (redundant) ++this->stats_.elided;
+                else ++this->stats_.issued;
+                return redundant;
+            }
+            indexed_binding_t* find_binding(const GLenum target, const GLuint index);
+        private:
+            GLuint program_ = 0;
+            GLuint vao_ = 0;
+            GLuint indirect_buffer_ = 0;
+            blend_state_t blend_;
+            bool program_known_ = false;
+            bool vao_known_ = false;
+            bool indirect_buffer_known_ = false;
+            bool blend_known_ = false;
+            indexed_binding_t uniform_bindings_[k_max_indexed_bindings];
+            indexed_binding_t storage_bindings_[k_max_indexed_bindings];
+            render_state_stats_t stats_;
+        };
+
+        namespace DrawCommand {
+            enum DrawCommandType
+            {
+                ARRAYS = 0,
+                /// GL_UNSIGNED_INT indices from the VAO's element buffer
+                ELEMENTS = 1,
+                /// draw_count GL_UNSIGNED_INT element commands read from indirect_buffer at indirect_offset
+                MULTI_ELEMENTS_INDIRECT = 2
+            };
+        }
+
+        /// Everything one draw needs: the state it runs with and its arguments.
+        struct render_packet_t
+        {
+            GLuint program = 0;
+            GLuint vao = 0;
+            blend_state_t blend;
+            DrawCommand::DrawCommandType type = DrawCommand::ARRAYS;
+            GLenum mode = GL_TRIANGLES;
+            /// vertices (ARRAYS) or indices (ELEMENTS)
+            uint32_t count = 0;
+            uint32_t instance_count = 1;
+            /// first vertex (ARRAYS) or first index (ELEMENTS)
+            uint32_t first = 0;
+            int32_t base_vertex = 0;
+            uint32_t base_instance = 0;
+            GLuint indirect_buffer = 0;
+            GLintptr indirect_offset = 0;
+            uint32_t draw_count = 0;
+        };
+
+        /// Draw packets recorded by any number of subsystems, radix sorted by key and executed through a
+        /// state tracker. Draws with equal keys run in recording order. Per-draw data travels in buffer
+        /// ranges (a streaming_buffer_t allocation), never in glUniform* calls.
+        struct render_command_list_t
+        {
+        public:
+            void clear(void);
+            /// bindings are copied, they are applied in order before the draw
+            void add(const uint64_t key, const render_packet_t& packet, const buffer_binding_t* bindings = NULL, const uint32_t binding_count = 0);
+            /// stable LSD radix sort on the keys, bytes equal across all keys are skipped
+            void sort(void);
+            /// runs the packets in sorted order, or recording order when sort() was not called since the last add()
+            void execute(render_state_tracker_t& state) const;
+            /// only the packets of passes first_pass to last_pass, e.g. the opaque ones before reading their depth
+            void execute(render_state_tracker_t& state, const uint32_t first_pass, const uint32_t last_pass) const;
+        public:
+            inline size_t size(void) const { return this->packets_.size(); }
+            inline uint64_t get_key(const size_t i) const { return this->entries_[i].key; }
+            inline const render_packet_t& get_packet(const size_t i) const { return this->packets_[this->entries_[i].packet].packet; }
+        private:
+            struct entry_t
+            {
+                uint64_t key;
+                uint32_t packet;
+            };
+            struct stored_packet_t
+            {
+                render_packet_t packet;
+                uint32_t first_binding;
+                uint32_t binding_count;
+            };
+        private:
+            std::vector<entry_t> entries_;
+            std::vector<entry_t> scratch_;
+            std::vector<stored_packet_t> packets_;
+            std::vector<buffer_binding_t> bindings_;
+        };
+
+    }
+
+}
+#endif
@@ -0,0 +1,75 @@
+#include "shader_variants.h"
+
+#include <chrono>
+
+#include "../../hash.h"
+
+using namespace Continuum;
+using namespace Continuum::Graphics;
+
+shader_variant_registry_t::shader_variant_registry_t(async_shader_compiler_t* hot_reload)
+	: hot_reload_(hot_reload)
+{
+}
+
+uint64_t shader_variant_registry_t::get_key(const std::vector<std::string>& files, const shader_permutation_t& permutation)
+{
+	uint64_t key = permutation.get_hash();
+	for (const std::string& file : files)
+	{
+		key = Hash::fnv1a_64(file, key);
+		key = Hash::fnv1a_64(std::string_view(";"), key);
+	}
+	return key;
+}
+
+shader_variant_t shader_variant_registry_t::request(const std::vector<std::string>& files, const shader_permutation_t& permutation)
+{
+	++this->stats_.requests;
+
+	const uint64_t key = get_key(files, permutation);
+	const auto range = this->lookup_.equal_range(key);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		const entry_t& entry = this->entries_[it->second];
+		if (entry.files != files || !(entry.permutation == permutation)) continue;
+		++this->stats_.shared;
+		return { it->second };
+	}
+
+	entry_t entry;
+	entry.files = files;
+	entry.permutation = permutation;
+	this->entries_.push_back(std::move(entry));
+	const uint32_t index = static_cast<uint32_t>(this->entries_.size() - 1);
+	this->lookup_.emplace(key, index);
+	++this->stats_.variants;
+	return { index };
+}
+
+glsl_program_t& shader_variant_registry_t::get(const shader_variant_t variant)
+{
+	entry_t& entry = this->entries_[variant.index];
+	if (entry.compiled) return *entry.program;
+
+	// a fresh program per attempt, a failed one may hold half its stages
+	const auto t0 = std::chrono::high_resolution_clock::now();
+	std::unique_ptr<glsl_program_t> program = std::make_unique<glsl_program_t>();
+	try
+	{
+		for (const std::string& file : entry.files) program->compile_shader(file.c_str(), entry.permutation);
+		program->link();
+	}
+	catch (const GLSLProgramException&)
+	{
+		++this->stats_.failed;
+		throw;
+	}
+	this->stats_.compile_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+	++this->stats_.compiled;
+
+	entry.program = std::move(program);
+	entry.compiled = true;
+	if (this->hot_reload_ != NULL) this->hot_reload_->watch_program(*entry.program, entry.files, entry.permutation);
+	return *entry.program;
+}
@@ -0,0 +1,77 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "glslprogram.h"
+#include "async_shader_compiler.h"
+
+namespace Continuum {
+
+    namespace Graphics {
+
+        /// handle of a program registered with shader_variant_registry_t
+        struct shader_variant_t
+        {
+            uint32_t index = 0xffffffffu;
+        public:
+            inline bool is_valid(void) const { return index != 0xffffffffu; }
+        };
+
+        struct shader_variant_stats_t
+        {
+            uint32_t requests = 0;
+            /// requests answered with a program registered earlier
+            uint32_t shared = 0;
+            /// distinct programs registered, and those compiled so far
+            uint32_t variants = 0;
+            uint32_t compiled = 0;
+            uint32_t failed = 0;
+            /// compiling and linking, or loading from the binary cache
+            double compile_ms = 0.0;
+        };
+
+        /// Programs keyed by their stage files and permutation. Identical requests share one program, and
+        /// a variant is only compiled the first time get() asks for it, so quality levels and features that
+        /// are never used cost nothing. With a hot reload compiler, compiled variants are watched and
+        /// rebuilt with their permutation.
+        struct shader_variant_registry_t
+        {
+            explicit shader_variant_registry_t(async_shader_compiler_t* hot_reload = NULL);
+            shader_variant_registry_t(const shader_variant_registry_t&) = delete;
+            shader_variant_registry_t& operator=(const shader_variant_registry_t&) = delete;
+        public:
+            /// stage types come from the file extensions; nothing is compiled yet
+            shader_variant_t request(const std::vector<std::string>& files, const shader_permutation_t& permutation = shader_permutation_t());
+            /// compiles and links on first use, throws GLSLProgramException on failure and retries on the next call
+            glsl_program_t& get(const shader_variant_t variant);
+            inline bool is_compiled(const shader_variant_t variant) const { return this->entries_[variant.index].compiled; }
+            inline const shader_permutation_t& get_permutation(const shader_variant_t variant) const { return this->entries_[variant.index].permutation; }
+            inline const shader_variant_stats_t& get_stats(void) const { return this->stats_; }
+        private:
+            struct entry_t
+            {
+                std::vector<std::string> files;
+                shader_permutation_t permutation;
+                std::unique_ptr<glsl_program_t> program;
+                bool compiled = false;
+            };
+            static uint64_t get_key(const std::vector<std::string>& files, const shader_permutation_t& permutation);
+        private:
+            async_shader_compiler_t* hot_reload_;
+            std::vector<entry_t> entries_;
+            /// key -> entry, colliding keys are told apart by comparing files and permutation
+            std::unordered_multimap<uint64_t, uint32_t> lookup_;
+            shader_variant_stats_t stats_;
+        };
+
+    }
+
+}
+#endif
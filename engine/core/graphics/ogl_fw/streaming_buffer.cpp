@@ -0,0 +1,118 @@
+#include "streaming_buffer.h"
+
+#include <chrono>
+#include <algorithm>
+
+using namespace Continuum::Graphics;
+
+streaming_buffer_t::streaming_buffer_t(const GLenum target, const GLsizeiptr region_size, const uint32_t region_count)
+	: target_(target)
+	, region_size_(region_size)
+	, region_count_(std::max<uint32_t>(region_count, 1))
+	, fences_(std::max<uint32_t>(region_count, 1), (GLsync)NULL)
+{
+	if (target == GL_UNIFORM_BUFFER)
+	{
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &this->alignment_);
+	}
+	else if (target == GL_SHADER_STORAGE_BUFFER)
+	{
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &this->alignment_);
+	}
+	this->alignment_ = std::max<GLint>(this->alignment_, 16);
+
+	// every region starts aligned so that offsets stay valid for glBindBufferRange
+	this->region_size_ = (region_size + this->alignment_ - 1) / this->alignment_ * this->alignment_;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const GLsizeiptr total_size = this->region_size_ * this->region_count_;
+
+	glCreateBuffers(1, &this->handle_);
+	if (this->handle_ == 0) throw StreamingBufferException("Unable to create streaming buffer.");
+
+	glNamedBufferStorage(this->handle_, total_size, NULL, flags);
+	this->mapped_ = static_cast<uint8_t*>(glMapNamedBufferRange(this->handle_, 0, total_size, flags));
+	if (this->mapped_ == NULL)
+	{
+		glDeleteBuffers(1, &this->handle_);
+		this->handle_ = 0;
+		throw StreamingBufferException("Unable to map streaming buffer persistently.");
+	}
+}
+
+streaming_buffer_t::~streaming_buffer_t()
+{
+	if (this->handle_ == 0) return;
+
+	for (GLsync& fence : this->fences_)
+	{
+		if (fence != NULL) glDeleteSync(fence);
+		fence = NULL;
+	}
+	glUnmapNamedBuffer(this->handle_);
+	glDeleteBuffers(1, &this->handle_);
+	this->handle_ = 0;
+	this->mapped_ = NULL;
+}
+
+void streaming_buffer_t::begin_frame(void)
+{
+	this->region_ = (this->region_ + 1) % this->region_count_;
+	this->head_ = 0;
+	++this->stats_.frames;
+
+	GLsync& fence = this->fences_[this->region_];
+	if (fence == NULL) return;
+
+	// polls first so that only real stalls are counted
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+	{
+		++this->stats_.fence_waits;
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		while (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED && result != GL_WAIT_FAILED)
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		const auto t1 = std::chrono::high_resolution_clock::now();
+		this->stats_.fence_wait_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+	}
+
+	glDeleteSync(fence);
+	fence = NULL;
+}
+
+void streaming_buffer_t::end_frame(void)
+{
+	GLsync& fence = this->fences_[this->region_];
+	if (fence != NULL) glDeleteSync(fence);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+streaming_allocation_t streaming_buffer_t::allocate(const GLsizeiptr size)
+{
+	const GLsizeiptr aligned_size = (size + this->alignment_ - 1) / this->alignment_ * this->alignment_;
+	if (this->head_ + aligned_size > this->region_size_)
+	{
+		throw StreamingBufferException("Streaming buffer region overflow, increase the region size.");
+	}
+
+	streaming_allocation_t allocation = {};
+	allocation.offset = this->region_size_ * this->region_ + this->head_;
+	allocation.data = this->mapped_ + allocation.offset;
+	allocation.size = size;
+
+	this->head_ += aligned_size;
+	this->stats_.peak_region_usage = std::max(this->stats_.peak_region_usage, this->head_);
+	return allocation;
+}
+
+void streaming_buffer_t::bind_range(const GLuint index, const streaming_allocation_t& allocation) const
+{
+	bind_range(this->target_, index, allocation);
+}
+
+void streaming_buffer_t::bind_range(const GLenum target, const GLuint index, const streaming_allocation_t& allocation) const
+{
+	glBindBufferRange(target, index, this->handle_, allocation.offset, allocation.size);
+}
@@ -0,0 +1,90 @@
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace Continuum {
+
+    namespace Graphics {
+
+        struct StreamingBufferException : public std::runtime_error {
+            StreamingBufferException(const std::string& msg) :
+                std::runtime_error(msg) {}
+        };
+
+        struct streaming_allocation_t
+        {
+            void* data = NULL;
+            GLintptr offset = 0;
+            GLsizeiptr size = 0;
+        };
+
+        struct streaming_buffer_stats_t
+        {
+            uint64_t frames = 0;
+            /// frames that found their region still in use by the GPU
+            uint64_t fence_waits = 0;
+            double fence_wait_ms = 0.0;
+            /// largest number of bytes written into a region within one frame
+            GLsizeiptr peak_region_usage = 0;
+        };
+
+        /// Persistently mapped, coherent buffer split into region_count regions, one per frame in flight.
+        /// begin_frame() moves to the next region and waits for the fence the GPU signals once it is done
+        /// reading it, allocations are bump-allocated inside the region and bound with glBindBufferRange.
+        struct streaming_buffer_t
+        {
+            /// target picks the offset alignment: GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER or anything else (16 bytes)
+            streaming_buffer_t(const GLenum target, const GLsizeiptr region_size, const uint32_t region_count = 3);
+            ~streaming_buffer_t();
+            streaming_buffer_t(const streaming_buffer_t&) = delete;
+            streaming_buffer_t& operator=(const streaming_buffer_t&) = delete;
+        public:
+            void begin_frame(void);
+            void end_frame(void);
+            streaming_allocation_t allocate(const GLsizeiptr size);
+            void bind_range(const GLuint index, const streaming_allocation_t& allocation) const;
+            void bind_range(const GLenum target, const GLuint index, const streaming_allocation_t& allocation) const;
+        public:
+            template<typename T>
+            streaming_allocation_t push(const T& value)
+            {
+                const streaming_allocation_t allocation = allocate(sizeof(T));
+                memcpy(allocation.data, &value, sizeof(T));
+                return allocation;
+            }
+            template<typename T>
+            streaming_allocation_t push(const T* values, const size_t count)
+            {
+                const streaming_allocation_t allocation = allocate(static_cast<GLsizeiptr>(sizeof(T) * count));
+                memcpy(allocation.data, values, sizeof(T) * count);
+                return allocation;
+            }
+        public:
+            inline GLuint get_handle(void) const { return this->handle_; }
+            inline GLsizeiptr get_region_size(void) const { return this->region_size_; }
+            inline uint32_t get_region_count(void) const { return this->region_count_; }
+            inline const streaming_buffer_stats_t& get_stats(void) const { return this->stats_; }
+        private:
+            GLenum target_;
+            GLuint handle_ = 0;
+            uint8_t* mapped_ = NULL;
+            GLsizeiptr region_size_;
+            uint32_t region_count_;
+            GLint alignment_ = 16;
+            uint32_t region_ = 0;
+            GLsizeiptr head_ = 0;
+            std::vector<GLsync> fences_;
+            streaming_buffer_stats_t stats_;
+        };
+
+    }
+
+}
+#endif
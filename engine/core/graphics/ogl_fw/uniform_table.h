@@ -0,0 +1,112 @@
+#ifndef UNIFORM_TABLE_H
+#define UNIFORM_TABLE_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "../../hash.h"
+
+namespace Continuum {
+
+    namespace Graphics {
+
+        /// uniform name together with its hash, built at compile time from a literal: "view"_uniform
+        struct uniform_name_t
+        {
+            uint64_t hash;
+            const char* name;
+        };
+
+        namespace UniformLiterals {
+            consteval uniform_name_t operator""_uniform(const char* str, const size_t length)
+            {
+                return uniform_name_t{ Hash::fnv1a_64(std::string_view(str, length)), str };
+            }
+        }
+
+        /// typed handle into a program's uniform slots, setting it costs one array load
+        template<typename T>
+        struct uniform_t
+        {
+            uint32_t slot = 0xffffffffu;
+            /// id of the program that resolved the handle, 0 for none
+            uint32_t program = 0;
+        public:
+            inline bool is_valid(void) const { return slot != 0xffffffffu; }
+        };
+
+        /// open-addressing hash -> location table, filled from program reflection after linking
+        struct uniform_table_t
+        {
+        public:
+            inline void clear(void)
+            {
+                this->entries_.clear();
+                this->size_ = 0;
+            }
+            inline void reserve(const size_t count)
+            {
+                size_t capacity = 16;
+                while (capacity < count * 2) capacity *= 2;
+                if (capacity <= this->entries_.size()) return;
+
+                std::vector<entry_t> old = std::move(this->entries_);
+                this->entries_.assign(capacity, entry_t{});
+                this->size_ = 0;
+                for (const entry_t& e : old)
+                {
+                    if (e.used) insert(e.hash, e.location);
+                }
+            }
+            inline void insert(const uint64_t hash, const GLint location)
+            {
+                if ((this->size_ + 1) * 2 > this->entries_.size()) reserve(this->size_ + 1);
+
+                const size_t mask = this->entries_.size() - 1;
+                for (size_t i = static_cast<size_t>(hash) & mask;; i = (i + 1) & mask)
+                {
+                    entry_t& e = this->entries_[i];
+                    if (e.used && e.hash != hash) continue;
+                    if (!e.used) ++this->size_;
+                    e.hash = hash;
+                    e.location = location;
+                    e.used = true;
+                    return;
+                }
+            }
+            /// false if the hash is not in the table
+            inline bool find(const uint64_t hash, GLint& location) const
+            {
+                if (this->entries_.empty()) return false;
+
+                const size_t mask = this->entries_.size() - 1;
+                for (size_t i = static_cast<size_t>(hash) & mask;; i = (i + 1) & mask)
+                {
+                    const entry_t& e = this->entries_[i];
+                    if (!e.used) return false;
+                    if (e.hash == hash)
+                    {
+                        location = e.location;
+                        return true;
+                    }
+                }
+            }
+            inline size_t size(void) const { return this->size_; }
+        private:
+            struct entry_t
+            {
+                uint64_t hash = 0;
+                GLint location = -1;
+                bool used = false;
+            };
+            std::vector<entry_t> entries_;
+            size_t size_ = 0;
+        };
+
+    }
+
+}
+#endif
@@ -0,0 +1,42 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string_view>
+
+namespace Continuum {
+
+	namespace Hash {
+
+		static constexpr uint64_t k_fnv1a_offset = 0xcbf29ce484222325ull;
+		static constexpr uint64_t k_fnv1a_prime = 0x100000001b3ull;
+
+		/// 64-bit FNV-1a; chain calls by passing the previous result as seed
+		constexpr uint64_t fnv1a_64(const std::string_view str, const uint64_t seed = k_fnv1a_offset)
+		{
+			uint64_t h = seed;
+			for (const char c : str)
+			{
+				h ^= static_cast<uint8_t>(c);
+				h *= k_fnv1a_prime;
+			}
+			return h;
+		}
+
+		inline uint64_t fnv1a_64(const void* data, const size_t size, const uint64_t seed = k_fnv1a_offset)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			uint64_t h = seed;
+			for (size_t i = 0; i < size; ++i)
+			{
+				h ^= bytes[i];
+				h *= k_fnv1a_prime;
+			}
+			return h;
+		}
+
+	}
+
+}
+#endif
@@ -0,0 +1,215 @@
+#include "job_system.h"
+#include "../profiler/profiler.h"
+
+#include <algorithm>
+
+using namespace Continuum::Jobs;
+
+namespace {
+	struct worker_identity_t
+	{
+		const job_system_t* owner = NULL;
+		uint32_t index = 0;
+	};
+	thread_local worker_identity_t tls_worker = {};
+}
+
+job_system_t::job_system_t(uint32_t worker_count)
+{
+	if (worker_count == 0)
+	{
+		const uint32_t hardware = std::thread::hardware_concurrency();
+		worker_count = hardware > 1 ? hardware - 1 : 1;
+	}
+
+	for (uint32_t i = 0; i < worker_count + 1; ++i) this->queues_.push_back(std::make_unique<queue_t>());
+
+	this->threads_.reserve(worker_count);
+	for (uint32_t i = 0; i < worker_count; ++i)
+	{
+		this->threads_.emplace_back([this, i]() { worker_main(i); });
+	}
+}
+
+job_system_t::~job_system_t()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->sleep_mutex_);
+		this->running_ = false;
+	}
+	this->sleep_cv_.notify_all();
+	for (std::thread& thread : this->threads_) thread.join();
+}
+
+void job_system_t::submit(job_function_t fn, job_counter_t* counter)
+{
+	if (counter != NULL) counter->value_.fetch_add(1, std::memory_order_acq_rel);
+	push(job_t{ std::move(fn), counter });
+}
+
+void job_system_t::submit_after(job_counter_t& dependency, job_function_t fn, job_counter_t* counter)
+{
+	if (counter != NULL) counter->value_.fetch_add(1, std::memory_order_acq_rel);
+
+	{
+		std::lock_guard<std::mutex> lock(dependency.continuations_mutex_);
+		if (!dependency.is_done())
+		{
+			dependency.continuations_.push_back({ std::move(fn), counter });
+			return;
+		}
+	}
+	push(job_t{ std::move(fn), counter });
+}
+
+void job_system_t::parallel_for(const uint32_t count, const uint32_t batch_size, const std::function<void(uint32_t, uint32_t)>& fn, job_counter_t* counter)
+{
+	const uint32_t batch = std::max<uint32_t>(batch_size, 1);
+	const auto shared_fn = std::make_shared<std::function<void(uint32_t, uint32_t)>>(fn);
+	for (uint32_t begin = 0; begin < count; begin += batch)
+	{
+		const uint32_t end = std::min(count, begin + batch);
+		submit([shared_fn, begin, end]() { (*shared_fn)(begin, end); }, counter);
+	}
+}
+
+void job_system_t::wait(const job_counter_t& counter)
+{
+	while (!counter.is_done())
+	{
+		if (!try_run_one()) std::this_thread::yield();
+	}
+	std::lock_guard<std::mutex> lock(counter.continuations_mutex_);
+}
+
+bool job_system_t::try_run_one(void)
+{
+	job_t job = {};
+	if (!find_job(job)) return false;
+	execute(job);
+	return true;
+}
+
+job_system_stats_t job_system_t::get_stats(void) const
+{
+	job_system_stats_t stats = {};
+	stats.executed = this->executed_.load(std::memory_order_relaxed);
+	stats.stolen = this->stolen_.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void job_system_t::push(job_t&& job)
+{
+	// counted before the job becomes visible, a thief popping it straight away must not take pending_ below zero;
+	// the brief overcount only costs a worker one extra look before it sleeps
+	this->pending_.fetch_add(1, std::memory_order_release);
+	queue_t& queue = *this->queues_[get_queue_index()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+
+	// taking the sleep mutex orders the push before a worker's predicate check, no lost wake-ups
+	{
+		std::lock_guard<std::mutex> lock(this->sleep_mutex_);
+	}
+	this->sleep_cv_.notify_one();
+}
+
+bool job_system_t::pop(const uint32_t queue_index, job_t& job)
+{
+	queue_t& queue = *this->queues_[queue_index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty()) return false;
+	job = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	this->pending_.fetch_sub(1, std::memory_order_acq_rel);
+	return true;
+}
+
+bool job_system_t::steal(const uint32_t thief_index, job_t& job)
+{
+	const uint32_t queue_count = static_cast<uint32_t>(this->queues_.size());
+	for (uint32_t offset = 1; offset < queue_count; ++offset)
+	{
+		queue_t& queue = *this->queues_[(thief_index + offset) % queue_count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty()) continue;
+		// oldest job, the owner keeps working on the recently pushed (cache warm) end
+		job = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+		this->pending_.fetch_sub(1, std::memory_order_acq_rel);
+		this->stolen_.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+bool job_system_t::find_job(job_t& job)
+{
+	const uint32_t index = get_queue_index();
+	return pop(index, job) || steal(index, job);
+}
+
+void job_system_t::execute(job_t& job)
+{
+	{
+		CONTINUUM_PROFILE_SCOPE("job");
+		job.fn();
+	}
+	this->executed_.fetch_add(1, std::memory_order_relaxed);
+	finish(job.counter);
+}
+
+void job_system_t::finish(job_counter_t* counter)
+{
+	if (counter == NULL) return;
+
+	// decrements that cannot reach zero skip the lock
+	int32_t value = counter->value_.load(std::memory_order_acquire);
+	while (value > 1)
+	{
+		if (counter->value_.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel)) return;
+	}
+
+	// the last decrement happens under the lock, wait() takes it once more before returning so the
+	// counter can be destroyed right after
+	std::vector<job_counter_t::continuation_t> ready = {};
+	{
+		std::lock_guard<std::mutex> lock(counter->continuations_mutex_);
+		if (counter->value_.fetch_sub(1, std::memory_order_acq_rel) == 1) ready.swap(counter->continuations_);
+	}
+	for (job_counter_t::continuation_t& continuation : ready)
+	{
+		push(job_t{ std::move(continuation.fn), continuation.counter });
+	}
+}
+
+void job_system_t::worker_main(const uint32_t worker_index)
+{
+	tls_worker.owner = this;
+	tls_worker.index = worker_index;
+	CONTINUUM_PROFILE_THREAD(("job worker " + std::to_string(worker_index)).c_str());
+
+	while (true)
+	{
+		job_t job = {};
+		if (find_job(job))
+		{
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(this->sleep_mutex_);
+		this->sleep_cv_.wait(lock, [this]() { return !this->running_ || this->pending_.load(std::memory_order_acquire) > 0; });
+		if (!this->running_) break;
+	}
+
+	tls_worker = {};
+}
+
+uint32_t job_system_t::get_queue_index(void) const
+{
+	if (tls_worker.owner == this) return tls_worker.index;
+	return static_cast<uint32_t>(this->queues_.size() - 1);
+}
@@ -0,0 +1,108 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace Continuum {
+
+	namespace Jobs {
+
+		using job_function_t = std::function<void(void)>;
+
+		struct job_system_t;
+
+		/// Counts unfinished jobs. Jobs submitted with a counter increment it, and decrement it when done;
+		/// jobs submitted after a counter run once it reaches zero.
+		struct job_counter_t
+		{
+			job_counter_t() = default;
+			job_counter_t(const job_counter_t&) = delete;
+			job_counter_t& operator=(const job_counter_t&) = delete;
+		public:
+			inline int32_t get_value(void) const { return this->value_.load(std::memory_order_acquire); }
+			inline bool is_done(void) const { return get_value() == 0; }
+		private:
+			friend struct job_system_t;
+			struct continuation_t
+			{
+				job_function_t fn;
+				job_counter_t* counter;
+			};
+			std::atomic<int32_t> value_ = 0;
+			mutable std::mutex continuations_mutex_;
+			std::vector<continuation_t> continuations_;
+		};
+
+		struct job_system_stats_t
+		{
+			uint64_t executed = 0;
+			uint64_t stolen = 0;
+		};
+
+		/// Work-stealing job pool. Every worker owns a deque it pushes to and pops from at the back,
+		/// idle workers steal from the front of the others. Threads that are not workers (the main thread)
+		/// submit to a shared queue and help executing jobs while they wait on a counter.
+		struct job_system_t
+		{
+			/// worker_count == 0 picks hardware_concurrency - 1, leaving a core for the main thread
+			explicit job_system_t(uint32_t worker_count = 0);
+			~job_system_t();
+			job_system_t(const job_system_t&) = delete;
+			job_system_t& operator=(const job_system_t&) = delete;
+		public:
+			void submit(job_function_t fn, job_counter_t* counter = NULL);
+			/// fn runs once dependency reaches zero; counter is incremented right away
+			void submit_after(job_counter_t& dependency, job_function_t fn, job_counter_t* counter = NULL);
+			/// splits [0, count) into batches of batch_size and calls fn(begin, end) for each
+			void parallel_for(const uint32_t count, const uint32_t batch_size, const std::function<void(uint32_t, uint32_t)>& fn, job_counter_t* counter);
+			/// runs pending jobs on the calling thread until counter reaches zero, the counter may be destroyed afterwards
+			void wait(const job_counter_t& counter);
+			/// runs at most one pending job on the calling thread, false if nothing was found
+			bool try_run_one(void);
+		public:
+			inline uint32_t get_worker_count(void) const { return static_cast<uint32_t>(this->threads_.size()); }
+			job_system_stats_t get_stats(void) const;
+		private:
+			struct job_t
+			{
+				job_function_t fn;
+				job_counter_t* counter = NULL;
+			};
+			struct queue_t
+			{
+				std::mutex mutex;
+				std::deque<job_t> jobs;
+			};
+		private:
+			void push(job_t&& job);
+			bool pop(const uint32_t queue_index, job_t& job);
+			bool steal(const uint32_t thief_index, job_t& job);
+			bool find_job(job_t& job);
+			void execute(job_t& job);
+			void finish(job_counter_t* counter);
+			void worker_main(const uint32_t worker_index);
+			uint32_t get_queue_index(void) const;
+		private:
+			/// one queue per worker plus the shared queue for external threads at the end
+			std::vector<std::unique_ptr<queue_t>> queues_;
+			std::vector<std::thread> threads_;
+			std::atomic<bool> running_ = true;
+			std::atomic<uint32_t> pending_ = 0;
+			std::mutex sleep_mutex_;
+			std::condition_variable sleep_cv_;
+			std::atomic<uint64_t> executed_ = 0;
+			std::atomic<uint64_t> stolen_ = 0;
+		};
+
+	}
+
+}
+#endif
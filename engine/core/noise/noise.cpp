@@ -0,0 +1,151 @@
+#include "noise_kernels.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace Continuum;
+using namespace Continuum::Noise;
+
+static inline uint32_t hash3(const int32_t i, const int32_t j, const int32_t k, const uint32_t seed)
+{
+	uint32_t h = (uint32_t(i) * Detail::k_prime_x) ^ (uint32_t(j) * Detail::k_prime_y) ^ (uint32_t(k) * Detail::k_prime_z) ^ seed;
+	h *= Detail::k_mix;
+	h ^= h >> 15;
+	return h;
+}
+
+// one of the 12 cube edge gradients (plus 4 repeats) dotted with the offset, Perlin's improved noise selection
+static inline float grad3(const uint32_t hash, const float x, const float y, const float z)
+{
+	const uint32_t h = hash & 15;
+	const float u = h < 8 ? x : y;
+	const float v = h < 4 ? y : ((h == 12 || h == 14) ? x : z);
+	return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+static inline float corner(const float x, const float y, const float z, const uint32_t hash)
+{
+	float t = Detail::k_radius_sq - x * x - y * y - z * z;
+	t = std::max(t, 0.0f);
+	const float t2 = t * t;
+	return t2 * t2 * grad3(hash, x, y, z);
+}
+
+float Noise::simplex3(const float x, const float y, const float z, const uint32_t seed)
+{
+	// skew into simplex cell space
+	const float s = (x + y + z) * Detail::k_f3;
+	const float fi = std::floor(x + s);
+	const float fj = std::floor(y + s);
+	const float fk = std::floor(z + s);
+	const int32_t i = static_cast<int32_t>(fi);
+	const int32_t j = static_cast<int32_t>(fj);
+	const int32_t k = static_cast<int32_t>(fk);
+
+	const float t = (fi + fj + fk) * Detail::k_g3;
+	const float x0 = x - (fi - t);
+	const float y0 = y - (fj - t);
+	const float z0 = z - (fk - t);
+
+	// rank the offsets to find the simplex the point is in, branch free in the batched kernels
+	const bool gx = x0 >= y0;
+	const bool gy = y0 >= z0;
+	const bool gz = z0 >= x0;
+	const int32_t i1 = (gx && !gz) ? 1 : 0;
+	const int32_t j1 = (gy && !gx) ? 1 : 0;
+	const int32_t k1 = (gz && !gy) ? 1 : 0;
+	const int32_t i2 = (gx || !gz) ? 1 : 0;
+	const int32_t j2 = (gy || !gx) ? 1 : 0;
+	const int32_t k2 = (gz || !gy) ? 1 : 0;
+
+	const float x1 = x0 - float(i1) + Detail::k_g3;
+	const float y1 = y0 - float(j1) + Detail::k_g3;
+	const float z1 = z0 - float(k1) + Detail::k_g3;
+	const float x2 = x0 - float(i2) + 2.0f * Detail::k_g3;
+	const float y2 = y0 - float(j2) + 2.0f * Detail::k_g3;
+	const float z2 = z0 - float(k2) + 2.0f * Detail::k_g3;
+	const float x3 = x0 - 1.0f + 3.0f * Detail::k_g3;
+	const float y3 = y0 - 1.0f + 3.0f * Detail::k_g3;
+	const float z3 = z0 - 1.0f + 3.0f * Detail::k_g3;
+
+	const float n0 = corner(x0, y0, z0, hash3(i, j, k, seed));
+	const float n1 = corner(x1, y1, z1, hash3(i + i1, j + j1, k + k1, seed));
+	const float n2 = corner(x2, y2, z2, hash3(i + i2, j + j2, k + k2, seed));
+	const float n3 = corner(x3, y3, z3, hash3(i + 1, j + 1, k + 1, seed));
+
+	return Detail::k_scale * (n0 + n1 + n2 + n3);
+}
+
+Detail::octave_table_t Detail::make_octave_table(const noise_params_t& params)
+{
+	octave_table_t table = {};
+	table.count = params.type == NoiseType::SIMPLEX ? 1 : std::clamp<uint32_t>(params.octaves, 1, octave_table_t::k_max_octaves);
+
+	float frequency = params.frequency;
+	float amplitude = 1.0f;
+	float amplitude_sum = 0.0f;
+	for (uint32_t o = 0; o < table.count; ++o)
+	{
+		table.frequency[o] = frequency;
+		table.amplitude[o] = amplitude;
+		table.seed[o] = params.seed + o * 0x9e3779b9u;
+		amplitude_sum += amplitude;
+		frequency *= params.lacunarity;
+		amplitude *= params.gain;
+	}
+	table.normalization = 1.0f / amplitude_sum;
+	return table;
+}
+
+void Detail::evaluate_scalar(const noise_params_t& params, const octave_table_t& octaves, const float* x, const float* y, const float* z, float* out, const size_t count)
+{
+	for (size_t p = 0; p < count; ++p)
+	{
+		float sum = 0.0f;
+		float weight = 1.0f;
+		for (uint32_t o = 0; o < octaves.count; ++o)
+		{
+			const float f = octaves.frequency[o];
+			const float n = simplex3(x[p] * f, y[p] * f, z[p] * f, octaves.seed[o]);
+			if (params.type == NoiseType::RIDGED)
+			{
+				float s = params.ridge_offset - std::fabs(n);
+				s = s * s;
+				s = s * weight;
+				weight = std::min(std::max(s * 2.0f, 0.0f), 1.0f);
+				sum = sum + s * octaves.amplitude[o];
+			}
+			else
+			{
+				sum = sum + n * octaves.amplitude[o];
+			}
+		}
+		out[p] = sum * octaves.normalization;
+	}
+}
+
+void Noise::evaluate(const noise_params_t& params, const float* x, const float* y, const float* z, float* out, const size_t count)
+{
+	evaluate(params, x, y, z, out, count, Simd::detect());
+}
+
+void Noise::evaluate(const noise_params_t& params, const float* x, const float* y, const float* z, float* out, const size_t count, const Simd::SimdLevel level)
+{
+	const Detail::octave_table_t octaves = Detail::make_octave_table(params);
+	const Simd::SimdLevel supported = std::min(level, Simd::detect());
+
+#if CONTINUUM_SIMD_X86
+	if (supported == Simd::SimdLevel::AVX2)
+	{
+		Detail::evaluate_avx2(params, octaves, x, y, z, out, count);
+		return;
+	}
+	if (supported == Simd::SimdLevel::SSE42)
+	{
+		Detail::evaluate_sse42(params, octaves, x, y, z, out, count);
+		return;
+	}
+#endif
+	(void)supported;
+	Detail::evaluate_scalar(params, octaves, x, y, z, out, count);
+}
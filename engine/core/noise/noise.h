@@ -0,0 +1,66 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "../simd.h"
+
+namespace Continuum {
+
+	namespace Noise {
+
+		namespace NoiseType {
+			enum NoiseTypeType
+			{
+				SIMPLEX = 0,
+				FBM = 1,
+				RIDGED = 2
+			};
+		}
+
+		struct noise_params_t
+		{
+			NoiseType::NoiseTypeType type = NoiseType::FBM;
+			uint32_t seed = 1337;
+			uint32_t octaves = 6;
+			float frequency = 1.0f;
+			float lacunarity = 2.0f;
+			float gain = 0.5f;
+			/// ridged only, 1 - |n| is offset by this before squaring
+			float ridge_offset = 1.0f;
+		};
+
+		/// structure-of-arrays input, one coordinate per array so that the kernels load 4 / 8 points at once
+		struct point_grid_t
+		{
+			std::vector<float> x;
+			std::vector<float> y;
+			std::vector<float> z;
+		public:
+			inline void resize(const size_t count) { x.resize(count); y.resize(count); z.resize(count); }
+			inline size_t size(void) const { return x.size(); }
+		};
+
+		/// single-point 3D simplex noise in [-1, 1], the scalar reference for the batched kernels
+		float simplex3(const float x, const float y, const float z, const uint32_t seed);
+
+		/// evaluates count points through the best kernel the CPU supports
+		void evaluate(const noise_params_t& params, const float* x, const float* y, const float* z, float* out, const size_t count);
+		/// same, through a given kernel; levels the CPU lacks fall back to the best supported one
+		void evaluate(const noise_params_t& params, const float* x, const float* y, const float* z, float* out, const size_t count, const Simd::SimdLevel level);
+
+		inline void evaluate(const noise_params_t& params, const point_grid_t& points, float* out)
+		{
+			evaluate(params, points.x.data(), points.y.data(), points.z.data(), out, points.size());
+		}
+		inline void evaluate(const noise_params_t& params, const point_grid_t& points, float* out, const Simd::SimdLevel level)
+		{
+			evaluate(params, points.x.data(), points.y.data(), points.z.data(), out, points.size(), level);
+		}
+
+	}
+
+}
+#endif
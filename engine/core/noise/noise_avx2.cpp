@@ -0,0 +1,164 @@
+// Compiled with AVX2 enabled (see CMakeLists.txt), only called after Simd::detect() reported support.
+#include "noise_kernels.h"
+
+#if CONTINUUM_SIMD_X86
+
+#include <immintrin.h>
+
+using namespace Continuum::Noise;
+
+namespace {
+
+	struct avx_constants_t
+	{
+		__m256 f3 = _mm256_set1_ps(Detail::k_f3);
+		__m256 g3 = _mm256_set1_ps(Detail::k_g3);
+		__m256 g3x2 = _mm256_set1_ps(2.0f * Detail::k_g3);
+		__m256 g3x3 = _mm256_set1_ps(3.0f * Detail::k_g3);
+		__m256 radius_sq = _mm256_set1_ps(Detail::k_radius_sq);
+		__m256 scale = _mm256_set1_ps(Detail::k_scale);
+		__m256 one = _mm256_set1_ps(1.0f);
+		__m256 zero = _mm256_setzero_ps();
+		__m256 all_ones = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		__m256i prime_x = _mm256_set1_epi32(int32_t(Detail::k_prime_x));
+		__m256i prime_y = _mm256_set1_epi32(int32_t(Detail::k_prime_y));
+		__m256i prime_z = _mm256_set1_epi32(int32_t(Detail::k_prime_z));
+		__m256i mix = _mm256_set1_epi32(int32_t(Detail::k_mix));
+		__m256i i1 = _mm256_set1_epi32(1);
+		__m256i i2 = _mm256_set1_epi32(2);
+		__m256i i4 = _mm256_set1_epi32(4);
+		__m256i i8 = _mm256_set1_epi32(8);
+		__m256i i12 = _mm256_set1_epi32(12);
+		__m256i i14 = _mm256_set1_epi32(14);
+		__m256i i15 = _mm256_set1_epi32(15);
+	};
+
+	inline __m256i hash3(const avx_constants_t& c, const __m256i i, const __m256i j, const __m256i k, const __m256i seed)
+	{
+		__m256i h = _mm256_xor_si256(_mm256_mullo_epi32(i, c.prime_x), _mm256_mullo_epi32(j, c.prime_y));
+		h = _mm256_xor_si256(h, _mm256_mullo_epi32(k, c.prime_z));
+		h = _mm256_xor_si256(h, seed);
+		h = _mm256_mullo_epi32(h, c.mix);
+		return _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+	}
+
+	inline __m256 corner(const avx_constants_t& c, const __m256 x, const __m256 y, const __m256 z, const __m256i hash)
+	{
+		const __m256i h = _mm256_and_si256(hash, c.i15);
+		const __m256 lt8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(c.i8, h));
+		const __m256 lt4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(c.i4, h));
+		const __m256 h12or14 = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, c.i12), _mm256_cmpeq_epi32(h, c.i14)));
+
+		__m256 u = _mm256_blendv_ps(y, x, lt8);
+		__m256 v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, h12or14), y, lt4);
+		u = _mm256_xor_ps(u, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, c.i1), 31)));
+		v = _mm256_xor_ps(v, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, c.i2), 30)));
+		const __m256 g = _mm256_add_ps(u, v);
+
+		__m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(c.radius_sq, _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+		t = _mm256_max_ps(t, c.zero);
+		const __m256 t2 = _mm256_mul_ps(t, t);
+		return _mm256_mul_ps(_mm256_mul_ps(t2, t2), g);
+	}
+
+	// mirrors Noise::simplex3 operation for operation
+	inline __m256 simplex3(const avx_constants_t& c, const __m256 x, const __m256 y, const __m256 z, const __m256i seed)
+	{
+		const __m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x, y), z), c.f3);
+		const __m256 fi = _mm256_floor_ps(_mm256_add_ps(x, s));
+		const __m256 fj = _mm256_floor_ps(_mm256_add_ps(y, s));
+		const __m256 fk = _mm256_floor_ps(_mm256_add_ps(z, s));
+		const __m256i i = _mm256_cvttps_epi32(fi);
+		const __m256i j = _mm256_cvttps_epi32(fj);
+		const __m256i k = _mm256_cvttps_epi32(fk);
+
+		const __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(fi, fj), fk), c.g3);
+		const __m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(fi, t));
+		const __m256 y0 = _mm256_sub_ps(y, _mm256_sub_ps(fj, t));
+		const __m256 z0 = _mm256_sub_ps(z, _mm256_sub_ps(fk, t));
+
+		const __m256 gx = _mm256_cmp_ps(x0, y0, _CMP_GE_OQ);
+		const __m256 gy = _mm256_cmp_ps(y0, z0, _CMP_GE_OQ);
+		const __m256 gz = _mm256_cmp_ps(z0, x0, _CMP_GE_OQ);
+		const __m256 i1 = _mm256_andnot_ps(gz, gx);
+		const __m256 j1 = _mm256_andnot_ps(gx, gy);
+		const __m256 k1 = _mm256_andnot_ps(gy, gz);
+		const __m256 i2 = _mm256_or_ps(gx, _mm256_xor_ps(gz, c.all_ones));
+		const __m256 j2 = _mm256_or_ps(gy, _mm256_xor_ps(gx, c.all_ones));
+		const __m256 k2 = _mm256_or_ps(gz, _mm256_xor_ps(gy, c.all_ones));
+
+		const __m256 x1 = _mm256_add_ps(_mm256_sub_ps(x0, _mm256_and_ps(i1, c.one)), c.g3);
+		const __m256 y1 = _mm256_add_ps(_mm256_sub_ps(y0, _mm256_and_ps(j1, c.one)), c.g3);
+		const __m256 z1 = _mm256_add_ps(_mm256_sub_ps(z0, _mm256_and_ps(k1, c.one)), c.g3);
+		const __m256 x2 = _mm256_add_ps(_mm256_sub_ps(x0, _mm256_and_ps(i2, c.one)), c.g3x2);
+		const __m256 y2 = _mm256_add_ps(_mm256_sub_ps(y0, _mm256_and_ps(j2, c.one)), c.g3x2);
+		const __m256 z2 = _mm256_add_ps(_mm256_sub_ps(z0, _mm256_and_ps(k2, c.one)), c.g3x2);
+		const __m256 x3 = _mm256_add_ps(_mm256_sub_ps(x0, c.one), c.g3x3);
+		const __m256 y3 = _mm256_add_ps(_mm256_sub_ps(y0, c.one), c.g3x3);
+		const __m256 z3 = _mm256_add_ps(_mm256_sub_ps(z0, c.one), c.g3x3);
+
+		// the comparison masks are -1 where set, so subtracting them adds one
+		const __m256i ii1 = _mm256_sub_epi32(i, _mm256_castps_si256(i1));
+		const __m256i jj1 = _mm256_sub_epi32(j, _mm256_castps_si256(j1));
+		const __m256i kk1 = _mm256_sub_epi32(k, _mm256_castps_si256(k1));
+		const __m256i ii2 = _mm256_sub_epi32(i, _mm256_castps_si256(i2));
+		const __m256i jj2 = _mm256_sub_epi32(j, _mm256_castps_si256(j2));
+		const __m256i kk2 = _mm256_sub_epi32(k, _mm256_castps_si256(k2));
+
+		const __m256 n0 = corner(c, x0, y0, z0, hash3(c, i, j, k, seed));
+		const __m256 n1 = corner(c, x1, y1, z1, hash3(c, ii1, jj1, kk1, seed));
+		const __m256 n2 = corner(c, x2, y2, z2, hash3(c, ii2, jj2, kk2, seed));
+		const __m256 n3 = corner(c, x3, y3, z3, hash3(c, _mm256_add_epi32(i, c.i1), _mm256_add_epi32(j, c.i1), _mm256_add_epi32(k, c.i1), seed));
+
+		return _mm256_mul_ps(c.scale, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), n3));
+	}
+
+}
+
+void Detail::evaluate_avx2(const noise_params_t& params, const octave_table_t& octaves, const float* x, const float* y, const float* z, float* out, const size_t count)
+{
+	const avx_constants_t c = {};
+	const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 ridge_offset = _mm256_set1_ps(params.ridge_offset);
+	const __m256 normalization = _mm256_set1_ps(octaves.normalization);
+	const bool ridged = params.type == NoiseType::RIDGED;
+
+	const size_t simd_count = count & ~size_t(7);
+	for (size_t p = 0; p < simd_count; p += 8)
+	{
+		const __m256 px = _mm256_loadu_ps(x + p);
+		const __m256 py = _mm256_loadu_ps(y + p);
+		const __m256 pz = _mm256_loadu_ps(z + p);
+
+		__m256 sum = c.zero;
+		__m256 weight = c.one;
+		for (uint32_t o = 0; o < octaves.count; ++o)
+		{
+			const __m256 f = _mm256_set1_ps(octaves.frequency[o]);
+			const __m256 amplitude = _mm256_set1_ps(octaves.amplitude[o]);
+			const __m256i seed = _mm256_set1_epi32(int32_t(octaves.seed[o]));
+			const __m256 n = simplex3(c, _mm256_mul_ps(px, f), _mm256_mul_ps(py, f), _mm256_mul_ps(pz, f), seed);
+			if (ridged)
+			{
+				__m256 s = _mm256_sub_ps(ridge_offset, _mm256_andnot_ps(sign_mask, n));
+				s = _mm256_mul_ps(s, s);
+				s = _mm256_mul_ps(s, weight);
+				weight = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(s, two), c.zero), c.one);
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(s, amplitude));
+			}
+			else
+			{
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(n, amplitude));
+			}
+		}
+		_mm256_storeu_ps(out + p, _mm256_mul_ps(sum, normalization));
+	}
+
+	if (simd_count < count)
+	{
+		evaluate_scalar(params, octaves, x + simd_count, y + simd_count, z + simd_count, out + simd_count, count - simd_count);
+	}
+}
+
+#endif
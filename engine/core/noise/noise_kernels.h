@@ -0,0 +1,49 @@
+#ifndef NOISE_KERNELS_H
+#define NOISE_KERNELS_H
+
+// Shared between noise.cpp and the per-ISA translation units, which are compiled with their own
+// instruction set flags. Everything here has internal linkage or is out of line in noise.cpp so
+// the linker can never pick an AVX2 copy of a helper for the scalar path.
+
+#include "noise.h"
+
+namespace Continuum {
+
+	namespace Noise {
+
+		namespace Detail {
+
+			static constexpr float k_f3 = 1.0f / 3.0f;
+			static constexpr float k_g3 = 1.0f / 6.0f;
+			static constexpr float k_radius_sq = 0.6f;
+			static constexpr float k_scale = 32.0f;
+
+			static constexpr uint32_t k_prime_x = 0x8da6b343u;
+			static constexpr uint32_t k_prime_y = 0xd8163841u;
+			static constexpr uint32_t k_prime_z = 0xcb1ab31fu;
+			static constexpr uint32_t k_mix = 0x27d4eb2du;
+
+			/// per-octave constants, computed once per call so that every kernel sees the same values
+			struct octave_table_t
+			{
+				static constexpr uint32_t k_max_octaves = 16;
+				uint32_t count = 0;
+				float frequency[k_max_octaves] = {};
+				float amplitude[k_max_octaves] = {};
+				uint32_t seed[k_max_octaves] = {};
+				float normalization = 1.0f;
+			};
+
+			octave_table_t make_octave_table(const noise_params_t& params);
+
+			void evaluate_scalar(const noise_params_t& params, const octave_table_t& octaves, const float* x, const float* y, const float* z, float* out, const size_t count);
+#if CONTINUUM_SIMD_X86
+			void evaluate_sse42(const noise_params_t& params, const octave_table_t& octaves, const float* x, const float* y, const float* z, float* out, const size_t count);
+			void evaluate_avx2(const noise_params_t& params, const octave_table_t& octaves, const float* x, const float* y, const float* z, float* out, const size_t count);
+#endif
+		}
+
+	}
+
+}
+#endif
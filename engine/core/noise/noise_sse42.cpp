@@ -0,0 +1,164 @@
+// Compiled with SSE4.2 enabled (see CMakeLists.txt), only called after Simd::detect() reported support.
+#include "noise_kernels.h"
+
+#if CONTINUUM_SIMD_X86
+
+#include <nmmintrin.h>
+
+using namespace Continuum::Noise;
+
+namespace {
+
+	struct sse_constants_t
+	{
+		__m128 f3 = _mm_set1_ps(Detail::k_f3);
+		__m128 g3 = _mm_set1_ps(Detail::k_g3);
+		__m128 g3x2 = _mm_set1_ps(2.0f * Detail::k_g3);
+		__m128 g3x3 = _mm_set1_ps(3.0f * Detail::k_g3);
+		__m128 radius_sq = _mm_set1_ps(Detail::k_radius_sq);
+		__m128 scale = _mm_set1_ps(Detail::k_scale);
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 zero = _mm_setzero_ps();
+		__m128 all_ones = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		__m128i prime_x = _mm_set1_epi32(int32_t(Detail::k_prime_x));
+		__m128i prime_y = _mm_set1_epi32(int32_t(Detail::k_prime_y));
+		__m128i prime_z = _mm_set1_epi32(int32_t(Detail::k_prime_z));
+		__m128i mix = _mm_set1_epi32(int32_t(Detail::k_mix));
+		__m128i i1 = _mm_set1_epi32(1);
+		__m128i i2 = _mm_set1_epi32(2);
+		__m128i i4 = _mm_set1_epi32(4);
+		__m128i i8 = _mm_set1_epi32(8);
+		__m128i i12 = _mm_set1_epi32(12);
+		__m128i i14 = _mm_set1_epi32(14);
+		__m128i i15 = _mm_set1_epi32(15);
+	};
+
+	inline __m128i hash3(const sse_constants_t& c, const __m128i i, const __m128i j, const __m128i k, const __m128i seed)
+	{
+		__m128i h = _mm_xor_si128(_mm_mullo_epi32(i, c.prime_x), _mm_mullo_epi32(j, c.prime_y));
+		h = _mm_xor_si128(h, _mm_mullo_epi32(k, c.prime_z));
+		h = _mm_xor_si128(h, seed);
+		h = _mm_mullo_epi32(h, c.mix);
+		return _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+	}
+
+	inline __m128 corner(const sse_constants_t& c, const __m128 x, const __m128 y, const __m128 z, const __m128i hash)
+	{
+		const __m128i h = _mm_and_si128(hash, c.i15);
+		const __m128 lt8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, c.i8));
+		const __m128 lt4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, c.i4));
+		const __m128 h12or14 = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, c.i12), _mm_cmpeq_epi32(h, c.i14)));
+
+		__m128 u = _mm_blendv_ps(y, x, lt8);
+		__m128 v = _mm_blendv_ps(_mm_blendv_ps(z, x, h12or14), y, lt4);
+		u = _mm_xor_ps(u, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, c.i1), 31)));
+		v = _mm_xor_ps(v, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, c.i2), 30)));
+		const __m128 g = _mm_add_ps(u, v);
+
+		__m128 t = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(c.radius_sq, _mm_mul_ps(x, x)), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		t = _mm_max_ps(t, c.zero);
+		const __m128 t2 = _mm_mul_ps(t, t);
+		return _mm_mul_ps(_mm_mul_ps(t2, t2), g);
+	}
+
+	// mirrors Noise::simplex3 operation for operation
+	inline __m128 simplex3(const sse_constants_t& c, const __m128 x, const __m128 y, const __m128 z, const __m128i seed)
+	{
+		const __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, y), z), c.f3);
+		const __m128 fi = _mm_floor_ps(_mm_add_ps(x, s));
+		const __m128 fj = _mm_floor_ps(_mm_add_ps(y, s));
+		const __m128 fk = _mm_floor_ps(_mm_add_ps(z, s));
+		const __m128i i = _mm_cvttps_epi32(fi);
+		const __m128i j = _mm_cvttps_epi32(fj);
+		const __m128i k = _mm_cvttps_epi32(fk);
+
+		const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(fi, fj), fk), c.g3);
+		const __m128 x0 = _mm_sub_ps(x, _mm_sub_ps(fi, t));
+		const __m128 y0 = _mm_sub_ps(y, _mm_sub_ps(fj, t));
+		const __m128 z0 = _mm_sub_ps(z, _mm_sub_ps(fk, t));
+
+		const __m128 gx = _mm_cmpge_ps(x0, y0);
+		const __m128 gy = _mm_cmpge_ps(y0, z0);
+		const __m128 gz = _mm_cmpge_ps(z0, x0);
+		const __m128 i1 = _mm_andnot_ps(gz, gx);
+		const __m128 j1 = _mm_andnot_ps(gx, gy);
+		const __m128 k1 = _mm_andnot_ps(gy, gz);
+		const __m128 i2 = _mm_or_ps(gx, _mm_xor_ps(gz, c.all_ones));
+		const __m128 j2 = _mm_or_ps(gy, _mm_xor_ps(gx, c.all_ones));
+		const __m128 k2 = _mm_or_ps(gz, _mm_xor_ps(gy, c.all_ones));
+
+		const __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(i1, c.one)), c.g3);
+		const __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(j1, c.one)), c.g3);
+		const __m128 z1 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(k1, c.one)), c.g3);
+		const __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(i2, c.one)), c.g3x2);
+		const __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(j2, c.one)), c.g3x2);
+		const __m128 z2 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(k2, c.one)), c.g3x2);
+		const __m128 x3 = _mm_add_ps(_mm_sub_ps(x0, c.one), c.g3x3);
+		const __m128 y3 = _mm_add_ps(_mm_sub_ps(y0, c.one), c.g3x3);
+		const __m128 z3 = _mm_add_ps(_mm_sub_ps(z0, c.one), c.g3x3);
+
+		// the comparison masks are -1 where set, so subtracting them adds one
+		const __m128i ii1 = _mm_sub_epi32(i, _mm_castps_si128(i1));
+		const __m128i jj1 = _mm_sub_epi32(j, _mm_castps_si128(j1));
+		const __m128i kk1 = _mm_sub_epi32(k, _mm_castps_si128(k1));
+		const __m128i ii2 = _mm_sub_epi32(i, _mm_castps_si128(i2));
+		const __m128i jj2 = _mm_sub_epi32(j, _mm_castps_si128(j2));
+		const __m128i kk2 = _mm_sub_epi32(k, _mm_castps_si128(k2));
+
+		const __m128 n0 = corner(c, x0, y0, z0, hash3(c, i, j, k, seed));
+		const __m128 n1 = corner(c, x1, y1, z1, hash3(c, ii1, jj1, kk1, seed));
+		const __m128 n2 = corner(c, x2, y2, z2, hash3(c, ii2, jj2, kk2, seed));
+		const __m128 n3 = corner(c, x3, y3, z3, hash3(c, _mm_add_epi32(i, c.i1), _mm_add_epi32(j, c.i1), _mm_add_epi32(k, c.i1), seed));
+
+		return _mm_mul_ps(c.scale, _mm_add_ps(_mm_add_ps(_mm_add_ps(n0, n1), n2), n3));
+	}
+
+}
+
+void Detail::evaluate_sse42(const noise_params_t& params, const octave_table_t& octaves, const float* x, const float* y, const float* z, float* out, const size_t count)
+{
+	const sse_constants_t c = {};
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 ridge_offset = _mm_set1_ps(params.ridge_offset);
+	const __m128 normalization = _mm_set1_ps(octaves.normalization);
+	const bool ridged = params.type == NoiseType::RIDGED;
+
+	const size_t simd_count = count & ~size_t(3);
+	for (size_t p = 0; p < simd_count; p += 4)
+	{
+		const __m128 px = _mm_loadu_ps(x + p);
+		const __m128 py = _mm_loadu_ps(y + p);
+		const __m128 pz = _mm_loadu_ps(z + p);
+
+		__m128 sum = c.zero;
+		__m128 weight = c.one;
+		for (uint32_t o = 0; o < octaves.count; ++o)
+		{
+			const __m128 f = _mm_set1_ps(octaves.frequency[o]);
+			const __m128 amplitude = _mm_set1_ps(octaves.amplitude[o]);
+			const __m128i seed = _mm_set1_epi32(int32_t(octaves.seed[o]));
+			const __m128 n = simplex3(c, _mm_mul_ps(px, f), _mm_mul_ps(py, f), _mm_mul_ps(pz, f), seed);
+			if (ridged)
+			{
+				__m128 s = _mm_sub_ps(ridge_offset, _mm_andnot_ps(sign_mask, n));
+				s = _mm_mul_ps(s, s);
+				s = _mm_mul_ps(s, weight);
+				weight = _mm_min_ps(_mm_max_ps(_mm_mul_ps(s, two), c.zero), c.one);
+				sum = _mm_add_ps(sum, _mm_mul_ps(s, amplitude));
+			}
+			else
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(n, amplitude));
+			}
+		}
+		_mm_storeu_ps(out + p, _mm_mul_ps(sum, normalization));
+	}
+
+	if (simd_count < count)
+	{
+		evaluate_scalar(params, octaves, x + simd_count, y + simd_count, z + simd_count, out + simd_count, count - simd_count);
+	}
+}
+
+#endif
@@ -0,0 +1,137 @@
+#include "fft_kernels.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace Continuum;
+using namespace Continuum::Ocean;
+
+namespace FftDetail
+{
+	/// ping-pong planes of the column passes, one set per thread so that cascades can transform concurrently
+	struct scratch_t
+	{
+		std::vector<float> re;
+		std::vector<float> im;
+	};
+
+	static scratch_t& get_scratch(const size_t count)
+	{
+		static thread_local scratch_t scratch;
+		if (scratch.re.size() < count)
+		{
+			scratch.re.resize(count);
+			scratch.im.resize(count);
+		}
+		return scratch;
+	}
+
+	/// blocked so that both the rows read and the rows written stay in cache
+	static void transpose(float* data, const uint32_t size)
+	{
+		const uint32_t k_block = 16;
+		for (uint32_t by = 0; by < size; by += k_block)
+		{
+			for (uint32_t bx = by; bx < size; bx += k_block)
+			{
+				const uint32_t y_end = std::min(by + k_block, size);
+				const uint32_t x_end = std::min(bx + k_block, size);
+				for (uint32_t y = by; y < y_end; ++y)
+				{
+					for (uint32_t x = (bx == by ? y + 1 : bx); x < x_end; ++x)
+					{
+						std::swap(data[size_t(y) * size + x], data[size_t(x) * size + y]);
+					}
+				}
+			}
+		}
+	}
+
+	static void columns(float* re, float* im, float* scratch_re, float* scratch_im, const uint32_t size, const bool inverse, const Simd::SimdLevel level)
+	{
+#if CONTINUUM_SIMD_X86
+		if (level == Simd::SimdLevel::AVX2)
+		{
+			Detail::fft_columns_avx2(re, im, scratch_re, scratch_im, size, inverse);
+			return;
+		}
+		if (level == Simd::SimdLevel::SSE42)
+		{
+			Detail::fft_columns_sse42(re, im, scratch_re, scratch_im, size, inverse);
+			return;
+		}
+#endif
+		(void)level;
+		Detail::fft_columns_scalar(re, im, scratch_re, scratch_im, size, inverse);
+	}
+}
+
+void Detail::fft_columns_scalar(float* re, float* im, float* scratch_re, float* scratch_im, const uint32_t size, const bool inverse)
+{
+	fft_columns<scalar_lane_t>(re, im, scratch_re, scratch_im, size, inverse);
+}
+
+void Ocean::fft_2d(complex_grid_t& grid, const FftDirection::FftDirectionType direction)
+{
+	fft_2d(grid, direction, Simd::detect());
+}
+
+void Ocean::fft_2d(complex_grid_t& grid, const FftDirection::FftDirectionType direction, const Simd::SimdLevel level)
+{
+	const uint32_t size = grid.size;
+	if (!is_power_of_two(size) || size < 2)
+	{
+		throw FftException("fft_2d: size " + std::to_string(size) + " is not a power of two");
+	}
+	const size_t count = size_t(size) * size;
+	if (grid.re.size() != count || grid.im.size() != count)
+	{
+		throw FftException("fft_2d: planes do not match the grid size");
+	}
+
+	const Simd::SimdLevel supported = std::min(level, Simd::detect());
+	const bool inverse = direction == FftDirection::INVERSE;
+	FftDetail::scratch_t& scratch = FftDetail::get_scratch(count);
+
+	// along y, then along x through the transposed grid, then back to row-major
+	FftDetail::columns(grid.re.data(), grid.im.data(), scratch.re.data(), scratch.im.data(), size, inverse, supported);
+	FftDetail::transpose(grid.re.data(), size);
+	FftDetail::transpose(grid.im.data(), size);
+	FftDetail::columns(grid.re.data(), grid.im.data(), scratch.re.data(), scratch.im.data(), size, inverse, supported);
+	FftDetail::transpose(grid.re.data(), size);
+	FftDetail::transpose(grid.im.data(), size);
+}
+
+void Ocean::dft_2d(const complex_grid_t& in, complex_grid_t& out, const FftDirection::FftDirectionType direction)
+{
+	const uint32_t n = in.size;
+	const double sign = direction == FftDirection::INVERSE ? 1.0 : -1.0;
+	const double k_two_pi = 6.283185307179586476925;
+	out.resize(n);
+
+	for (uint32_t ky = 0; ky < n; ++ky)
+	{
+		for (uint32_t kx = 0; kx < n; ++kx)
+		{
+			double sum_re = 0.0;
+			double sum_im = 0.0;
+			for (uint32_t y = 0; y < n; ++y)
+			{
+				for (uint32_t x = 0; x < n; ++x)
+				{
+					// products reduced modulo n first, the angle stays exact for any grid size
+					const uint32_t phase = uint32_t((uint64_t(kx) * x + uint64_t(ky) * y) % n);
+					const double angle = sign * k_two_pi * double(phase) / double(n);
+					const double c = std::cos(angle);
+					const double s = std::sin(angle);
+					const size_t i = size_t(y) * n + x;
+					sum_re += in.re[i] * c - in.im[i] * s;
+					sum_im += in.re[i] * s + in.im[i] * c;
+				}
+			}
+			const size_t o = size_t(ky) * n + kx;
+			out.re[o] = float(sum_re);
+			out.im[o] = float(sum_im);
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../simd.h"
+
+namespace Continuum {
+
+	namespace Ocean {
+
+		struct FftException : public std::runtime_error {
+			FftException(const std::string& msg) :
+				std::runtime_error(msg) {}
+		};
+
+		namespace FftDirection {
+			enum FftDirectionType
+			{
+				/// X[k] = sum x[n] e^{-2 pi i k n / N}
+				FORWARD = 0,
+				/// x[n] = sum X[k] e^{+2 pi i k n / N}, not divided by N
+				INVERSE = 1
+			};
+		}
+
+		/// square complex grid, row-major, real and imaginary parts in separate planes so that the kernels
+		/// load 4 / 8 neighbouring values of either at once
+		struct complex_grid_t
+		{
+			uint32_t size = 0;
+			std::vector<float> re;
+			std::vector<float> im;
+		public:
+			inline void resize(const uint32_t grid_size)
+			{
+				this->size = grid_size;
+				this->re.assign(size_t(grid_size) * grid_size, 0.0f);
+				this->im.assign(size_t(grid_size) * grid_size, 0.0f);
+			}
+		};
+
+		inline bool is_power_of_two(const uint32_t value) { return value != 0 && (value & (value - 1)) == 0; }
+
+		/// In-place 2D FFT through the best kernel the CPU supports. Stockham radix-4 passes (one radix-2 pass
+		/// for odd powers) run down the columns, every butterfly combining whole rows, then the grid is
+		/// transposed and the columns transformed again. size must be a power of two.
+		void fft_2d(complex_grid_t& grid, const FftDirection::FftDirectionType direction);
+		/// same, through a given kernel; levels the CPU lacks fall back to the best supported one
+		void fft_2d(complex_grid_t& grid, const FftDirection::FftDirectionType direction, const Simd::SimdLevel level);
+
+		/// O(N^4) direct evaluation of the same sums in double precision, the reference for fft_2d
+		void dft_2d(const complex_grid_t& in, complex_grid_t& out, const FftDirection::FftDirectionType direction);
+
+	}
+
+}
+#endif
@@ -0,0 +1,197 @@
+#ifndef FFT_KERNELS_H
+#define FFT_KERNELS_H
+
+// Shared between fft.cpp and the per-ISA translation units, which are compiled with their own
+// instruction set flags. The template below has internal linkage and is instantiated by each of them
+// with its own lane type, so the linker can never pick an AVX2 copy for the scalar path.
+
+#include "fft.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace Continuum {
+
+	namespace Ocean {
+
+		namespace Detail {
+
+			/// one column pass: size-point transforms down every column of the size x size planes re / im,
+			/// scratch planes of the same size are used for the ping-pong between passes
+			void fft_columns_scalar(float* re, float* im, float* scratch_re, float* scratch_im, const uint32_t size, const bool inverse);
+#if CONTINUUM_SIMD_X86
+			void fft_columns_sse42(float* re, float* im, float* scratch_re, float* scratch_im, const uint32_t size, const bool inverse);
+			void fft_columns_avx2(float* re, float* im, float* scratch_re, float* scratch_im, const uint32_t size, const bool inverse);
+#endif
+
+			/// single-lane fallback for rows narrower than a vector, and the whole scalar kernel
+			struct scalar_lane_t
+			{
+				using type = float;
+				static constexpr uint32_t k_width = 1;
+				static inline type load(const float* p) { return *p; }
+				static inline void store(float* p, const type v) { *p = v; }
+				static inline type set1(const float v) { return v; }
+				static inline type add(const type a, const type b) { return a + b; }
+				static inline type sub(const type a, const type b) { return a - b; }
+				static inline type mul(const type a, const type b) { return a * b; }
+			};
+
+			struct twiddle_t
+			{
+				float re = 1.0f;
+				float im = 0.0f;
+			};
+
+			static inline twiddle_t make_twiddle(const double angle)
+			{
+				twiddle_t w;
+				w.re = float(std::cos(angle));
+				w.im = float(std::sin(angle));
+				return w;
+			}
+
+			/// rows [x, end) of one radix-4 butterfly: a, b, c, d are input rows, y0..y3 output rows
+			template<typename L>
+			static inline void radix4_rows(const float* ar, const float* ai, const float* br, const float* bi, const float* cr, const float* ci,
+				const float* dr, const float* di, float* const* yr, float* const* yi, const twiddle_t* w, const bool inverse, uint32_t& x, const uint32_t end)
+			{
+				using V = typename L::type;
+				const V w1r = L::set1(w[0].re), w1i = L::set1(w[0].im);
+				const V w2r = L::set1(w[1].re), w2i = L::set1(w[1].im);
+				const V w3r = L::set1(w[2].re), w3i = L::set1(w[2].im);
+				for (; x + L::k_width <= end; x += L::k_width)
+				{
+					const V a_r = L::load(ar + x), a_i = L::load(ai + x);
+					const V b_r = L::load(br + x), b_i = L::load(bi + x);
+					const V c_r = L::load(cr + x), c_i = L::load(ci + x);
+					const V d_r = L::load(dr + x), d_i = L::load(di + x);
+
+					const V apc_r = L::add(a_r, c_r), apc_i = L::add(a_i, c_i);
+					const V amc_r = L::sub(a_r, c_r), amc_i = L::sub(a_i, c_i);
+					const V bpd_r = L::add(b_r, d_r), bpd_i = L::add(b_i, d_i);
+					// j (b - d) for the forward transform, -j (b - d) for the inverse
+					V jbmd_r = L::sub(d_i, b_i), jbmd_i = L::sub(b_r, d_r);
+					if (inverse)
+					{
+						jbmd_r = L::sub(b_i, d_i);
+						jbmd_i = L::sub(d_r, b_r);
+					}
+
+					L::store(yr[0] + x, L::add(apc_r, bpd_r));
+					L::store(yi[0] + x, L::add(apc_i, bpd_i));
+
+					const V t1_r = L::sub(amc_r, jbmd_r), t1_i = L::sub(amc_i, jbmd_i);
+					L::store(yr[1] + x, L::sub(L::mul(t1_r, w1r), L::mul(t1_i, w1i)));
+					L::store(yi[1] + x, L::add(L::mul(t1_r, w1i), L::mul(t1_i, w1r)));
+
+					const V t2_r = L::sub(apc_r, bpd_r), t2_i = L::sub(apc_i, bpd_i);
+					L::store(yr[2] + x, L::sub(L::mul(t2_r, w2r), L::mul(t2_i, w2i)));
+					L::store(yi[2] + x, L::add(L::mul(t2_r, w2i), L::mul(t2_i, w2r)));
+
+					const V t3_r = L::add(amc_r, jbmd_r), t3_i = L::add(amc_i, jbmd_i);
+					L::store(yr[3] + x, L::sub(L::mul(t3_r, w3r), L::mul(t3_i, w3i)));
+					L::store(yi[3] + x, L::add(L::mul(t3_r, w3i), L::mul(t3_i, w3r)));
+				}
+			}
+
+			template<typename L>
+			static inline void radix2_rows(const float* ar, const float* ai, const float* br, const float* bi,
+				float* y0r, float* y0i, float* y1r, float* y1i, const twiddle_t w, uint32_t& x, const uint32_t end)
+			{
+				using V = typename L::type;
+				const V wr = L::set1(w.re), wi = L::set1(w.im);
+				for (; x + L::k_width <= end; x += L::k_width)
+				{
+					const V a_r = L::load(ar + x), a_i = L::load(ai + x);
+					const V b_r = L::load(br + x), b_i = L::load(bi + x);
+					L::store(y0r + x, L::add(a_r, b_r));
+					L::store(y0i + x, L::add(a_i, b_i));
+					const V t_r = L::sub(a_r, b_r), t_i = L::sub(a_i, b_i);
+					L::store(y1r + x, L::sub(L::mul(t_r, wr), L::mul(t_i, wi)));
+					L::store(y1i + x, L::add(L::mul(t_r, wi), L::mul(t_i, wr)));
+				}
+			}
+
+			/// Stockham autosort: every pass reads one plane pair and writes the other in natural order, so no
+			/// bit reversal is needed. Element k of a pass is row k, the innermost loop runs along the row.
+			template<typename L>
+			static void fft_columns(float* re, float* im, float* scratch_re, float* scratch_im, const uint32_t size, const bool inverse)
+			{
+				const double k_two_pi = 6.283185307179586476925;
+				const double sign = inverse ? 1.0 : -1.0;
+				const uint32_t width = size;
+				float* xr = re;
+				float* xi = im;
+				float* yr = scratch_re;
+				float* yi = scratch_im;
+
+				uint32_t length = size;
+				uint32_t stride = 1;
+				while (length > 1)
+				{
+					if (length % 4 == 0)
+					{
+						const uint32_t quarter = length / 4;
+						for (uint32_t p = 0; p < quarter; ++p)
+						{
+							const double angle = sign * k_two_pi * double(p) / double(length);
+							const twiddle_t w[3] = { make_twiddle(angle), make_twiddle(2.0 * angle), make_twiddle(3.0 * angle) };
+							for (uint32_t q = 0; q < stride; ++q)
+							{
+								const size_t a = size_t(q + stride * p) * width;
+								const size_t b = size_t(q + stride * (p + quarter)) * width;
+								const size_t c = size_t(q + stride * (p + 2 * quarter)) * width;
+								const size_t d = size_t(q + stride * (p + 3 * quarter)) * width;
+								float* out_r[4];
+								float* out_i[4];
+								for (uint32_t k = 0; k < 4; ++k)
+								{
+									const size_t row = size_t(q + stride * (4 * p + k)) * width;
+									out_r[k] = yr + row;
+									out_i[k] = yi + row;
+								}
+								uint32_t x = 0;
+								radix4_rows<L>(xr + a, xi + a, xr + b, xi + b, xr + c, xi + c, xr + d, xi + d, out_r, out_i, w, inverse, x, width);
+								radix4_rows<scalar_lane_t>(xr + a, xi + a, xr + b, xi + b, xr + c, xi + c, xr + d, xi + d, out_r, out_i, w, inverse, x, width);
+							}
+						}
+						length = quarter;
+						stride *= 4;
+					}
+					else
+					{
+						const uint32_t half = length / 2;
+						for (uint32_t p = 0; p < half; ++p)
+						{
+							const twiddle_t w = make_twiddle(sign * k_two_pi * double(p) / double(length));
+							for (uint32_t q = 0; q < stride; ++q)
+							{
+								const size_t a = size_t(q + stride * p) * width;
+								const size_t b = size_t(q + stride * (p + half)) * width;
+								const size_t y0 = size_t(q + stride * (2 * p)) * width;
+								const size_t y1 = size_t(q + stride * (2 * p + 1)) * width;
+								uint32_t x = 0;
+								radix2_rows<L>(xr + a, xi + a, xr + b, xi + b, yr + y0, yi + y0, yr + y1, yi + y1, w, x, width);
+								radix2_rows<scalar_lane_t>(xr + a, xi + a, xr + b, xi + b, yr + y0, yi + y0, yr + y1, yi + y1, w, x, width);
+							}
+						}
+						length = half;
+						stride *= 2;
+					}
+					std::swap(xr, yr);
+					std::swap(xi, yi);
+				}
+
+				if (xr != re)
+				{
+					std::copy(xr, xr + size_t(size) * width, re);
+					std::copy(xi, xi + size_t(size) * width, im);
+				}
+			}
+		}
+
+	}
+
+}
+#endif
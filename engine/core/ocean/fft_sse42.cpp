@@ -0,0 +1,31 @@
+// Compiled with SSE4.2 enabled (see CMakeLists.txt), only called after Simd::detect() reported support.
+#include "fft_kernels.h"
+
+#if CONTINUUM_SIMD_X86
+
+#include <immintrin.h>
+
+using namespace Continuum::Ocean;
+
+namespace {
+
+	struct sse_lane_t
+	{
+		using type = __m128;
+		static constexpr uint32_t k_width = 4;
+		static inline type load(const float* p) { return _mm_loadu_ps(p); }
+		static inline void store(float* p, const type v) { _mm_storeu_ps(p, v); }
+		static inline type set1(const float v) { return _mm_set1_ps(v); }
+		static inline type add(const type a, const type b) { return _mm_add_ps(a, b); }
+		static inline type sub(const type a, const type b) { return _mm_sub_ps(a, b); }
+		static inline type mul(const type a, const type b) { return _mm_mul_ps(a, b); }
+	};
+
+}
+
+void Detail::fft_columns_sse42(float* re, float* im, float* scratch_re, float* scratch_im, const uint32_t size, const bool inverse)
+{
+	fft_columns<sse_lane_t>(re, im, scratch_re, scratch_im, size, inverse);
+}
+
+#endif
@@ -0,0 +1,458 @@
+#include "ocean.h"
+
+#include "../profiler/profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Continuum;
+using namespace Continuum::Ocean;
+
+namespace OceanDetail
+{
+	static constexpr double k_gravity = 9.81;
+	static constexpr double k_two_pi = 6.283185307179586476925;
+	/// a cascade takes over from the previous one at this many of its own fundamental wave numbers, far below
+	/// the previous cascade's Nyquist limit so that every band is resolved by a few texels per wavelength
+	static constexpr double k_band_start = 6.0;
+
+	static inline double elapsed_ms(const std::chrono::high_resolution_clock::time_point& from)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - from).count();
+	}
+
+	static inline uint32_t hash(uint32_t h)
+	{
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+	/// two independent standard normal numbers per texel, Box-Muller over hashed uniforms so that the
+	/// spectrum does not depend on the standard library's distributions
+	static inline glm::dvec2 gaussian_pair(const uint32_t seed, const uint32_t cascade, const uint32_t index)
+	{
+		const uint32_t h0 = hash(seed ^ hash(cascade * 0x9e3779b9u ^ hash(index)));
+		const uint32_t h1 = hash(h0 ^ 0x68e31da4u);
+		const double u0 = (double(h0 >> 8) + 1.0) / 16777217.0;
+		const double u1 = double(h1 >> 8) / 16777216.0;
+		const double r = std::sqrt(-2.0 * std::log(u0));
+		return glm::dvec2(r * std::cos(k_two_pi * u1), r * std::sin(k_two_pi * u1));
+	}
+
+	/// signed wave number index of grid index i
+	static inline int32_t wrap(const uint32_t i, const uint32_t n)
+	{
+		return i < n / 2 ? int32_t(i) : int32_t(i) - int32_t(n);
+	}
+
+	static inline glm::vec2 mul_i(const glm::vec2& a) { return glm::vec2(-a.y, a.x); }
+}
+
+ocean_t::ocean_t(const ocean_settings_t& settings, Jobs::job_system_t* jobs) :
+	settings_(settings),
+	jobs_(jobs)
+{
+	const uint32_t n = this->settings_.resolution;
+	if (!is_power_of_two(n) || n < 4)
+	{
+		throw OceanException("ocean: resolution " + std::to_string(n) + " is not a power of two of at least 4");
+	}
+	const std::vector<float>& lengths = this->settings_.tile_lengths;
+	if (lengths.empty())
+	{
+		throw OceanException("ocean: no cascades");
+	}
+	for (size_t c = 0; c < lengths.size(); ++c)
+	{
+		if (!(lengths[c] > 0.0f) || (c > 0 && lengths[c] >= lengths[c - 1]))
+		{
+			throw OceanException("ocean: tile lengths must be positive and decreasing");
+		}
+	}
+	if (glm::length(this->settings_.wind_direction) <= 0.0f)
+	{
+		this->settings_.wind_direction = glm::vec2(1.0f, 0.0f);
+	}
+	this->settings_.wind_direction = glm::normalize(this->settings_.wind_direction);
+
+	this->stats_.cascade_ms.assign(lengths.size(), 0.0);
+	for (uint32_t c = 0; c < uint32_t(lengths.size()); ++c)
+	{
+		std::unique_ptr<cascade_t> cascade = std::make_unique<cascade_t>();
+		init_spectrum(*cascade, c);
+		this->cascades_.push_back(std::move(cascade));
+	}
+}
+
+ocean_t::~ocean_t()
+{
+	if (this->running_ && this->jobs_ != NULL) this->jobs_->wait(this->in_flight_);
+	release();
+}
+
+void ocean_t::init_spectrum(cascade_t& cascade, const uint32_t index)
+{
+	using namespace OceanDetail;
+	const uint32_t n = this->settings_.resolution;
+	const std::vector<float>& lengths = this->settings_.tile_lengths;
+	const size_t count = size_t(n) * n;
+
+	cascade.tile_length = lengths[index];
+	const double dk = k_two_pi / cascade.tile_length;
+	const double nyquist = dk * double(n / 2);
+	cascade.k_min = index == 0 ? 0.0f : float(dk * k_band_start);
+	cascade.k_max = float(nyquist);
+	if (index + 1 < lengths.size())
+	{
+		const double next_start = k_two_pi / lengths[index + 1] * k_band_start;
+		if (next_start > nyquist)
+		{
+			throw OceanException("ocean: tile length " + std::to_string(lengths[index + 1]) + " takes over above the Nyquist limit of the previous cascade");
+		}
+		cascade.k_max = float(next_start);
+	}
+
+	const double wind_speed = std::max(double(this->settings_.wind_speed), 1e-3);
+	const double largest_wave = wind_speed * wind_speed / k_gravity;
+	const double small_wave = this->settings_.small_wave_length;
+	const glm::dvec2 wind = glm::dvec2(this->settings_.wind_direction);
+
+	cascade.h0.assign(count, glm::vec2(0.0f));
+	cascade.h0_minus_conj.assign(count, glm::vec2(0.0f));
+	cascade.omega.assign(count, 0.0f);
+	cascade.spectrum.assign(count, glm::vec2(0.0f));
+	for (uint32_t g = 0; g < k_field_grids; ++g)
+	{
+		cascade.grids[g].resize(n);
+	}
+	for (ocean_maps_t& maps : cascade.maps)
+	{
+		maps.displacement.assign(count, glm::vec4(0.0f));
+		maps.slopes.assign(count, glm::vec4(0.0f, 0.0f, 1.0f, 0.0f));
+	}
+
+	for (uint32_t z = 0; z < n; ++z)
+	{
+		for (uint32_t x = 0; x < n; ++x)
+		{
+			const size_t i = size_t(z) * n + x;
+			const glm::dvec2 k = glm::dvec2(wrap(x, n), wrap(z, n)) * dk;
+			const double k_length = glm::length(k);
+			if (k_length <= 0.0) continue;
+
+			const double depth = this->settings_.depth;
+			cascade.omega[i] = float(depth > 0.0 ? std::sqrt(k_gravity * k_length * std::tanh(k_length * depth)) : std::sqrt(k_gravity * k_length));
+
+			// the Nyquist row and column have no negative partner, dropping them keeps the fields real
+			if (x == n / 2 || z == n / 2 || k_length < cascade.k_min || k_length >= cascade.k_max) continue;
+
+			// Phillips spectrum
+			const double k2 = k_length * k_length;
+			const double alignment = glm::dot(k / k_length, wind);
+			const double phillips = this->settings_.amplitude * std::exp(-1.0 / (k2 * largest_wave * largest_wave)) / (k2 * k2) *
+				alignment * alignment * std::exp(-k2 * small_wave * small_wave);
+			const glm::dvec2 xi = gaussian_pair(this->settings_.seed, index, uint32_t(i));
+			cascade.h0[i] = glm::vec2(xi * std::sqrt(phillips * 0.5) * dk);
+		}
+	}
+	for (uint32_t z = 0; z < n; ++z)
+	{
+		for (uint32_t x = 0; x < n; ++x)
+		{
+			const glm::vec2 minus = cascade.h0[size_t((n - z) % n) * n + (n - x) % n];
+			cascade.h0_minus_conj[size_t(z) * n + x] = glm::vec2(minus.x, -minus.y);
+		}
+	}
+}
+
+void ocean_t::evolve_spectrum(cascade_t& cascade, const float time)
+{
+	const size_t count = cascade.spectrum.size();
+	for (size_t i = 0; i < count; ++i)
+	{
+		// h0(k) e^{i w t} + conj(h0(-k)) e^{-i w t}
+		const float phase = cascade.omega[i] * time;
+		const float c = std::cos(phase);
+		const float s = std::sin(phase);
+		const glm::vec2 a = cascade.h0[i];
+		const glm::vec2 b = cascade.h0_minus_conj[i];
+		cascade.spectrum[i] = glm::vec2(a.x * c - a.y * s + b.x * c + b.y * s, a.x * s + a.y * c + b.y * c - b.x * s);
+	}
+}
+
+void ocean_t::fill_grid(cascade_t& cascade, const uint32_t grid)
+{
+	using OceanDetail::mul_i;
+	const uint32_t n = this->settings_.resolution;
+	const float dk = float(OceanDetail::k_two_pi / cascade.tile_length);
+	complex_grid_t& out = cascade.grids[grid];
+
+	for (uint32_t z = 0; z < n; ++z)
+	{
+		const float kz = float(OceanDetail::wrap(z, n)) * dk;
+		for (uint32_t x = 0; x < n; ++x)
+		{
+			const size_t i = size_t(z) * n + x;
+			const float kx = float(OceanDetail::wrap(x, n)) * dk;
+			const float k_length = std::sqrt(kx * kx + kz * kz);
+			const glm::vec2 h = cascade.spectrum[i];
+			const float inv_k = k_length > 0.0f ? 1.0f / k_length : 0.0f;
+
+			// two real fields a and b share one transform as a + i b
+			glm::vec2 a;
+			glm::vec2 b;
+			switch (grid)
+			{
+			case 0: // height, x displacement
+				a = h;
+				b = mul_i(h) * (kx * inv_k);
+				break;
+			case 1: // z displacement, x slope
+				a = mul_i(h) * (kz * inv_k);
+				b = mul_i(h) * kx;
+				break;
+			case 2: // z slope, d(Dx)/dx
+				a = mul_i(h) * kz;
+				b = -h * (kx * kx * inv_k);
+				break;
+			default: // d(Dz)/dz, d(Dx)/dz
+				a = -h * (kz * kz * inv_k);
+				b = -h * (kx * kz * inv_k);
+				break;
+			}
+			out.re[i] = a.x - b.y;
+			out.im[i] = a.y + b.x;
+		}
+	}
+	fft_2d(out, FftDirection::INVERSE);
+}
+
+void ocean_t::assemble(cascade_t& cascade, ocean_maps_t& maps, const float time)
+{
+	const float lambda = this->settings_.choppiness;
+	const complex_grid_t* g = cascade.grids;
+	const size_t count = maps.displacement.size();
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float jxx = 1.0f + lambda * g[2].im[i];
+		const float jzz = 1.0f + lambda * g[3].re[i];
+		const float jxz = lambda * g[3].im[i];
+		maps.displacement[i] = glm::vec4(lambda * g[0].im[i], g[0].re[i], lambda * g[1].re[i], 0.0f);
+		maps.slopes[i] = glm::vec4(g[1].im[i], g[2].re[i], jxx * jzz - jxz * jxz, 0.0f);
+	}
+	maps.time = time;
+}
+
+void ocean_t::simulate(cascade_t& cascade, const uint32_t buffer, const float time)
+{
+	auto t0 = std::chrono::high_resolution_clock::now();
+	evolve_spectrum(cascade, time);
+	cascade.job_ms[0] = OceanDetail::elapsed_ms(t0);
+	for (uint32_t g = 0; g < k_field_grids; ++g)
+	{
+		t0 = std::chrono::high_resolution_clock::now();
+		fill_grid(cascade, g);
+		cascade.job_ms[1 + g] = OceanDetail::elapsed_ms(t0);
+	}
+	t0 = std::chrono::high_resolution_clock::now();
+	assemble(cascade, cascade.maps[buffer], time);
+	cascade.job_ms[k_field_grids + 1] = OceanDetail::elapsed_ms(t0);
+}
+
+void ocean_t::kick(const float time)
+{
+	this->kick_time_ = std::chrono::high_resolution_clock::now();
+	this->running_ = true;
+	const uint32_t back = this->front_ ^ 1;
+
+	if (this->jobs_ == NULL)
+	{
+		for (std::unique_ptr<cascade_t>& cascade : this->cascades_)
+		{
+			simulate(*cascade, back, time);
+		}
+		return;
+	}
+
+	// per cascade: evolve the spectrum, then the four transforms side by side, then the maps
+	for (std::unique_ptr<cascade_t>& owned : this->cascades_)
+	{
+		cascade_t* cascade = owned.get();
+		this->jobs_->submit([this, cascade, time]()
+		{
+			const auto t0 = std::chrono::high_resolution_clock::now();
+			evolve_spectrum(*cascade, time);
+			cascade->job_ms[0] = OceanDetail::elapsed_ms(t0);
+		}, &cascade->spectrum_counter);
+		for (uint32_t g = 0; g < k_field_grids; ++g)
+		{
+			this->jobs_->submit_after(cascade->spectrum_counter, [this, cascade, g]()
+			{
+				const auto t0 = std::chrono::high_resolution_clock::now();
+				fill_grid(*cascade, g);
+				cascade->job_ms[1 + g] = OceanDetail::elapsed_ms(t0);
+			}, &cascade->fft_counter);
+		}
+		this->jobs_->submit_after(cascade->fft_counter, [this, cascade, back, time]()
+		{
+			const auto t0 = std::chrono::high_resolution_clock::now();
+			assemble(*cascade, cascade->maps[back], time);
+			cascade->job_ms[k_field_grids + 1] = OceanDetail::elapsed_ms(t0);
+		}, &this->in_flight_);
+	}
+}
+
+void ocean_t::publish(void)
+{
+	this->running_ = false;
+	this->front_ ^= 1;
+	++this->stats_.completed;
+	this->stats_.latency_ms = OceanDetail::elapsed_ms(this->kick_time_);
+	this->stats_.simulate_ms = 0.0;
+	for (size_t c = 0; c < this->cascades_.size(); ++c)
+	{
+		double ms = 0.0;
+		for (const double job_ms : this->cascades_[c]->job_ms) ms += job_ms;
+		this->stats_.cascade_ms[c] = ms;
+		this->stats_.simulate_ms += ms;
+	}
+	if (this->textures_) upload();
+}
+
+void ocean_t::update(const float time)
+{
+	CONTINUUM_PROFILE_SCOPE("ocean_update");
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	if (this->running_ && this->in_flight_.is_done())
+	{
+		publish();
+	}
+	if (!this->running_)
+	{
+		kick(time);
+		if (this->jobs_ == NULL) publish();
+	}
+	else
+	{
+		++this->stats_.skipped;
+	}
+
+	this->stats_.update_ms = OceanDetail::elapsed_ms(t0);
+}
+
+void ocean_t::finish(void)
+{
+	if (!this->running_) return;
+	if (this->jobs_ != NULL) this->jobs_->wait(this->in_flight_);
+	publish();
+}
+
+void ocean_t::create_textures(void)
+{
+	if (this->textures_) return;
+	const uint32_t n = this->settings_.resolution;
+	GLsizei levels = 1;
+	while ((n >> levels) > 0) ++levels;
+
+	for (std::unique_ptr<cascade_t>& cascade : this->cascades_)
+	{
+		GLuint* textures[2] = { &cascade->displacement_texture, &cascade->slope_texture };
+		const GLenum formats[2] = { GL_RGBA32F, GL_RGBA16F };
+		for (uint32_t t = 0; t < 2; ++t)
+		{
+			glCreateTextures(GL_TEXTURE_2D, 1, textures[t]);
+			glTextureStorage2D(*textures[t], levels, formats[t], GLsizei(n), GLsizei(n));
+			glTextureParameteri(*textures[t], GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTextureParameteri(*textures[t], GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTextureParameteri(*textures[t], GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTextureParameteri(*textures[t], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		}
+	}
+	this->textures_ = true;
+	if (has_maps()) upload();
+}
+
+void ocean_t::upload(void)
+{
+	CONTINUUM_PROFILE_SCOPE("ocean_upload");
+	const auto t0 = std::chrono::high_resolution_clock::now();
+	const GLsizei n = GLsizei(this->settings_.resolution);
+	for (std::unique_ptr<cascade_t>& cascade : this->cascades_)
+	{
+		const ocean_maps_t& maps = cascade->maps[this->front_];
+		glTextureSubImage2D(cascade->displacement_texture, 0, 0, 0, n, n, GL_RGBA, GL_FLOAT, maps.displacement.data());
+		glTextureSubImage2D(cascade->slope_texture, 0, 0, 0, n, n, GL_RGBA, GL_FLOAT, maps.slopes.data());
+		glGenerateTextureMipmap(cascade->displacement_texture);
+		glGenerateTextureMipmap(cascade->slope_texture);
+	}
+	// the upload is asynchronous, the time measured is the driver's copy of the texels
+	this->stats_.upload_ms = OceanDetail::elapsed_ms(t0);
+}
+
+void ocean_t::release(void)
+{
+	if (!this->textures_) return;
+	for (std::unique_ptr<cascade_t>& cascade : this->cascades_)
+	{
+		glDeleteTextures(1, &cascade->displacement_texture);
+		glDeleteTextures(1, &cascade->slope_texture);
+		cascade->displacement_texture = 0;
+		cascade->slope_texture = 0;
+	}
+	this->textures_ = false;
+}
+
+glm::vec4 ocean_t::sample_reference(const uint32_t cascade_index, const float x, const float z, const float time, glm::vec4* slopes) const
+{
+	using OceanDetail::k_two_pi;
+	const cascade_t& cascade = *this->cascades_[cascade_index];
+	const uint32_t n = this->settings_.resolution;
+	const double dk = k_two_pi / cascade.tile_length;
+	const double lambda = this->settings_.choppiness;
+
+	// height, Dx, Dz, slope x, slope z, dDx/dx, dDz/dz, dDx/dz
+	double fields[8] = {};
+	for (uint32_t iz = 0; iz < n; ++iz)
+	{
+		for (uint32_t ix = 0; ix < n; ++ix)
+		{
+			const size_t i = size_t(iz) * n + ix;
+			const glm::dvec2 a = glm::dvec2(cascade.h0[i]);
+			const glm::dvec2 b = glm::dvec2(cascade.h0_minus_conj[i]);
+			if (a == glm::dvec2(0.0) && b == glm::dvec2(0.0)) continue;
+
+			const double kx = OceanDetail::wrap(ix, n) * dk;
+			const double kz = OceanDetail::wrap(iz, n) * dk;
+			const double k_length = std::sqrt(kx * kx + kz * kz);
+			const double phase = double(cascade.omega[i]) * time;
+			const double c = std::cos(phase);
+			const double s = std::sin(phase);
+			const glm::dvec2 h = glm::dvec2(a.x * c - a.y * s + b.x * c + b.y * s, a.x * s + a.y * c + b.y * c - b.x * s);
+			// real parts of h e^{i k.x}, i h e^{i k.x} and -h e^{i k.x}
+			const double e_re = std::cos(kx * x + kz * z);
+			const double e_im = std::sin(kx * x + kz * z);
+			const double re = h.x * e_re - h.y * e_im;
+			const double i_re = -(h.x * e_im + h.y * e_re);
+			fields[0] += re;
+			fields[1] += i_re * kx / k_length;
+			fields[2] += i_re * kz / k_length;
+			fields[3] += i_re * kx;
+			fields[4] += i_re * kz;
+			fields[5] -= re * kx * kx / k_length;
+			fields[6] -= re * kz * kz / k_length;
+			fields[7] -= re * kx * kz / k_length;
+		}
+	}
+
+	if (slopes != NULL)
+	{
+		const double jacobian = (1.0 + lambda * fields[5]) * (1.0 + lambda * fields[6]) - lambda * lambda * fields[7] * fields[7];
+		*slopes = glm::vec4(float(fields[3]), float(fields[4]), float(jacobian), 0.0f);
+	}
+	return glm::vec4(float(lambda * fields[1]), float(fields[0]), float(lambda * fields[2]), 0.0f);
+}
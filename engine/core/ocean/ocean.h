@@ -0,0 +1,155 @@
+#ifndef OCEAN_H
+#define OCEAN_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "fft.h"
+#include "../jobs/job_system.h"
+
+namespace Continuum {
+
+	namespace Ocean {
+
+		struct OceanException : public std::runtime_error {
+			OceanException(const std::string& msg) :
+				std::runtime_error(msg) {}
+		};
+
+		struct ocean_settings_t
+		{
+			/// texels per cascade side, a power of two
+			uint32_t resolution = 256;
+			/// world size of each cascade's tile in metres, largest first; wave numbers are split between the
+			/// cascades so that no wavelength is simulated twice
+			std::vector<float> tile_lengths = { 500.0f, 85.0f, 16.0f };
+			float wind_speed = 10.0f;
+			/// horizontal, normalized internally
+			glm::vec2 wind_direction = glm::vec2(1.0f, 0.0f);
+			/// Phillips spectrum constant
+			float amplitude = 0.0081f;
+			/// waves shorter than this are suppressed
+			float small_wave_length = 0.01f;
+			/// water depth in metres for the dispersion relation, 0 is deep water
+			float depth = 0.0f;
+			/// scale of the horizontal displacement, 0 gives plain height field waves
+			float choppiness = 1.0f;
+			uint32_t seed = 1;
+		};
+
+		struct ocean_stats_t
+		{
+			/// simulations published / update() calls that found the previous one still running
+			uint64_t completed = 0;
+			uint64_t skipped = 0;
+			/// job time of the last published simulation, per cascade and in total
+			std::vector<double> cascade_ms;
+			double simulate_ms = 0.0;
+			/// from the update() that started the last published simulation to the one that published it
+			double latency_ms = 0.0;
+			/// time spent in the last update() call, uploads included
+			double update_ms = 0.0;
+			double upload_ms = 0.0;
+		};
+
+		/// One cascade's maps, texel (x, z) at world (x, z) * tile_length / resolution, tiling.
+		/// displacement: horizontal x, height, horizontal z; slopes: dh/dx, dh/dz, Jacobian of the horizontal
+		/// displacement (below 0 where the surface folds over, the foam term).
+		struct ocean_maps_t
+		{
+			std::vector<glm::vec4> displacement;
+			std::vector<glm::vec4> slopes;
+			/// simulation time the maps were computed for
+			float time = 0.0f;
+		};
+
+		/// Tessendorf FFT ocean in cascaded tiles. update() never waits: it publishes the simulation started by
+		/// an earlier update() once its jobs are done, and starts the next one into the back buffer. Without a job
+		/// system every update() simulates on the calling thread.
+		struct ocean_t
+		{
+			ocean_t(const ocean_settings_t& settings, Jobs::job_system_t* jobs = NULL);
+			~ocean_t();
+			ocean_t(const ocean_t&) = delete;
+			ocean_t& operator=(const ocean_t&) = delete;
+		public:
+			/// per cascade displacement (RGBA32F) and slope (RGBA16F) textures, updated by update() from then on
+			void create_textures(void);
+			void update(const float time);
+			/// waits for the running simulation, if any, and publishes it
+			void finish(void);
+			/// Direct sum over the cascade's spectrum in double, what the front maps are checked against.
+			/// Returns the displacement texel at world (x, z), slopes receives the slope texel.
+			glm::vec4 sample_reference(const uint32_t cascade, const float x, const float z, const float time, glm::vec4* slopes = NULL) const;
+		public:
+			inline uint32_t get_cascade_count(void) const { return uint32_t(this->cascades_.size()); }
+			inline uint32_t get_resolution(void) const { return this->settings_.resolution; }
+			inline float get_tile_length(const uint32_t cascade) const { return this->cascades_[cascade]->tile_length; }
+			/// false until the first simulation was published
+			inline bool has_maps(void) const { return this->stats_.completed > 0; }
+			inline const ocean_maps_t& get_maps(const uint32_t cascade) const { return this->cascades_[cascade]->maps[this->front_]; }
+			inline GLuint get_displacement_texture(const uint32_t cascade) const { return this->cascades_[cascade]->displacement_texture; }
+			inline GLuint get_slope_texture(const uint32_t cascade) const { return this->cascades_[cascade]->slope_texture; }
+			inline const ocean_stats_t& get_stats(void) const { return this->stats_; }
+		private:
+			/// the four field pairs packed into one inverse transform each
+			static constexpr uint32_t k_field_grids = 4;
+
+			struct cascade_t
+			{
+				float tile_length = 0.0f;
+				/// |k| range of this cascade
+				float k_min = 0.0f;
+				float k_max = 0.0f;
+				/// h0(k) and conj(h0(-k)) in wrapped index order, zero outside the band
+				std::vector<glm::vec2> h0;
+				std::vector<glm::vec2> h0_minus_conj;
+				std::vector<float> omega;
+				/// h(k, t)
+				std::vector<glm::vec2> spectrum;
+				complex_grid_t grids[k_field_grids];
+				ocean_maps_t maps[2];
+				/// written by the jobs, read once the simulation completed
+				double job_ms[k_field_grids + 2] = {};
+
+				Jobs::job_counter_t spectrum_counter;
+				Jobs::job_counter_t fft_counter;
+				GLuint displacement_texture = 0;
+				GLuint slope_texture = 0;
+			};
+		private:
+			void init_spectrum(cascade_t& cascade, const uint32_t index);
+			void evolve_spectrum(cascade_t& cascade, const float time);
+			void fill_grid(cascade_t& cascade, const uint32_t grid);
+			void assemble(cascade_t& cascade, ocean_maps_t& maps, const float time);
+			void simulate(cascade_t& cascade, const uint32_t buffer, const float time);
+			void kick(const float time);
+			void publish(void);
+			void upload(void);
+			void release(void);
+		private:
+			ocean_settings_t settings_;
+			Jobs::job_system_t* jobs_ = NULL;
+			ocean_stats_t stats_;
+			std::vector<std::unique_ptr<cascade_t>> cascades_;
+			/// maps[front_] is read, the simulation writes maps[front_ ^ 1]
+			uint32_t front_ = 0;
+			bool running_ = false;
+			bool textures_ = false;
+			Jobs::job_counter_t in_flight_;
+			std::chrono::high_resolution_clock::time_point kick_time_;
+		};
+
+	}
+
+}
+#endif
@@ -0,0 +1,232 @@
+#include "profiler.h"
+
+#if CONTINUUM_PROFILER
+
+#include "../file_io.h"
+
+#include <stdio.h>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+
+using namespace Continuum::Profiler;
+
+namespace {
+	struct registry_t
+	{
+		std::mutex mutex;
+		/// buffers outlive their threads so late exports still see them
+		std::vector<std::unique_ptr<thread_buffer_t>> buffers;
+		uint64_t epoch_ticks = now_ticks();
+		std::chrono::steady_clock::time_point epoch_time = std::chrono::steady_clock::now();
+		gpu_profiler_t* gpu = NULL;
+	};
+
+	registry_t& get_registry(void)
+	{
+		static registry_t registry;
+		return registry;
+	}
+}
+
+thread_buffer_t* Continuum::Profiler::register_thread(void)
+{
+	if (tls_buffer != NULL) return tls_buffer;
+
+	registry_t& registry = get_registry();
+	std::unique_ptr<thread_buffer_t> buffer = std::make_unique<thread_buffer_t>();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	buffer->thread_index = static_cast<uint32_t>(registry.buffers.size());
+	buffer->thread_name = "thread " + std::to_string(buffer->thread_index);
+	tls_buffer = buffer.get();
+	registry.buffers.push_back(std::move(buffer));
+	return tls_buffer;
+}
+
+void Continuum::Profiler::set_thread_name(const char* name)
+{
+	thread_buffer_t* buffer = register_thread();
+	std::lock_guard<std::mutex> lock(get_registry().mutex);
+	buffer->thread_name = name;
+}
+
+gpu_profiler_t::gpu_profiler_t(const uint32_t max_scopes_per_frame, const size_t max_events)
+	: max_scopes_(max_scopes_per_frame), max_events_(max_events)
+{
+	for (frame_t& frame : this->frames_)
+	{
+		frame.queries.resize(size_t(max_scopes_per_frame) * 2);
+		frame.names.resize(max_scopes_per_frame);
+		glGenQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+	}
+	this->events_.reserve(max_events);
+}
+
+gpu_profiler_t::~gpu_profiler_t()
+{
+	for (frame_t& frame : this->frames_)
+	{
+		glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+	}
+}
+
+void gpu_profiler_t::begin_frame(void)
+{
+	this->current_ ^= 1;
+	frame_t& frame = this->frames_[this->current_];
+	if (frame.pending) resolve(frame);
+
+	// pair a CPU tick with the GPU clock so the timestamps land on the CPU timeline
+	frame.count = 0;
+	frame.pending = false;
+	frame.reference_ticks = now_ticks();
+	glGetInteger64v(GL_TIMESTAMP, &frame.reference_gpu_ns);
+	++this->stats_.frames;
+}
+
+void gpu_profiler_t::resolve(frame_t& frame)
+{
+	// timestamps complete in order, the last query being ready means the whole frame is
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.count * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		++this->stats_.dropped_frames;
+		return;
+	}
+
+	for (uint32_t i = 0; i < frame.count; ++i)
+	{
+		GLuint64 begin = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+		const gpu_event_t event = { frame.names[i], frame.reference_ticks,
+			static_cast<int64_t>(begin) - frame.reference_gpu_ns, static_cast<int64_t>(end) - frame.reference_gpu_ns };
+		if (this->events_.size() < this->max_events_)
+		{
+			this->events_.push_back(event);
+		}
+		else
+		{
+			this->events_[this->event_start_] = event;
+			this->event_start_ = (this->event_start_ + 1) % this->max_events_;
+		}
+	}
+	++this->stats_.resolved_frames;
+}
+
+uint32_t gpu_profiler_t::begin_scope(const char* name)
+{
+	frame_t& frame = this->frames_[this->current_];
+	if (frame.count == this->max_scopes_)
+	{
+		++this->stats_.overflowed_scopes;
+		return UINT32_MAX;
+	}
+
+	const uint32_t scope = frame.count++;
+	frame.names[scope] = name;
+	frame.pending = true;
+	glQueryCounter(frame.queries[scope * 2], GL_TIMESTAMP);
+	// until end_scope() the end query mirrors the begin so an unbalanced scope still resolves
+	glQueryCounter(frame.queries[scope * 2 + 1], GL_TIMESTAMP);
+	return scope;
+}
+
+void gpu_profiler_t::end_scope(const uint32_t scope)
+{
+	if (scope == UINT32_MAX) return;
+	glQueryCounter(this->frames_[this->current_].queries[scope * 2 + 1], GL_TIMESTAMP);
+}
+
+void Continuum::Profiler::init_gpu(void)
+{
+	registry_t& registry = get_registry();
+	if (registry.gpu == NULL) registry.gpu = new gpu_profiler_t();
+}
+
+void Continuum::Profiler::shutdown_gpu(void)
+{
+	registry_t& registry = get_registry();
+	delete registry.gpu;
+	registry.gpu = NULL;
+}
+
+gpu_profiler_t* Continuum::Profiler::get_gpu(void)
+{
+	return get_registry().gpu;
+}
+
+int64_t Continuum::Profiler::write_chrome_trace(const char* path)
+{
+	registry_t& registry = get_registry();
+
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) return -1;
+
+	// calibrate ticks against the steady clock over the whole run
+	const uint64_t ticks_now = now_ticks();
+	const double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - registry.epoch_time).count();
+	const double ns_per_tick = ticks_now > registry.epoch_ticks ? elapsed_ns / double(ticks_now - registry.epoch_ticks) : 1.0;
+	const auto to_us = [&](const uint64_t ticks) { return double(int64_t(ticks - registry.epoch_ticks)) * ns_per_tick / 1000.0; };
+
+	int64_t written = 0;
+	std::vector<cpu_event_t> events;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (const std::unique_ptr<thread_buffer_t>& buffer : registry.buffers)
+	{
+		const uint64_t capacity = thread_buffer_t::k_capacity;
+		const uint64_t end = buffer->write_index.load(std::memory_order_acquire);
+		const uint64_t begin = end > capacity ? end - capacity : 0;
+		events.clear();
+		for (uint64_t i = begin; i < end; ++i) events.push_back(buffer->events[i & (capacity - 1)]);
+
+		// anything the owner wrote since may have replaced the oldest entries, including the slot being written now
+		const uint64_t end_after = buffer->write_index.load(std::memory_order_acquire);
+		const uint64_t valid_begin = end_after >= capacity ? end_after - capacity + 1 : 0;
+		const size_t skip = valid_begin > begin ? static_cast<size_t>(std::min(valid_begin - begin, end - begin)) : 0;
+
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", written > 0 ? ",\n" : "", buffer->thread_index);
+		FileIO::write_json_string(file, buffer->thread_name.c_str());
+		fprintf(file, "}}");
+		++written;
+
+		for (size_t i = skip; i < events.size(); ++i)
+		{
+			fprintf(file, ",\n{\"name\":");
+			FileIO::write_json_string(file, events[i].name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				buffer->thread_index, to_us(events[i].begin), double(events[i].end - events[i].begin) * ns_per_tick / 1000.0);
+			++written;
+		}
+	}
+
+	if (registry.gpu != NULL)
+	{
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}", written > 0 ? ",\n" : "");
+		++written;
+
+		const std::vector<gpu_event_t>& gpu_events = registry.gpu->get_events();
+		for (size_t n = 0; n < gpu_events.size(); ++n)
+		{
+			const gpu_event_t& event = gpu_events[(registry.gpu->get_event_start() + n) % gpu_events.size()];
+			fprintf(file, ",\n{\"name\":");
+			FileIO::write_json_string(file, event.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+				to_us(event.reference_ticks) + double(event.begin_ns) / 1000.0, double(event.end_ns - event.begin_ns) / 1000.0);
+			++written;
+		}
+	}
+	fprintf(file, "\n]}\n");
+
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok ? written : -1;
+}
+
+#endif
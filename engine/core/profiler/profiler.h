@@ -0,0 +1,194 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Set by the CONTINUUM_ENABLE_PROFILER CMake option; when 0 every CONTINUUM_PROFILE_* macro expands to nothing.
+#ifndef CONTINUUM_PROFILER
+#define CONTINUUM_PROFILER 0
+#endif
+
+#if CONTINUUM_PROFILER
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <string>
+
+#include "../simd.h"
+
+#if CONTINUUM_SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <chrono>
+#endif
+
+namespace Continuum {
+
+	namespace Profiler {
+
+		/// raw timestamp, TSC ticks on x86 and nanoseconds elsewhere; converted when exporting
+		inline uint64_t now_ticks(void)
+		{
+#if CONTINUUM_SIMD_X86
+			return __rdtsc();
+#else
+			return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+		}
+
+		struct cpu_event_t
+		{
+			const char* name;
+			uint64_t begin;
+			uint64_t end;
+		};
+
+		/// single-producer ring owned by one thread; the exporter copies the published range and discards
+		/// whatever the owner overwrote meanwhile, so recording never takes a lock
+		struct thread_buffer_t
+		{
+			static constexpr uint64_t k_capacity = 1 << 16;
+
+			cpu_event_t events[k_capacity];
+			std::atomic<uint64_t> write_index = 0;
+			uint32_t thread_index = 0;
+			std::string thread_name;
+		};
+
+		/// registers the calling thread's buffer (once, under a lock)
+		thread_buffer_t* register_thread(void);
+		void set_thread_name(const char* name);
+
+		inline thread_local thread_buffer_t* tls_buffer = NULL;
+
+		inline void record(const char* name, const uint64_t begin, const uint64_t end)
+		{
+			thread_buffer_t* buffer = tls_buffer != NULL ? tls_buffer : register_thread();
+			const uint64_t index = buffer->write_index.load(std::memory_order_relaxed);
+			buffer->events[index & (thread_buffer_t::k_capacity - 1)] = { name, begin, end };
+			buffer->write_index.store(index + 1, std::memory_order_release);
+		}
+
+		/// name must outlive the export, in practice a string literal
+		struct cpu_scope_t
+		{
+		public:
+			inline explicit cpu_scope_t(const char* name) : name_(name), begin_(now_ticks()) {}
+			inline ~cpu_scope_t() { record(this->name_, this->begin_, now_ticks()); }
+			cpu_scope_t(const cpu_scope_t&) = delete;
+			cpu_scope_t& operator=(const cpu_scope_t&) = delete;
+		private:
+			const char* name_;
+			uint64_t begin_;
+		};
+
+		struct gpu_event_t
+		{
+			const char* name;
+			/// CPU tick of the frame reference point and GPU nanoseconds relative to it
+			uint64_t reference_ticks;
+			int64_t begin_ns;
+			int64_t end_ns;
+		};
+
+		struct gpu_profiler_stats_t
+		{
+			uint64_t frames = 0;
+			uint64_t resolved_frames = 0;
+			/// frames whose queries were still in flight when their buffer came around again
+			uint64_t dropped_frames = 0;
+			uint64_t overflowed_scopes = 0;
+		};
+
+		/// GL_TIMESTAMP queries, double-buffered: a frame's results are read two begin_frame() calls later and
+		/// only if they are already available, so the CPU never waits on the GPU
+		class gpu_profiler_t
+		{
+		public:
+			explicit gpu_profiler_t(const uint32_t max_scopes_per_frame = 64, const size_t max_events = 1 << 14);
+			~gpu_profiler_t();
+			gpu_profiler_t(const gpu_profiler_t&) = delete;
+			gpu_profiler_t& operator=(const gpu_profiler_t&) = delete;
+		public:
+			void begin_frame(void);
+			/// returns a scope id for end_scope(), UINT32_MAX when the frame ran out of queries
+			uint32_t begin_scope(const char* name);
+			void end_scope(const uint32_t scope);
+		public:
+			inline const std::vector<gpu_event_t>& get_events(void) const { return this->events_; }
+			inline size_t get_event_start(void) const { return this->event_start_; }
+			inline const gpu_profiler_stats_t& get_stats(void) const { return this->stats_; }
+		private:
+			struct frame_t
+			{
+				std::vector<GLuint> queries;
+				std::vector<const char*> names;
+				uint32_t count = 0;
+				bool pending = false;
+				uint64_t reference_ticks = 0;
+				GLint64 reference_gpu_ns = 0;
+			};
+			void resolve(frame_t& frame);
+		private:
+			frame_t frames_[2];
+			uint32_t current_ = 0;
+			uint32_t max_scopes_ = 0;
+			/// resolved events, used as a ring once max_events_ is reached
+			std::vector<gpu_event_t> events_;
+			size_t event_start_ = 0;
+			size_t max_events_ = 0;
+			gpu_profiler_stats_t stats_;
+		};
+
+		/// process-wide GPU profiler, created and destroyed with the GL context
+		void init_gpu(void);
+		void shutdown_gpu(void);
+		gpu_profiler_t* get_gpu(void);
+
+		struct gpu_scope_t
+		{
+		public:
+			inline explicit gpu_scope_t(const char* name) : profiler_(get_gpu()), scope_(profiler_ != NULL ? profiler_->begin_scope(name) : UINT32_MAX) {}
+			inline ~gpu_scope_t() { if (this->profiler_ != NULL) this->profiler_->end_scope(this->scope_); }
+			gpu_scope_t(const gpu_scope_t&) = delete;
+			gpu_scope_t& operator=(const gpu_scope_t&) = delete;
+		private:
+			gpu_profiler_t* profiler_;
+			uint32_t scope_;
+		};
+
+		/// writes every retained CPU and GPU event as Chrome/Perfetto trace JSON, returns the event count or -1
+		int64_t write_chrome_trace(const char* path);
+
+	}
+
+}
+
+#define CONTINUUM_PROFILE_CONCAT_INNER(a, b) a##b
+#define CONTINUUM_PROFILE_CONCAT(a, b) CONTINUUM_PROFILE_CONCAT_INNER(a, b)
+#define CONTINUUM_PROFILE_SCOPE(name) ::Continuum::Profiler::cpu_scope_t CONTINUUM_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define CONTINUUM_PROFILE_GPU_SCOPE(name) ::Continuum::Profiler::gpu_scope_t CONTINUUM_PROFILE_CONCAT(profile_gpu_scope_, __LINE__)(name)
+#define CONTINUUM_PROFILE_THREAD(name) ::Continuum::Profiler::set_thread_name(name)
+#define CONTINUUM_PROFILE_GPU_INIT() ::Continuum::Profiler::init_gpu()
+#define CONTINUUM_PROFILE_GPU_SHUTDOWN() ::Continuum::Profiler::shutdown_gpu()
+#define CONTINUUM_PROFILE_GPU_FRAME() do { if (::Continuum::Profiler::get_gpu() != NULL) ::Continuum::Profiler::get_gpu()->begin_frame(); } while (0)
+#define CONTINUUM_PROFILE_EXPORT(path) ::Continuum::Profiler::write_chrome_trace(path)
+
+#else
+
+#define CONTINUUM_PROFILE_SCOPE(name) ((void)0)
+#define CONTINUUM_PROFILE_GPU_SCOPE(name) ((void)0)
+#define CONTINUUM_PROFILE_THREAD(name) ((void)0)
+#define CONTINUUM_PROFILE_GPU_INIT() ((void)0)
+#define CONTINUUM_PROFILE_GPU_SHUTDOWN() ((void)0)
+#define CONTINUUM_PROFILE_GPU_FRAME() ((void)0)
+#define CONTINUUM_PROFILE_EXPORT(path) (int64_t(-1))
+
+#endif
+
+#endif
@@ -0,0 +1,129 @@
+#include "sim_thread.h"
+#include "../profiler/profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Continuum::Sim;
+
+sim_thread_t::sim_thread_t(const sim_thread_settings_t& settings, sim_tick_function_t tick) :
+	settings_(settings), tick_(std::move(tick))
+{
+	if (!(this->settings_.timestep > 0.0)) this->settings_.timestep = 1.0 / 60.0;
+}
+
+sim_thread_t::~sim_thread_t()
+{
+	stop();
+}
+
+void sim_thread_t::start(void)
+{
+	if (this->running_) return;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		this->stopping_ = false;
+	}
+	this->start_time_ = clock_t::now();
+	this->running_ = true;
+	this->thread_ = std::thread([this]() { thread_main(); });
+}
+
+void sim_thread_t::stop(void)
+{
+	if (!this->running_) return;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		this->stopping_ = true;
+	}
+	this->wake_cv_.notify_all();
+	this->done_cv_.notify_all();
+	this->thread_.join();
+	this->running_ = false;
+}
+
+void sim_thread_t::run_until(const uint64_t tick_count)
+{
+	if (!this->running_ || this->settings_.pacing != SimPacing::LOCKSTEP) return;
+	std::unique_lock<std::mutex> lock(this->mutex_);
+	this->target_ticks_ = std::max(this->target_ticks_, tick_count);
+	this->wake_cv_.notify_all();
+	this->done_cv_.wait(lock, [this, tick_count]() { return this->stopping_ || get_tick_count() >= tick_count; });
+}
+
+double sim_thread_t::get_interpolation(const uint64_t tick_count) const
+{
+	if (this->settings_.pacing == SimPacing::LOCKSTEP || !this->running_) return 1.0;
+	// the state after tick_count ticks belongs to clock tick_count, the renderer shows clock - 1
+	return std::clamp(get_clock_ticks() - double(tick_count), 0.0, 1.0);
+}
+
+sim_thread_stats_t sim_thread_t::get_stats(void) const
+{
+	sim_thread_stats_t stats;
+	stats.ticks = get_tick_count();
+	stats.dropped_ticks = this->dropped_ticks_.load(std::memory_order_relaxed);
+	stats.average_tick_ms = stats.ticks > 0 ? double(this->total_tick_ns_.load(std::memory_order_relaxed)) / double(stats.ticks) * 1e-6 : 0.0;
+	stats.max_tick_ms = double(this->max_tick_ns_.load(std::memory_order_relaxed)) * 1e-6;
+	return stats;
+}
+
+double sim_thread_t::get_clock_ticks(void) const
+{
+	const double elapsed = std::chrono::duration<double>(clock_t::now() - this->start_time_).count();
+	return elapsed / this->settings_.timestep - double(this->dropped_ticks_.load(std::memory_order_relaxed));
+}
+
+void sim_thread_t::run_tick(void)
+{
+	CONTINUUM_PROFILE_SCOPE("sim_tick");
+	const clock_t::time_point t0 = clock_t::now();
+	this->tick_(get_tick_count(), this->settings_.timestep);
+	const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() - t0).count());
+
+	// only this thread writes the counters
+	this->total_tick_ns_.store(this->total_tick_ns_.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+	this->max_tick_ns_.store(std::max(this->max_tick_ns_.load(std::memory_order_relaxed), ns), std::memory_order_relaxed);
+	this->ticks_.fetch_add(1, std::memory_order_release);
+}
+
+void sim_thread_t::thread_main(void)
+{
+	CONTINUUM_PROFILE_THREAD("sim");
+
+	std::unique_lock<std::mutex> lock(this->mutex_);
+	while (!this->stopping_)
+	{
+		const uint64_t ticks = get_tick_count();
+		if (this->settings_.pacing == SimPacing::LOCKSTEP)
+		{
+			if (ticks >= this->target_ticks_)
+			{
+				this->wake_cv_.wait(lock);
+				continue;
+			}
+		}
+		else
+		{
+			const double due = std::floor(get_clock_ticks());
+			if (due < double(ticks + 1))
+			{
+				const double next_tick = double(ticks + 1 + this->dropped_ticks_.load(std::memory_order_relaxed)) * this->settings_.timestep;
+				this->wake_cv_.wait_until(lock, this->start_time_ + std::chrono::duration_cast<clock_t::duration>(std::chrono::duration<double>(next_tick)));
+				continue;
+			}
+			// after a stall keep max_catch_up_ticks of the backlog and drop the rest, instead of spiralling
+			const uint64_t behind = static_cast<uint64_t>(due) - ticks;
+			if (behind > this->settings_.max_catch_up_ticks)
+			{
+				this->dropped_ticks_.fetch_add(behind - this->settings_.max_catch_up_ticks, std::memory_order_relaxed);
+			}
+		}
+
+		// one tick per iteration, stop() never waits for more than the running tick
+		lock.unlock();
+		run_tick();
+		lock.lock();
+		this->done_cv_.notify_all();
+	}
+}
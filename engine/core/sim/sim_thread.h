@@ -0,0 +1,101 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Continuum {
+
+	namespace Sim {
+
+		namespace SimPacing {
+			enum SimPacingType
+			{
+				/// ticks follow the wall clock, the renderer interpolates between the last two
+				REALTIME = 0,
+				/// ticks run only when run_until() asks for them, replays and headless runs stay deterministic
+				LOCKSTEP = 1
+			};
+		}
+
+		struct sim_thread_settings_t
+		{
+			/// seconds per tick
+			double timestep = 1.0 / 60.0;
+			SimPacing::SimPacingType pacing = SimPacing::REALTIME;
+			/// REALTIME: ticks run back to back after a stall before the rest of the lost time is dropped
+			uint32_t max_catch_up_ticks = 8;
+		};
+
+		struct sim_thread_stats_t
+		{
+			uint64_t ticks = 0;
+			/// REALTIME ticks skipped because the thread fell further behind than max_catch_up_ticks
+			uint64_t dropped_ticks = 0;
+			double average_tick_ms = 0.0;
+			double max_tick_ms = 0.0;
+		};
+
+		/// tick is the index of the tick being run, timestep the settings' one
+		using sim_tick_function_t = std::function<void(uint64_t tick, double timestep)>;
+
+		/// Runs a tick function at a fixed timestep on its own thread. Tick k advances the simulation from
+		/// k * timestep to (k + 1) * timestep; under REALTIME pacing it runs once the clock passed its end.
+		/// The tick function owns the simulation state and hands it to other threads itself, typically
+		/// through a triple_buffer_t.
+		struct sim_thread_t
+		{
+			sim_thread_t(const sim_thread_settings_t& settings, sim_tick_function_t tick);
+			~sim_thread_t();
+			sim_thread_t(const sim_thread_t&) = delete;
+			sim_thread_t& operator=(const sim_thread_t&) = delete;
+		public:
+			void start(void);
+			/// finishes the running tick, if any, and joins the thread
+			void stop(void);
+			/// LOCKSTEP: runs the ticks up to tick_count on the simulation thread and waits for them
+			void run_until(const uint64_t tick_count);
+			/// How far the renderer is between the state after tick_count - 1 ticks and the one after tick_count,
+			/// in [0, 1]. REALTIME renders one tick behind the clock so that both states exist, LOCKSTEP always
+			/// renders the latest state.
+			double get_interpolation(const uint64_t tick_count) const;
+		public:
+			inline const sim_thread_settings_t& get_settings(void) const { return this->settings_; }
+			inline uint64_t get_tick_count(void) const { return this->ticks_.load(std::memory_order_acquire); }
+			sim_thread_stats_t get_stats(void) const;
+		private:
+			using clock_t = std::chrono::steady_clock;
+
+			void thread_main(void);
+			void run_tick(void);
+			/// REALTIME: ticks the clock asks for, in ticks since start() minus the dropped ones
+			double get_clock_ticks(void) const;
+		private:
+			sim_thread_settings_t settings_;
+			sim_tick_function_t tick_;
+			std::thread thread_;
+			bool running_ = false;
+			clock_t::time_point start_time_;
+
+			std::mutex mutex_;
+			std::condition_variable wake_cv_;
+			std::condition_variable done_cv_;
+			/// guarded by mutex_
+			bool stopping_ = false;
+			uint64_t target_ticks_ = 0;
+
+			std::atomic<uint64_t> ticks_ = 0;
+			std::atomic<uint64_t> dropped_ticks_ = 0;
+			std::atomic<uint64_t> total_tick_ns_ = 0;
+			std::atomic<uint64_t> max_tick_ns_ = 0;
+		};
+
+	}
+
+}
+#endif
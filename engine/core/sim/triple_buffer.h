@@ -0,0 +1,50 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stdint.h>
+#include <atomic>
+
+namespace Continuum {
+
+	namespace Sim {
+
+		/// Lock-free handoff of the latest value from one writer thread to one reader thread. The writer fills
+		/// get_back() and publish()es it, the reader acquire()s the newest published value into get_front().
+		/// Neither side ever waits: the three slots are swapped through one atomic index, values the reader
+		/// did not pick up in time are overwritten.
+		template<typename T>
+		struct triple_buffer_t
+		{
+			triple_buffer_t() = default;
+			triple_buffer_t(const triple_buffer_t&) = delete;
+			triple_buffer_t& operator=(const triple_buffer_t&) = delete;
+		public:
+			/// writer side; the slot holds whatever was published three publishes ago, overwrite all of it
+			inline T& get_back(void) { return this->slots_[this->back_]; }
+			inline void publish(void)
+			{
+				this->back_ = this->middle_.exchange(this->back_ | k_fresh, std::memory_order_acq_rel) & k_index;
+			}
+			/// reader side; false, and get_front() unchanged, when nothing was published since the last acquire()
+			inline bool acquire(void)
+			{
+				if ((this->middle_.load(std::memory_order_relaxed) & k_fresh) == 0) return false;
+				this->front_ = this->middle_.exchange(this->front_, std::memory_order_acq_rel) & k_index;
+				return true;
+			}
+			inline const T& get_front(void) const { return this->slots_[this->front_]; }
+		private:
+			static constexpr uint32_t k_index = 3;
+			static constexpr uint32_t k_fresh = 4;
+
+			T slots_[3] = {};
+			/// each index is owned by one side, kept on separate cache lines so that they do not share one
+			alignas(64) uint32_t back_ = 0;
+			alignas(64) std::atomic<uint32_t> middle_ = 1;
+			alignas(64) uint32_t front_ = 2;
+		};
+
+	}
+
+}
+#endif
@@ -0,0 +1,60 @@
+#include "simd.h"
+
+#if CONTINUUM_SIMD_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+using namespace Continuum;
+
+static Simd::SimdLevel query_level(void)
+{
+#if CONTINUUM_SIMD_X86 && defined(_MSC_VER)
+	int info[4] = {};
+	__cpuid(info, 0);
+	const int max_leaf = info[0];
+
+	__cpuid(info, 1);
+	const bool sse42 = (info[2] & (1 << 20)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	// the OS has to save the ymm registers on context switches
+	const bool ymm_enabled = osxsave && ((_xgetbv(0) & 0x6) == 0x6);
+
+	bool avx2 = false;
+	if (max_leaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	if (avx && avx2 && ymm_enabled) return Simd::SimdLevel::AVX2;
+	if (sse42) return Simd::SimdLevel::SSE42;
+	return Simd::SimdLevel::SCALAR;
+#elif CONTINUUM_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return Simd::SimdLevel::AVX2;
+	if (__builtin_cpu_supports("sse4.2")) return Simd::SimdLevel::SSE42;
+	return Simd::SimdLevel::SCALAR;
+#else
+	return Simd::SimdLevel::SCALAR;
+#endif
+}
+
+Simd::SimdLevel Simd::detect(void)
+{
+	static const SimdLevel level = query_level();
+	return level;
+}
+
+const char* Simd::get_level_name(const SimdLevel level)
+{
+	switch (level) {
+	case SimdLevel::AVX2:
+		return "avx2";
+	case SimdLevel::SSE42:
+		return "sse4.2";
+	default:
+		return "scalar";
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CONTINUUM_SIMD_X86 1
+#else
+#define CONTINUUM_SIMD_X86 0
+#endif
+
+namespace Continuum {
+
+	namespace Simd {
+		enum SimdLevel
+		{
+			SCALAR = 0,
+			SSE42 = 1,
+			AVX2 = 2
+		};
+
+		/// highest instruction set supported by both the CPU and the OS, queried once
+		SimdLevel detect(void);
+		const char* get_level_name(const SimdLevel level);
+	}
+
+}
+#endif
@@ -0,0 +1,105 @@
+#ifndef CUBE_SPHERE_H
+#define CUBE_SPHERE_H
+
+#include <stdint.h>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+namespace Continuum {
+
+	namespace Terrain {
+
+		namespace CubeFace {
+			enum CubeFaceType : uint8_t
+			{
+				POS_X = 0,
+				NEG_X = 1,
+				POS_Y = 2,
+				NEG_Y = 3,
+				POS_Z = 4,
+				NEG_Z = 5,
+				COUNT = 6
+			};
+		}
+
+		/// (face, level, x, y) address of a quadtree patch; x and y are in [0, 2^level)
+		struct patch_key_t
+		{
+			uint8_t face = 0;
+			uint8_t level = 0;
+			uint32_t x = 0;
+			uint32_t y = 0;
+		public:
+			inline uint64_t packed(void) const
+			{
+				return (uint64_t(face) << 61) | (uint64_t(level) << 56) | (uint64_t(y) << 28) | uint64_t(x);
+			}
+			inline bool operator == (const patch_key_t& o) const { return packed() == o.packed(); }
+			inline bool operator != (const patch_key_t& o) const { return packed() != o.packed(); }
+		};
+
+		struct CubeSphere {
+
+			/// maps face-local coordinates in [-1, 1]^2 onto the cube surface
+			static inline glm::vec3 face_to_cube(const uint8_t face, const float u, const float v)
+			{
+				switch (face) {
+				case CubeFace::POS_X: return glm::vec3(1.0f, v, -u);
+				case CubeFace::NEG_X: return glm::vec3(-1.0f, v, u);
+				case CubeFace::POS_Y: return glm::vec3(u, 1.0f, -v);
+				case CubeFace::NEG_Y: return glm::vec3(u, -1.0f, v);
+				case CubeFace::POS_Z: return glm::vec3(u, v, 1.0f);
+				default:              return glm::vec3(-u, v, -1.0f);
+				}
+			}
+
+			/// inverse of face_to_cube for any non-zero direction; returns the face and writes u, v in [-1, 1]
+			static inline uint8_t cube_to_face(const glm::vec3& p, float& u, float& v)
+			{
+				const glm::vec3 a = glm::vec3(std::fabs(p.x), std::fabs(p.y), std::fabs(p.z));
+				if (a.x >= a.y && a.x >= a.z)
+				{
+					if (p.x > 0.0f) { u = -p.z / a.x; v = p.y / a.x; return CubeFace::POS_X; }
+					u = p.z / a.x; v = p.y / a.x; return CubeFace::NEG_X;
+				}
+				if (a.y >= a.z)
+				{
+					if (p.y > 0.0f) { u = p.x / a.y; v = -p.z / a.y; return CubeFace::POS_Y; }
+					u = p.x / a.y; v = p.z / a.y; return CubeFace::NEG_Y;
+				}
+				if (p.z > 0.0f) { u = p.x / a.z; v = p.y / a.z; return CubeFace::POS_Z; }
+				u = -p.x / a.z; v = p.y / a.z; return CubeFace::NEG_Z;
+			}
+
+			/// area-preserving-ish cube to sphere warp, keeps patches close to equal size at the face corners
+			static inline glm::vec3 cube_to_sphere(const glm::vec3& p)
+			{
+				const glm::vec3 p2 = p * p;
+				return glm::vec3(
+					p.x * std::sqrt(1.0f - 0.5f * (p2.y + p2.z) + p2.y * p2.z / 3.0f),
+					p.y * std::sqrt(1.0f - 0.5f * (p2.z + p2.x) + p2.z * p2.x / 3.0f),
+					p.z * std::sqrt(1.0f - 0.5f * (p2.x + p2.y) + p2.x * p2.y / 3.0f)
+				);
+			}
+
+			static inline glm::vec3 face_to_sphere(const uint8_t face, const float u, const float v)
+			{
+				return cube_to_sphere(face_to_cube(face, u, v));
+			}
+
+			/// face-local [-1, 1] bounds of a patch
+			static inline void patch_bounds(const patch_key_t& key, float& u0, float& v0, float& u1, float& v1)
+			{
+				const float size = 2.0f / float(1u << key.level);
+				u0 = -1.0f + size * float(key.x);
+				v0 = -1.0f + size * float(key.y);
+				u1 = u0 + size;
+				v1 = v0 + size;
+			}
+		};
+
+	}
+
+}
+#endif
@@ -0,0 +1,71 @@
+#include "heightfield.h"
+
+#include "../hash.h"
+
+#include <algorithm>
+
+using namespace Continuum;
+using namespace Continuum::Terrain;
+
+uint64_t heightfield_settings_t::hash(void) const
+{
+	// hashed field by field, padding bytes must not leak into the key
+	const uint32_t fields[] = {
+		static_cast<uint32_t>(this->noise.type), this->noise.seed, this->noise.octaves, this->resolution
+	};
+	const float values[] = {
+		this->noise.frequency, this->noise.lacunarity, this->noise.gain, this->noise.ridge_offset, this->planet_radius, this->max_height
+	};
+	const uint64_t h = Hash::fnv1a_64(fields, sizeof(fields), Hash::k_fnv1a_offset);
+	return Hash::fnv1a_64(values, sizeof(values), h);
+}
+
+glm::vec3 Terrain::sample_direction(const patch_key_t& key, const uint32_t resolution, const int32_t i, const int32_t j)
+{
+	float u0 = 0.0f, v0 = 0.0f, u1 = 0.0f, v1 = 0.0f;
+	CubeSphere::patch_bounds(key, u0, v0, u1, v1);
+	const float step = 1.0f / float(std::max<uint32_t>(resolution, 2) - 1);
+	// written so that t = 1 lands exactly on u1, the u0 of the next patch: both patches sample their shared edge
+	// at the same direction (u0 + (u1 - u0) * t can miss u1 by an ulp)
+	const float s = float(i) * step;
+	const float t = float(j) * step;
+	const float u = u0 * (1.0f - s) + u1 * s;
+	const float v = v0 * (1.0f - t) + v1 * t;
+	return glm::normalize(CubeSphere::face_to_sphere(key.face, u, v));
+}
+
+void Terrain::generate_heightfield(const heightfield_settings_t& settings, const patch_key_t& key, heightfield_tile_t& tile)
+{
+	const uint32_t resolution = std::max<uint32_t>(settings.resolution, 2);
+	const size_t count = size_t(resolution) * resolution;
+
+	Noise::point_grid_t points;
+	points.resize(count);
+	for (uint32_t j = 0; j < resolution; ++j)
+	{
+		for (uint32_t i = 0; i < resolution; ++i)
+		{
+			const glm::vec3 dir = sample_direction(key, resolution, int32_t(i), int32_t(j));
+			const size_t index = size_t(j) * resolution + i;
+			points.x[index] = dir.x;
+			points.y[index] = dir.y;
+			points.z[index] = dir.z;
+		}
+	}
+
+	tile.key = key;
+	tile.resolution = resolution;
+	tile.heights.resize(count);
+	Noise::evaluate(settings.noise, points, tile.heights.data());
+
+	float lo = settings.max_height;
+	float hi = 0.0f;
+	for (float& h : tile.heights)
+	{
+		h = settings.to_height(h);
+		lo = std::min(lo, h);
+		hi = std::max(hi, h);
+	}
+	tile.min_height = lo;
+	tile.max_height = hi;
+}
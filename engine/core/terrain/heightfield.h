@@ -0,0 +1,52 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <vector>
+
+#include "cube_sphere.h"
+#include "../noise/noise.h"
+
+namespace Continuum {
+
+	namespace Terrain {
+
+		struct heightfield_settings_t
+		{
+			Noise::noise_params_t noise = {};
+			float planet_radius = 6360000.0f;
+			/// noise in [-1, 1] maps onto [0, max_height] above the planet radius
+			float max_height = 9000.0f;
+			/// samples per patch edge, quadtree_settings_t::patch_resolution + 1
+			uint32_t resolution = 33;
+		public:
+			/// identifies the generated data, tiles cached under other settings are rejected
+			uint64_t hash(void) const;
+			inline float to_height(const float noise) const { return std::clamp(noise * 0.5f + 0.5f, 0.0f, 1.0f) * this->max_height; }
+		};
+
+		/// heights in metres above the planet radius on a resolution x resolution grid spanning the patch
+		struct heightfield_tile_t
+		{
+			patch_key_t key = {};
+			uint32_t resolution = 0;
+			float min_height = 0.0f;
+			float max_height = 0.0f;
+			std::vector<float> heights;
+		public:
+			inline size_t get_bytes(void) const { return sizeof(heightfield_tile_t) + this->heights.capacity() * sizeof(float); }
+		};
+
+		/// unit-sphere direction of grid sample (i, j) of a patch, the generators' shared parametrisation;
+		/// -1 and resolution reach one sample into the neighbours
+		glm::vec3 sample_direction(const patch_key_t& key, const uint32_t resolution, const int32_t i, const int32_t j);
+
+		/// CPU reference generator, evaluates the noise on the patch grid through the SIMD kernels
+		void generate_heightfield(const heightfield_settings_t& settings, const patch_key_t& key, heightfield_tile_t& tile);
+
+	}
+
+}
+#endif
@@ -0,0 +1,434 @@
+#include "patch_generator.h"
+#include "vertex_packing.h"
+
+#include "../noise/noise_kernels.h"
+#include "../profiler/profiler.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace Continuum;
+using namespace Continuum::Terrain;
+using namespace Continuum::Graphics::UniformLiterals;
+
+namespace PatchGeneratorDetail
+{
+	/// work group edge of patch_generate.cs
+	static constexpr uint32_t k_group_size = 8;
+	static constexpr GLuint k_params_binding = 3;
+	static constexpr GLuint k_jobs_binding = 4;
+	static constexpr GLuint k_vertices_binding = 5;
+	static constexpr GLuint k_heights_binding = 6;
+	static constexpr GLuint k_ranges_binding = 7;
+}
+
+static glm::vec3 patch_origin_direction(const heightfield_settings_t& settings, const patch_key_t& key)
+{
+	const uint32_t resolution = std::max<uint32_t>(settings.resolution, 2);
+	const int32_t mid = int32_t(resolution / 2);
+	return sample_direction(key, resolution, mid, mid);
+}
+
+gpu_noise_params_t Terrain::make_gpu_noise_params(const heightfield_settings_t& settings)
+{
+	// the octave table is built exactly as the CPU kernels build it
+	const Noise::Detail::octave_table_t octaves = Noise::Detail::make_octave_table(settings.noise);
+	static_assert(Noise::Detail::octave_table_t::k_max_octaves == gpu_noise_params_t::k_max_octaves, "NoiseParams holds the whole octave table");
+
+	gpu_noise_params_t params = {};
+	params.octave_count = octaves.count;
+	params.noise_type = static_cast<uint32_t>(settings.noise.type);
+	params.ridge_offset = settings.noise.ridge_offset;
+	params.normalization = octaves.normalization;
+	params.planet_radius = settings.planet_radius;
+	params.max_height = settings.max_height;
+	params.resolution = std::max<uint32_t>(settings.resolution, 2);
+	for (uint32_t o = 0; o < octaves.count; ++o)
+	{
+		params.frequency[o] = octaves.frequency[o];
+		params.amplitude[o] = octaves.amplitude[o];
+		params.seed[o] = octaves.seed[o];
+	}
+	return params;
+}
+
+Graphics::shader_permutation_t Terrain::make_noise_permutation(const heightfield_settings_t& settings)
+{
+	const gpu_noise_params_t params = make_gpu_noise_params(settings);
+	Graphics::shader_permutation_t permutation;
+	permutation.define("NOISE_TYPE", params.noise_type);
+	permutation.define("OCTAVE_COUNT", params.octave_count);
+	return permutation;
+}
+
+glm::dvec3 Terrain::patch_origin(const heightfield_settings_t& settings, const patch_key_t& key)
+{
+	return glm::dvec3(patch_origin_direction(settings, key)) * double(settings.planet_radius);
+}
+
+void Terrain::build_patch_vertices(const heightfield_settings_t& settings, const patch_key_t& key, terrain_vertex_t* vertices)
+{
+	const uint32_t resolution = std::max<uint32_t>(settings.resolution, 2);
+	const uint32_t border = resolution + 2;
+	const size_t count = size_t(border) * border;
+
+	Noise::point_grid_t points;
+	points.resize(count);
+	std::vector<glm::vec3> directions(count);
+	for (uint32_t j = 0; j < border; ++j)
+	{
+		for (uint32_t i = 0; i < border; ++i)
+		{
+			const size_t index = size_t(j) * border + i;
+			directions[index] = sample_direction(key, resolution, int32_t(i) - 1, int32_t(j) - 1);
+			points.x[index] = directions[index].x;
+			points.y[index] = directions[index].y;
+			points.z[index] = directions[index].z;
+		}
+	}
+
+	std::vector<float> heights(count);
+	Noise::evaluate(settings.noise, points, heights.data());
+
+	// the direction difference is small and exact enough, scaling the radius first would round to half a metre
+	const glm::vec3 origin_direction = patch_origin_direction(settings, key);
+	std::vector<glm::vec3> positions(count);
+	for (size_t index = 0; index < count; ++index)
+	{
+		heights[index] = settings.to_height(heights[index]);
+		positions[index] = (directions[index] - origin_direction) * settings.planet_radius + directions[index] * heights[index];
+	}
+
+	for (uint32_t j = 0; j < resolution; ++j)
+	{
+		for (uint32_t i = 0; i < resolution; ++i)
+		{
+			const size_t c = size_t(j + 1) * border + (i + 1);
+			const glm::vec3 du = positions[c + 1] - positions[c - 1];
+			const glm::vec3 dv = positions[c + border] - positions[c - border];
+			const glm::vec3 n = glm::normalize(glm::cross(du, dv));
+
+			terrain_vertex_t& v = vertices[size_t(j) * resolution + i];
+			v.position[0] = positions[c].x;
+			v.position[1] = positions[c].y;
+			v.position[2] = positions[c].z;
+			v.height = heights[c];
+			v.normal[0] = n.x;
+			v.normal[1] = n.y;
+			v.normal[2] = n.z;
+			v.reserved = 0.0f;
+		}
+	}
+}
+
+void Terrain::pack_patch_vertices(const heightfield_settings_t& settings, const terrain_vertex_t* vertices, packed_terrain_vertex_t* packed)
+{
+	const uint32_t resolution = std::max<uint32_t>(settings.resolution, 2);
+	const uint32_t count = resolution * resolution;
+	packed_patch_header_t header = {};
+	float max_height = vertices[0].height;
+	header.min_height = max_height;
+	for (uint32_t v = 1; v < count; ++v)
+	{
+		header.min_height = std::min(header.min_height, vertices[v].height);
+		max_height = std::max(max_height, vertices[v].height);
+	}
+	header.height_step = VertexPacking::height_step(header.min_height, max_height);
+	std::memcpy(packed, &header, sizeof(header));
+
+	const float edge_step = VertexPacking::height_step(0.0f, settings.max_height);
+	packed_terrain_vertex_t* out = packed + packed_patch_header_t::k_vertices;
+	for (uint32_t v = 0; v < count; ++v)
+	{
+		const bool edge = VertexPacking::is_edge_vertex(v % resolution, v / resolution, resolution);
+		out[v].height = edge ? VertexPacking::quantize_height(vertices[v].height, 0.0f, edge_step)
+			: VertexPacking::quantize_height(vertices[v].height, header.min_height, header.height_step);
+		VertexPacking::oct_encode(glm::vec3(vertices[v].normal[0], vertices[v].normal[1], vertices[v].normal[2]), out[v].normal);
+	}
+}
+
+float Terrain::unpack_patch_height(const heightfield_settings_t& settings, const packed_terrain_vertex_t* packed, const uint32_t i, const uint32_t j)
+{
+	const uint32_t resolution = std::max<uint32_t>(settings.resolution, 2);
+	packed_patch_header_t header = {};
+	std::memcpy(&header, packed, sizeof(header));
+	const uint16_t quantized = packed[packed_patch_header_t::k_vertices + size_t(j) * resolution + i].height;
+	if (VertexPacking::is_edge_vertex(i, j, resolution)) return VertexPacking::dequantize_height(quantized, 0.0f, VertexPacking::height_step(0.0f, settings.max_height));
+	return VertexPacking::dequantize_height(quantized, header.min_height, header.height_step);
+}
+
+glm::vec3 Terrain::unpack_patch_position(const heightfield_settings_t& settings, const patch_key_t& key, const uint32_t i, const uint32_t j, const float height)
+{
+	const uint32_t resolution = std::max<uint32_t>(settings.resolution, 2);
+	const glm::vec3 direction = sample_direction(key, resolution, int32_t(i), int32_t(j));
+	return (direction - patch_origin_direction(settings, key)) * settings.planet_radius + direction * height;
+}
+
+patch_generator_t::patch_generator_t(const heightfield_settings_t& settings, Graphics::buffer_suballocator_t& buffers, Jobs::job_system_t* jobs,
+	const PatchVertexFormat::PatchVertexFormatType format) :
+	settings_(settings), buffers_(buffers), jobs_(jobs), format_(format)
+{
+	this->settings_.resolution = std::max<uint32_t>(this->settings_.resolution, 2);
+}
+
+patch_generator_t::~patch_generator_t()
+{
+	release_gpu();
+}
+
+void patch_generator_t::release_gpu(void)
+{
+	if (this->params_buffer_ != 0) glDeleteBuffers(1, &this->params_buffer_);
+	if (this->jobs_buffer_ != 0) glDeleteBuffers(1, &this->jobs_buffer_);
+	if (this->heights_buffer_ != 0) glDeleteBuffers(1, &this->heights_buffer_);
+	if (this->ranges_buffer_ != 0) glDeleteBuffers(1, &this->ranges_buffer_);
+	this->params_buffer_ = 0;
+	this->jobs_buffer_ = 0;
+	this->jobs_capacity_ = 0;
+	this->heights_buffer_ = 0;
+	this->ranges_buffer_ = 0;
+	this->scratch_capacity_ = 0;
+	this->program_.reset();
+	if (this->backend_ == PatchBackend::GPU) this->backend_ = PatchBackend::CPU;
+}
+
+bool patch_generator_t::init_gpu(const std::string& shader_root)
+{
+	release_gpu();
+
+	auto program = std::make_unique<Graphics::glsl_program_t>();
+	try
+	{
+		const char* shader = this->format_ == PatchVertexFormat::PACKED ? "/terrain/patch_generate_packed.cs" : "/terrain/patch_generate.cs";
+		program->compile_shader((shader_root + shader).c_str(), make_noise_permutation(this->settings_));
+		program->link();
+	}
+	catch (const Graphics::GLSLProgramException& e)
+	{
+		fprintf(stderr, "Terrain: compute patch generator unavailable: %s\n", e.what());
+		return false;
+	}
+
+	// the noise parameters never change
+	const gpu_noise_params_t params = make_gpu_noise_params(this->settings_);
+	glCreateBuffers(1, &this->params_buffer_);
+	glNamedBufferStorage(this->params_buffer_, sizeof(params), &params, 0);
+	this->first_job_ = program->get_uniform<GLuint>("first_job"_uniform);
+	if (this->format_ == PatchVertexFormat::PACKED) this->stage_ = program->get_uniform<GLuint>("stage"_uniform);
+	this->program_ = std::move(program);
+	return true;
+}
+
+void patch_generator_t::set_backend(const PatchBackend::PatchBackendType backend)
+{
+	this->backend_ = backend == PatchBackend::GPU && !is_gpu_available() ? PatchBackend::CPU : backend;
+}
+
+void patch_generator_t::check_request(const patch_request_t& request) const
+{
+	if (!request.vertices.is_valid() || request.vertices.size < get_patch_bytes())
+	{
+		throw PatchGeneratorException("Patch vertex allocation is smaller than resolution^2 vertices.");
+	}
+	if (request.vertices.offset % get_vertex_size() != 0)
+	{
+		throw PatchGeneratorException("Patch vertex allocation is not aligned to the vertex size.");
+	}
+}
+
+void patch_generator_t::generate(const patch_request_t* requests, const uint32_t count)
+{
+	if (count == 0) return;
+	CONTINUUM_PROFILE_SCOPE("patch_generate");
+
+	for (uint32_t r = 0; r < count; ++r) check_request(requests[r]);
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+	this->patch_bounds_.clear();
+	if (this->backend_ == PatchBackend::GPU) generate_gpu(requests, count);
+	else generate_cpu(requests, count);
+	const auto t1 = std::chrono::high_resolution_clock::now();
+
+	this->stats_.patches += count;
+	this->stats_.submit_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void patch_generator_t::generate_cpu(const patch_request_t* requests, const uint32_t count)
+{
+	const size_t patch_vertices = size_t(this->settings_.resolution) * this->settings_.resolution;
+	const size_t packed_stride = patch_vertices + packed_patch_header_t::k_vertices;
+	const bool packed = this->format_ == PatchVertexFormat::PACKED;
+	this->staging_.resize(patch_vertices * count);
+	this->patch_bounds_.resize(count);
+	if (packed) this->packed_staging_.resize(packed_stride * count);
+
+	const auto build = [this, requests, patch_vertices, packed_stride, packed](const uint32_t begin, const uint32_t end)
+	{
+		for (uint32_t r = begin; r < end; ++r)
+		{
+			terrain_vertex_t* vertices = this->staging_.data() + patch_vertices * r;
+			build_patch_vertices(this->settings_, requests[r].key, vertices);
+
+			glm::vec3 lo = glm::vec3(vertices[0].position[0], vertices[0].position[1], vertices[0].position[2]);
+			glm::vec3 hi = lo;
+			for (size_t v = 1; v < patch_vertices; ++v)
+			{
+				const glm::vec3 p = glm::vec3(vertices[v].position[0], vertices[v].position[1], vertices[v].position[2]);
+				lo = glm::min(lo, p);
+				hi = glm::max(hi, p);
+			}
+			const glm::vec3 center = 0.5f * (lo + hi);
+			float radius = 0.0f;
+			for (size_t v = 0; v < patch_vertices; ++v)
+			{
+				radius = std::max(radius, glm::length(glm::vec3(vertices[v].position[0], vertices[v].position[1], vertices[v].position[2]) - center));
+			}
+			this->patch_bounds_[r] = glm::vec4(center, radius);
+
+			if (packed) pack_patch_vertices(this->settings_, vertices, this->packed_staging_.data() + packed_stride * r);
+		}
+	};
+	if (this->jobs_ != NULL)
+	{
+		Jobs::job_counter_t done;
+		this->jobs_->parallel_for(count, 1, build, &done);
+		this->jobs_->wait(done);
+	}
+	else
+	{
+		build(0, count);
+	}
+
+	// uploads stay on the calling thread, it owns the GL context
+	for (uint32_t r = 0; r < count; ++r)
+	{
+		if (packed) this->buffers_.upload(requests[r].vertices, this->packed_staging_.data() + packed_stride * r, get_patch_bytes());
+		else this->buffers_.upload(requests[r].vertices, this->staging_.data() + patch_vertices * r, get_patch_bytes());
+	}
+}
+
+void patch_generator_t::generate_gpu(const patch_request_t* requests, const uint32_t count)
+{
+	CONTINUUM_PROFILE_GPU_SCOPE("patch_generate");
+
+	// one dispatch per destination buffer, patches in the same arena share it
+	this->order_.resize(count);
+	for (uint32_t r = 0; r < count; ++r) this->order_[r] = r;
+	std::stable_sort(this->order_.begin(), this->order_.end(), [requests](const uint32_t a, const uint32_t b)
+	{
+		return requests[a].vertices.buffer < requests[b].vertices.buffer;
+	});
+
+	this->gpu_jobs_.resize(count);
+	for (uint32_t n = 0; n < count; ++n)
+	{
+		const patch_request_t& request = requests[this->order_[n]];
+		float u0 = 0.0f, v0 = 0.0f, u1 = 0.0f, v1 = 0.0f;
+		CubeSphere::patch_bounds(request.key, u0, v0, u1, v1);
+		const glm::vec3 origin = patch_origin_direction(this->settings_, request.key);
+
+		gpu_job_t& job = this->gpu_jobs_[n];
+		job.bounds[0] = u0;
+		job.bounds[1] = v0;
+		job.bounds[2] = u1;
+		job.bounds[3] = v1;
+		job.origin[0] = origin.x;
+		job.origin[1] = origin.y;
+		job.origin[2] = origin.z;
+		job.origin[3] = 0.0f;
+		job.face = request.key.face;
+		job.base_vertex = get_base_vertex(request.vertices);
+		job.pad[0] = job.pad[1] = 0;
+	}
+
+	if (count > this->jobs_capacity_)
+	{
+		if (this->jobs_buffer_ != 0) glDeleteBuffers(1, &this->jobs_buffer_);
+		this->jobs_capacity_ = std::max(count, this->jobs_capacity_ * 2);
+		glCreateBuffers(1, &this->jobs_buffer_);
+		glNamedBufferStorage(this->jobs_buffer_, GLsizeiptr(this->jobs_capacity_) * sizeof(gpu_job_t), NULL, GL_DYNAMIC_STORAGE_BIT);
+	}
+	glNamedBufferSubData(this->jobs_buffer_, 0, GLsizeiptr(count) * sizeof(gpu_job_t), this->gpu_jobs_.data());
+
+	this->program_->use();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PatchGeneratorDetail::k_params_binding, this->params_buffer_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PatchGeneratorDetail::k_jobs_binding, this->jobs_buffer_);
+
+	const GLuint groups = (this->settings_.resolution + PatchGeneratorDetail::k_group_size - 1) / PatchGeneratorDetail::k_group_size;
+	if (this->format_ == PatchVertexFormat::PACKED)
+	{
+		generate_gpu_packed(requests, count, groups);
+		return;
+	}
+
+	uint32_t begin = 0;
+	while (begin < count)
+	{
+		const GLuint buffer = requests[this->order_[begin]].vertices.buffer;
+		uint32_t end = begin + 1;
+		while (end < count && requests[this->order_[end]].vertices.buffer == buffer) ++end;
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PatchGeneratorDetail::k_vertices_binding, buffer);
+		this->program_->set_uniform(this->first_job_, begin);
+		glDispatchCompute(groups, groups, end - begin);
+		++this->stats_.dispatches;
+		begin = end;
+	}
+
+	// patches are drawn by pulling from the SSBO and read back by the reference checks
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void patch_generator_t::generate_gpu_packed(const patch_request_t* requests, const uint32_t count, const GLuint groups)
+{
+	// the heights of every patch and its border first, the range of each patch has to be known before any
+	// of its vertices can be quantized
+	const uint32_t border = this->settings_.resolution + 2;
+	if (count > this->scratch_capacity_)
+	{
+		if (this->heights_buffer_ != 0) glDeleteBuffers(1, &this->heights_buffer_);
+		if (this->ranges_buffer_ != 0) glDeleteBuffers(1, &this->ranges_buffer_);
+		this->scratch_capacity_ = std::max(count, this->scratch_capacity_ * 2);
+		glCreateBuffers(1, &this->heights_buffer_);
+		glNamedBufferStorage(this->heights_buffer_, GLsizeiptr(this->scratch_capacity_) * border * border * sizeof(float), NULL, 0);
+		glCreateBuffers(1, &this->ranges_buffer_);
+		glNamedBufferStorage(this->ranges_buffer_, GLsizeiptr(this->scratch_capacity_) * 2 * sizeof(uint32_t), NULL, GL_DYNAMIC_STORAGE_BIT);
+	}
+	// heights are never negative, so their float bits order like the floats: atomicMin from +inf, atomicMax from 0
+	this->empty_ranges_.resize(size_t(count) * 2);
+	for (uint32_t n = 0; n < count; ++n)
+	{
+		this->empty_ranges_[size_t(n) * 2] = 0x7F800000u;
+		this->empty_ranges_[size_t(n) * 2 + 1] = 0u;
+	}
+	glNamedBufferSubData(this->ranges_buffer_, 0, GLsizeiptr(count) * 2 * sizeof(uint32_t), this->empty_ranges_.data());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PatchGeneratorDetail::k_heights_binding, this->heights_buffer_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PatchGeneratorDetail::k_ranges_binding, this->ranges_buffer_);
+
+	const GLuint border_groups = (border + PatchGeneratorDetail::k_group_size - 1) / PatchGeneratorDetail::k_group_size;
+	this->program_->set_uniform(this->first_job_, 0u);
+	this->program_->set_uniform(this->stage_, 0u);
+	glDispatchCompute(border_groups, border_groups, count);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	++this->stats_.dispatches;
+
+	this->program_->set_uniform(this->stage_, 1u);
+	uint32_t begin = 0;
+	while (begin < count)
+	{
+		const GLuint buffer = requests[this->order_[begin]].vertices.buffer;
+		uint32_t end = begin + 1;
+		while (end < count && requests[this->order_[end]].vertices.buffer == buffer) ++end;
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PatchGeneratorDetail::k_vertices_binding, buffer);
+		this->program_->set_uniform(this->first_job_, begin);
+		glDispatchCompute(groups, groups, end - begin);
+		++this->stats_.dispatches;
+		begin = end;
+	}
+
+	// as in generate_gpu(), drawn by vertex pulling and read back by the reference checks
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
@@ -0,0 +1,219 @@
+#ifndef PATCH_GENERATOR_H
+#define PATCH_GENERATOR_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "heightfield.h"
+#include "../graphics/ogl_fw/buffer_suballocator.h"
+#include "../graphics/ogl_fw/glslprogram.h"
+#include "../jobs/job_system.h"
+
+namespace Continuum {
+
+	namespace Terrain {
+
+		struct PatchGeneratorException : public std::runtime_error {
+			PatchGeneratorException(const std::string& msg) :
+				std::runtime_error(msg) {}
+		};
+
+		namespace PatchBackend {
+			enum PatchBackendType
+			{
+				/// generate_heightfield's noise kernels on the job system, uploaded with glNamedBufferSubData
+				CPU = 0,
+				/// shader/terrain/patch_generate.cs writes the vertex buffers directly
+				GPU = 1
+			};
+		}
+
+		namespace PatchVertexFormat {
+			enum PatchVertexFormatType
+			{
+				/// terrain_vertex_t, position and normal as floats
+				FULL = 0,
+				/// packed_patch_header_t followed by packed_terrain_vertex_t, the position is rebuilt from the grid index
+				PACKED = 1
+			};
+		}
+
+		/// generated patch vertex, 32 bytes so that a 33x33 patch fills one slab slot of buffer_suballocator_t
+		struct terrain_vertex_t
+		{
+			/// relative to patch_origin()
+			float position[3];
+			/// metres above the planet radius
+			float height;
+			float normal[3];
+			float reserved;
+		};
+		static_assert(sizeof(terrain_vertex_t) == 32, "terrain_vertex_t is mirrored by TerrainVertex in patch_generate.cs");
+
+		/// PACKED patch vertex, one uint in the shaders: the height in the low 16 bits, quantized between the
+		/// patch's lowest and highest vertex (over [0, max_height] on the patch edges, see VertexPacking::is_edge_vertex),
+		/// and an octahedral normal in two snorm8. The grid position (i, j)
+		/// is gl_VertexID - gl_BaseVertex, the direction follows from it like in sample_direction().
+		struct packed_terrain_vertex_t
+		{
+			uint16_t height;
+			int8_t normal[2];
+		};
+		static_assert(sizeof(packed_terrain_vertex_t) == 4, "packed_terrain_vertex_t is mirrored by shader/terrain/vertex_packing.glsl");
+
+		/// leads a PACKED patch, the vertices follow at base vertex offset / 4 + k_vertices
+		struct packed_patch_header_t
+		{
+			static constexpr uint32_t k_vertices = 2;
+			float min_height;
+			/// metres per quantization step
+			float height_step;
+		};
+		static_assert(sizeof(packed_patch_header_t) == packed_patch_header_t::k_vertices * sizeof(packed_terrain_vertex_t), "the header takes whole vertices");
+
+		struct patch_request_t
+		{
+			patch_key_t key = {};
+			/// resolution^2 terrain_vertex_t, offset a multiple of sizeof(terrain_vertex_t)
+			Graphics::gpu_allocation_t vertices = {};
+		};
+
+		struct patch_generator_stats_t
+		{
+			uint64_t patches = 0;
+			uint64_t dispatches = 0;
+			/// time spent in generate() on the calling thread, GPU work not included
+			double submit_ms = 0.0;
+		};
+
+		/// mirrors NoiseParams in shader/terrain/planet.glsl (std430), bound at binding 3 by every shader evaluating the terrain
+		struct gpu_noise_params_t
+		{
+			static constexpr uint32_t k_max_octaves = 16;
+			uint32_t octave_count;
+			uint32_t noise_type;
+			float ridge_offset;
+			float normalization;
+			float planet_radius;
+			float max_height;
+			uint32_t resolution;
+			uint32_t pad;
+			float frequency[k_max_octaves];
+			float amplitude[k_max_octaves];
+			uint32_t seed[k_max_octaves];
+		};
+
+		gpu_noise_params_t make_gpu_noise_params(const heightfield_settings_t& settings);
+		/// NOISE_TYPE and OCTAVE_COUNT of shader/terrain/planet.glsl, specialises the noise to these settings
+		Graphics::shader_permutation_t make_noise_permutation(const heightfield_settings_t& settings);
+
+		/// Point on the sphere the vertices of a patch are stored relative to, keeps the floats small. In double:
+		/// rounded to float it would be up to half a metre off at Earth radius, and so would the whole patch.
+		glm::dvec3 patch_origin(const heightfield_settings_t& settings, const patch_key_t& key);
+
+		/// CPU reference, fills resolution^2 vertices. Normals use a one-sample border so that the
+		/// vertices neighbouring patches share along an edge get the same normal.
+		void build_patch_vertices(const heightfield_settings_t& settings, const patch_key_t& key, terrain_vertex_t* vertices);
+
+		/// Encodes the resolution^2 FULL vertices of one patch: packed receives the header and the vertices after it.
+		/// Heights are off by at most half a step, normals by about half a degree.
+		void pack_patch_vertices(const heightfield_settings_t& settings, const terrain_vertex_t* vertices, packed_terrain_vertex_t* packed);
+		/// height of grid vertex (i, j) of a PACKED patch, packed pointing at its header; what terrain_patch_packed.vert computes
+		float unpack_patch_height(const heightfield_settings_t& settings, const packed_terrain_vertex_t* packed, const uint32_t i, const uint32_t j);
+		/// position relative to patch_origin() of grid vertex (i, j) at a given height, what terrain_patch_packed.vert computes
+		glm::vec3 unpack_patch_position(const heightfield_settings_t& settings, const patch_key_t& key, const uint32_t i, const uint32_t j, const float height);
+
+		/// Writes terrain patches into suballocated vertex buffers, on the CPU or with a compute shader.
+		/// Both backends evaluate the same noise on the same grid; the GPU result matches build_patch_vertices
+		/// up to float rounding.
+		struct patch_generator_t
+		{
+			patch_generator_t(const heightfield_settings_t& settings, Graphics::buffer_suballocator_t& buffers, Jobs::job_system_t* jobs = NULL,
+				const PatchVertexFormat::PatchVertexFormatType format = PatchVertexFormat::FULL);
+			~patch_generator_t();
+			patch_generator_t(const patch_generator_t&) = delete;
+			patch_generator_t& operator=(const patch_generator_t&) = delete;
+		public:
+			/// compiles the compute path; on failure the message is printed and only the CPU backend is available
+			bool init_gpu(const std::string& shader_root);
+			/// GPU falls back to CPU when init_gpu() has not succeeded
+			void set_backend(const PatchBackend::PatchBackendType backend);
+			/// fills every request's allocation; GPU writes are made visible to vertex pulling and buffer reads
+			void generate(const patch_request_t* requests, const uint32_t count);
+			inline void generate(const std::vector<patch_request_t>& requests) { generate(requests.data(), static_cast<uint32_t>(requests.size())); }
+		public:
+			inline PatchBackend::PatchBackendType get_backend(void) const { return this->backend_; }
+			inline bool is_gpu_available(void) const { return this->program_ != NULL; }
+			inline PatchVertexFormat::PatchVertexFormatType get_format(void) const { return this->format_; }
+			inline uint32_t get_vertex_size(void) const { return this->format_ == PatchVertexFormat::PACKED ? sizeof(packed_terrain_vertex_t) : sizeof(terrain_vertex_t); }
+			inline uint64_t get_patch_bytes(void) const
+			{
+				const uint64_t vertices = uint64_t(this->settings_.resolution) * this->settings_.resolution;
+				return this->format_ == PatchVertexFormat::PACKED ? (vertices + packed_patch_header_t::k_vertices) * sizeof(packed_terrain_vertex_t) : vertices * sizeof(terrain_vertex_t);
+			}
+			/// gl_BaseVertex of a patch's first grid vertex when its allocation is bound as the vertex buffer
+			inline uint32_t get_base_vertex(const Graphics::gpu_allocation_t& vertices) const
+			{
+				const uint32_t base = static_cast<uint32_t>(vertices.offset / get_vertex_size());
+				return this->format_ == PatchVertexFormat::PACKED ? base + packed_patch_header_t::k_vertices : base;
+			}
+			inline const heightfield_settings_t& get_settings(void) const { return this->settings_; }
+			inline const patch_generator_stats_t& get_stats(void) const { return this->stats_; }
+			/// Bounding sphere of each request's vertices from the last generate(), xyz relative to patch_origin() and
+			/// w the radius, tighter than the quadtree's bounds spanning every possible height. Empty after the GPU
+			/// backend, which never reads its heights back.
+			inline const std::vector<glm::vec4>& get_patch_bounds(void) const { return this->patch_bounds_; }
+		private:
+			/// mirrors PatchJob in patch_generate.cs and patch_generate_packed.cs (std430)
+			struct gpu_job_t
+			{
+				float bounds[4];
+				/// direction of patch_origin()
+				float origin[4];
+				uint32_t face;
+				/// get_base_vertex()
+				uint32_t base_vertex;
+				uint32_t pad[2];
+			};
+			void check_request(const patch_request_t& request) const;
+			void generate_cpu(const patch_request_t* requests, const uint32_t count);
+			void generate_gpu(const patch_request_t* requests, const uint32_t count);
+			void generate_gpu_packed(const patch_request_t* requests, const uint32_t count, const GLuint groups);
+			void release_gpu(void);
+		private:
+			heightfield_settings_t settings_;
+			Graphics::buffer_suballocator_t& buffers_;
+			Jobs::job_system_t* jobs_ = NULL;
+			PatchVertexFormat::PatchVertexFormatType format_ = PatchVertexFormat::FULL;
+			PatchBackend::PatchBackendType backend_ = PatchBackend::CPU;
+			patch_generator_stats_t stats_;
+
+			std::vector<terrain_vertex_t> staging_;
+			std::vector<glm::vec4> patch_bounds_;
+			std::vector<packed_terrain_vertex_t> packed_staging_;
+			std::unique_ptr<Graphics::glsl_program_t> program_;
+			Graphics::uniform_t<GLuint> first_job_;
+			/// PACKED: 0 evaluates the heights of a patch and its border and reduces their range, 1 encodes the vertices
+			Graphics::uniform_t<GLuint> stage_;
+			GLuint params_buffer_ = 0;
+			GLuint jobs_buffer_ = 0;
+			uint32_t jobs_capacity_ = 0;
+			/// PACKED, per job: (resolution + 2)^2 heights, and the bits of the lowest and highest one
+			GLuint heights_buffer_ = 0;
+			GLuint ranges_buffer_ = 0;
+			uint32_t scratch_capacity_ = 0;
+			std::vector<uint32_t> empty_ranges_;
+			std::vector<gpu_job_t> gpu_jobs_;
+			std::vector<uint32_t> order_;
+		};
+
+	}
+
+}
+#endif
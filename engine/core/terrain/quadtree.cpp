@@ -0,0 +1,258 @@
+#include "quadtree.h"
+
+#include <chrono>
+#include <algorithm>
+
+using namespace Continuum::Terrain;
+
+cube_sphere_quadtree_t::cube_sphere_quadtree_t(const quadtree_settings_t& settings)
+	: settings_(settings)
+{
+	reset();
+}
+
+void cube_sphere_quadtree_t::reset(void)
+{
+	this->nodes_.clear();
+	this->free_blocks_.clear();
+	this->patches_.clear();
+	this->added_.clear();
+	this->removed_.clear();
+
+	for (uint8_t face = 0; face < CubeFace::COUNT; ++face)
+	{
+		patch_key_t key = {};
+		key.face = face;
+		this->roots_[face] = allocate_node(key, k_invalid);
+		this->added_.push(key);
+	}
+
+	for (uint8_t face = 0; face < CubeFace::COUNT; ++face) collect_leaves(this->roots_[face]);
+
+	this->stats_ = {};
+	this->stats_.node_count = static_cast<uint32_t>(this->nodes_.size());
+	this->stats_.leaf_count = static_cast<uint32_t>(this->patches_.size());
+}
+
+void cube_sphere_quadtree_t::update(const glm::vec3& camera_pos, const glm::mat4& proj, const float viewport_height)
+{
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	this->camera_pos_ = camera_pos;
+	// proj[1][1] == 1 / tan(fovy / 2)
+	this->pixels_per_radian_ = proj[1][1] * viewport_height * 0.5f;
+	this->split_budget_ = this->settings_.max_splits_per_update;
+
+	this->added_.clear();
+	this->removed_.clear();
+	this->stats_.splits = 0;
+	this->stats_.merges = 0;
+
+	for (uint8_t face = 0; face < CubeFace::COUNT; ++face) visit(this->roots_[face]);
+
+	if (this->stats_.splits > 0 || this->stats_.merges > 0)
+	{
+		this->patches_.clear();
+		this->stats_.deepest_level = 0;
+		for (uint8_t face = 0; face < CubeFace::COUNT; ++face) collect_leaves(this->roots_[face]);
+	}
+
+	this->stats_.node_count = static_cast<uint32_t>(this->nodes_.size() - 4 * this->free_blocks_.size());
+	this->stats_.leaf_count = static_cast<uint32_t>(this->patches_.size());
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	this->stats_.update_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+patch_key_t cube_sphere_quadtree_t::find_leaf(const uint8_t face, const float u, const float v) const
+{
+	uint32_t index = this->roots_[face % CubeFace::COUNT];
+	while (!is_leaf(index))
+	{
+		float u0, v0, u1, v1;
+		CubeSphere::patch_bounds(this->nodes_[index].patch.key, u0, v0, u1, v1);
+		const uint32_t dx = u >= 0.5f * (u0 + u1) ? 1 : 0;
+		const uint32_t dy = v >= 0.5f * (v0 + v1) ? 1 : 0;
+		index = this->nodes_[index].children + dy * 2 + dx;
+	}
+	return this->nodes_[index].patch.key;
+}
+
+float cube_sphere_quadtree_t::screen_space_error(const quadtree_patch_t& patch) const
+{
+	const float distance = std::max(glm::length(this->camera_pos_ - patch.center) - patch.radius, 1e-3f);
+	return patch.geometric_error / distance * this->pixels_per_radian_;
+}
+
+uint32_t cube_sphere_quadtree_t::allocate_node(const patch_key_t& key, const uint32_t parent)
+{
+	node_t node = {};
+	node.patch = make_patch(key);
+	node.parent = parent;
+	this->nodes_.push_back(node);
+	return static_cast<uint32_t>(this->nodes_.size() - 1);
+}
+
+void cube_sphere_quadtree_t::change_list_t::clear(void)
+{
+	this->keys.clear();
+	this->positions.clear();
+}
+
+void cube_sphere_quadtree_t::change_list_t::push(const patch_key_t& key)
+{
+	this->positions[key.packed()] = static_cast<uint32_t>(this->keys.size());
+	this->keys.push_back(key);
+}
+
+bool cube_sphere_quadtree_t::change_list_t::erase(const patch_key_t& key)
+{
+	const auto it = this->positions.find(key.packed());
+	if (it == this->positions.end()) return false;
+
+	// the last key takes the erased one's place, the order of a change list carries no meaning
+	const uint32_t position = it->second;
+	this->positions.erase(it);
+	if (position + 1 < this->keys.size())
+	{
+		this->keys[position] = this->keys.back();
+		this->positions[this->keys[position].packed()] = position;
+	}
+	this->keys.pop_back();
+	return true;
+}
+
+void cube_sphere_quadtree_t::change_list_t::note(change_list_t& opposite, const patch_key_t& key)
+{
+	// a patch created and destroyed within the same update is not reported at all
+	if (!opposite.erase(key)) this->push(key);
+}
+
+void cube_sphere_quadtree_t::split(const uint32_t index)
+{
+	const patch_key_t key = this->nodes_[index].patch.key;
+
+	// children live in one contiguous block of four so that only the first index is stored,
+	// blocks released by merges are recycled before the node array grows
+	uint32_t first = k_invalid;
+	if (!this->free_blocks_.empty())
+	{
+		first = this->free_blocks_.back();
+		this->free_blocks_.pop_back();
+	}
+	else
+	{
+		first = static_cast<uint32_t>(this->nodes_.size());
+		this->nodes_.resize(this->nodes_.size() + 4);
+	}
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		patch_key_t child = {};
+		child.face = key.face;
+		child.level = static_cast<uint8_t>(key.level + 1);
+		child.x = key.x * 2 + (i & 1);
+		child.y = key.y * 2 + (i >> 1);
+
+		node_t& node = this->nodes_[first + i];
+		node.patch = make_patch(child);
+		node.parent = index;
+		node.children = k_invalid;
+
+		this->added_.note(this->removed_, child);
+	}
+	this->nodes_[index].children = first;
+	this->removed_.note(this->added_, key);
+
+	--this->split_budget_;
+	++this->stats_.splits;
+}
+
+void cube_sphere_quadtree_t::merge(const uint32_t index)
+{
+	const uint32_t first = this->nodes_[index].children;
+	for (uint32_t i = 0; i < 4; ++i) this->removed_.note(this->added_, this->nodes_[first + i].patch.key);
+	this->free_blocks_.push_back(first);
+	this->nodes_[index].children = k_invalid;
+	this->added_.note(this->removed_, this->nodes_[index].patch.key);
+
+	++this->stats_.merges;
+}
+
+void cube_sphere_quadtree_t::visit(const uint32_t index)
+{
+	const float error = screen_space_error(this->nodes_[index].patch);
+
+	if (is_leaf(index))
+	{
+		const bool can_split = this->nodes_[index].patch.key.level < this->settings_.max_level && this->split_budget_ > 0;
+		if (can_split && error > this->settings_.split_threshold)
+		{
+			split(index);
+			// keep refining the new children while budget is left
+			const uint32_t first = this->nodes_[index].children;
+			for (uint32_t i = 0; i < 4; ++i) visit(first + i);
+		}
+		return;
+	}
+
+	const uint32_t first = this->nodes_[index].children;
+	const bool children_are_leaves = is_leaf(first) && is_leaf(first + 1) && is_leaf(first + 2) && is_leaf(first + 3);
+	if (children_are_leaves && error < this->settings_.split_threshold * this->settings_.merge_ratio)
+	{
+		merge(index);
+		return;
+	}
+
+	for (uint32_t i = 0; i < 4; ++i) visit(first + i);
+}
+
+bool cube_sphere_quadtree_t::is_leaf(const uint32_t index) const
+{
+	return this->nodes_[index].children == k_invalid;
+}
+
+void cube_sphere_quadtree_t::collect_leaves(const uint32_t index)
+{
+	const node_t& node = this->nodes_[index];
+	if (node.children == k_invalid)
+	{
+		this->patches_.push_back(node.patch);
+		this->stats_.deepest_level = std::max<uint32_t>(this->stats_.deepest_level, node.patch.key.level);
+		return;
+	}
+	for (uint32_t i = 0; i < 4; ++i) collect_leaves(node.children + i);
+}
+
+quadtree_patch_t cube_sphere_quadtree_t::make_patch(const patch_key_t& key) const
+{
+	float u0, v0, u1, v1;
+	CubeSphere::patch_bounds(key, u0, v0, u1, v1);
+
+	const float r_min = this->settings_.planet_radius;
+	const float r_max = this->settings_.planet_radius + this->settings_.max_height;
+
+	quadtree_patch_t patch = {};
+	patch.key = key;
+	patch.center = CubeSphere::face_to_sphere(key.face, 0.5f * (u0 + u1), 0.5f * (v0 + v1)) * (0.5f * (r_min + r_max));
+
+	float radius = 0.0f;
+	for (uint32_t j = 0; j < 3; ++j)
+	{
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			const float u = u0 + (u1 - u0) * 0.5f * float(i);
+			const float v = v0 + (v1 - v0) * 0.5f * float(j);
+			const glm::vec3 dir = CubeSphere::face_to_sphere(key.face, u, v);
+			radius = std::max(radius, glm::length(dir * r_min - patch.center));
+			radius = std::max(radius, glm::length(dir * r_max - patch.center));
+		}
+	}
+	patch.radius = radius;
+
+	const glm::vec3 c0 = CubeSphere::face_to_sphere(key.face, u0, v0) * r_min;
+	const glm::vec3 c1 = CubeSphere::face_to_sphere(key.face, u1, v0) * r_min;
+	patch.geometric_error = glm::length(c1 - c0) / float(this->settings_.patch_resolution);
+
+	return patch;
+}
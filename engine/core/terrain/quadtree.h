@@ -0,0 +1,116 @@
+#ifndef QUADTREE_H
+#define QUADTREE_H
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "cube_sphere.h"
+
+namespace Continuum {
+
+	namespace Terrain {
+
+		struct quadtree_settings_t
+		{
+			float planet_radius = 6360000.0f;
+			/// upper bound of the terrain displacement, widens the node bounds
+			float max_height = 9000.0f;
+			/// quads per patch edge, the geometric error of a node is its edge length divided by this
+			uint32_t patch_resolution = 32;
+			uint32_t max_level = 18;
+			/// a leaf splits once its projected error exceeds this many pixels
+			float split_threshold = 2.0f;
+			/// a parent merges once its projected error falls below split_threshold * merge_ratio (hysteresis)
+			float merge_ratio = 0.5f;
+			/// maximum number of splits per update, spreads the refinement of a fast moving camera over several frames
+			uint32_t max_splits_per_update = 256;
+		};
+
+		struct quadtree_patch_t
+		{
+			patch_key_t key = {};
+			glm::vec3 center = glm::vec3(0.0f);
+			float radius = 0.0f;
+			float geometric_error = 0.0f;
+		};
+
+		struct quadtree_stats_t
+		{
+			uint32_t node_count = 0;
+			uint32_t leaf_count = 0;
+			uint32_t splits = 0;
+			uint32_t merges = 0;
+			uint32_t deepest_level = 0;
+			double update_ms = 0.0;
+		};
+
+		/// CPU-side cube-sphere quadtree, six root nodes, one per cube face.
+		/// Nodes are split and merged incrementally on screen-space error; the leaves are the patches to draw.
+		struct cube_sphere_quadtree_t
+		{
+			explicit cube_sphere_quadtree_t(const quadtree_settings_t& settings = {});
+		public:
+			/// proj is the projection matrix of the frame, only its vertical focal length is used
+			void update(const glm::vec3& camera_pos, const glm::mat4& proj, const float viewport_height);
+			void reset(void);
+		public:
+			inline const std::vector<quadtree_patch_t>& get_patches(void) const { return this->patches_; }
+			/// leaves that appeared / disappeared during the last update
+			inline const std::vector<patch_key_t>& get_added(void) const { return this->added_.keys; }
+			inline const std::vector<patch_key_t>& get_removed(void) const { return this->removed_.keys; }
+			inline const quadtree_stats_t& get_stats(void) const { return this->stats_; }
+			inline const quadtree_settings_t& get_settings(void) const { return this->settings_; }
+		public:
+			/// finest active patch containing the face-local point (u, v)
+			patch_key_t find_leaf(const uint8_t face, const float u, const float v) const;
+			float screen_space_error(const quadtree_patch_t& patch) const;
+		private:
+			static constexpr uint32_t k_invalid = 0xffffffffu;
+			struct node_t
+			{
+				quadtree_patch_t patch = {};
+				uint32_t parent = k_invalid;
+				uint32_t children = k_invalid;
+			};
+			/// keys with their position in the list, so that a change undone within the same update leaves in O(1)
+			struct change_list_t
+			{
+				std::vector<patch_key_t> keys;
+				std::unordered_map<uint64_t, uint32_t> positions;
+
+				void clear(void);
+				void push(const patch_key_t& key);
+				/// false when key is not in the list
+				bool erase(const patch_key_t& key);
+				/// records key unless it cancels out against an entry in the opposite list
+				void note(change_list_t& opposite, const patch_key_t& key);
+			};
+		private:
+			uint32_t allocate_node(const patch_key_t& key, const uint32_t parent);
+			void split(const uint32_t index);
+			void merge(const uint32_t index);
+			void visit(const uint32_t index);
+			bool is_leaf(const uint32_t index) const;
+			void collect_leaves(const uint32_t index);
+			quadtree_patch_t make_patch(const patch_key_t& key) const;
+		private:
+			quadtree_settings_t settings_;
+			std::vector<node_t> nodes_;
+			std::vector<uint32_t> free_blocks_;
+			uint32_t roots_[CubeFace::COUNT] = {};
+			std::vector<quadtree_patch_t> patches_;
+			change_list_t added_;
+			change_list_t removed_;
+			quadtree_stats_t stats_;
+			glm::vec3 camera_pos_ = glm::vec3(0.0f);
+			float pixels_per_radian_ = 1.0f;
+			uint32_t split_budget_ = 0;
+		};
+
+	}
+
+}
+#endif
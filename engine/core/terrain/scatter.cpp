@@ -0,0 +1,394 @@
+#include "scatter.h"
+
+#include "patch_generator.h"
+#include "../graphics/culling.h"
+#include "../noise/noise.h"
+#include "../hash.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+using namespace Continuum;
+using namespace Continuum::Terrain;
+
+namespace ScatterDetail {
+	/// Bridson's candidates per active point before it retires
+	constexpr uint32_t k_attempts = 30;
+	/// metres between the samples the slope is measured over, the terrain mesh is not much finer than this
+	constexpr float k_slope_step = 8.0f;
+	constexpr float k_two_pi = 6.28318530718f;
+
+	/// xorshift64*, the placement has to come out the same on every platform and thread
+	struct random_t
+	{
+		uint64_t state;
+	public:
+		explicit random_t(const uint64_t seed) : state(seed != 0 ? seed : 0x9E3779B97F4A7C15ull) {}
+		inline uint64_t next(void)
+		{
+			this->state ^= this->state >> 12;
+			this->state ^= this->state << 25;
+			this->state ^= this->state >> 27;
+			return this->state * 0x2545F4914F6CDD1Dull;
+		}
+		/// [0, 1)
+		inline float uniform(void) { return float(next() >> 40) * (1.0f / 16777216.0f); }
+	};
+
+	/// Bridson's Poisson-disk sampling of the size x size square, no two points closer than radius
+	static void poisson_disk(random_t& random, const float size, const float radius, std::vector<glm::vec2>& points)
+	{
+		points.clear();
+		if (!(radius > 0.0f) || !(size > 0.0f)) return;
+
+		const float cell = radius / std::sqrt(2.0f);
+		const int32_t n = std::max(1, int32_t(std::ceil(size / cell)));
+		std::vector<int32_t> grid(size_t(n) * n, -1);
+		std::vector<uint32_t> active;
+
+		auto grid_index = [&](const glm::vec2& p) {
+			const int32_t gx = std::min(n - 1, int32_t(p.x / cell));
+			const int32_t gy = std::min(n - 1, int32_t(p.y / cell));
+			return size_t(gy) * n + gx;
+		};
+		auto fits = [&](const glm::vec2& p) {
+			const int32_t gx = std::min(n - 1, int32_t(p.x / cell));
+			const int32_t gy = std::min(n - 1, int32_t(p.y / cell));
+			for (int32_t y = std::max(0, gy - 2); y <= std::min(n - 1, gy + 2); ++y)
+			{
+				for (int32_t x = std::max(0, gx - 2); x <= std::min(n - 1, gx + 2); ++x)
+				{
+					const int32_t other = grid[size_t(y) * n + x];
+					if (other >= 0)
+					{
+						const glm::vec2 d = points[other] - p;
+						if (glm::dot(d, d) < radius * radius) return false;
+					}
+				}
+			}
+			return true;
+		};
+		auto insert = [&](const glm::vec2& p) {
+			grid[grid_index(p)] = int32_t(points.size());
+			active.push_back(uint32_t(points.size()));
+			points.push_back(p);
+		};
+
+		insert(glm::vec2(random.uniform() * size, random.uniform() * size));
+		while (!active.empty())
+		{
+			const uint32_t slot = uint32_t(random.next() % active.size());
+			const glm::vec2 center = points[active[slot]];
+			bool placed = false;
+			for (uint32_t attempt = 0; attempt < k_attempts; ++attempt)
+			{
+				const float angle = random.uniform() * k_two_pi;
+				const float distance = radius * (1.0f + random.uniform());
+				const glm::vec2 p = center + distance * glm::vec2(std::cos(angle), std::sin(angle));
+				if (p.x < 0.0f || p.y < 0.0f || p.x >= size || p.y >= size || !fits(p)) continue;
+				insert(p);
+				placed = true;
+				break;
+			}
+			if (!placed)
+			{
+				active[slot] = active.back();
+				active.pop_back();
+			}
+		}
+	}
+}
+
+void Terrain::place_scatter_cell(const heightfield_settings_t& heightfield, const scatter_settings_t& settings, const patch_key_t& key, scatter_cell_t& cell)
+{
+	cell.key = key;
+	cell.origin = patch_origin(heightfield, key);
+	cell.bounds = glm::vec4(0.0f);
+	cell.instances.clear();
+	cell.candidates = 0;
+
+	float u0 = 0.0f, v0 = 0.0f, u1 = 0.0f, v1 = 0.0f;
+	CubeSphere::patch_bounds(key, u0, v0, u1, v1);
+	const float um = 0.5f * (u0 + u1), vm = 0.5f * (v0 + v1);
+	const float radius = heightfield.planet_radius;
+	const float edge_u = glm::length(glm::normalize(CubeSphere::face_to_sphere(key.face, u1, vm)) - glm::normalize(CubeSphere::face_to_sphere(key.face, u0, vm))) * radius;
+	const float edge_v = glm::length(glm::normalize(CubeSphere::face_to_sphere(key.face, um, v1)) - glm::normalize(CubeSphere::face_to_sphere(key.face, um, v0))) * radius;
+	// the disk is sampled on a square of the shorter edge stretched over the cell, which only spreads points apart
+	const float size = std::min(edge_u, edge_v);
+	if (!(size > 0.0f)) return;
+	const float metres_to_u = (u1 - u0) / size;
+	const float metres_to_v = (v1 - v0) / size;
+	const float step_u = ScatterDetail::k_slope_step * metres_to_u;
+	const float step_v = ScatterDetail::k_slope_step * metres_to_v;
+	const float metres_u = ScatterDetail::k_slope_step * edge_u / size;
+	const float metres_v = ScatterDetail::k_slope_step * edge_v / size;
+
+	const glm::vec3 origin_direction = glm::vec3(cell.origin / double(radius));
+	const uint64_t cell_seed = Hash::fnv1a_64(&heightfield.noise.seed, sizeof(heightfield.noise.seed), key.packed());
+
+	std::vector<glm::vec2> points;
+	std::vector<glm::vec3> directions;
+	Noise::point_grid_t samples;
+	std::vector<float> heights;
+	glm::vec3 lo = glm::vec3(0.0f), hi = glm::vec3(0.0f);
+
+	for (uint32_t layer_index = 0; layer_index < uint32_t(settings.layers.size()); ++layer_index)
+	{
+		const scatter_layer_t& layer = settings.layers[layer_index];
+		ScatterDetail::random_t random(Hash::fnv1a_64(&layer.seed, sizeof(layer.seed), cell_seed));
+		ScatterDetail::poisson_disk(random, size, layer.spacing, points);
+		cell.candidates += uint32_t(points.size());
+
+		// each point and two neighbours along u and v, evaluated in one batch
+		const size_t count = points.size();
+		directions.resize(count);
+		samples.resize(count * 3);
+		heights.resize(count * 3);
+		for (size_t p = 0; p < count; ++p)
+		{
+			const float u = u0 + points[p].x * metres_to_u;
+			const float v = v0 + points[p].y * metres_to_v;
+			const glm::vec3 d[3] = {
+				glm::normalize(CubeSphere::face_to_sphere(key.face, u, v)),
+				glm::normalize(CubeSphere::face_to_sphere(key.face, u + step_u, v)),
+				glm::normalize(CubeSphere::face_to_sphere(key.face, u, v + step_v))
+			};
+			directions[p] = d[0];
+			for (uint32_t s = 0; s < 3; ++s)
+			{
+				samples.x[p * 3 + s] = d[s].x;
+				samples.y[p * 3 + s] = d[s].y;
+				samples.z[p * 3 + s] = d[s].z;
+			}
+		}
+		Noise::evaluate(heightfield.noise, samples, heights.data());
+
+		for (size_t p = 0; p < count; ++p)
+		{
+			const float h = heightfield.to_height(heights[p * 3]);
+			if (h < layer.min_height || h > layer.max_height) continue;
+			const float slope_u = (heightfield.to_height(heights[p * 3 + 1]) - h) / metres_u;
+			const float slope_v = (heightfield.to_height(heights[p * 3 + 2]) - h) / metres_v;
+			if (slope_u * slope_u + slope_v * slope_v > layer.max_slope * layer.max_slope) continue;
+
+			// same expression as the terrain vertices, so instances sit on the mesh
+			const glm::vec3 position = (directions[p] - origin_direction) * radius + directions[p] * h;
+			scatter_instance_t instance = {};
+			instance.position[0] = position.x;
+			instance.position[1] = position.y;
+			instance.position[2] = position.z;
+			instance.scale = layer.min_scale + (layer.max_scale - layer.min_scale) * random.uniform();
+			instance.yaw = random.uniform() * ScatterDetail::k_two_pi;
+			instance.layer = layer_index;
+
+			if (cell.instances.empty()) { lo = position; hi = position; }
+			lo = glm::min(lo, position);
+			hi = glm::max(hi, position);
+			cell.instances.push_back(instance);
+		}
+	}
+
+	if (!cell.instances.empty())
+	{
+		const glm::vec3 center = 0.5f * (lo + hi);
+		float r2 = 0.0f;
+		for (const scatter_instance_t& instance : cell.instances)
+		{
+			const glm::vec3 d = glm::vec3(instance.position[0], instance.position[1], instance.position[2]) - center;
+			r2 = std::max(r2, glm::dot(d, d));
+		}
+		cell.bounds = glm::vec4(center, std::sqrt(r2));
+	}
+}
+
+scatter_system_t::scatter_system_t(const heightfield_settings_t& heightfield, const scatter_settings_t& settings, Jobs::job_system_t* jobs) :
+	heightfield_(heightfield), settings_(settings), jobs_(jobs)
+{
+	for (const scatter_layer_t& layer : this->settings_.layers)
+	{
+		const uint32_t bands = std::min(layer.band_count, scatter_layer_t::k_max_bands);
+		if (bands > 0) this->range_ = std::max(this->range_, layer.band_distances[bands - 1]);
+		this->max_scale_ = std::max(this->max_scale_, layer.max_scale);
+	}
+}
+
+const scatter_cell_t* scatter_system_t::find_cell(const patch_key_t& key) const
+{
+	const auto it = this->cells_.find(key.packed());
+	return it != this->cells_.end() ? it->second.cell.get() : NULL;
+}
+
+void scatter_system_t::update(const cube_sphere_quadtree_t& quadtree, const glm::dvec3& camera, const glm::mat4& view_proj)
+{
+	const auto t0 = std::chrono::high_resolution_clock::now();
+	++this->frame_;
+	const uint32_t level = this->settings_.cell_level;
+
+	// cells under the leaves, each once
+	std::vector<uint64_t> packed_cells;
+	for (const quadtree_patch_t& patch : quadtree.get_patches())
+	{
+		if (patch.key.level < level) continue;
+		const uint32_t shift = patch.key.level - level;
+		patch_key_t cell = {};
+		cell.face = patch.key.face;
+		cell.level = uint8_t(level);
+		cell.x = patch.key.x >> shift;
+		cell.y = patch.key.y >> shift;
+		packed_cells.push_back(cell.packed());
+	}
+	std::sort(packed_cells.begin(), packed_cells.end());
+	packed_cells.erase(std::unique(packed_cells.begin(), packed_cells.end()), packed_cells.end());
+
+	// cells are measured at the camera's altitude, a height difference only moves instances farther away; a cell
+	// edge spans at most about one cube-space edge of planet radius
+	const double camera_radius = glm::length(camera);
+	const double cell_radius = double(this->heightfield_.planet_radius) * 2.0 / double(1u << level) + double(this->max_scale_);
+	this->in_range_.clear();
+	this->missing_.clear();
+	std::vector<std::pair<double, patch_key_t>> missing;
+	for (const uint64_t packed : packed_cells)
+	{
+		patch_key_t key = {};
+		key.face = uint8_t(packed >> 61);
+		key.level = uint8_t(level);
+		key.y = uint32_t(packed >> 28) & 0x0FFFFFFFu;
+		key.x = uint32_t(packed) & 0x0FFFFFFFu;
+		const double distance = glm::length(glm::normalize(patch_origin(this->heightfield_, key)) * camera_radius - camera);
+		if (distance - cell_radius > double(this->range_)) continue;
+		this->in_range_.push_back(key);
+		if (this->cells_.find(packed) == this->cells_.end()) missing.push_back(std::make_pair(distance, key));
+	}
+	std::sort(missing.begin(), missing.end(), [](const std::pair<double, patch_key_t>& a, const std::pair<double, patch_key_t>& b) {
+		return a.first < b.first || (a.first == b.first && a.second.packed() < b.second.packed());
+	});
+	if (missing.size() > this->settings_.max_cells_per_update) missing.resize(this->settings_.max_cells_per_update);
+	for (const auto& m : missing) this->missing_.push_back(m.second);
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	place(this->missing_);
+	const auto t2 = std::chrono::high_resolution_clock::now();
+
+	// the frustum test is per cell, the bands sort instances out within them
+	Graphics::bounding_spheres_t spheres;
+	std::vector<const scatter_cell_t*> candidates;
+	for (const patch_key_t& key : this->in_range_)
+	{
+		const auto it = this->cells_.find(key.packed());
+		if (it == this->cells_.end()) continue;
+		it->second.last_use = this->frame_;
+		const scatter_cell_t& cell = *it->second.cell;
+		if (cell.instances.empty()) continue;
+		const glm::vec3 center = glm::vec3(cell.origin - camera) + glm::vec3(cell.bounds);
+		spheres.push_back(center, cell.bounds.w + this->max_scale_);
+		candidates.push_back(&cell);
+	}
+	std::vector<uint32_t> visible;
+	Graphics::cull_spheres(spheres, Graphics::frustum_t::from_matrix(view_proj), NULL, visible);
+
+	this->draws_.clear();
+	this->stats_.instances = 0;
+	for (uint32_t b = 0; b < scatter_layer_t::k_max_bands; ++b) this->stats_.band_instances[b] = 0;
+	for (const uint32_t index : visible) queue_instances(*candidates[index], camera);
+
+	evict();
+	const auto t3 = std::chrono::high_resolution_clock::now();
+
+	this->stats_.cells = uint32_t(this->in_range_.size());
+	this->stats_.visible_cells = uint32_t(visible.size());
+	this->stats_.cached_cells = uint32_t(this->cells_.size());
+	this->stats_.placed_cells = uint32_t(this->missing_.size());
+	this->stats_.placement_ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+	this->stats_.placement_ms_per_cell = this->placed_total_ > 0 ? this->placed_ms_total_ / double(this->placed_total_) : 0.0;
+	this->stats_.update_ms = std::chrono::duration<double, std::milli>(t3 - t0).count();
+}
+
+void scatter_system_t::place(const std::vector<patch_key_t>& keys)
+{
+	const uint32_t count = uint32_t(keys.size());
+	if (count == 0) return;
+
+	std::vector<std::unique_ptr<scatter_cell_t>> placed(count);
+	this->cell_ms_.assign(count, 0.0);
+	auto build = [&](const uint32_t begin, const uint32_t end) {
+		for (uint32_t c = begin; c < end; ++c)
+		{
+			const auto t0 = std::chrono::high_resolution_clock::now();
+			placed[c].reset(new scatter_cell_t());
+			place_scatter_cell(this->heightfield_, this->settings_, keys[c], *placed[c]);
+			const auto t1 = std::chrono::high_resolution_clock::now();
+			this->cell_ms_[c] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+		}
+	};
+
+	if (this->jobs_ != NULL)
+	{
+		Jobs::job_counter_t done;
+		this->jobs_->parallel_for(count, 1, build, &done);
+		this->jobs_->wait(done);
+	}
+	else
+	{
+		build(0, count);
+	}
+
+	for (uint32_t c = 0; c < count; ++c)
+	{
+		cached_cell_t& entry = this->cells_[keys[c].packed()];
+		entry.cell = std::move(placed[c]);
+		entry.last_use = this->frame_;
+		this->placed_ms_total_ += this->cell_ms_[c];
+	}
+	this->placed_total_ += count;
+}
+
+void scatter_system_t::evict(void)
+{
+	if (this->cells_.size() <= this->settings_.max_cached_cells) return;
+
+	std::vector<std::pair<uint64_t, uint64_t>> unused;
+	for (const auto& entry : this->cells_)
+	{
+		if (entry.second.last_use != this->frame_) unused.push_back(std::make_pair(entry.second.last_use, entry.first));
+	}
+	std::sort(unused.begin(), unused.end());
+	for (const auto& entry : unused)
+	{
+		if (this->cells_.size() <= this->settings_.max_cached_cells) break;
+		this->cells_.erase(entry.second);
+	}
+}
+
+void scatter_system_t::queue_instances(const scatter_cell_t& cell, const glm::dvec3& camera)
+{
+	// one tangent frame per cell, the vertical turns by a ten-thousandth of a radian across one
+	const glm::vec3 offset = glm::vec3(cell.origin - camera);
+	const glm::vec3 up = glm::normalize(glm::vec3(cell.origin));
+	const glm::vec3 reference = std::fabs(up.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+	const glm::vec3 east = glm::normalize(glm::cross(reference, up));
+	const glm::vec3 north = glm::cross(up, east);
+
+	for (const scatter_instance_t& instance : cell.instances)
+	{
+		const scatter_layer_t& layer = this->settings_.layers[instance.layer];
+		const glm::vec3 position = offset + glm::vec3(instance.position[0], instance.position[1], instance.position[2]);
+		const float distance = glm::length(position);
+
+		const uint32_t bands = std::min(layer.band_count, scatter_layer_t::k_max_bands);
+		uint32_t band = 0;
+		while (band < bands && distance >= layer.band_distances[band]) ++band;
+		if (band == bands) continue;
+
+		const glm::vec3 tangent = std::cos(instance.yaw) * east + std::sin(instance.yaw) * north;
+		const glm::vec3 bitangent = glm::cross(tangent, up);
+		glm::mat4 model(1.0f);
+		model[0] = glm::vec4(tangent * instance.scale, 0.0f);
+		model[1] = glm::vec4(up * instance.scale, 0.0f);
+		model[2] = glm::vec4(bitangent * instance.scale, 0.0f);
+		model[3] = glm::vec4(position, 1.0f);
+		this->draws_.add(layer.band_meshes[band], model);
+		++this->stats_.instances;
+		++this->stats_.band_instances[band];
+	}
+}
@@ -0,0 +1,146 @@
+#ifndef SCATTER_H
+#define SCATTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "heightfield.h"
+#include "quadtree.h"
+#include "../graphics/ogl_fw/indirect_draw.h"
+#include "../jobs/job_system.h"
+
+namespace Continuum {
+
+	namespace Terrain {
+
+		/// one kind of object scattered over the terrain: trees, rocks, buildings
+		struct scatter_layer_t
+		{
+			static constexpr uint32_t k_max_bands = 3;
+			/// Poisson-disk radius, no two instances of the layer are placed closer than this many metres
+			float spacing = 20.0f;
+			/// steepest terrain accepted, rise over run
+			float max_slope = 1.0f;
+			/// metres above the planet radius
+			float min_height = 0.0f;
+			float max_height = 1e9f;
+			/// uniform scale picked per instance; the meshes fit the unit sphere, so this is their size in metres
+			float min_scale = 1.0f;
+			float max_scale = 1.0f;
+			/// instances closer than band_distances[b] metres are drawn with band_meshes[b], beyond the last band not at all
+			uint32_t band_count = 1;
+			float band_distances[k_max_bands] = { 500.0f };
+			uint32_t band_meshes[k_max_bands] = {};
+			uint32_t seed = 1;
+		};
+
+		struct scatter_settings_t
+		{
+			/// quadtree level of the cells instances are placed and cached per; finer leaves share their ancestor's cell
+			uint32_t cell_level = 14;
+			std::vector<scatter_layer_t> layers;
+			/// cells placed by one update at most, nearest first, the rest follow on the next updates
+			uint32_t max_cells_per_update = 64;
+			/// the least recently used cells are evicted past this
+			uint32_t max_cached_cells = 1024;
+		};
+
+		struct scatter_instance_t
+		{
+			/// relative to the cell's patch_origin()
+			float position[3];
+			float scale;
+			/// about the local vertical, radians
+			float yaw;
+			uint32_t layer;
+		};
+
+		struct scatter_cell_t
+		{
+			patch_key_t key = {};
+			glm::dvec3 origin = glm::dvec3(0.0);
+			/// sphere around the instance positions, xyz relative to origin
+			glm::vec4 bounds = glm::vec4(0.0f);
+			std::vector<scatter_instance_t> instances;
+			/// Poisson-disk points before the slope and height filters
+			uint32_t candidates = 0;
+		};
+
+		/// Deterministic placement: a Poisson disk per layer seeded from the key and the layer's seed, filtered by
+		/// slope and height of the heightfield. Disks are independent per cell, instances on either side of a cell
+		/// border can be closer than the spacing.
+		void place_scatter_cell(const heightfield_settings_t& heightfield, const scatter_settings_t& settings, const patch_key_t& key, scatter_cell_t& cell);
+
+		struct scatter_stats_t
+		{
+			/// cells within the last band of any layer, and those of them in the frustum
+			uint32_t cells = 0;
+			uint32_t visible_cells = 0;
+			uint32_t cached_cells = 0;
+			/// placed by the last update
+			uint32_t placed_cells = 0;
+			/// queued by the last update, per band
+			uint32_t instances = 0;
+			uint32_t band_instances[scatter_layer_t::k_max_bands] = {};
+			/// wall time of the last update's placement, and the average time of one cell on one thread since creation
+			double placement_ms = 0.0;
+			double placement_ms_per_cell = 0.0;
+			double update_ms = 0.0;
+		};
+
+		/// Scatter instances for the cells around the camera. Missing cells are placed on the job system and cached
+		/// by key; every update queues the instances of the visible cells into one draw list, the mesh picked by
+		/// distance band, so that indirect_renderer_t draws them as one instanced command per mesh.
+		struct scatter_system_t
+		{
+			scatter_system_t(const heightfield_settings_t& heightfield, const scatter_settings_t& settings, Jobs::job_system_t* jobs = NULL);
+			scatter_system_t(const scatter_system_t&) = delete;
+			scatter_system_t& operator=(const scatter_system_t&) = delete;
+		public:
+			/// Cells come from the quadtree's leaves at cell_level or finer. view_proj is relative to the camera
+			/// (proj * view rotation) and so are the model matrices queued.
+			void update(const cube_sphere_quadtree_t& quadtree, const glm::dvec3& camera, const glm::mat4& view_proj);
+		public:
+			inline const Graphics::draw_list_t& get_draw_list(void) const { return this->draws_; }
+			inline const scatter_stats_t& get_stats(void) const { return this->stats_; }
+			inline const scatter_settings_t& get_settings(void) const { return this->settings_; }
+			/// NULL when the cell is not cached
+			const scatter_cell_t* find_cell(const patch_key_t& key) const;
+		private:
+			struct cached_cell_t
+			{
+				std::unique_ptr<scatter_cell_t> cell;
+				uint64_t last_use = 0;
+			};
+			void place(const std::vector<patch_key_t>& keys);
+			void evict(void);
+			void queue_instances(const scatter_cell_t& cell, const glm::dvec3& camera);
+		private:
+			heightfield_settings_t heightfield_;
+			scatter_settings_t settings_;
+			Jobs::job_system_t* jobs_ = NULL;
+			/// farthest band of any layer, and the largest instance
+			float range_ = 0.0f;
+			float max_scale_ = 0.0f;
+
+			std::unordered_map<uint64_t, cached_cell_t> cells_;
+			uint64_t frame_ = 0;
+			std::vector<patch_key_t> in_range_;
+			std::vector<patch_key_t> missing_;
+			std::vector<double> cell_ms_;
+			double placed_ms_total_ = 0.0;
+			uint64_t placed_total_ = 0;
+
+			Graphics::draw_list_t draws_;
+			scatter_stats_t stats_;
+		};
+
+	}
+
+}
+#endif
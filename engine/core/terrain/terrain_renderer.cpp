@@ -0,0 +1,631 @@
+#include "terrain_renderer.h"
+
+#include "../profiler/profiler.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace Continuum;
+using namespace Continuum::Terrain;
+using namespace Continuum::Graphics::UniformLiterals;
+
+namespace TerrainRendererDetail
+{
+	/// GL_MAX_TESS_GEN_LEVEL is at least 64, the shaders assume exactly that
+	static constexpr uint32_t k_max_tess_level = 64;
+	/// Patches per sub-draw of the tessellated multi-draw. Software rasterisers (llvmpipe) tessellate a whole
+	/// draw before rasterising it and slow down by orders of magnitude past a few ten thousand triangles.
+	static constexpr uint32_t k_tess_patches_per_draw = 4;
+	static constexpr GLuint k_noise_params_binding = 3;
+	static constexpr GLuint k_vertices_binding = 5;
+	static constexpr GLuint k_patches_binding = 6;
+
+	static terrain_renderer_settings_t prepare_settings(terrain_renderer_settings_t settings)
+	{
+		settings.quadtree.patch_resolution = std::max<uint32_t>(settings.quadtree.patch_resolution, 1);
+		settings.quadtree.planet_radius = settings.heightfield.planet_radius;
+		settings.quadtree.max_height = settings.heightfield.max_height;
+		settings.heightfield.resolution = settings.quadtree.patch_resolution + 1;
+		settings.tess_edge_pixels = std::max(settings.tess_edge_pixels, 0.5f);
+		return settings;
+	}
+
+	static uint32_t log2_floor(uint32_t value)
+	{
+		uint32_t log = 0;
+		while (value > 1) { value >>= 1; ++log; }
+		return log;
+	}
+
+	/// leaves split once a 64-segment edge would exceed the target, and bottom out where the fine tree's quads do
+	static quadtree_settings_t coarse_settings(const terrain_renderer_settings_t& settings)
+	{
+		quadtree_settings_t coarse = settings.quadtree;
+		coarse.patch_resolution = k_max_tess_level;
+		coarse.split_threshold = settings.tess_edge_pixels;
+		const uint32_t finest = settings.quadtree.max_level + log2_floor(settings.quadtree.patch_resolution);
+		coarse.max_level = finest > log2_floor(k_max_tess_level) ? finest - log2_floor(k_max_tess_level) : 0;
+		return coarse;
+	}
+
+	static glm::vec3 face_direction(const uint8_t face, const float u, const float v)
+	{
+		return glm::normalize(CubeSphere::face_to_sphere(face, u, v));
+	}
+
+	/// endpoints of edge 0..3 (u0, v0, u1, v1 side), in the order the quad tessellator walks them
+	static void edge_directions(const patch_key_t& key, const uint32_t edge, glm::vec3& a, glm::vec3& b)
+	{
+		float u0, v0, u1, v1;
+		CubeSphere::patch_bounds(key, u0, v0, u1, v1);
+		switch (edge) {
+		case 0:  a = face_direction(key.face, u0, v0); b = face_direction(key.face, u0, v1); break;
+		case 1:  a = face_direction(key.face, u0, v0); b = face_direction(key.face, u1, v0); break;
+		case 2:  a = face_direction(key.face, u1, v0); b = face_direction(key.face, u1, v1); break;
+		default: a = face_direction(key.face, u0, v1); b = face_direction(key.face, u1, v1); break;
+		}
+	}
+
+	/// face-local coordinates of a cube-surface point on a given face, also for points on its border
+	static void cube_to_face_coords(const uint8_t face, const glm::vec3& p, float& u, float& v)
+	{
+		const glm::vec3 n = CubeSphere::face_to_cube(face, 0.0f, 0.0f);
+		const glm::vec3 axis_u = CubeSphere::face_to_cube(face, 1.0f, 0.0f) - n;
+		const glm::vec3 axis_v = CubeSphere::face_to_cube(face, 0.0f, 1.0f) - n;
+		const glm::vec3 q = p / glm::dot(p, n);
+		u = glm::dot(q, axis_u);
+		v = glm::dot(q, axis_v);
+	}
+}
+
+terrain_renderer_t::terrain_renderer_t(const terrain_renderer_settings_t& settings, Graphics::buffer_suballocator_t& buffers, Jobs::job_system_t* jobs) :
+	settings_(TerrainRendererDetail::prepare_settings(settings)), buffers_(buffers),
+	generator_(settings_.heightfield, buffers, jobs, settings_.vertex_format),
+	quadtree_(settings_.quadtree), coarse_quadtree_(TerrainRendererDetail::coarse_settings(settings_))
+{
+}
+
+terrain_renderer_t::~terrain_renderer_t()
+{
+	for (const auto& entry : this->resident_) this->buffers_.free(entry.second.vertices);
+	release();
+}
+
+void terrain_renderer_t::release(void)
+{
+	if (this->vao_ != 0) glDeleteVertexArrays(1, &this->vao_);
+	if (this->queries_[0] != 0) glDeleteQueries(2, this->queries_);
+	const GLuint buffers[5] = { this->index_buffer_, this->noise_params_buffer_, this->draws_buffer_, this->commands_buffer_, this->cull_buffer_ };
+	for (const GLuint buffer : buffers)
+	{
+		if (buffer != 0) glDeleteBuffers(1, &buffer);
+	}
+	this->vao_ = 0;
+	this->queries_[0] = this->queries_[1] = 0;
+	this->index_buffer_ = this->noise_params_buffer_ = this->draws_buffer_ = this->commands_buffer_ = this->cull_buffer_ = 0;
+	this->draws_capacity_ = this->commands_capacity_ = this->cull_capacity_ = 0;
+	this->patch_program_.reset();
+	this->tess_program_.reset();
+}
+
+bool terrain_renderer_t::init(const std::string& shader_root)
+{
+	release();
+
+	// the noise settings never change, every program evaluating it gets them baked in
+	const Graphics::shader_permutation_t noise_permutation = make_noise_permutation(this->settings_.heightfield);
+
+	auto patch_program = std::make_unique<Graphics::glsl_program_t>();
+	try
+	{
+		const char* vertex_shader = this->settings_.vertex_format == PatchVertexFormat::PACKED ? "/terrain/terrain_patch_packed.vert" : "/terrain/terrain_patch.vert";
+		patch_program->compile_shader((shader_root + vertex_shader).c_str(), noise_permutation);
+		patch_program->compile_shader((shader_root + "/terrain/terrain.frag").c_str());
+		patch_program->link();
+	}
+	catch (const Graphics::GLSLProgramException& e)
+	{
+		fprintf(stderr, "Terrain: patch program failed: %s\n", e.what());
+		return false;
+	}
+	this->patch_view_proj_ = patch_program->get_uniform<glm::mat4>("view_proj"_uniform);
+	this->patch_program_ = std::move(patch_program);
+
+	auto tess_program = std::make_unique<Graphics::glsl_program_t>();
+	try
+	{
+		tess_program->compile_shader((shader_root + "/terrain/terrain_tess.vert").c_str());
+		tess_program->compile_shader((shader_root + "/terrain/terrain_tess.tcs").c_str(), noise_permutation);
+		tess_program->compile_shader((shader_root + "/terrain/terrain_tess.tes").c_str(), noise_permutation);
+		tess_program->compile_shader((shader_root + "/terrain/terrain.frag").c_str());
+		tess_program->link();
+		this->tess_view_proj_ = tess_program->get_uniform<glm::mat4>("view_proj"_uniform);
+		this->tess_camera_pos_ = tess_program->get_uniform<glm::vec3>("camera_pos"_uniform);
+		this->tess_pixels_per_radian_ = tess_program->get_uniform<float>("pixels_per_radian"_uniform);
+		this->tess_edge_pixels_ = tess_program->get_uniform<float>("edge_pixels"_uniform);
+		this->tess_program_ = std::move(tess_program);
+	}
+	catch (const Graphics::GLSLProgramException& e)
+	{
+		fprintf(stderr, "Terrain: tessellation mode unavailable: %s\n", e.what());
+	}
+
+	this->generator_.init_gpu(shader_root);
+
+	// one grid shared by every generated patch, base_vertex selects the patch
+	const uint32_t resolution = this->settings_.heightfield.resolution;
+	std::vector<uint32_t> indices;
+	indices.reserve(size_t(resolution - 1) * (resolution - 1) * 6);
+	for (uint32_t j = 0; j + 1 < resolution; ++j)
+	{
+		for (uint32_t i = 0; i + 1 < resolution; ++i)
+		{
+			const uint32_t v = j * resolution + i;
+			indices.push_back(v);
+			indices.push_back(v + 1);
+			indices.push_back(v + resolution + 1);
+			indices.push_back(v);
+			indices.push_back(v + resolution + 1);
+			indices.push_back(v + resolution);
+		}
+	}
+	// PACKED patches hang a skirt off their perimeter: the vertices past the grid are the edge ones walked
+	// counter-clockwise and lowered by terrain_patch_packed.vert, so they take no vertex memory. It hides the
+	// T-junctions where a finer patch meets a coarser one, which the quadtree mode does not stitch.
+	if (this->settings_.vertex_format == PatchVertexFormat::PACKED)
+	{
+		const uint32_t perimeter = 4 * (resolution - 1);
+		const auto edge_vertex = [resolution](const uint32_t k) {
+			const uint32_t side = k / (resolution - 1);
+			const uint32_t t = k % (resolution - 1);
+			const uint32_t last = resolution - 1;
+			const uint32_t i = side == 0 ? t : side == 1 ? last : side == 2 ? last - t : 0;
+			const uint32_t j = side == 0 ? 0 : side == 1 ? t : side == 2 ? last : last - t;
+			return j * resolution + i;
+		};
+		const uint32_t first_skirt = resolution * resolution;
+		for (uint32_t k = 0; k < perimeter; ++k)
+		{
+			const uint32_t next = (k + 1) % perimeter;
+			indices.push_back(edge_vertex(k));
+			indices.push_back(first_skirt + k);
+			indices.push_back(first_skirt + next);
+			indices.push_back(edge_vertex(k));
+			indices.push_back(first_skirt + next);
+			indices.push_back(edge_vertex(next));
+		}
+	}
+	this->index_count_ = static_cast<uint32_t>(indices.size());
+	glCreateBuffers(1, &this->index_buffer_);
+	glNamedBufferStorage(this->index_buffer_, GLsizeiptr(indices.size() * sizeof(uint32_t)), indices.data(), 0);
+	glCreateVertexArrays(1, &this->vao_);
+	glVertexArrayElementBuffer(this->vao_, this->index_buffer_);
+
+	const gpu_noise_params_t params = make_gpu_noise_params(this->settings_.heightfield);
+	glCreateBuffers(1, &this->noise_params_buffer_);
+	glNamedBufferStorage(this->noise_params_buffer_, sizeof(params), &params, 0);
+
+	glGenQueries(2, this->queries_);
+	this->query_frame_ = 0;
+	return true;
+}
+
+void terrain_renderer_t::set_mode(const TerrainMode::TerrainModeType mode)
+{
+	const TerrainMode::TerrainModeType next = mode == TerrainMode::TESSELLATION && !is_tessellation_available() ? TerrainMode::QUADTREE : mode;
+	if (next == this->mode_) return;
+
+	// the inactive tree starts over from the roots, its patches are released right away
+	for (const auto& entry : this->resident_) this->buffers_.free(entry.second.vertices);
+	this->resident_.clear();
+	this->quadtree_.reset();
+	this->coarse_quadtree_.reset();
+	this->tess_patches_.clear();
+	this->mode_ = next;
+}
+
+void terrain_renderer_t::update(const glm::dvec3& camera, const glm::mat4& view, const glm::mat4& proj, const float viewport_height)
+{
+	CONTINUUM_PROFILE_SCOPE("terrain_update");
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	// the shaders work relative to the camera, only the rotation of the view is applied on the GPU; refinement,
+	// culling and the tessellation LOD are fine with the camera rounded to float
+	const glm::vec3 camera_pos = glm::vec3(camera);
+	const glm::mat4 view_rotation = glm::mat4(glm::mat3(view));
+	this->camera_pos_ = camera_pos;
+	this->camera_world_ = camera;
+	this->view_proj_ = proj * view_rotation;
+	this->pixels_per_radian_ = proj[1][1] * viewport_height * 0.5f;
+	this->stats_.generated_patches = 0;
+
+	if (this->mode_ == TerrainMode::QUADTREE)
+	{
+		this->quadtree_.update(camera_pos, proj, viewport_height);
+		update_resident();
+		cull(this->quadtree_, camera_pos, view_rotation * glm::translate(glm::mat4(1.0f), -camera_pos), proj);
+		build_quadtree_draws(camera);
+		this->stats_.geometry_bytes = uint64_t(this->resident_.size()) * this->generator_.get_patch_bytes()
+			+ uint64_t(this->settings_.quadtree.patch_resolution) * this->settings_.quadtree.patch_resolution * 6 * sizeof(uint32_t);
+	}
+	else
+	{
+		this->coarse_quadtree_.update(camera_pos, proj, viewport_height);
+		const quadtree_stats_t& tree = this->coarse_quadtree_.get_stats();
+		if (tree.splits > 0 || tree.merges > 0 || this->tess_patches_.size() != this->coarse_quadtree_.get_patches().size()) update_tess_patches();
+		cull(this->coarse_quadtree_, camera_pos, view_rotation * glm::translate(glm::mat4(1.0f), -camera_pos), proj);
+		build_tess_draws(camera);
+		this->stats_.geometry_bytes = uint64_t(this->tess_draws_.size()) * sizeof(gpu_tess_patch_t) + sizeof(gpu_noise_params_t);
+	}
+
+	const cube_sphere_quadtree_t& quadtree = get_quadtree();
+	this->stats_.nodes = quadtree.get_stats().node_count;
+	this->stats_.patches = quadtree.get_stats().leaf_count;
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	this->stats_.update_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void terrain_renderer_t::update_resident(void)
+{
+	for (const patch_key_t& key : this->quadtree_.get_removed())
+	{
+		const auto it = this->resident_.find(key.packed());
+		if (it == this->resident_.end()) continue;
+		this->buffers_.free(it->second.vertices);
+		this->resident_.erase(it);
+	}
+
+	// every leaf is kept resident, culled ones included, so turning the camera never regenerates
+	this->requests_.clear();
+	for (const quadtree_patch_t& patch : this->quadtree_.get_patches())
+	{
+		if (this->resident_.count(patch.key.packed()) != 0) continue;
+		patch_request_t request = {};
+		request.key = patch.key;
+		request.vertices = this->buffers_.allocate(this->generator_.get_patch_bytes());
+		// out of arena space, the patch is retried next frame
+		if (!request.vertices.is_valid()) continue;
+		this->resident_.emplace(patch.key.packed(), resident_patch_t{ request.vertices });
+		this->requests_.push_back(request);
+	}
+	this->generator_.generate(this->requests_);
+
+	// the occlusion culler gets the spheres of the vertices themselves when the generator has them
+	const std::vector<glm::vec4>& bounds = this->generator_.get_patch_bounds();
+	for (size_t r = 0; r < bounds.size(); ++r)
+	{
+		resident_patch_t& resident = this->resident_[this->requests_[r].key.packed()];
+		resident.center = patch_origin(this->settings_.heightfield, this->requests_[r].key) + glm::dvec3(glm::vec3(bounds[r]));
+		resident.radius = bounds[r].w;
+	}
+	this->stats_.generated_patches = static_cast<uint32_t>(this->requests_.size());
+}
+
+void terrain_renderer_t::update_tess_patches(void)
+{
+	using namespace TerrainRendererDetail;
+
+	const std::vector<quadtree_patch_t>& patches = this->coarse_quadtree_.get_patches();
+	const uint32_t max_level = this->coarse_quadtree_.get_settings().max_level;
+	// a quarter of the finest patch, the probe always lands inside the neighbouring leaf
+	const float probe = 0.5f / float(1u << std::min<uint32_t>(max_level, 24));
+
+	// the leaf across each edge midpoint, and which of its edges faces back
+	std::vector<patch_key_t> neighbours(patches.size() * 4);
+	std::vector<uint8_t> neighbour_edges(patches.size() * 4);
+	this->finer_neighbours_.clear();
+	for (size_t p = 0; p < patches.size(); ++p)
+	{
+		const patch_key_t& key = patches[p].key;
+		float u0, v0, u1, v1;
+		CubeSphere::patch_bounds(key, u0, v0, u1, v1);
+		const float um = 0.5f * (u0 + u1);
+		const float vm = 0.5f * (v0 + v1);
+		const float edge_u[4] = { u0, um, u1, um };
+		const float edge_v[4] = { vm, v0, vm, v1 };
+		const float probe_u[4] = { u0 - probe, um, u1 + probe, um };
+		const float probe_v[4] = { vm, v0 - probe, vm, v1 + probe };
+
+		for (uint32_t e = 0; e < 4; ++e)
+		{
+			// probes past the face border land on the neighbouring face through the cube
+			float nu, nv;
+			const uint8_t face = CubeSphere::cube_to_face(CubeSphere::face_to_cube(key.face, probe_u[e], probe_v[e]), nu, nv);
+			const patch_key_t neighbour = this->coarse_quadtree_.find_leaf(face, nu, nv);
+
+			float nu0, nv0, nu1, nv1, mu, mv;
+			CubeSphere::patch_bounds(neighbour, nu0, nv0, nu1, nv1);
+			cube_to_face_coords(neighbour.face, CubeSphere::face_to_cube(key.face, edge_u[e], edge_v[e]), mu, mv);
+			const float distances[4] = { std::abs(mu - nu0), std::abs(mv - nv0), std::abs(mu - nu1), std::abs(mv - nv1) };
+			const uint8_t facing = static_cast<uint8_t>(std::min_element(distances, distances + 4) - distances);
+
+			neighbours[p * 4 + e] = neighbour;
+			neighbour_edges[p * 4 + e] = facing;
+			if (neighbour.level < key.level)
+			{
+				glm::uvec4& finer = this->finer_neighbours_[neighbour.packed()];
+				finer[facing] = std::max<uint32_t>(finer[facing], key.level - neighbour.level);
+			}
+		}
+	}
+
+	// A shared edge takes its factor from the coarser side's edge on both sides: the coarse patch uses
+	// max(factor, 2^d of its finest neighbour), a neighbour d levels finer covers 1/2^d of that edge and
+	// divides by 2^d. Power-of-two factors and dyadic uv bounds then put every edge vertex on the same
+	// direction from both sides. Jumps of more than 6 levels exceed the 64 segments and can crack.
+	const auto level_factor = [](const uint32_t levels) { return float(1u << std::min<uint32_t>(levels, 6)); };
+	this->tess_patches_.resize(patches.size());
+	for (size_t p = 0; p < patches.size(); ++p)
+	{
+		tess_patch_t& patch = this->tess_patches_[p];
+		patch.key = patches[p].key;
+		float u0, v0, u1, v1;
+		CubeSphere::patch_bounds(patch.key, u0, v0, u1, v1);
+		patch.origin_dir = face_direction(patch.key.face, 0.5f * (u0 + u1), 0.5f * (v0 + v1));
+
+		for (uint32_t e = 0; e < 4; ++e)
+		{
+			const patch_key_t& neighbour = neighbours[p * 4 + e];
+			const bool coarser = neighbour.level < patch.key.level;
+			const patch_key_t& owner = coarser ? neighbour : patch.key;
+			const uint32_t owner_edge = coarser ? neighbour_edges[p * 4 + e] : e;
+
+			tess_edge_t& edge = patch.edges[e];
+			edge_directions(owner, owner_edge, edge.a, edge.b);
+			const auto finer = this->finer_neighbours_.find(owner.packed());
+			edge.min_factor = level_factor(finer != this->finer_neighbours_.end() ? finer->second[owner_edge] : 0);
+			edge.divisor = coarser ? level_factor(patch.key.level - neighbour.level) : 1.0f;
+		}
+	}
+}
+
+void terrain_renderer_t::cull(const cube_sphere_quadtree_t& quadtree, const glm::vec3& camera_pos, const glm::mat4& view, const glm::mat4& proj)
+{
+	this->spheres_.clear();
+	for (const quadtree_patch_t& patch : quadtree.get_patches()) this->spheres_.push_back(patch.center, patch.radius);
+
+	Graphics::horizon_occluder_t horizon;
+	horizon.camera_pos = camera_pos;
+	horizon.planet_radius = this->settings_.heightfield.planet_radius;
+	Graphics::cull_spheres(this->spheres_, Graphics::frustum_t::from_matrix(proj * view), &horizon, this->visible_);
+	this->stats_.drawn_patches = static_cast<uint32_t>(this->visible_.size());
+}
+
+void terrain_renderer_t::build_quadtree_draws(const glm::dvec3& camera)
+{
+	const std::vector<quadtree_patch_t>& patches = this->quadtree_.get_patches();
+
+	// visible patches grouped by vertex buffer, one multi-draw per buffer
+	this->visible_draws_.clear();
+	for (const uint32_t index : this->visible_)
+	{
+		const auto it = this->resident_.find(patches[index].key.packed());
+		if (it == this->resident_.end()) continue;
+		patch_request_t draw = {};
+		draw.key = patches[index].key;
+		draw.vertices = it->second.vertices;
+
+		// the occlusion culler's sphere, relative to the camera: the generated vertices' own when known, else
+		// the quadtree's spanning every possible height, which terrain can hardly ever hide
+		const resident_patch_t& resident = it->second;
+		const bool generated_bounds = resident.radius > 0.0f;
+		const glm::vec3 center = glm::vec3((generated_bounds ? resident.center : glm::dvec3(patches[index].center)) - camera);
+		// the float planet-centred quadtree centre is up to half a metre off, the margin makes up for it and for packed heights
+		this->visible_draws_.push_back({ draw, glm::vec4(center, (generated_bounds ? resident.radius : patches[index].radius) + 1.0f) });
+	}
+	std::stable_sort(this->visible_draws_.begin(), this->visible_draws_.end(), [](const auto& a, const auto& b)
+	{
+		return a.first.vertices.buffer < b.first.vertices.buffer;
+	});
+	this->requests_.resize(this->visible_draws_.size());
+	this->cull_instances_.resize(this->visible_draws_.size());
+	for (size_t d = 0; d < this->visible_draws_.size(); ++d)
+	{
+		this->requests_[d] = this->visible_draws_[d].first;
+
+		const glm::vec4& sphere = this->visible_draws_[d].second;
+		Graphics::gpu_cull_instance_t& instance = this->cull_instances_[d];
+		instance.sphere[0] = sphere.x;
+		instance.sphere[1] = sphere.y;
+		instance.sphere[2] = sphere.z;
+		instance.sphere[3] = sphere.w;
+		instance.command = static_cast<uint32_t>(d);
+		instance.matrix = Graphics::gpu_cull_instance_t::k_no_matrix;
+		instance.pad[0] = instance.pad[1] = 0;
+	}
+
+	const uint32_t resolution = this->settings_.heightfield.resolution;
+	this->patch_draws_.resize(this->requests_.size());
+	this->commands_.resize(this->requests_.size());
+	this->command_runs_.clear();
+	for (size_t d = 0; d < this->requests_.size(); ++d)
+	{
+		const patch_request_t& draw = this->requests_[d];
+		const glm::dvec3 origin = patch_origin(this->settings_.heightfield, draw.key);
+		const glm::vec3 relative = glm::vec3(origin - camera);
+		const glm::vec3 origin_dir = sample_direction(draw.key, resolution, int32_t(resolution / 2), int32_t(resolution / 2));
+		float u0, v0, u1, v1;
+		CubeSphere::patch_bounds(draw.key, u0, v0, u1, v1);
+
+		gpu_patch_draw_t& patch_draw = this->patch_draws_[d];
+		patch_draw.origin[0] = relative.x;
+		patch_draw.origin[1] = relative.y;
+		patch_draw.origin[2] = relative.z;
+		patch_draw.origin[3] = 0.0f;
+		patch_draw.planet_origin[0] = float(origin.x);
+		patch_draw.planet_origin[1] = float(origin.y);
+		patch_draw.planet_origin[2] = float(origin.z);
+		patch_draw.planet_origin[3] = 0.0f;
+		patch_draw.bounds[0] = u0;
+		patch_draw.bounds[1] = v0;
+		patch_draw.bounds[2] = u1;
+		patch_draw.bounds[3] = v1;
+		patch_draw.origin_dir[0] = origin_dir.x;
+		patch_draw.origin_dir[1] = origin_dir.y;
+		patch_draw.origin_dir[2] = origin_dir.z;
+		patch_draw.origin_dir[3] = float(draw.key.face);
+
+		Graphics::draw_elements_indirect_command_t& command = this->commands_[d];
+		command.count = this->index_count_;
+		command.instance_count = 1;
+		command.first_index = 0;
+		command.base_vertex = static_cast<GLint>(this->generator_.get_base_vertex(draw.vertices));
+		command.base_instance = static_cast<GLuint>(d);
+
+		if (d == 0 || draw.vertices.buffer != this->requests_[d - 1].vertices.buffer) this->command_runs_.push_back(static_cast<uint32_t>(d));
+	}
+	this->command_runs_.push_back(static_cast<uint32_t>(this->requests_.size()));
+}
+
+void terrain_renderer_t::build_tess_draws(const glm::dvec3& camera)
+{
+	const double radius = this->settings_.heightfield.planet_radius;
+	this->tess_draws_.resize(this->visible_.size());
+	this->batch_firsts_.clear();
+	this->batch_counts_.clear();
+	for (size_t first = 0; first < this->visible_.size(); first += TerrainRendererDetail::k_tess_patches_per_draw)
+	{
+		this->batch_firsts_.push_back(static_cast<GLint>(first));
+		this->batch_counts_.push_back(static_cast<GLsizei>(std::min<size_t>(TerrainRendererDetail::k_tess_patches_per_draw, this->visible_.size() - first)));
+	}
+	for (size_t d = 0; d < this->visible_.size(); ++d)
+	{
+		const tess_patch_t& patch = this->tess_patches_[this->visible_[d]];
+		const glm::vec3 relative = glm::vec3(glm::dvec3(patch.origin_dir) * radius - camera);
+		float u0, v0, u1, v1;
+		CubeSphere::patch_bounds(patch.key, u0, v0, u1, v1);
+
+		gpu_tess_patch_t& draw = this->tess_draws_[d];
+		draw.bounds[0] = u0;
+		draw.bounds[1] = v0;
+		draw.bounds[2] = u1;
+		draw.bounds[3] = v1;
+		draw.origin[0] = relative.x;
+		draw.origin[1] = relative.y;
+		draw.origin[2] = relative.z;
+		draw.origin[3] = float(patch.key.face);
+		draw.origin_dir[0] = patch.origin_dir.x;
+		draw.origin_dir[1] = patch.origin_dir.y;
+		draw.origin_dir[2] = patch.origin_dir.z;
+		draw.origin_dir[3] = 0.0f;
+		for (uint32_t e = 0; e < 4; ++e)
+		{
+			const tess_edge_t& edge = patch.edges[e];
+			draw.edge_a[e][0] = edge.a.x;
+			draw.edge_a[e][1] = edge.a.y;
+			draw.edge_a[e][2] = edge.a.z;
+			draw.edge_a[e][3] = edge.min_factor;
+			draw.edge_b[e][0] = edge.b.x;
+			draw.edge_b[e][1] = edge.b.y;
+			draw.edge_b[e][2] = edge.b.z;
+			draw.edge_b[e][3] = edge.divisor;
+		}
+	}
+}
+
+void terrain_renderer_t::upload(GLuint& buffer, GLsizeiptr& capacity, const void* data, const GLsizeiptr size)
+{
+	if (size > capacity)
+	{
+		if (buffer != 0) glDeleteBuffers(1, &buffer);
+		capacity = std::max(size, capacity * 2);
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, capacity, NULL, GL_DYNAMIC_STORAGE_BIT);
+	}
+	glNamedBufferSubData(buffer, 0, size, data);
+}
+
+void terrain_renderer_t::draw(void)
+{
+	if (this->vao_ == 0) return;
+	CONTINUUM_PROFILE_GPU_SCOPE("terrain_draw");
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	const uint32_t current = this->query_frame_ & 1;
+	glBeginQuery(GL_PRIMITIVES_GENERATED, this->queries_[current]);
+	glBindVertexArray(this->vao_);
+	if (this->mode_ == TerrainMode::QUADTREE) draw_quadtree();
+	else draw_tessellation();
+	glBindVertexArray(0);
+	glEndQuery(GL_PRIMITIVES_GENERATED);
+
+	// the previous frame's count, read only once available so that a GPU running behind never stalls the CPU here
+	if (this->query_frame_ > 0)
+	{
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(this->queries_[current ^ 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_TRUE)
+		{
+			GLuint64 primitives = 0;
+			glGetQueryObjectui64v(this->queries_[current ^ 1], GL_QUERY_RESULT, &primitives);
+			this->stats_.triangles = primitives;
+		}
+	}
+	++this->query_frame_;
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	this->stats_.draw_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void terrain_renderer_t::draw_quadtree(void)
+{
+	if (this->commands_.empty()) return;
+
+	// with occlusion culling the commands start without instances, the culler adds the visible ones
+	const bool occlusion = this->occlusion_ != NULL && this->occlusion_->is_available();
+	for (Graphics::draw_elements_indirect_command_t& command : this->commands_) command.instance_count = occlusion ? 0 : 1;
+
+	const GLsizeiptr commands_size = GLsizeiptr(this->commands_.size() * sizeof(Graphics::draw_elements_indirect_command_t));
+	upload(this->draws_buffer_, this->draws_capacity_, this->patch_draws_.data(), GLsizeiptr(this->patch_draws_.size() * sizeof(gpu_patch_draw_t)));
+	upload(this->commands_buffer_, this->commands_capacity_, this->commands_.data(), commands_size);
+	if (occlusion)
+	{
+		const GLsizeiptr instances_size = GLsizeiptr(this->cull_instances_.size() * sizeof(Graphics::gpu_cull_instance_t));
+		upload(this->cull_buffer_, this->cull_capacity_, this->cull_instances_.data(), instances_size);
+		Graphics::hiz_cull_job_t job;
+		job.instances = { this->cull_buffer_, 0, instances_size };
+		job.instance_count = static_cast<uint32_t>(this->cull_instances_.size());
+		job.commands = { this->commands_buffer_, 0, commands_size };
+		job.view_proj = this->view_proj_;
+		job.origin = this->camera_world_;
+		this->occlusion_->cull(job);
+	}
+
+	this->patch_program_->use();
+	this->patch_program_->set_uniform(this->patch_view_proj_, this->view_proj_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TerrainRendererDetail::k_patches_binding, this->draws_buffer_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TerrainRendererDetail::k_noise_params_binding, this->noise_params_buffer_);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commands_buffer_);
+	for (size_t run = 0; run + 1 < this->command_runs_.size(); ++run)
+	{
+		const uint32_t begin = this->command_runs_[run];
+		const uint32_t end = this->command_runs_[run + 1];
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TerrainRendererDetail::k_vertices_binding, this->requests_[begin].vertices.buffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(uintptr_t(begin) * sizeof(Graphics::draw_elements_indirect_command_t)),
+			static_cast<GLsizei>(end - begin), 0);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void terrain_renderer_t::draw_tessellation(void)
+{
+	if (this->tess_draws_.empty()) return;
+
+	upload(this->draws_buffer_, this->draws_capacity_, this->tess_draws_.data(), GLsizeiptr(this->tess_draws_.size() * sizeof(gpu_tess_patch_t)));
+
+	this->tess_program_->use();
+	this->tess_program_->set_uniform(this->tess_view_proj_, this->view_proj_);
+	this->tess_program_->set_uniform(this->tess_camera_pos_, this->camera_pos_);
+	this->tess_program_->set_uniform(this->tess_pixels_per_radian_, this->pixels_per_radian_);
+	this->tess_program_->set_uniform(this->tess_edge_pixels_, this->settings_.tess_edge_pixels);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TerrainRendererDetail::k_noise_params_binding, this->noise_params_buffer_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TerrainRendererDetail::k_patches_binding, this->draws_buffer_);
+
+	// one vertex per patch, its gl_VertexID indexes the patch records
+	glPatchParameteri(GL_PATCH_VERTICES, 1);
+	glMultiDrawArrays(GL_PATCHES, this->batch_firsts_.data(), this->batch_counts_.data(), static_cast<GLsizei>(this->batch_firsts_.size()));
+}
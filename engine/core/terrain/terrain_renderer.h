@@ -0,0 +1,214 @@
+#ifndef TERRAIN_RENDERER_H
+#define TERRAIN_RENDERER_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "quadtree.h"
+#include "patch_generator.h"
+#include "../graphics/culling.h"
+#include "../graphics/ogl_fw/buffer_suballocator.h"
+#include "../graphics/ogl_fw/glslprogram.h"
+#include "../graphics/ogl_fw/indirect_draw.h"
+#include "../graphics/ogl_fw/hiz_culling.h"
+#include "../jobs/job_system.h"
+
+namespace Continuum {
+
+	namespace Terrain {
+
+		namespace TerrainMode {
+			enum TerrainModeType
+			{
+				/// fine CPU quadtree, every leaf a generated 33x33 vertex patch drawn with multi-draw indirect
+				QUADTREE = 0,
+				/// coarse quadtree, the tessellation stages subdivide each leaf and evaluate the noise per vertex
+				TESSELLATION = 1
+			};
+		}
+
+		struct terrain_renderer_settings_t
+		{
+			heightfield_settings_t heightfield = {};
+			/// QUADTREE leaves; heightfield.resolution follows patch_resolution + 1
+			quadtree_settings_t quadtree = {};
+			/// TESSELLATION: target projected length of a tessellated edge segment, in pixels. The coarse
+			/// quadtree splits a leaf only once it would need more than the 64 segments per edge GL guarantees.
+			float tess_edge_pixels = 2.0f;
+			/// QUADTREE patch vertices, PACKED stores 4 instead of 32 bytes per vertex
+			PatchVertexFormat::PatchVertexFormatType vertex_format = PatchVertexFormat::PACKED;
+		};
+
+		struct terrain_renderer_stats_t
+		{
+			/// CPU quadtree nodes of the active mode, all levels
+			uint32_t nodes = 0;
+			uint32_t patches = 0;
+			uint32_t drawn_patches = 0;
+			/// GL_PRIMITIVES_GENERATED of the previous draw(), read back one frame late; keeps the older count when
+			/// the GPU has not finished that draw yet
+			uint64_t triangles = 0;
+			/// GPU bytes holding terrain geometry: resident patch vertices and the grid indices, or the patch records
+			uint64_t geometry_bytes = 0;
+			/// patches generated by the last update()
+			uint32_t generated_patches = 0;
+			double update_ms = 0.0;
+			double draw_ms = 0.0;
+		};
+
+		/// Planet terrain in one of two LOD modes over the same heightfield.
+		/// Both draw camera-relative: per patch origins are subtracted from the camera in double on the CPU,
+		/// the shaders only ever see small offsets. The tessellated mode keeps neighbouring patches crack-free
+		/// by deriving a shared edge's factor on both sides from the coarser patch's edge, see update_tess_patches().
+		struct terrain_renderer_t
+		{
+			terrain_renderer_t(const terrain_renderer_settings_t& settings, Graphics::buffer_suballocator_t& buffers, Jobs::job_system_t* jobs = NULL);
+			~terrain_renderer_t();
+			terrain_renderer_t(const terrain_renderer_t&) = delete;
+			terrain_renderer_t& operator=(const terrain_renderer_t&) = delete;
+		public:
+			/// compiles the programs; false when the quadtree program fails, the tessellation program is optional
+			bool init(const std::string& shader_root);
+			/// TESSELLATION falls back to QUADTREE when its program is not available
+			void set_mode(const TerrainMode::TerrainModeType mode);
+			/// Refines the active quadtree, generates new patches, culls, and builds this frame's draw data.
+			/// camera_pos is planet-centred in double; draws are placed relative to it, so only the rotation of view
+			/// is used and patch vertex buffers never depend on where the camera is.
+			void update(const glm::dvec3& camera_pos, const glm::mat4& view, const glm::mat4& proj, const float viewport_height);
+			/// draws what the last update() built, with the depth state of the caller
+			void draw(void);
+			/// QUADTREE patches are then also occlusion culled on the GPU before they are drawn. The pyramid is
+			/// the caller's to build, around the camera position and proj * view rotation given to update().
+			inline void set_occlusion_culler(Graphics::hiz_culler_t* culler) { this->occlusion_ = culler; }
+		public:
+			inline TerrainMode::TerrainModeType get_mode(void) const { return this->mode_; }
+			inline bool is_tessellation_available(void) const { return this->tess_program_ != NULL; }
+			inline const terrain_renderer_stats_t& get_stats(void) const { return this->stats_; }
+			inline const cube_sphere_quadtree_t& get_quadtree(void) const { return this->mode_ == TerrainMode::TESSELLATION ? this->coarse_quadtree_ : this->quadtree_; }
+			inline patch_generator_t& get_generator(void) { return this->generator_; }
+		private:
+			/// mirrors PatchDraw in terrain_patch.vert (std430)
+			struct gpu_patch_draw_t
+			{
+				/// patch origin relative to the camera
+				float origin[4];
+				/// patch origin relative to the planet centre, for the up vector
+				float planet_origin[4];
+				/// PACKED: face-local u0, v0, u1, v1
+				float bounds[4];
+				/// PACKED: xyz unit direction of the origin, w cube face
+				float origin_dir[4];
+			};
+			/// mirrors TessPatch in terrain_tess.glsl (std430)
+			struct gpu_tess_patch_t
+			{
+				/// face-local u0, v0, u1, v1
+				float bounds[4];
+				/// xyz: origin relative to the camera, w: cube face
+				float origin[4];
+				/// unit direction of the origin
+				float origin_dir[4];
+				/// per edge (u0, v0, u1, v1 side): unit directions of the endpoints of the coarser of the two
+				/// patches sharing it; edge_a w is the minimum factor of that edge, edge_b w the 2^d the finer side divides by
+				float edge_a[4][4];
+				float edge_b[4][4];
+			};
+			struct tess_edge_t
+			{
+				glm::vec3 a = glm::vec3(0.0f);
+				glm::vec3 b = glm::vec3(0.0f);
+				float min_factor = 1.0f;
+				float divisor = 1.0f;
+			};
+			struct tess_patch_t
+			{
+				patch_key_t key = {};
+				glm::vec3 origin_dir = glm::vec3(0.0f);
+				tess_edge_t edges[4];
+			};
+		private:
+			void update_resident(void);
+			void update_tess_patches(void);
+			void cull(const cube_sphere_quadtree_t& quadtree, const glm::vec3& camera_pos, const glm::mat4& view, const glm::mat4& proj);
+			void build_quadtree_draws(const glm::dvec3& camera);
+			void build_tess_draws(const glm::dvec3& camera);
+			void draw_quadtree(void);
+			void draw_tessellation(void);
+			void upload(GLuint& buffer, GLsizeiptr& capacity, const void* data, const GLsizeiptr size);
+			void release(void);
+		private:
+			terrain_renderer_settings_t settings_;
+			Graphics::buffer_suballocator_t& buffers_;
+			patch_generator_t generator_;
+			TerrainMode::TerrainModeType mode_ = TerrainMode::QUADTREE;
+			terrain_renderer_stats_t stats_;
+
+			cube_sphere_quadtree_t quadtree_;
+			cube_sphere_quadtree_t coarse_quadtree_;
+			struct resident_patch_t
+			{
+				Graphics::gpu_allocation_t vertices;
+				/// bounding sphere of the generated vertices, radius 0 when the generator did not report one
+				glm::dvec3 center = glm::dvec3(0.0);
+				float radius = 0.0f;
+			};
+			std::unordered_map<uint64_t, resident_patch_t> resident_;
+			std::vector<patch_request_t> requests_;
+			std::vector<tess_patch_t> tess_patches_;
+			/// per patch edge, the largest level difference to a finer neighbour, indexed by packed key
+			std::unordered_map<uint64_t, glm::uvec4> finer_neighbours_;
+
+			Graphics::bounding_spheres_t spheres_;
+			std::vector<uint32_t> visible_;
+			glm::mat4 view_proj_ = glm::mat4(1.0f);
+			float pixels_per_radian_ = 1.0f;
+			glm::vec3 camera_pos_ = glm::vec3(0.0f);
+			glm::dvec3 camera_world_ = glm::dvec3(0.0);
+			Graphics::hiz_culler_t* occlusion_ = NULL;
+
+			/// visible resident patches with their bounding sphere relative to the camera, grouped by vertex buffer
+			std::vector<std::pair<patch_request_t, glm::vec4>> visible_draws_;
+			std::vector<gpu_patch_draw_t> patch_draws_;
+			/// bounding sphere of every patch draw relative to the camera, for the occlusion culler
+			std::vector<Graphics::gpu_cull_instance_t> cull_instances_;
+			std::vector<Graphics::draw_elements_indirect_command_t> commands_;
+			/// first command of each run of draws sharing a vertex buffer, plus an end marker
+			std::vector<uint32_t> command_runs_;
+			std::vector<gpu_tess_patch_t> tess_draws_;
+			std::vector<GLint> batch_firsts_;
+			std::vector<GLsizei> batch_counts_;
+
+			std::unique_ptr<Graphics::glsl_program_t> patch_program_;
+			std::unique_ptr<Graphics::glsl_program_t> tess_program_;
+			Graphics::uniform_t<glm::mat4> patch_view_proj_;
+			Graphics::uniform_t<glm::mat4> tess_view_proj_;
+			Graphics::uniform_t<glm::vec3> tess_camera_pos_;
+			Graphics::uniform_t<float> tess_pixels_per_radian_;
+			Graphics::uniform_t<float> tess_edge_pixels_;
+			GLuint vao_ = 0;
+			GLuint index_buffer_ = 0;
+			/// the grid's, plus the skirt around it for PACKED patches
+			uint32_t index_count_ = 0;
+			GLuint noise_params_buffer_ = 0;
+			GLuint draws_buffer_ = 0;
+			GLsizeiptr draws_capacity_ = 0;
+			GLuint commands_buffer_ = 0;
+			GLsizeiptr commands_capacity_ = 0;
+			GLuint cull_buffer_ = 0;
+			GLsizeiptr cull_capacity_ = 0;
+			GLuint queries_[2] = {};
+			uint32_t query_frame_ = 0;
+		};
+
+	}
+
+}
+#endif
@@ -0,0 +1,411 @@
+#include "tile_cache.h"
+
+#include "../file_io.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Continuum;
+using namespace Continuum::Terrain;
+
+namespace TileCacheDetail
+{
+	/// read-only mapping of a whole file, unmapped when it goes out of scope
+	class mapped_file_t
+	{
+	public:
+		explicit mapped_file_t(const std::string& path)
+		{
+#ifdef _WIN32
+			file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (file_ == INVALID_HANDLE_VALUE) return;
+			LARGE_INTEGER size = {};
+			if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) return;
+			mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping_ == NULL) return;
+			data_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+			if (data_ != NULL) size_ = static_cast<size_t>(size.QuadPart);
+#else
+			fd_ = open(path.c_str(), O_RDONLY);
+			if (fd_ < 0) return;
+			struct stat st = {};
+			if (fstat(fd_, &st) != 0 || st.st_size <= 0) return;
+			void* data = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+			if (data == MAP_FAILED) return;
+			data_ = data;
+			size_ = static_cast<size_t>(st.st_size);
+#endif
+		}
+		~mapped_file_t()
+		{
+#ifdef _WIN32
+			if (data_ != NULL) UnmapViewOfFile(data_);
+			if (mapping_ != NULL) CloseHandle(mapping_);
+			if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+			if (data_ != NULL) munmap(data_, size_);
+			if (fd_ >= 0) close(fd_);
+#endif
+		}
+		mapped_file_t(const mapped_file_t&) = delete;
+		mapped_file_t& operator=(const mapped_file_t&) = delete;
+	public:
+		inline bool is_open(void) const { return this->data_ != NULL; }
+		inline const uint8_t* data(void) const { return static_cast<const uint8_t*>(this->data_); }
+		inline size_t size(void) const { return this->size_; }
+	private:
+#ifdef _WIN32
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = NULL;
+#else
+		int fd_ = -1;
+#endif
+		void* data_ = NULL;
+		size_t size_ = 0;
+	};
+
+	static inline uint32_t slot_hash(uint64_t key)
+	{
+		// splitmix64 finalizer, the packed key keeps x in its low bits
+		key ^= key >> 30; key *= 0xbf58476d1ce4e5b9ull;
+		key ^= key >> 27; key *= 0x94d049bb133111ebull;
+		key ^= key >> 31;
+		return static_cast<uint32_t>(key);
+	}
+
+	static inline uint32_t payload_checksum(const void* data, const size_t size)
+	{
+		return FileIO::payload_checksum({ { data, size } });
+	}
+
+	/// heights as the file stores them, relative to the tile min/max
+	static void quantize(const heightfield_tile_t& tile, std::vector<uint16_t>& out)
+	{
+		const float range = tile.max_height - tile.min_height;
+		const float scale = range > 0.0f ? 65535.0f / range : 0.0f;
+		out.resize(tile.heights.size());
+		for (size_t i = 0; i < tile.heights.size(); ++i)
+		{
+			const float q = std::round((tile.heights[i] - tile.min_height) * scale);
+			out[i] = static_cast<uint16_t>(std::clamp(q, 0.0f, 65535.0f));
+		}
+	}
+
+	static void dequantize(const uint16_t* in, const size_t count, heightfield_tile_t& tile)
+	{
+		const float step = (tile.max_height - tile.min_height) / 65535.0f;
+		tile.heights.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			tile.heights[i] = tile.min_height + float(in[i]) * step;
+		}
+	}
+
+	static constexpr uint32_t k_min_capacity = 64;
+}
+
+tile_cache_t::tile_cache_t(const heightfield_settings_t& heightfield, const tile_cache_settings_t& settings) :
+	heightfield_(heightfield), settings_(settings)
+{
+	this->heightfield_.resolution = std::max<uint32_t>(this->heightfield_.resolution, 2);
+	this->settings_hash_ = this->heightfield_.hash();
+
+	if (!this->settings_.directory.empty())
+	{
+		char name[32] = {};
+		snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(this->settings_hash_));
+		this->tile_directory_ = this->settings_.directory + "/" + name;
+
+		std::error_code ec = {};
+		std::filesystem::create_directories(this->tile_directory_, ec);
+		if (ec) this->tile_directory_.clear();
+	}
+
+	// twice the tiles the budget can hold keeps probe chains short
+	const size_t tile_bytes = sizeof(entry_t) + size_t(this->heightfield_.resolution) * this->heightfield_.resolution * sizeof(float);
+	const size_t max_tiles = this->settings_.memory_budget / tile_bytes + 1;
+	uint32_t capacity = TileCacheDetail::k_min_capacity;
+	while (capacity < max_tiles * 2 && capacity < (1u << 30)) capacity <<= 1;
+
+	this->capacity_ = capacity;
+	this->slots_ = std::make_unique<slot_t[]>(capacity);
+	for (uint32_t i = 0; i < capacity; ++i)
+	{
+		this->slots_[i].key.store(k_empty, std::memory_order_relaxed);
+	}
+}
+
+tile_cache_t::~tile_cache_t()
+{
+}
+
+std::shared_ptr<const heightfield_tile_t> tile_cache_t::find(const patch_key_t& key) const
+{
+	const uint64_t packed = key.packed();
+	const uint32_t mask = this->capacity_ - 1;
+	uint32_t index = TileCacheDetail::slot_hash(packed) & mask;
+	for (uint32_t probe = 0; probe < this->capacity_; ++probe, index = (index + 1) & mask)
+	{
+		const slot_t& slot = this->slots_[index];
+		const uint64_t slot_key = slot.key.load(std::memory_order_acquire);
+		if (slot_key == k_empty) return NULL;
+		if (slot_key != packed) continue;
+
+		// the slot may be evicted or reused between the two loads, the entry carries its own key
+		const std::shared_ptr<const entry_t> entry = slot.entry.load(std::memory_order_acquire);
+		if (entry == NULL || entry->tile.key != key) return NULL;
+
+		entry->last_use.store(this->clock_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		this->memory_hits_.fetch_add(1, std::memory_order_relaxed);
+		return std::shared_ptr<const heightfield_tile_t>(entry, &entry->tile);
+	}
+	return NULL;
+}
+
+std::shared_ptr<const heightfield_tile_t> tile_cache_t::load(const patch_key_t& key)
+{
+	std::shared_ptr<const heightfield_tile_t> tile = find(key);
+	if (tile != NULL || this->tile_directory_.empty()) return tile;
+
+	const auto t0 = std::chrono::steady_clock::now();
+	heightfield_tile_t loaded = {};
+	if (!read_file(key, loaded)) return NULL;
+	tile = insert(std::move(loaded));
+	const auto t1 = std::chrono::steady_clock::now();
+
+	this->disk_hits_.fetch_add(1, std::memory_order_relaxed);
+	this->load_ns_.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()), std::memory_order_relaxed);
+	return tile;
+}
+
+std::shared_ptr<const heightfield_tile_t> tile_cache_t::store(heightfield_tile_t&& tile)
+{
+	const auto t0 = std::chrono::steady_clock::now();
+
+	// resident tiles go through the same quantization as the file, a tile reads back identical from either
+	std::vector<uint16_t> quantized = {};
+	TileCacheDetail::quantize(tile, quantized);
+	TileCacheDetail::dequantize(quantized.data(), quantized.size(), tile);
+
+	if (!this->tile_directory_.empty()) write_file(tile, quantized);
+	std::shared_ptr<const heightfield_tile_t> resident = insert(std::move(tile));
+	const auto t1 = std::chrono::steady_clock::now();
+
+	this->stores_.fetch_add(1, std::memory_order_relaxed);
+	this->store_ns_.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()), std::memory_order_relaxed);
+	return resident;
+}
+
+std::shared_ptr<const heightfield_tile_t> tile_cache_t::get_or_generate(const patch_key_t& key)
+{
+	std::shared_ptr<const heightfield_tile_t> tile = load(key);
+	if (tile != NULL) return tile;
+
+	this->misses_.fetch_add(1, std::memory_order_relaxed);
+	heightfield_tile_t generated = {};
+	generate_heightfield(this->heightfield_, key, generated);
+	return store(std::move(generated));
+}
+
+void tile_cache_t::clear_memory(void)
+{
+	std::lock_guard<std::mutex> lock(this->write_mutex_);
+	for (uint32_t i = 0; i < this->capacity_; ++i)
+	{
+		this->slots_[i].key.store(k_empty, std::memory_order_release);
+		this->slots_[i].entry.store(NULL, std::memory_order_release);
+	}
+	this->memory_bytes_ = 0;
+	this->resident_tiles_ = 0;
+}
+
+tile_cache_stats_t tile_cache_t::get_stats(void) const
+{
+	tile_cache_stats_t stats = {};
+	stats.memory_hits = this->memory_hits_.load(std::memory_order_relaxed);
+	stats.disk_hits = this->disk_hits_.load(std::memory_order_relaxed);
+	stats.misses = this->misses_.load(std::memory_order_relaxed);
+	stats.rejected = this->rejected_.load(std::memory_order_relaxed);
+	stats.stores = this->stores_.load(std::memory_order_relaxed);
+	stats.evictions = this->evictions_.load(std::memory_order_relaxed);
+	stats.load_ms = double(this->load_ns_.load(std::memory_order_relaxed)) * 1e-6;
+	stats.store_ms = double(this->store_ns_.load(std::memory_order_relaxed)) * 1e-6;
+	stats.lock_free_lookups = this->slots_[0].entry.is_lock_free();
+	{
+		std::lock_guard<std::mutex> lock(this->write_mutex_);
+		stats.memory_bytes = this->memory_bytes_;
+		stats.resident_tiles = this->resident_tiles_;
+	}
+	return stats;
+}
+
+std::string tile_cache_t::get_tile_path(const patch_key_t& key) const
+{
+	char name[64] = {};
+	snprintf(name, sizeof(name), "/%u/%u/%u_%u.ctile", unsigned(key.face), unsigned(key.level), key.x, key.y);
+	return this->tile_directory_ + name;
+}
+
+std::shared_ptr<const heightfield_tile_t> tile_cache_t::insert(heightfield_tile_t&& tile)
+{
+	auto entry = std::make_shared<entry_t>();
+	entry->tile = std::move(tile);
+	entry->bytes = sizeof(entry_t) + entry->tile.heights.capacity() * sizeof(float);
+	const uint64_t packed = entry->tile.key.packed();
+
+	std::lock_guard<std::mutex> lock(this->write_mutex_);
+	entry->last_use.store(this->clock_.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	// keep a quarter of the slots empty so misses stop probing early
+	if (this->resident_tiles_ + 1 > this->capacity_ - this->capacity_ / 4)
+	{
+		evict(this->memory_bytes_, packed);
+	}
+
+	const uint32_t mask = this->capacity_ - 1;
+	uint32_t index = TileCacheDetail::slot_hash(packed) & mask;
+	uint32_t target = this->capacity_;
+	for (uint32_t probe = 0; probe < this->capacity_; ++probe, index = (index + 1) & mask)
+	{
+		const uint64_t slot_key = this->slots_[index].key.load(std::memory_order_relaxed);
+		if (slot_key == packed)
+		{
+			// a concurrent loader got here first, replace its copy
+			const std::shared_ptr<const entry_t> previous = this->slots_[index].entry.load(std::memory_order_relaxed);
+			if (previous != NULL) this->memory_bytes_ -= previous->bytes;
+			--this->resident_tiles_;
+			target = index;
+			break;
+		}
+		if (slot_key == k_tombstone && target == this->capacity_) target = index;
+		if (slot_key == k_empty)
+		{
+			if (target == this->capacity_) target = index;
+			break;
+		}
+	}
+
+	// entry before key, a reader that sees the key also sees the entry
+	slot_t& slot = this->slots_[target];
+	slot.entry.store(entry, std::memory_order_release);
+	slot.key.store(packed, std::memory_order_release);
+	this->memory_bytes_ += entry->bytes;
+	++this->resident_tiles_;
+
+	if (this->memory_bytes_ > this->settings_.memory_budget)
+	{
+		// evict in batches, a full scan per insert would dominate once the budget is reached
+		evict(this->settings_.memory_budget - this->settings_.memory_budget / 10, packed);
+	}
+	return std::shared_ptr<const heightfield_tile_t>(entry, &entry->tile);
+}
+
+void tile_cache_t::evict(const size_t target_bytes, const uint64_t keep)
+{
+	std::vector<std::pair<uint64_t, uint32_t>> candidates = {};
+	candidates.reserve(this->resident_tiles_);
+	for (uint32_t i = 0; i < this->capacity_; ++i)
+	{
+		const uint64_t slot_key = this->slots_[i].key.load(std::memory_order_relaxed);
+		if (slot_key == k_empty || slot_key == k_tombstone || slot_key == keep) continue;
+		const std::shared_ptr<const entry_t> entry = this->slots_[i].entry.load(std::memory_order_relaxed);
+		candidates.push_back({ entry->last_use.load(std::memory_order_relaxed), i });
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	// also frees slots, evicting only by bytes could leave the table without room when tiles are small
+	const uint32_t target_tiles = this->capacity_ / 2;
+	const uint32_t mask = this->capacity_ - 1;
+	for (const std::pair<uint64_t, uint32_t>& candidate : candidates)
+	{
+		if (this->memory_bytes_ <= target_bytes && this->resident_tiles_ <= target_tiles) break;
+
+		slot_t& slot = this->slots_[candidate.second];
+		const std::shared_ptr<const entry_t> entry = slot.entry.load(std::memory_order_relaxed);
+		slot.key.store(k_tombstone, std::memory_order_release);
+		slot.entry.store(NULL, std::memory_order_release);
+		this->memory_bytes_ -= entry->bytes;
+		--this->resident_tiles_;
+		this->evictions_.fetch_add(1, std::memory_order_relaxed);
+
+		// a tombstone followed by an empty slot ends no probe chain, turn the run back into empty slots
+		uint32_t index = candidate.second;
+		if (this->slots_[(index + 1) & mask].key.load(std::memory_order_relaxed) != k_empty) continue;
+		while (this->slots_[index].key.load(std::memory_order_relaxed) == k_tombstone)
+		{
+			this->slots_[index].key.store(k_empty, std::memory_order_release);
+			index = (index - 1) & mask;
+		}
+	}
+}
+
+bool tile_cache_t::read_file(const patch_key_t& key, heightfield_tile_t& tile)
+{
+	const TileCacheDetail::mapped_file_t file(get_tile_path(key));
+	if (!file.is_open()) return false;
+
+	tile_file_header_t header = {};
+	const size_t count = size_t(this->heightfield_.resolution) * this->heightfield_.resolution;
+	const size_t payload = count * sizeof(uint16_t);
+	if (file.size() >= sizeof(header)) memcpy(&header, file.data(), sizeof(header));
+
+	const bool valid = file.size() == sizeof(header) + payload
+		&& header.magic == tile_file_header_t::k_magic
+		&& header.version == tile_file_header_t::k_version
+		&& header.header_size == sizeof(tile_file_header_t)
+		&& header.settings_hash == this->settings_hash_
+		&& header.seed == this->heightfield_.noise.seed
+		&& header.face == key.face && header.level == key.level && header.x == key.x && header.y == key.y
+		&& header.resolution == this->heightfield_.resolution
+		&& header.min_height <= header.max_height
+		&& header.checksum == TileCacheDetail::payload_checksum(file.data() + sizeof(header), payload);
+	if (!valid)
+	{
+		// stale or truncated, regenerated and overwritten by the caller
+		this->rejected_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	tile.key = key;
+	tile.resolution = header.resolution;
+	tile.min_height = header.min_height;
+	tile.max_height = header.max_height;
+
+	// the payload sits 48 bytes into a page-aligned mapping, aligned for uint16_t
+	TileCacheDetail::dequantize(reinterpret_cast<const uint16_t*>(file.data() + sizeof(header)), count, tile);
+	return true;
+}
+
+void tile_cache_t::write_file(const heightfield_tile_t& tile, const std::vector<uint16_t>& quantized) const
+{
+	tile_file_header_t header = {};
+	header.settings_hash = this->settings_hash_;
+	header.seed = this->heightfield_.noise.seed;
+	header.face = tile.key.face;
+	header.level = tile.key.level;
+	header.resolution = static_cast<uint16_t>(tile.resolution);
+	header.x = tile.key.x;
+	header.y = tile.key.y;
+	header.min_height = tile.min_height;
+	header.max_height = tile.max_height;
+	header.checksum = TileCacheDetail::payload_checksum(quantized.data(), quantized.size() * sizeof(uint16_t));
+
+	// workers storing the same tile each rename a complete file, the last one wins
+	FileIO::write_file_atomic(get_tile_path(tile.key), { { &header, sizeof(header) }, { quantized.data(), quantized.size() * sizeof(uint16_t) } });
+}
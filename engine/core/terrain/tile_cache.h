@@ -0,0 +1,141 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "heightfield.h"
+
+namespace Continuum {
+
+	namespace Terrain {
+
+		/// on-disk tile: this header followed by resolution^2 uint16 heights quantized between min and max
+		struct tile_file_header_t
+		{
+			static constexpr uint32_t k_magic = 0x4C495443; // "CTIL"
+			static constexpr uint16_t k_version = 1;
+
+			uint32_t magic = k_magic;
+			uint16_t version = k_version;
+			uint16_t header_size = sizeof(tile_file_header_t);
+			uint64_t settings_hash = 0;
+			uint32_t seed = 0;
+			uint8_t face = 0;
+			uint8_t level = 0;
+			uint16_t resolution = 0;
+			uint32_t x = 0;
+			uint32_t y = 0;
+			float min_height = 0.0f;
+			float max_height = 0.0f;
+			/// low 32 bits of the FNV-1a hash of the quantized heights
+			uint32_t checksum = 0;
+			uint32_t reserved = 0;
+		};
+		static_assert(sizeof(tile_file_header_t) == 48, "tile header layout is part of the file format");
+
+		struct tile_cache_settings_t
+		{
+			/// tiles live in <directory>/<settings hash>/, empty keeps the cache in memory only
+			std::string directory = "tile_cache";
+			/// decoded tiles kept in memory, the least recently used are evicted past this
+			size_t memory_budget = 64ull * 1024 * 1024;
+		};
+
+		struct tile_cache_stats_t
+		{
+			uint64_t memory_hits = 0;
+			uint64_t disk_hits = 0;
+			uint64_t misses = 0;
+			/// files with a bad header, checksum or size
+			uint64_t rejected = 0;
+			uint64_t stores = 0;
+			uint64_t evictions = 0;
+			size_t memory_bytes = 0;
+			uint32_t resident_tiles = 0;
+			double load_ms = 0.0;
+			double store_ms = 0.0;
+			/// false when the standard library guards atomic shared pointers with a lock, lookups then
+			/// briefly contend on it with the writer instead of being lock-free
+			bool lock_free_lookups = false;
+		};
+
+		/// Heightfield tiles cached in memory and on disk. Lookups in memory never take the cache mutex (an
+		/// open-addressing table of atomic shared pointers, readers only stamp the entry they hit); inserts and
+		/// evictions serialize on it. Whether a lookup is also lock-free depends on std::atomic<std::shared_ptr>,
+		/// which libstdc++ and MSVC implement with a small internal lock per pointer, see
+		/// tile_cache_stats_t::lock_free_lookups. Files are read back through a memory mapping outside the mutex.
+		class tile_cache_t
+		{
+		public:
+			tile_cache_t(const heightfield_settings_t& heightfield, const tile_cache_settings_t& settings = tile_cache_settings_t());
+			~tile_cache_t();
+			tile_cache_t(const tile_cache_t&) = delete;
+			tile_cache_t& operator=(const tile_cache_t&) = delete;
+		public:
+			/// memory only, never blocks
+			std::shared_ptr<const heightfield_tile_t> find(const patch_key_t& key) const;
+			/// memory, then disk; NULL when the tile was never stored
+			std::shared_ptr<const heightfield_tile_t> load(const patch_key_t& key);
+			/// quantizes the tile exactly as the file does, writes it and makes it resident
+			std::shared_ptr<const heightfield_tile_t> store(heightfield_tile_t&& tile);
+			/// load(), or generate_heightfield() and store() on a miss; safe to call from job workers
+			std::shared_ptr<const heightfield_tile_t> get_or_generate(const patch_key_t& key);
+			/// drops every resident tile, the files stay
+			void clear_memory(void);
+		public:
+			tile_cache_stats_t get_stats(void) const;
+			std::string get_tile_path(const patch_key_t& key) const;
+			inline const heightfield_settings_t& get_heightfield_settings(void) const { return this->heightfield_; }
+		private:
+			struct entry_t
+			{
+				heightfield_tile_t tile;
+				size_t bytes = 0;
+				mutable std::atomic<uint64_t> last_use = 0;
+			};
+			struct slot_t
+			{
+				std::atomic<uint64_t> key;
+				std::atomic<std::shared_ptr<const entry_t>> entry;
+			};
+			static constexpr uint64_t k_empty = ~0ull;
+			static constexpr uint64_t k_tombstone = ~0ull - 1;
+
+			std::shared_ptr<const heightfield_tile_t> insert(heightfield_tile_t&& tile);
+			void evict(const size_t target_bytes, const uint64_t keep);
+			bool read_file(const patch_key_t& key, heightfield_tile_t& tile);
+			void write_file(const heightfield_tile_t& tile, const std::vector<uint16_t>& quantized) const;
+		private:
+			heightfield_settings_t heightfield_;
+			tile_cache_settings_t settings_;
+			std::string tile_directory_;
+			uint64_t settings_hash_ = 0;
+
+			std::unique_ptr<slot_t[]> slots_;
+			uint32_t capacity_ = 0;
+			mutable std::mutex write_mutex_;
+			/// advanced by every insert, readers copy it into the entries they hit
+			std::atomic<uint64_t> clock_ = 0;
+			size_t memory_bytes_ = 0;
+			uint32_t resident_tiles_ = 0;
+
+			mutable std::atomic<uint64_t> memory_hits_ = 0;
+			std::atomic<uint64_t> disk_hits_ = 0;
+			std::atomic<uint64_t> misses_ = 0;
+			std::atomic<uint64_t> rejected_ = 0;
+			std::atomic<uint64_t> stores_ = 0;
+			std::atomic<uint64_t> evictions_ = 0;
+			std::atomic<uint64_t> load_ns_ = 0;
+			std::atomic<uint64_t> store_ns_ = 0;
+		};
+
+	}
+
+}
+#endif
@@ -0,0 +1,106 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+// Encoders of the packed terrain vertex, mirrored by shader/terrain/vertex_packing.glsl.
+
+namespace Continuum {
+
+	namespace Terrain {
+
+		namespace VertexPacking {
+
+			static constexpr float k_snorm8_max = 127.0f;
+			static constexpr float k_height_steps = 65535.0f;
+
+			/// unit vector folded onto the octahedron and unfolded into [-1, 1]^2 (Cigolle et al. 2014)
+			static inline glm::vec2 oct_project(const glm::vec3& n)
+			{
+				const float inv_l1 = 1.0f / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+				glm::vec2 p = glm::vec2(n.x, n.y) * inv_l1;
+				if (n.z < 0.0f)
+				{
+					p = glm::vec2((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+				}
+				return p;
+			}
+
+			static inline glm::vec3 oct_unproject(const glm::vec2& p)
+			{
+				glm::vec3 n = glm::vec3(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+				const float t = std::max(-n.z, 0.0f);
+				n.x += n.x >= 0.0f ? -t : t;
+				n.y += n.y >= 0.0f ? -t : t;
+				return glm::normalize(n);
+			}
+
+			static inline glm::vec3 oct_decode(const int8_t encoded[2])
+			{
+				return oct_unproject(glm::max(glm::vec2(float(encoded[0]), float(encoded[1])) / k_snorm8_max, glm::vec2(-1.0f)));
+			}
+
+			/// two snorm8 components; of the four roundings around the projection the one decoding closest to n
+			/// is kept, which roughly halves the worst angular error of plain rounding
+			static inline void oct_encode(const glm::vec3& n, int8_t encoded[2])
+			{
+				const glm::vec2 p = oct_project(n) * k_snorm8_max;
+				const float x0 = std::floor(p.x);
+				const float y0 = std::floor(p.y);
+				float best = -1.0f;
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					const float qx = std::min(x0 + float(c & 1), k_snorm8_max);
+					const float qy = std::min(y0 + float(c >> 1), k_snorm8_max);
+					// cos^2 of the angle to the unnormalized decode, candidates facing away score below zero
+					glm::vec3 d = glm::vec3(qx, qy, k_snorm8_max - std::abs(qx) - std::abs(qy));
+					const float t = std::max(-d.z, 0.0f);
+					d.x += d.x >= 0.0f ? -t : t;
+					d.y += d.y >= 0.0f ? -t : t;
+					const float dn = glm::dot(d, n);
+					const float score = dn * std::abs(dn) / glm::dot(d, d);
+					if (score > best)
+					{
+						best = score;
+						encoded[0] = int8_t(qx);
+						encoded[1] = int8_t(qy);
+					}
+				}
+			}
+
+			/// metres per height step of a patch spanning [min_height, max_height]
+			static inline float height_step(const float min_height, const float max_height)
+			{
+				return (max_height - min_height) / k_height_steps;
+			}
+
+			static inline uint16_t quantize_height(const float height, const float min_height, const float step)
+			{
+				if (step <= 0.0f) return 0;
+				return uint16_t(std::clamp(std::floor((height - min_height) / step + 0.5f), 0.0f, k_height_steps));
+			}
+
+			static inline float dequantize_height(const uint16_t quantized, const float min_height, const float step)
+			{
+				return min_height + float(quantized) * step;
+			}
+
+			/// edge vertices quantize over the planet's whole [0, max_height] instead of their patch's range: both
+			/// patches sharing an edge then store the same value for it and decode the same float, whatever their
+			/// own ranges, so the per-patch range cannot open a crack
+			static inline bool is_edge_vertex(const uint32_t i, const uint32_t j, const uint32_t resolution)
+			{
+				return i == 0 || j == 0 || i + 1 >= resolution || j + 1 >= resolution;
+			}
+
+		}
+
+	}
+
+}
+#endif
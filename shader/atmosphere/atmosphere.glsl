@@ -0,0 +1,238 @@
+// Shared by the atmosphere passes: Bruneton's lookups into the tables baked by Atmosphere::bake_tables(),
+// mirrored on the CPU in engine/core/atmosphere/atmosphere.cpp. Lengths in metres, positions planet-centred.
+
+// mirrors gpu_atmosphere_params_t in atmosphere_renderer.h (std140)
+layout(std140, binding = 1) uniform AtmosphereParams
+{
+	vec4 solar_irradiance;      // w: sun angular radius
+	vec4 rayleigh_scattering;   // w: Rayleigh scale height
+	vec4 mie_scattering;        // w: Mie scale height
+	vec4 mie_extinction;        // w: Mie phase g
+	vec4 ozone_absorption;      // w: ozone altitude
+	vec4 ground_albedo;         // w: ozone width
+	vec4 radii;                 // x: bottom, y: top, z: ground to top along the horizon, w: mu_s_min
+};
+
+layout(binding = 0) uniform sampler2D transmittance_texture;
+layout(binding = 1) uniform sampler2D multiple_scattering_texture;
+layout(binding = 2) uniform sampler3D scattering_texture;
+layout(binding = 3) uniform sampler2D irradiance_texture;
+
+// atmosphere_tables_t
+const int TRANSMITTANCE_WIDTH = 256;
+const int TRANSMITTANCE_HEIGHT = 64;
+const int SCATTERING_R = 32;
+const int SCATTERING_MU = 128;
+const int SCATTERING_MU_S = 32;
+const int SCATTERING_NU = 8;
+const int IRRADIANCE_WIDTH = 64;
+const int IRRADIANCE_HEIGHT = 16;
+const int MULTIPLE_SCATTERING_SIZE = 32;
+
+const float PI = 3.14159265358979;
+
+float clamp_cosine(float mu) { return clamp(mu, -1.0, 1.0); }
+float clamp_radius(float r) { return clamp(r, radii.x, radii.y); }
+float safe_sqrt(float a) { return sqrt(max(a, 0.0)); }
+// r * r - R * R without the cancellation, r is only metre-accurate this far from the centre
+float radius_difference(float r, float R) { return (r - R) * (r + R); }
+
+float distance_to_top(float r, float mu)
+{
+	return max(-r * mu + safe_sqrt(r * r * (mu * mu - 1.0) + radii.y * radii.y), 0.0);
+}
+
+float distance_to_bottom(float r, float mu)
+{
+	return max(-r * mu - safe_sqrt(r * r * (mu * mu - 1.0) + radii.x * radii.x), 0.0);
+}
+
+bool intersects_ground(float r, float mu)
+{
+	return mu < 0.0 && r * r * (mu * mu - 1.0) + radii.x * radii.x >= 0.0;
+}
+
+float coord_from_unit(float x, int size) { return 0.5 / float(size) + x * (1.0 - 1.0 / float(size)); }
+
+float rayleigh_phase(float nu) { return 3.0 / (16.0 * PI) * (1.0 + nu * nu); }
+
+float mie_phase(float nu)
+{
+	float g = mie_extinction.w;
+	float k = 3.0 / (8.0 * PI) * (1.0 - g * g) / (2.0 + g * g);
+	return k * (1.0 + nu * nu) / pow(1.0 + g * g - 2.0 * g * nu, 1.5);
+}
+
+float rayleigh_density(float altitude) { return exp(-altitude / rayleigh_scattering.w); }
+float mie_density(float altitude) { return exp(-altitude / mie_scattering.w); }
+float ozone_density(float altitude) { return max(0.0, 1.0 - abs(altitude - ozone_absorption.w) / (0.5 * ground_albedo.w)); }
+
+vec3 extinction_at(float altitude)
+{
+	return rayleigh_scattering.rgb * rayleigh_density(altitude) + mie_extinction.rgb * mie_density(altitude) + ozone_absorption.rgb * ozone_density(altitude);
+}
+
+vec3 scattering_at(float altitude)
+{
+	return rayleigh_scattering.rgb * rayleigh_density(altitude) + mie_scattering.rgb * mie_density(altitude);
+}
+
+vec3 get_transmittance_to_top(float r, float mu)
+{
+	float rho = safe_sqrt(radius_difference(r, radii.x));
+	float d = distance_to_top(r, mu);
+	float d_min = radii.y - r;
+	float d_max = rho + radii.z;
+	vec2 uv = vec2(coord_from_unit((d - d_min) / (d_max - d_min), TRANSMITTANCE_WIDTH), coord_from_unit(rho / radii.z, TRANSMITTANCE_HEIGHT));
+	return texture(transmittance_texture, uv).rgb;
+}
+
+// between the point at r, mu and the one d further along the ray
+vec3 get_transmittance(float r, float mu, float d, bool ground)
+{
+	float r_d = clamp_radius(sqrt(d * d + 2.0 * r * mu * d + r * r));
+	float mu_d = clamp_cosine((r * mu + d) / r_d);
+	if (ground) return min(get_transmittance_to_top(r_d, -mu_d) / get_transmittance_to_top(r, -mu), vec3(1.0));
+	return min(get_transmittance_to_top(r, mu) / get_transmittance_to_top(r_d, mu_d), vec3(1.0));
+}
+
+vec3 get_transmittance_to_sun(float r, float mu_s)
+{
+	float sin_h = radii.x / r;
+	float cos_h = -safe_sqrt(1.0 - sin_h * sin_h);
+	float alpha = solar_irradiance.w;
+	return get_transmittance_to_top(r, mu_s) * smoothstep(-sin_h * alpha, sin_h * alpha, mu_s - cos_h);
+}
+
+vec3 get_multiple_scattering(float r, float mu_s)
+{
+	vec2 uv = vec2(coord_from_unit(mu_s * 0.5 + 0.5, MULTIPLE_SCATTERING_SIZE), coord_from_unit((r - radii.x) / (radii.y - radii.x), MULTIPLE_SCATTERING_SIZE));
+	return texture(multiple_scattering_texture, uv).rgb;
+}
+
+vec4 scattering_uvwz(float r, float mu, float mu_s, float nu, bool ground)
+{
+	float H = radii.z;
+	float rho = safe_sqrt(radius_difference(r, radii.x));
+	float u_r = coord_from_unit(rho / H, SCATTERING_R);
+
+	float r_mu = r * mu;
+	float discriminant = r_mu * r_mu - radius_difference(r, radii.x);
+	float u_mu;
+	if (ground)
+	{
+		float d = -r_mu - safe_sqrt(discriminant);
+		float d_min = r - radii.x;
+		float d_max = rho;
+		u_mu = 0.5 - 0.5 * coord_from_unit(d_max == d_min ? 0.0 : (d - d_min) / (d_max - d_min), SCATTERING_MU / 2);
+	}
+	else
+	{
+		float d = -r_mu + safe_sqrt(discriminant + H * H);
+		float d_min = radii.y - r;
+		float d_max = rho + H;
+		u_mu = 0.5 + 0.5 * coord_from_unit((d - d_min) / (d_max - d_min), SCATTERING_MU / 2);
+	}
+
+	float d = distance_to_top(radii.x, mu_s);
+	float d_min = radii.y - radii.x;
+	float d_max = H;
+	float a = (d - d_min) / (d_max - d_min);
+	float A = (distance_to_top(radii.x, radii.w) - d_min) / (d_max - d_min);
+	float u_mu_s = coord_from_unit(max(1.0 - a / A, 0.0) / (1.0 + a), SCATTERING_MU_S);
+
+	return vec4((nu + 1.0) * 0.5, u_mu_s, u_mu, u_r);
+}
+
+// the 4D lookup, two filtered fetches blended along nu
+vec4 get_scattering(float r, float mu, float mu_s, float nu, bool ground)
+{
+	vec4 uvwz = scattering_uvwz(r, mu, mu_s, nu, ground);
+	float tex_coord_x = uvwz.x * float(SCATTERING_NU - 1);
+	float tex_x = floor(tex_coord_x);
+	float t = tex_coord_x - tex_x;
+	vec3 uvw0 = vec3((tex_x + uvwz.y) / float(SCATTERING_NU), uvwz.z, uvwz.w);
+	vec3 uvw1 = vec3((min(tex_x + 1.0, float(SCATTERING_NU - 1)) + uvwz.y) / float(SCATTERING_NU), uvwz.z, uvwz.w);
+	return mix(texture(scattering_texture, uvw0), texture(scattering_texture, uvw1), t);
+}
+
+// Mie rgb from the red channel stored in a
+vec3 extrapolated_mie(vec4 scattering)
+{
+	if (scattering.r <= 0.0) return vec3(0.0);
+	return scattering.rgb * (scattering.a / scattering.r) * (rayleigh_scattering.r / mie_scattering.r) * (mie_scattering.rgb / rayleigh_scattering.rgb);
+}
+
+// radiance along view_ray, the sun disk excluded; transmittance of the ray to the top of the atmosphere
+vec3 get_sky_radiance(vec3 camera, vec3 view_ray, vec3 sun_direction, out vec3 transmittance)
+{
+	float r = length(camera);
+	float r_mu = dot(camera, view_ray);
+	float discriminant = r_mu * r_mu - r * r + radii.y * radii.y;
+	transmittance = vec3(1.0);
+	// from space, start where the ray enters the atmosphere
+	if (r > radii.y)
+	{
+		if (discriminant < 0.0 || r_mu > 0.0) return vec3(0.0);
+		float entry = -r_mu - sqrt(discriminant);
+		camera += view_ray * entry;
+		r = radii.y;
+		r_mu += entry;
+	}
+
+	float mu = r_mu / r;
+	float mu_s = dot(camera, sun_direction) / r;
+	float nu = dot(view_ray, sun_direction);
+	bool ground = intersects_ground(r, mu);
+	transmittance = ground ? vec3(0.0) : get_transmittance_to_top(r, mu);
+
+	vec4 scattering = get_scattering(r, mu, mu_s, nu, ground);
+	return scattering.rgb * rayleigh_phase(nu) + extrapolated_mie(scattering) * mie_phase(nu);
+}
+
+// in-scattered radiance between camera and point, and the transmittance between them (aerial perspective)
+vec3 get_sky_radiance_to_point(vec3 camera, vec3 point, vec3 sun_direction, out vec3 transmittance)
+{
+	vec3 view_ray = normalize(point - camera);
+	float r = length(camera);
+	float r_mu = dot(camera, view_ray);
+	float discriminant = r_mu * r_mu - r * r + radii.y * radii.y;
+	transmittance = vec3(1.0);
+	if (r > radii.y)
+	{
+		if (discriminant < 0.0 || r_mu > 0.0) return vec3(0.0);
+		float entry = -r_mu - sqrt(discriminant);
+		camera += view_ray * entry;
+		r = radii.y;
+		r_mu += entry;
+	}
+
+	float mu = r_mu / r;
+	float mu_s = dot(camera, sun_direction) / r;
+	float nu = dot(view_ray, sun_direction);
+	float d = max(dot(point - camera, view_ray), 0.0);
+	bool ground = intersects_ground(r, mu);
+	transmittance = get_transmittance(r, mu, d, ground);
+
+	float r_p = clamp_radius(sqrt(d * d + 2.0 * r * mu * d + r * r));
+	float mu_p = (r * mu + d) / r_p;
+	float mu_s_p = (r * mu_s + d * nu) / r_p;
+	vec4 scattering = get_scattering(r, mu, mu_s, nu, ground);
+	vec4 scattering_p = get_scattering(r_p, mu_p, mu_s_p, nu, ground);
+
+	vec3 rayleigh = max(scattering.rgb - transmittance * scattering_p.rgb, vec3(0.0));
+	// the extrapolated Mie difference is unreliable for a sun below the horizon (Bruneton's fade)
+	vec3 mie = max(extrapolated_mie(scattering) - transmittance * extrapolated_mie(scattering_p), vec3(0.0)) * smoothstep(0.0, 0.01, mu_s);
+	return rayleigh * rayleigh_phase(nu) + mie * mie_phase(nu);
+}
+
+// sun and sky irradiance on a surface with the given normal at point
+vec3 get_sun_and_sky_irradiance(vec3 point, vec3 normal, vec3 sun_direction, out vec3 sky_irradiance)
+{
+	float r = length(point);
+	float mu_s = dot(point, sun_direction) / r;
+	vec2 uv = vec2(coord_from_unit(mu_s * 0.5 + 0.5, IRRADIANCE_WIDTH), coord_from_unit((r - radii.x) / (radii.y - radii.x), IRRADIANCE_HEIGHT));
+	// the table holds a horizontal surface, tilted ones see part of the ground instead
+	sky_irradiance = texture(irradiance_texture, uv).rgb * (1.0 + dot(normal, point) / r) * 0.5;
+	return solar_irradiance.rgb * get_transmittance_to_sun(r, mu_s) * max(dot(normal, sun_direction), 0.0);
+}
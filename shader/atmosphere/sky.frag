@@ -0,0 +1,53 @@
+//
+#version 450 core
+
+// Drawn over the lit scene. Sky pixels get the sky radiance and the sun disk; geometry pixels are attenuated
+// and get the light scattered in between camera and surface, through dual-source blending with
+// (GL_ONE, GL_SRC1_COLOR). Two to four filtered table fetches per pixel, two more for geometry.
+
+#include "atmosphere.glsl"
+
+layout (location=0) in vec2 in_ndc;
+
+layout (location=0, index=0) out vec4 out_FragColor;
+layout (location=0, index=1) out vec4 out_Transmittance;
+
+layout(binding = 4) uniform sampler2D depth_texture;
+
+// inverse of the camera-relative view projection, proj * mat4(mat3(view))
+uniform mat4 inv_view_proj;
+uniform vec3 camera;
+uniform vec3 sun_direction;
+uniform float exposure;
+
+vec3 tonemap(vec3 radiance)
+{
+	return 1.0 - exp(-radiance * exposure);
+}
+
+void main()
+{
+	float depth = texelFetch(depth_texture, ivec2(gl_FragCoord.xy), 0).r;
+	vec4 p = inv_view_proj * vec4(in_ndc, depth * 2.0 - 1.0, 1.0);
+	vec3 offset = p.xyz / p.w;
+	vec3 view_ray = normalize(offset);
+
+	vec3 transmittance;
+	if (depth >= 1.0)
+	{
+		vec3 radiance = get_sky_radiance(camera, view_ray, sun_direction, transmittance);
+		float alpha = solar_irradiance.w;
+		if (dot(view_ray, sun_direction) > cos(alpha))
+		{
+			radiance += transmittance * solar_irradiance.rgb / (PI * alpha * alpha);
+		}
+		out_FragColor = vec4(tonemap(radiance), 1.0);
+		out_Transmittance = vec4(0.0);
+	}
+	else
+	{
+		vec3 in_scattered = get_sky_radiance_to_point(camera, camera + offset, sun_direction, transmittance);
+		out_FragColor = vec4(tonemap(in_scattered), 1.0);
+		out_Transmittance = vec4(transmittance, 1.0);
+	}
+}
@@ -0,0 +1,13 @@
+//
+#version 450 core
+
+// Full-screen triangle without vertex buffers.
+
+layout (location=0) out vec2 out_ndc;
+
+void main()
+{
+	vec2 ndc = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+	out_ndc = ndc;
+	gl_Position = vec4(ndc, 0.0, 1.0);
+}
@@ -0,0 +1,87 @@
+//
+#version 450 core
+
+// Brute-force sky for comparison with sky.frag: the view ray is ray marched with a nested march towards the
+// sun per sample, only the small multiple scattering table is read. Same outputs and blending as sky.frag.
+
+#include "atmosphere.glsl"
+
+layout (location=0) in vec2 in_ndc;
+
+layout (location=0, index=0) out vec4 out_FragColor;
+layout (location=0, index=1) out vec4 out_Transmittance;
+
+uniform mat4 inv_view_proj;
+uniform vec3 camera;
+uniform vec3 sun_direction;
+uniform float exposure;
+uniform int view_steps;
+uniform int sun_steps;
+
+void main()
+{
+	vec4 p = inv_view_proj * vec4(in_ndc, 1.0, 1.0);
+	vec3 view_ray = normalize(p.xyz / p.w);
+
+	vec3 origin = camera;
+	float r = length(origin);
+	float r_mu = dot(origin, view_ray);
+	float discriminant = r_mu * r_mu - r * r + radii.y * radii.y;
+	vec3 radiance = vec3(0.0);
+	vec3 optical_depth = vec3(0.0);
+	bool ground = false;
+	bool inside = r <= radii.y || (discriminant >= 0.0 && r_mu <= 0.0);
+	if (inside)
+	{
+		if (r > radii.y)
+		{
+			float entry = -r_mu - sqrt(discriminant);
+			origin += view_ray * entry;
+			r = radii.y;
+			r_mu += entry;
+		}
+		float mu = r_mu / r;
+		ground = intersects_ground(r, mu);
+		float dt = (ground ? distance_to_bottom(r, mu) : distance_to_top(r, mu)) / float(view_steps);
+		float nu = dot(view_ray, sun_direction);
+		float phase_r = rayleigh_phase(nu);
+		float phase_m = mie_phase(nu);
+
+		for (int i = 0; i < view_steps; ++i)
+		{
+			vec3 x = origin + view_ray * ((float(i) + 0.5) * dt);
+			float r_x = length(x);
+			float altitude = r_x - radii.x;
+			float mu_s = dot(x, sun_direction) / r_x;
+			vec3 sigma_t = extinction_at(altitude);
+			vec3 view_transmittance = exp(-(optical_depth + sigma_t * (0.5 * dt)));
+			optical_depth += sigma_t * dt;
+
+			vec3 sun_transmittance = vec3(0.0);
+			if (!intersects_ground(r_x, mu_s))
+			{
+				float ds = distance_to_top(r_x, mu_s) / float(sun_steps);
+				vec3 sun_depth = vec3(0.0);
+				for (int j = 0; j < sun_steps; ++j)
+				{
+					vec3 y = x + sun_direction * ((float(j) + 0.5) * ds);
+					sun_depth += extinction_at(length(y) - radii.x) * ds;
+				}
+				sun_transmittance = exp(-sun_depth);
+			}
+
+			vec3 single = (rayleigh_scattering.rgb * (rayleigh_density(altitude) * phase_r) + mie_scattering.rgb * (mie_density(altitude) * phase_m)) * sun_transmittance;
+			vec3 multiple = scattering_at(altitude) * get_multiple_scattering(r_x, mu_s);
+			radiance += view_transmittance * (single + multiple) * dt;
+		}
+		radiance *= solar_irradiance.rgb;
+	}
+
+	float alpha = solar_irradiance.w;
+	if (!ground && dot(view_ray, sun_direction) > cos(alpha))
+	{
+		radiance += exp(-optical_depth) * solar_irradiance.rgb / (PI * alpha * alpha);
+	}
+	out_FragColor = vec4(1.0 - exp(-radiance * exposure), 1.0);
+	out_Transmittance = vec4(0.0);
+}
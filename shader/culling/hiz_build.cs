@@ -0,0 +1,37 @@
+//
+#version 450 core
+
+// One level of the Hi-Z pyramid, GPU twin of Graphics::hiz_pyramid_t::build. Level 0 copies the depth
+// buffer, every level above keeps the farthest depth of the 2x2 texels below it; the last texel of an odd
+// level also takes the row or column left over, so no pixel falls out of the pyramid.
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+layout(binding = 0) uniform sampler2D in_Depth;
+layout(r32f, binding = 0) uniform restrict readonly image2D in_Level;
+layout(r32f, binding = 1) uniform restrict writeonly image2D out_Level;
+
+uniform uint level;
+uniform ivec2 in_size;
+uniform ivec2 out_size;
+
+void main()
+{
+	ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(p, out_size))) return;
+
+	if (level == 0u)
+	{
+		imageStore(out_Level, p, vec4(texelFetch(in_Depth, p, 0).r));
+		return;
+	}
+
+	ivec2 last = in_size - 1;
+	ivec2 end = 2 * p + 1 + ivec2(equal(p, out_size - 1)) * (in_size & 1);
+	float farthest = 0.0;
+	for (int y = 2 * p.y; y <= end.y; ++y)
+	{
+		for (int x = 2 * p.x; x <= end.x; ++x) farthest = max(farthest, imageLoad(in_Level, min(ivec2(x, y), last)).r);
+	}
+	imageStore(out_Level, p, vec4(farthest));
+}
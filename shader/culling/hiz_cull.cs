@@ -0,0 +1,137 @@
+//
+#version 450 core
+
+// Instance culling for multi-draw indirect. Every instance sphere is tested against this frame's frustum and
+// against the previous frame's Hi-Z pyramid (Graphics::hiz_occluded is the CPU reference), survivors take the
+// next slot of their command's instance_count and, when they carry a matrix, copy it to base_instance + slot.
+// Commands arrive with instance_count 0, the draw afterwards only sees the visible instances.
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+struct CullInstance
+{
+	// xyz centre relative to the origin of this frame's view, w radius
+	vec4 sphere;
+	uint command;
+	// index into in_Matrices, NO_MATRIX when the command draws a single instance of its own
+	uint matrix;
+	uint pad0;
+	uint pad1;
+};
+
+struct DrawCommand
+{
+	uint count;
+	uint instance_count;
+	uint first_index;
+	int base_vertex;
+	uint base_instance;
+};
+
+layout(std430, binding = 8) restrict readonly buffer Instances
+{
+	CullInstance in_Instances[];
+};
+
+layout(std430, binding = 9) restrict buffer Commands
+{
+	DrawCommand io_Commands[];
+};
+
+layout(std430, binding = 10) restrict readonly buffer SourceMatrices
+{
+	mat4 in_Matrices[];
+};
+
+layout(std430, binding = 11) restrict writeonly buffer Matrices
+{
+	mat4 out_Matrices[];
+};
+
+layout(std430, binding = 12) restrict buffer Counters
+{
+	uint tested;
+	uint visible;
+	uint frustum_culled;
+	uint occlusion_culled;
+};
+
+layout(binding = 0) uniform sampler2D in_HiZ;
+
+const uint NO_MATRIX = 0xffffffffu;
+
+uniform uint instance_count;
+uniform mat4 view_proj;
+// the pyramid's view, and the offset from this frame's origin to the origin it was rendered around
+uniform mat4 hiz_view_proj;
+uniform vec3 hiz_offset;
+uniform ivec2 hiz_size;
+// 0 without a pyramid
+uniform int hiz_levels;
+
+bool in_frustum(vec3 c, float r)
+{
+	// Gribb/Hartmann planes, normalized like Graphics::frustum_t::from_matrix
+	mat4 m = transpose(view_proj);
+	vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]);
+	for (int i = 0; i < 6; ++i)
+	{
+		float len = length(planes[i].xyz);
+		if (len > 1e-6 && dot(planes[i].xyz, c) + planes[i].w < -r * len) return false;
+	}
+	return true;
+}
+
+bool occluded(vec3 c, float r)
+{
+	if (hiz_levels == 0) return false;
+
+	vec3 lo = vec3(3.402823466e38);
+	vec3 hi = vec3(-3.402823466e38);
+	for (uint i = 0u; i < 8u; ++i)
+	{
+		vec3 corner = c + r * vec3((i & 1u) != 0u ? 1.0 : -1.0, (i & 2u) != 0u ? 1.0 : -1.0, (i & 4u) != 0u ? 1.0 : -1.0);
+		vec4 clip = hiz_view_proj * vec4(corner, 1.0);
+		if (clip.w <= 0.0 || clip.z < -clip.w) return false;
+		vec3 ndc = clip.xyz / clip.w;
+		lo = min(lo, ndc);
+		hi = max(hi, ndc);
+	}
+	if (hi.x < -1.0 || lo.x > 1.0 || hi.y < -1.0 || lo.y > 1.0) return false;
+
+	ivec2 p0 = clamp(ivec2(floor((lo.xy * 0.5 + 0.5) * vec2(hiz_size))), ivec2(0), hiz_size - 1);
+	ivec2 p1 = clamp(ivec2(floor((hi.xy * 0.5 + 0.5) * vec2(hiz_size))), ivec2(0), hiz_size - 1);
+
+	int level = 0;
+	while (level + 1 < hiz_levels && any(greaterThan((p1 >> level) - (p0 >> level), ivec2(1)))) ++level;
+	ivec2 last = max(hiz_size >> level, ivec2(1)) - 1;
+	ivec2 t0 = min(p0 >> level, last);
+	ivec2 t1 = min(p1 >> level, last);
+	float farthest = max(max(texelFetch(in_HiZ, t0, level).r, texelFetch(in_HiZ, ivec2(t1.x, t0.y), level).r),
+		max(texelFetch(in_HiZ, ivec2(t0.x, t1.y), level).r, texelFetch(in_HiZ, t1, level).r));
+
+	return lo.z * 0.5 + 0.5 > farthest;
+}
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= instance_count) return;
+
+	CullInstance instance = in_Instances[i];
+	atomicAdd(tested, 1u);
+	if (!in_frustum(instance.sphere.xyz, instance.sphere.w))
+	{
+		atomicAdd(frustum_culled, 1u);
+		return;
+	}
+	if (occluded(instance.sphere.xyz + hiz_offset, instance.sphere.w))
+	{
+		atomicAdd(occlusion_culled, 1u);
+		return;
+	}
+	atomicAdd(visible, 1u);
+
+	uint slot = atomicAdd(io_Commands[instance.command].instance_count, 1u);
+	if (instance.matrix != NO_MATRIX) out_Matrices[io_Commands[instance.command].base_instance + slot] = in_Matrices[instance.matrix];
+}
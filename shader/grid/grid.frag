@@ -1,20 +1,37 @@
 //
 #version 460 core
 
+// GRID_* are defined by the program's permutation, the values below are the defaults
+
 // extents of grid in world coordinates
-float grid_size = 10.0;
+#ifndef GRID_SIZE
+#define GRID_SIZE 10.0
+#endif
+const float grid_size = GRID_SIZE;
 
 // size of one cell
-float grid_cell_size = 0.0025;
+#ifndef GRID_CELL_SIZE
+#define GRID_CELL_SIZE 0.0025
+#endif
+const float grid_cell_size = GRID_CELL_SIZE;
 
 // color of thin lines
-vec4 grid_color_thin = vec4(0.5, 0.5, 0.5, 1.0);
+#ifndef GRID_COLOR_THIN
+#define GRID_COLOR_THIN vec4(0.5, 0.5, 0.5, 1.0)
+#endif
+const vec4 grid_color_thin = GRID_COLOR_THIN;
 
 // color of thick lines (every tenth line)
-vec4 grid_color_thick = vec4(0.0, 0.0, 0.0, 1.0);
+#ifndef GRID_COLOR_THICK
+#define GRID_COLOR_THICK vec4(0.0, 0.0, 0.0, 1.0)
+#endif
+const vec4 grid_color_thick = GRID_COLOR_THICK;
 
 // minimum number of pixels between cell lines before LOD switch should occur. 
-const float grid_min_pixel_between_cells = 2.0;
+#ifndef GRID_MIN_PIXELS_BETWEEN_CELLS
+#define GRID_MIN_PIXELS_BETWEEN_CELLS 2.0
+#endif
+const float grid_min_pixel_between_cells = GRID_MIN_PIXELS_BETWEEN_CELLS;
 
 const vec3 pos[4] = vec3[4](
 	vec3(-1.0, -1.0, 0.0),
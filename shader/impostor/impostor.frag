@@ -0,0 +1,47 @@
+//
+#version 450 core
+
+// Shades the baked view like mesh.frag shades the mesh, and moves the depth from the billboard plane to the
+// baked surface so that impostors intersect the rest of the scene where their meshes would.
+
+#include "impostor.glsl"
+
+layout(std140, binding = 0) uniform PerFrameData
+{
+	mat4 view;
+	mat4 proj;
+	vec4 cam_pos;
+};
+
+// units Graphics::impostor_set_t::k_albedo_unit and k_normal_depth_unit
+layout(binding = 4) uniform sampler2DArray impostor_albedo;
+layout(binding = 5) uniform sampler2DArray impostor_normal_depth;
+
+layout (location=0) in vec3 in_plane_pos;
+layout (location=1) in vec2 in_uv;
+layout (location=2) flat in vec3 in_depth_axis;
+layout (location=3) flat in float in_layer;
+layout (location=4) flat in float in_fade;
+layout (location=5) flat in mat3 in_normal_matrix;
+
+layout (location=0) out vec4 out_FragColor;
+
+const vec3 sun_dir = normalize(vec3(0.4, 0.8, 0.3));
+
+void main()
+{
+	if (impostor_dither(gl_FragCoord.xy) >= in_fade) discard;
+	vec4 albedo = texture(impostor_albedo, vec3(in_uv, in_layer));
+	if (albedo.a < 0.5) discard;
+	vec4 normal_depth = texture(impostor_normal_depth, vec3(in_uv, in_layer));
+
+	vec3 world_pos = in_plane_pos + in_depth_axis * (1.0 - 2.0 * normal_depth.a);
+	vec4 clip = proj * view * vec4(world_pos, 1.0);
+	gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+	// the normal goes through the model matrix the way mesh.vert sends it
+	vec3 n = normalize(in_normal_matrix * (normal_depth.xyz * 2.0 - 1.0));
+	float diffuse = max(dot(n, sun_dir), 0.0);
+	float ambient = 0.25;
+	out_FragColor = vec4(albedo.rgb * (ambient + diffuse), 1.0);
+}
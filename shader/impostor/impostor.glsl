@@ -0,0 +1,37 @@
+// Octahedral view directions of the impostor atlases, mirrored by Graphics::Octahedral in ogl_fw/impostor.h.
+
+vec2 octahedral_sign(vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unit direction to [0, 1]^2, the upper hemisphere (y > 0) fills the inner diamond
+vec2 octahedral_encode(vec3 d)
+{
+	vec2 p = d.xz / (abs(d.x) + abs(d.y) + abs(d.z));
+	if (d.y < 0.0) p = (1.0 - abs(p.yx)) * octahedral_sign(p);
+	return p * 0.5 + 0.5;
+}
+
+vec3 octahedral_decode(vec2 uv)
+{
+	vec2 p = uv * 2.0 - 1.0;
+	float y = 1.0 - abs(p.x) - abs(p.y);
+	if (y < 0.0) p = (1.0 - abs(p.yx)) * octahedral_sign(p);
+	return normalize(vec3(p.x, y, p.y));
+}
+
+// image axes of the baked view looking along -d
+void impostor_frame_basis(vec3 d, out vec3 right, out vec3 up)
+{
+	vec3 reference = abs(d.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(0.0, 0.0, 1.0);
+	right = normalize(cross(reference, d));
+	up = cross(d, right);
+}
+
+// Screen-door threshold of the mesh to impostor cross-fade: a pixel below the fade shows the impostor, the
+// others the mesh, so the two halves never overlap and need no sorting.
+float impostor_dither(vec2 frag_coord)
+{
+	return fract(52.9829189 * fract(dot(frag_coord, vec2(0.06711056, 0.00583715))));
+}
@@ -0,0 +1,83 @@
+//
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+
+// Octahedral impostor billboards. Every instance carries its mesh's model matrix with the bottom row reused:
+// [0][3] holds the cross-fade and [1][3] the impostor's layer. The quad shows the baked view closest to the
+// camera direction in mesh space, mapped through the model matrix, so that non-uniformly scaled instances
+// match their meshes.
+
+#include "impostor.glsl"
+
+layout(std140, binding = 0) uniform PerFrameData
+{
+	mat4 view;
+	mat4 proj;
+	vec4 cam_pos;
+};
+
+struct Vertex
+{
+	float p[3];
+	float n[3];
+	float tc[2];
+};
+
+layout(std430, binding = 1) restrict readonly buffer Vertices
+{
+	Vertex in_Vertices[];
+};
+
+layout(std430, binding = 2) restrict readonly buffer Matrices
+{
+	mat4 in_ModelMatrices[];
+};
+
+// mirrors Graphics::gpu_impostor_t
+struct Impostor
+{
+	vec4 bounds;
+	vec4 grid;
+};
+
+layout(std430, binding = 3) restrict readonly buffer Impostors
+{
+	Impostor in_Impostors[];
+};
+
+layout (location=0) out vec3 out_plane_pos;
+layout (location=1) out vec2 out_uv;
+layout (location=2) flat out vec3 out_depth_axis;
+layout (location=3) flat out float out_layer;
+layout (location=4) flat out float out_fade;
+layout (location=5) flat out mat3 out_normal_matrix;
+
+void main()
+{
+	Vertex v = in_Vertices[gl_VertexID];
+	mat4 model = in_ModelMatrices[gl_BaseInstanceARB + gl_InstanceID];
+	out_fade = model[0][3];
+	out_layer = model[1][3];
+	model[0][3] = 0.0;
+	model[1][3] = 0.0;
+
+	Impostor impostor = in_Impostors[int(out_layer + 0.5)];
+	float grid = impostor.grid.x;
+	mat3 basis = mat3(model);
+	vec3 center = (model * vec4(impostor.bounds.xyz, 1.0)).xyz;
+
+	// the view nearest to where the camera sits in mesh space
+	vec3 to_camera = normalize(inverse(basis) * (cam_pos.xyz - center));
+	vec2 cell = min(floor(octahedral_encode(to_camera) * grid), vec2(grid - 1.0));
+	vec3 d = octahedral_decode((cell + 0.5) / grid);
+	vec3 right, up;
+	impostor_frame_basis(d, right, up);
+
+	vec2 corner = vec2(v.p[0], v.p[1]);
+	out_plane_pos = center + basis * ((right * corner.x + up * corner.y) * impostor.bounds.w);
+	out_depth_axis = basis * (d * impostor.bounds.w);
+	out_uv = (cell + corner * 0.5 + 0.5) / grid;
+	out_normal_matrix = basis;
+
+	gl_Position = proj * view * vec4(out_plane_pos, 1.0);
+}
@@ -0,0 +1,20 @@
+//
+#version 450 core
+
+// Albedo with coverage, and the mesh-space normal with the depth across the bounding sphere. Lighting is left
+// to impostor.frag so that it matches mesh.frag; the albedo is mesh.frag's.
+
+layout (location=0) in vec3 in_normal;
+layout (location=1) in vec2 in_uv;
+
+layout (location=0) out vec4 out_albedo;
+layout (location=1) out vec4 out_normal_depth;
+
+void main()
+{
+	vec2 cell = floor(in_uv * 4.0);
+	float checker = mod(cell.x + cell.y, 2.0) * 0.08;
+
+	out_albedo = vec4(vec3(0.62, 0.6, 0.56) - checker, 1.0);
+	out_normal_depth = vec4(normalize(in_normal) * 0.5 + 0.5, gl_FragCoord.z);
+}
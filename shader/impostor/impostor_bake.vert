@@ -0,0 +1,30 @@
+//
+#version 450 core
+
+// One view of an impostor atlas: the mesh in its own space, orthographic across its bounding sphere.
+// gl_VertexID includes the draw's base vertex, like in mesh.vert.
+
+struct Vertex
+{
+	float p[3];
+	float n[3];
+	float tc[2];
+};
+
+layout(std430, binding = 1) restrict readonly buffer Vertices
+{
+	Vertex in_Vertices[];
+};
+
+uniform mat4 view_proj;
+
+layout (location=0) out vec3 out_normal;
+layout (location=1) out vec2 out_uv;
+
+void main()
+{
+	Vertex v = in_Vertices[gl_VertexID];
+	out_normal = vec3(v.n[0], v.n[1], v.n[2]);
+	out_uv = vec2(v.tc[0], v.tc[1]);
+	gl_Position = view_proj * vec4(v.p[0], v.p[1], v.p[2], 1.0);
+}
@@ -0,0 +1,43 @@
+//
+#version 450 core
+
+//
+
+layout(std140, binding = 0) uniform PerFrameData
+{
+	mat4 view;
+	mat4 proj;
+	vec4 cam_pos;
+};
+
+layout (location=0) in vec3 in_normal;
+layout (location=1) in vec2 in_uv;
+layout (location=2) in vec3 in_world_pos;
+#ifdef IMPOSTOR_FADE
+layout (location=3) flat in float in_fade;
+
+#include "../impostor/impostor.glsl"
+#endif
+
+layout (location=0) out vec4 out_FragColor;
+
+const vec3 sun_dir = normalize(vec3(0.4, 0.8, 0.3));
+
+void main()
+{
+#ifdef IMPOSTOR_FADE
+	// the impostor takes the pixels below the fade
+	if (impostor_dither(gl_FragCoord.xy) < in_fade) discard;
+#endif
+	vec3 n = normalize(in_normal);
+
+	// faint checker so that flat faces still read
+	vec2 cell = floor(in_uv * 4.0);
+	float checker = mod(cell.x + cell.y, 2.0) * 0.08;
+
+	float diffuse = max(dot(n, sun_dir), 0.0);
+	float ambient = 0.25;
+
+	vec3 albedo = vec3(0.62, 0.6, 0.56) - checker;
+	out_FragColor = vec4(albedo * (ambient + diffuse), 1.0);
+}
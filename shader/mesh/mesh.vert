@@ -0,0 +1,57 @@
+//
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+
+//
+
+layout(std140, binding = 0) uniform PerFrameData
+{
+	mat4 view;
+	mat4 proj;
+	vec4 cam_pos;
+};
+
+struct Vertex
+{
+	float p[3];
+	float n[3];
+	float tc[2];
+};
+
+layout(std430, binding = 1) restrict readonly buffer Vertices
+{
+	Vertex in_Vertices[];
+};
+
+layout(std430, binding = 2) restrict readonly buffer Matrices
+{
+	mat4 in_ModelMatrices[];
+};
+
+layout (location=0) out vec3 out_normal;
+layout (location=1) out vec2 out_uv;
+layout (location=2) out vec3 out_world_pos;
+#ifdef IMPOSTOR_FADE
+layout (location=3) flat out float out_fade;
+#endif
+
+void main()
+{
+	// gl_VertexID already includes the command's base vertex; matrices are laid out per command,
+	// so gl_BaseInstance + gl_InstanceID works for both the multi-draw and the per-instance path
+	Vertex v = in_Vertices[gl_VertexID];
+	mat4 model = in_ModelMatrices[gl_BaseInstanceARB + gl_InstanceID];
+#ifdef IMPOSTOR_FADE
+	// Graphics::impostor_set_t::split() keeps the cross-fade in the matrix's bottom row
+	out_fade = model[0][3];
+	model[0][3] = 0.0;
+#endif
+
+	vec4 world_pos = model * vec4(v.p[0], v.p[1], v.p[2], 1.0);
+
+	out_normal = mat3(model) * vec3(v.n[0], v.n[1], v.n[2]);
+	out_uv = vec2(v.tc[0], v.tc[1]);
+	out_world_pos = world_pos.xyz;
+
+	gl_Position = proj * view * world_pos;
+}
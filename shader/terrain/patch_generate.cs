@@ -0,0 +1,78 @@
+//
+#version 450 core
+
+// GPU twin of Terrain::build_patch_vertices, the noise and the sphere mapping come from planet.glsl.
+//
+// One work group writes an 8x8 block of a patch, gl_WorkGroupID.z selects the patch. The block's 10x10
+// positions (one sample of border on each side) are generated into shared memory first, the normals
+// are then taken from central differences exactly like the CPU reference.
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+#include "planet.glsl"
+
+struct PatchJob
+{
+	vec4 bounds;
+	// unit direction of the patch origin
+	vec4 origin;
+	uint face;
+	uint base_vertex;
+	uint pad0;
+	uint pad1;
+};
+
+layout(std430, binding = 4) restrict readonly buffer PatchJobs
+{
+	PatchJob in_Jobs[];
+};
+
+struct TerrainVertex
+{
+	vec4 position_height;
+	vec4 normal;
+};
+
+layout(std430, binding = 5) restrict writeonly buffer Vertices
+{
+	TerrainVertex out_Vertices[];
+};
+
+// dispatches of one generate() call index into the same job array
+uniform uint first_job;
+
+const uint BLOCK = 8u;
+const uint HALO = BLOCK + 2u;
+
+shared vec3 s_positions[HALO * HALO];
+shared float s_heights[HALO * HALO];
+
+void main()
+{
+	PatchJob job = in_Jobs[first_job + gl_WorkGroupID.z];
+	ivec2 block_origin = ivec2(gl_WorkGroupID.xy * BLOCK) - 1;
+	float step = 1.0 / float(max(resolution, 2u) - 1u);
+
+	for (uint s = gl_LocalInvocationIndex; s < HALO * HALO; s += BLOCK * BLOCK)
+	{
+		ivec2 ij = block_origin + ivec2(s % HALO, s / HALO);
+		vec2 t = vec2(ij) * step;
+		// exact at both ends like Terrain::sample_direction, neighbours sample their shared edge identically
+		vec2 uv = job.bounds.xy * (1.0 - t) + job.bounds.zw * t;
+		vec3 dir = face_to_sphere(job.face, uv);
+		float h = terrain_height(dir);
+		s_heights[s] = h;
+		s_positions[s] = (dir - job.origin.xyz) * planet_radius + dir * h;
+	}
+	barrier();
+
+	uvec2 ij = gl_GlobalInvocationID.xy;
+	if (ij.x >= resolution || ij.y >= resolution) return;
+
+	uint c = (gl_LocalInvocationID.y + 1u) * HALO + gl_LocalInvocationID.x + 1u;
+	vec3 du = s_positions[c + 1u] - s_positions[c - 1u];
+	vec3 dv = s_positions[c + HALO] - s_positions[c - HALO];
+	vec3 n = normalize(cross(du, dv));
+
+	out_Vertices[job.base_vertex + ij.y * resolution + ij.x] = TerrainVertex(vec4(s_positions[c], s_heights[c]), vec4(n, 0.0));
+}
@@ -0,0 +1,128 @@
+//
+#version 450 core
+
+// PACKED twin of patch_generate.cs, in two dispatches selected by stage. A vertex can only be quantized once
+// the range of its whole patch is known, so stage 0 evaluates the heights of every patch and its one-sample
+// border (one invocation per sample) and reduces each patch's lowest and highest vertex. Stage 1 rebuilds the
+// positions from those heights, takes the normals from central differences like Terrain::build_patch_vertices
+// and encodes the vertices like Terrain::pack_patch_vertices, the edge ones over the whole height range.
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+#include "planet.glsl"
+#include "vertex_packing.glsl"
+
+struct PatchJob
+{
+	vec4 bounds;
+	// unit direction of the patch origin
+	vec4 origin;
+	uint face;
+	// first grid vertex, the header takes the two uints before it
+	uint base_vertex;
+	uint pad0;
+	uint pad1;
+};
+
+layout(std430, binding = 4) restrict readonly buffer PatchJobs
+{
+	PatchJob in_Jobs[];
+};
+
+layout(std430, binding = 5) restrict writeonly buffer Vertices
+{
+	uint out_Vertices[];
+};
+
+// per job (resolution + 2)^2 heights
+layout(std430, binding = 6) restrict buffer Heights
+{
+	float io_Heights[];
+};
+
+// per job the float bits of the lowest and highest vertex
+layout(std430, binding = 7) restrict buffer Ranges
+{
+	uint io_Ranges[];
+};
+
+uniform uint first_job;
+uniform uint stage;
+
+shared uint s_min;
+shared uint s_max;
+
+vec3 sample_position(PatchJob job, uint heights_base, uint border, ivec2 ij, float step)
+{
+	vec2 t = vec2(ij) * step;
+	// exact at both ends like Terrain::sample_direction, neighbours sample their shared edge identically
+	vec2 uv = job.bounds.xy * (1.0 - t) + job.bounds.zw * t;
+	vec3 dir = face_to_sphere(job.face, uv);
+	float h = io_Heights[heights_base + uint(ij.y + 1) * border + uint(ij.x + 1)];
+	return (dir - job.origin.xyz) * planet_radius + dir * h;
+}
+
+void main()
+{
+	uint job_index = first_job + gl_WorkGroupID.z;
+	PatchJob job = in_Jobs[job_index];
+	uint border = resolution + 2u;
+	uint heights_base = job_index * border * border;
+	float step = 1.0 / float(max(resolution, 2u) - 1u);
+
+	if (stage == 0u)
+	{
+		if (gl_LocalInvocationIndex == 0u)
+		{
+			s_min = 0x7F800000u;
+			s_max = 0u;
+		}
+		barrier();
+
+		uvec2 s = gl_GlobalInvocationID.xy;
+		if (s.x < border && s.y < border)
+		{
+			ivec2 ij = ivec2(s) - 1;
+			vec2 t = vec2(ij) * step;
+			vec2 uv = job.bounds.xy * (1.0 - t) + job.bounds.zw * t;
+			float h = terrain_height(face_to_sphere(job.face, uv));
+			io_Heights[heights_base + s.y * border + s.x] = h;
+			// heights are never negative, their bits order like the floats once a -0 lost its sign
+			if (s.x >= 1u && s.y >= 1u && s.x <= resolution && s.y <= resolution)
+			{
+				uint bits = floatBitsToUint(h) & 0x7FFFFFFFu;
+				atomicMin(s_min, bits);
+				atomicMax(s_max, bits);
+			}
+		}
+		barrier();
+
+		if (gl_LocalInvocationIndex == 0u && s_min <= s_max)
+		{
+			atomicMin(io_Ranges[job_index * 2u], s_min);
+			atomicMax(io_Ranges[job_index * 2u + 1u], s_max);
+		}
+		return;
+	}
+
+	uvec2 ij = gl_GlobalInvocationID.xy;
+	if (ij.x >= resolution || ij.y >= resolution) return;
+
+	float min_height = uintBitsToFloat(io_Ranges[job_index * 2u]);
+	float height_step = (uintBitsToFloat(io_Ranges[job_index * 2u + 1u]) - min_height) / k_height_steps;
+	if (ij == uvec2(0u))
+	{
+		out_Vertices[job.base_vertex - 2u] = floatBitsToUint(min_height);
+		out_Vertices[job.base_vertex - 1u] = floatBitsToUint(height_step);
+	}
+
+	ivec2 c = ivec2(ij);
+	vec3 du = sample_position(job, heights_base, border, c + ivec2(1, 0), step) - sample_position(job, heights_base, border, c - ivec2(1, 0), step);
+	vec3 dv = sample_position(job, heights_base, border, c + ivec2(0, 1), step) - sample_position(job, heights_base, border, c - ivec2(0, 1), step);
+	vec3 n = normalize(cross(du, dv));
+	float h = io_Heights[heights_base + (ij.y + 1u) * border + ij.x + 1u];
+
+	bool edge = is_edge_vertex(ij, resolution);
+	uint quantized = edge ? quantize_height(h, 0.0, max_height / k_height_steps) : quantize_height(h, min_height, height_step);
+	out_Vertices[job.base_vertex + ij.y * resolution + ij.x] = quantized | oct_encode(n);
+}
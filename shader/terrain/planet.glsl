@@ -0,0 +1,148 @@
+// Planet surface shared by the terrain shaders: the noise of Noise::evaluate and the cube-sphere mapping of
+// Terrain::CubeSphere, mirrored step by step so that every stage and the CPU agree up to float rounding.
+// NoiseParams is filled from Terrain::make_gpu_noise_params.
+
+layout(std430, binding = 3) restrict readonly buffer NoiseParams
+{
+	uint octave_count;
+	uint noise_type;
+	float ridge_offset;
+	float normalization;
+	float planet_radius;
+	float max_height;
+	// generated patch grid, read by the patch generators and terrain_patch_packed.vert
+	uint resolution;
+	uint pad0;
+	float octave_frequency[16];
+	float octave_amplitude[16];
+	uint octave_seed[16];
+};
+
+const uint NOISE_RIDGED = 2u;
+
+// Terrain::make_noise_permutation() bakes both in, which folds the per-octave branch and fixes the loop
+// count; without them they are read from NoiseParams
+#ifndef NOISE_TYPE
+#define NOISE_TYPE noise_type
+#endif
+#ifndef OCTAVE_COUNT
+#define OCTAVE_COUNT octave_count
+#endif
+
+const float k_f3 = 1.0 / 3.0;
+const float k_g3 = 1.0 / 6.0;
+const float k_radius_sq = 0.6;
+const float k_scale = 32.0;
+
+const uint k_prime_x = 0x8da6b343u;
+const uint k_prime_y = 0xd8163841u;
+const uint k_prime_z = 0xcb1ab31fu;
+const uint k_mix = 0x27d4eb2du;
+
+uint hash3(ivec3 c, uint seed)
+{
+	uint h = (uint(c.x) * k_prime_x) ^ (uint(c.y) * k_prime_y) ^ (uint(c.z) * k_prime_z) ^ seed;
+	h *= k_mix;
+	h ^= h >> 15;
+	return h;
+}
+
+float grad3(uint hash, vec3 p)
+{
+	uint h = hash & 15u;
+	float u = h < 8u ? p.x : p.y;
+	float v = h < 4u ? p.y : ((h == 12u || h == 14u) ? p.x : p.z);
+	return ((h & 1u) != 0u ? -u : u) + ((h & 2u) != 0u ? -v : v);
+}
+
+float corner(vec3 p, uint hash)
+{
+	float t = k_radius_sq - p.x * p.x - p.y * p.y - p.z * p.z;
+	t = max(t, 0.0);
+	float t2 = t * t;
+	return t2 * t2 * grad3(hash, p);
+}
+
+float simplex3(vec3 p, uint seed)
+{
+	float s = (p.x + p.y + p.z) * k_f3;
+	vec3 f = floor(p + s);
+	ivec3 c = ivec3(f);
+
+	float t = (f.x + f.y + f.z) * k_g3;
+	vec3 p0 = p - (f - t);
+
+	bool gx = p0.x >= p0.y;
+	bool gy = p0.y >= p0.z;
+	bool gz = p0.z >= p0.x;
+	ivec3 c1 = ivec3((gx && !gz) ? 1 : 0, (gy && !gx) ? 1 : 0, (gz && !gy) ? 1 : 0);
+	ivec3 c2 = ivec3((gx || !gz) ? 1 : 0, (gy || !gx) ? 1 : 0, (gz || !gy) ? 1 : 0);
+
+	vec3 p1 = p0 - vec3(c1) + k_g3;
+	vec3 p2 = p0 - vec3(c2) + 2.0 * k_g3;
+	vec3 p3 = p0 - 1.0 + 3.0 * k_g3;
+
+	float n0 = corner(p0, hash3(c, seed));
+	float n1 = corner(p1, hash3(c + c1, seed));
+	float n2 = corner(p2, hash3(c + c2, seed));
+	float n3 = corner(p3, hash3(c + 1, seed));
+
+	return k_scale * (n0 + n1 + n2 + n3);
+}
+
+float noise(vec3 p)
+{
+	float sum = 0.0;
+	float weight = 1.0;
+	for (uint o = 0u; o < OCTAVE_COUNT; ++o)
+	{
+		float n = simplex3(p * octave_frequency[o], octave_seed[o]);
+		if (NOISE_TYPE == NOISE_RIDGED)
+		{
+			float s = ridge_offset - abs(n);
+			s = s * s;
+			s = s * weight;
+			weight = min(max(s * 2.0, 0.0), 1.0);
+			sum = sum + s * octave_amplitude[o];
+		}
+		else
+		{
+			sum = sum + n * octave_amplitude[o];
+		}
+	}
+	return sum * normalization;
+}
+
+vec3 face_to_cube(uint face, float u, float v)
+{
+	switch (face)
+	{
+	case 0u: return vec3(1.0, v, -u);
+	case 1u: return vec3(-1.0, v, u);
+	case 2u: return vec3(u, 1.0, -v);
+	case 3u: return vec3(u, -1.0, v);
+	case 4u: return vec3(u, v, 1.0);
+	default: return vec3(-u, v, -1.0);
+	}
+}
+
+vec3 cube_to_sphere(vec3 p)
+{
+	vec3 p2 = p * p;
+	return vec3(
+		p.x * sqrt(1.0 - 0.5 * (p2.y + p2.z) + p2.y * p2.z / 3.0),
+		p.y * sqrt(1.0 - 0.5 * (p2.z + p2.x) + p2.z * p2.x / 3.0),
+		p.z * sqrt(1.0 - 0.5 * (p2.x + p2.y) + p2.x * p2.y / 3.0)
+	);
+}
+
+vec3 face_to_sphere(uint face, vec2 uv)
+{
+	return normalize(cube_to_sphere(face_to_cube(face, uv.x, uv.y)));
+}
+
+// metres above planet_radius, Terrain::heightfield_settings_t::to_height
+float terrain_height(vec3 dir)
+{
+	return clamp(noise(dir) * 0.5 + 0.5, 0.0, 1.0) * max_height;
+}
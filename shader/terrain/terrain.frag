@@ -0,0 +1,31 @@
+//
+#version 450 core
+
+// Shared by both terrain modes. Normals come from screen-space derivatives so the two modes shade alike
+// and the tessellated one needs no extra noise evaluations.
+
+layout (location=0) in vec3 in_position;
+layout (location=1) in vec3 in_up;
+layout (location=2) in float in_height;
+
+layout (location=0) out vec4 out_FragColor;
+
+const vec3 sun_dir = normalize(vec3(0.4, 0.8, 0.3));
+
+void main()
+{
+	vec3 up = normalize(in_up);
+	vec3 n = normalize(cross(dFdx(in_position), dFdy(in_position)));
+	n = dot(n, up) < 0.0 ? -n : n;
+
+	float slope = dot(n, up);
+	vec3 rock = vec3(0.45, 0.42, 0.38);
+	vec3 grass = vec3(0.30, 0.40, 0.20);
+	vec3 snow = vec3(0.92, 0.93, 0.95);
+	vec3 albedo = mix(rock, grass, smoothstep(0.80, 0.95, slope));
+	albedo = mix(albedo, snow, smoothstep(6000.0, 7500.0, in_height) * smoothstep(0.6, 0.8, slope));
+
+	float diffuse = max(dot(n, sun_dir), 0.0);
+	float ambient = 0.2;
+	out_FragColor = vec4(albedo * (ambient + diffuse), 1.0);
+}
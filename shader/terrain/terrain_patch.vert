@@ -0,0 +1,53 @@
+//
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+
+// Generated patches, pulled from the patch generator's vertex buffers. gl_VertexID includes the draw's
+// base vertex, gl_BaseInstanceARB indexes the per-draw origins.
+
+struct TerrainVertex
+{
+	vec4 position_height;
+	vec4 normal;
+};
+
+layout(std430, binding = 5) restrict readonly buffer Vertices
+{
+	TerrainVertex in_Vertices[];
+};
+
+struct PatchDraw
+{
+	// patch origin relative to the camera
+	vec4 origin;
+	// patch origin relative to the planet centre
+	vec4 planet_origin;
+	// used by terrain_patch_packed.vert only
+	vec4 bounds;
+	vec4 origin_dir;
+};
+
+layout(std430, binding = 6) restrict readonly buffer PatchDraws
+{
+	PatchDraw in_Draws[];
+};
+
+// projection times the view rotation, positions are camera-relative
+uniform mat4 view_proj;
+
+layout (location=0) out vec3 out_position;
+layout (location=1) out vec3 out_up;
+layout (location=2) out float out_height;
+
+void main()
+{
+	TerrainVertex v = in_Vertices[gl_VertexID];
+	PatchDraw d = in_Draws[gl_BaseInstanceARB];
+
+	vec3 position = v.position_height.xyz + d.origin.xyz;
+
+	out_position = position;
+	out_up = d.planet_origin.xyz + v.position_height.xyz;
+	out_height = v.position_height.w;
+	gl_Position = view_proj * vec4(position, 1.0);
+}
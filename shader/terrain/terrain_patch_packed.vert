@@ -0,0 +1,77 @@
+//
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+
+// PACKED generated patches: a vertex is only its quantized height and normal, its grid position is
+// gl_VertexID - gl_BaseVertexARB. The position is rebuilt the way Terrain::unpack_patch_position and the
+// generators build it, so patches sharing an edge get the same directions from both sides.
+
+#include "planet.glsl"
+#include "vertex_packing.glsl"
+
+// the patch's min height and height step take the two uints before its base vertex
+layout(std430, binding = 5) restrict readonly buffer Vertices
+{
+	uint in_Vertices[];
+};
+
+struct PatchDraw
+{
+	// patch origin relative to the camera
+	vec4 origin;
+	// patch origin relative to the planet centre
+	vec4 planet_origin;
+	// face-local u0, v0, u1, v1
+	vec4 bounds;
+	// xyz: unit direction of the patch origin, w: cube face
+	vec4 origin_dir;
+};
+
+layout(std430, binding = 6) restrict readonly buffer PatchDraws
+{
+	PatchDraw in_Draws[];
+};
+
+// projection times the view rotation, positions are camera-relative
+uniform mat4 view_proj;
+
+layout (location=0) out vec3 out_position;
+layout (location=1) out vec3 out_up;
+layout (location=2) out float out_height;
+
+void main()
+{
+	PatchDraw d = in_Draws[gl_BaseInstanceARB];
+	uint grid_index = uint(gl_VertexID - gl_BaseVertexARB);
+	uvec2 ij = uvec2(grid_index % resolution, grid_index / resolution);
+	float step = 1.0 / float(max(resolution, 2u) - 1u);
+
+	// past the grid: the skirt, edge vertex k of the counter-clockwise perimeter walk of terrain_renderer_t::init()
+	bool skirt = grid_index >= resolution * resolution;
+	if (skirt)
+	{
+		uint last = resolution - 1u;
+		uint k = grid_index - resolution * resolution;
+		uint side = k / last;
+		uint t = k % last;
+		ij = side == 0u ? uvec2(t, 0u) : side == 1u ? uvec2(last, t) : side == 2u ? uvec2(last - t, last) : uvec2(0u, last - t);
+	}
+	uint packed_vertex = in_Vertices[gl_BaseVertexARB + int(ij.y * resolution + ij.x)];
+	vec2 t = vec2(ij) * step;
+	vec2 uv = d.bounds.xy * (1.0 - t) + d.bounds.zw * t;
+	vec3 dir = face_to_sphere(uint(d.origin_dir.w), uv);
+
+	bool edge = is_edge_vertex(ij, resolution);
+	float min_height = edge ? 0.0 : uintBitsToFloat(in_Vertices[gl_BaseVertexARB - 2]);
+	float height_step = edge ? max_height / k_height_steps : uintBitsToFloat(in_Vertices[gl_BaseVertexARB - 1]);
+	float h = dequantize_height(packed_vertex, min_height, height_step);
+	vec3 local_position = (dir - d.origin_dir.xyz) * planet_radius + dir * h;
+	// an eighth of the patch deep, more than the T-junction gaps the LOD steps between neighbours leave
+	if (skirt) local_position -= dir * ((d.bounds.z - d.bounds.x) * planet_radius * 0.125);
+	vec3 position = local_position + d.origin.xyz;
+
+	out_position = position;
+	out_up = d.planet_origin.xyz + local_position;
+	out_height = h;
+	gl_Position = view_proj * vec4(position, 1.0);
+}
@@ -0,0 +1,27 @@
+// Per-patch records of the tessellated terrain, Terrain::terrain_renderer_t::gpu_tess_patch_t.
+
+struct TessPatch
+{
+	// face-local u0, v0, u1, v1
+	vec4 bounds;
+	// xyz: patch origin relative to the camera, w: cube face
+	vec4 origin;
+	// unit direction of the origin
+	vec4 origin_dir;
+	// per edge (u0, v0, u1, v1 side): unit directions of the endpoints of the coarser patch's edge,
+	// edge_a.w is that edge's minimum factor, edge_b.w the power of two the finer side divides by
+	vec4 edge_a[4];
+	vec4 edge_b[4];
+};
+
+layout(std430, binding = 6) restrict readonly buffer TessPatches
+{
+	TessPatch in_Patches[];
+};
+
+// projection times the view rotation, positions are camera-relative
+uniform mat4 view_proj;
+// relative to the planet centre
+uniform vec3 camera_pos;
+uniform float pixels_per_radian;
+uniform float edge_pixels;
@@ -0,0 +1,12 @@
+//
+#version 450 core
+
+// Every patch is a single vertex without attributes; with glMultiDrawArrays gl_VertexID includes the
+// batch's first vertex and is the index of the patch record.
+
+layout (location=0) out uint out_patch;
+
+void main()
+{
+	out_patch = uint(gl_VertexID);
+}
@@ -0,0 +1,72 @@
+// Packed terrain vertex, Terrain::packed_terrain_vertex_t read as one uint: the height in the low 16 bits,
+// the octahedral normal in two snorm8 above it. The encoders mirror Terrain::VertexPacking step by step.
+
+const float k_snorm8_max = 127.0;
+const float k_height_steps = 65535.0;
+
+vec2 oct_project(vec3 n)
+{
+	vec2 p = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+	if (n.z < 0.0)
+	{
+		p = vec2((1.0 - abs(p.y)) * (p.x >= 0.0 ? 1.0 : -1.0), (1.0 - abs(p.x)) * (p.y >= 0.0 ? 1.0 : -1.0));
+	}
+	return p;
+}
+
+vec3 oct_unproject(vec2 p)
+{
+	vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+vec3 oct_decode(uint packed_vertex)
+{
+	return oct_unproject(unpackSnorm4x8(packed_vertex).zw);
+}
+
+// upper 16 bits of the packed vertex; the rounding around the projection decoding closest to n
+uint oct_encode(vec3 n)
+{
+	vec2 base = floor(oct_project(n) * k_snorm8_max);
+	float best = -1.0;
+	uint encoded = 0u;
+	for (uint c = 0u; c < 4u; ++c)
+	{
+		vec2 q = min(base + vec2(float(c & 1u), float(c >> 1u)), vec2(k_snorm8_max));
+		// cos^2 of the angle to the unnormalized decode, candidates facing away score below zero
+		vec3 d = vec3(q, k_snorm8_max - abs(q.x) - abs(q.y));
+		float t = max(-d.z, 0.0);
+		d.x += d.x >= 0.0 ? -t : t;
+		d.y += d.y >= 0.0 ? -t : t;
+		float dn = dot(d, n);
+		float score = dn * abs(dn) / dot(d, d);
+		if (score > best)
+		{
+			best = score;
+			encoded = ((uint(int(q.x)) & 0xFFu) << 16u) | ((uint(int(q.y)) & 0xFFu) << 24u);
+		}
+	}
+	return encoded;
+}
+
+uint quantize_height(float height, float min_height, float height_step)
+{
+	if (height_step <= 0.0) return 0u;
+	return uint(clamp(floor((height - min_height) / height_step + 0.5), 0.0, k_height_steps));
+}
+
+float dequantize_height(uint packed_vertex, float min_height, float height_step)
+{
+	return min_height + float(packed_vertex & 0xFFFFu) * height_step;
+}
+
+// edge vertices quantize over the planet's whole [0, max_height], like Terrain::VertexPacking::is_edge_vertex, so
+// patches sharing an edge store and decode the same height for it
+bool is_edge_vertex(uvec2 ij, uint resolution)
+{
+	return ij.x == 0u || ij.y == 0u || ij.x + 1u >= resolution || ij.y + 1u >= resolution;
+}
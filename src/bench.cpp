@@ -0,0 +1,3826 @@
+#include "bench.h"
+
+#include "core/graphics/camera.h"
+#include "core/graphics/culling.h"
+#include "core/terrain/quadtree.h"
+#include "core/terrain/tile_cache.h"
+#include "core/terrain/patch_generator.h"
+#include "core/terrain/vertex_packing.h"
+#include "core/terrain/terrain_renderer.h"
+#include "core/terrain/scatter.h"
+#include "core/atmosphere/atmosphere.h"
+#include "core/atmosphere/atmosphere_renderer.h"
+#include "core/ocean/fft.h"
+#include "core/ocean/ocean.h"
+#include "core/noise/noise.h"
+#include "core/jobs/job_system.h"
+#include "core/sim/triple_buffer.h"
+#include "core/sim/sim_thread.h"
+#include "core/profiler/profiler.h"
+#include "core/graphics/ogl_fw/uniform_table.h"
+#include "core/graphics/ogl_fw/buffer_suballocator.h"
+#include "core/graphics/ogl_fw/render_commands.h"
+#include "core/graphics/ogl_fw/glslprogram.h"
+#include "core/graphics/ogl_fw/shader_variants.h"
+#include "core/graphics/ogl_fw/indirect_draw.h"
+#include "core/graphics/ogl_fw/hiz_culling.h"
+#include "core/graphics/ogl_fw/impostor.h"
+#include "demo_scene.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+namespace Bench {
+
+    static std::string bench_shader_root;
+
+    // hidden window with a 4.6 context, 4.5 on llvmpipe, the same as headless mode; GPU benchmarks
+    // skip their GPU half without one
+    struct gl_context_t
+    {
+        GLFWwindow* window = NULL;
+    public:
+        gl_context_t()
+        {
+            if (!glfwInit()) return;
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            this->window = glfwCreateWindow(64, 64, "Continuum bench", NULL, NULL);
+            if (this->window == NULL)
+            {
+                glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+                this->window = glfwCreateWindow(64, 64, "Continuum bench", NULL, NULL);
+            }
+            if (this->window == NULL) return;
+            glfwMakeContextCurrent(this->window);
+            if (glewInit() != GLEW_OK)
+            {
+                glfwDestroyWindow(this->window);
+                this->window = NULL;
+            }
+        }
+        ~gl_context_t()
+        {
+            if (this->window != NULL) glfwDestroyWindow(this->window);
+            glfwTerminate();
+        }
+        inline bool is_valid(void) const { return this->window != NULL; }
+    };
+
+    // scripted flight: dive from orbit down to 1 km altitude, then skim along the surface
+    static glm::vec3 scripted_camera_position(const int frame, const int frame_count, const float planet_radius)
+    {
+        const int half = frame_count / 2;
+        if (frame < half)
+        {
+            const float t = float(frame) / float(half);
+            const float altitude = glm::mix(3.0f * planet_radius, 1000.0f, t * t * (3.0f - 2.0f * t));
+            return glm::normalize(glm::vec3(0.3f, 0.2f, 1.0f)) * (planet_radius + altitude);
+        }
+        const float t = float(frame - half) / float(frame_count - half);
+        const float angle = t * 0.25f;
+        const glm::vec3 start = glm::normalize(glm::vec3(0.3f, 0.2f, 1.0f));
+        const glm::vec3 side = glm::normalize(glm::cross(start, glm::vec3(0.0f, 1.0f, 0.0f)));
+        return (start * std::cos(angle) + side * std::sin(angle)) * (planet_radius + 1000.0f);
+    }
+
+    static int bench_quadtree(void)
+    {
+        const int frame_count = 600;
+        const float viewport_width = 1200.0f;
+        const float viewport_height = 800.0f;
+        // same projection as the main loop
+        const glm::mat4 p = glm::perspective(45.0f, viewport_width / viewport_height, 0.1f, 1000.0f);
+
+        Continuum::Terrain::cube_sphere_quadtree_t quadtree;
+        const float planet_radius = quadtree.get_settings().planet_radius;
+
+        Continuum::Camera::OrbCameraPositioner positioner;
+        Continuum::Camera::camera_t camera(positioner);
+
+        double total_ms = 0.0;
+        double max_ms = 0.0;
+        uint32_t max_nodes = 0;
+        uint32_t max_leaves = 0;
+        uint32_t total_changes = 0;
+
+        printf("%6s %14s %8s %8s %7s %7s %6s %10s\n", "frame", "altitude_m", "nodes", "leaves", "splits", "merges", "depth", "update_ms");
+        for (int frame = 0; frame < frame_count; ++frame)
+        {
+            const glm::vec3 pos = scripted_camera_position(frame, frame_count, planet_radius);
+            positioner.look_at(pos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+            quadtree.update(camera.get_position(), p, viewport_height);
+
+            const Continuum::Terrain::quadtree_stats_t& stats = quadtree.get_stats();
+            total_ms += stats.update_ms;
+            max_ms = std::max(max_ms, stats.update_ms);
+            max_nodes = std::max(max_nodes, stats.node_count);
+            max_leaves = std::max(max_leaves, stats.leaf_count);
+            total_changes += stats.splits + stats.merges;
+
+            if (frame % 50 == 0 || frame == frame_count - 1)
+            {
+                printf("%6d %14.1f %8u %8u %7u %7u %6u %10.4f\n", frame, glm::length(pos) - planet_radius,
+                    stats.node_count, stats.leaf_count, stats.splits, stats.merges, stats.deepest_level, stats.update_ms);
+            }
+        }
+
+        printf("quadtree: frames=%d avg_update_ms=%.4f max_update_ms=%.4f max_nodes=%u max_leaves=%u splits+merges=%u\n",
+            frame_count, total_ms / frame_count, max_ms, max_nodes, max_leaves, total_changes);
+        return 0;
+    }
+
+    static int bench_noise(void)
+    {
+        using namespace Continuum;
+
+        // 64 patches of 33x33 samples on the unit sphere, laid out the way the terrain generator feeds them
+        const uint32_t grid = 33;
+        const uint32_t patch_count = 64;
+        Noise::point_grid_t points;
+        points.resize(size_t(grid) * grid * patch_count);
+        size_t n = 0;
+        for (uint32_t patch = 0; patch < patch_count; ++patch)
+        {
+            Terrain::patch_key_t key = {};
+            key.face = static_cast<uint8_t>(patch % Terrain::CubeFace::COUNT);
+            key.level = 3;
+            key.x = patch % 8;
+            key.y = (patch / 8) % 8;
+            float u0, v0, u1, v1;
+            Terrain::CubeSphere::patch_bounds(key, u0, v0, u1, v1);
+            for (uint32_t j = 0; j < grid; ++j)
+            {
+                for (uint32_t i = 0; i < grid; ++i, ++n)
+                {
+                    const glm::vec3 p = Terrain::CubeSphere::face_to_sphere(key.face,
+                        u0 + (u1 - u0) * float(i) / float(grid - 1), v0 + (v1 - v0) * float(j) / float(grid - 1));
+                    points.x[n] = p.x;
+                    points.y[n] = p.y;
+                    points.z[n] = p.z;
+                }
+            }
+        }
+
+        // results may differ from the scalar reference only by float contraction / reassociation
+        const float tolerance = 1e-5f;
+        const char* type_names[] = { "simplex", "fbm", "ridged" };
+        const Simd::SimdLevel best = Simd::detect();
+        printf("cpu: %s, %zu samples per pass\n", Simd::get_level_name(best), points.size());
+        printf("%-8s %-8s %14s %14s %12s\n", "type", "kernel", "Msamples/s", "ns/sample", "max_abs_err");
+
+        int result = 0;
+        std::vector<float> reference(points.size());
+        std::vector<float> out(points.size());
+        for (int type = Noise::NoiseType::SIMPLEX; type <= Noise::NoiseType::RIDGED; ++type)
+        {
+            Noise::noise_params_t params = {};
+            params.type = static_cast<Noise::NoiseType::NoiseTypeType>(type);
+            params.frequency = 4.0f;
+            params.octaves = 8;
+
+            Noise::evaluate(params, points, reference.data(), Simd::SimdLevel::SCALAR);
+
+            for (int level = Simd::SimdLevel::SCALAR; level <= best; ++level)
+            {
+                const Simd::SimdLevel simd_level = static_cast<Simd::SimdLevel>(level);
+                const int passes = 20;
+                const auto t0 = std::chrono::high_resolution_clock::now();
+                for (int pass = 0; pass < passes; ++pass) Noise::evaluate(params, points, out.data(), simd_level);
+                const auto t1 = std::chrono::high_resolution_clock::now();
+
+                float max_err = 0.0f;
+                for (size_t i = 0; i < out.size(); ++i) max_err = std::max(max_err, std::fabs(out[i] - reference[i]));
+
+                const double seconds = std::chrono::duration<double>(t1 - t0).count();
+                const double samples = double(points.size()) * passes;
+                printf("%-8s %-8s %14.2f %14.2f %12.3g%s\n", type_names[type], Simd::get_level_name(simd_level),
+                    samples / seconds * 1e-6, seconds * 1e9 / samples, max_err, max_err > tolerance ? "  FAILED" : "");
+                if (max_err > tolerance) result = 1;
+            }
+        }
+        return result;
+    }
+
+    static int bench_jobs(void)
+    {
+        using namespace Continuum;
+
+        // synthetic terrain workload: one 33x33 fBm patch per job
+        const uint32_t grid = 33;
+        const uint32_t job_count = 512;
+        Noise::point_grid_t points;
+        points.resize(size_t(grid) * grid);
+        for (uint32_t j = 0; j < grid; ++j)
+        {
+            for (uint32_t i = 0; i < grid; ++i)
+            {
+                const glm::vec3 p = Terrain::CubeSphere::face_to_sphere(0, float(i) / float(grid - 1), float(j) / float(grid - 1));
+                points.x[j * grid + i] = p.x;
+                points.y[j * grid + i] = p.y;
+                points.z[j * grid + i] = p.z;
+            }
+        }
+        std::vector<float> heights(points.size() * job_count);
+
+        const uint32_t max_workers = std::max(1u, std::thread::hardware_concurrency());
+        printf("%8s %10s %10s %10s %10s\n", "workers", "ms", "patches/s", "speedup", "stolen");
+        double single_ms = 0.0;
+        for (uint32_t workers = 1; workers <= max_workers; ++workers)
+        {
+            // the main thread only waits here, so exactly `workers` threads do the work
+            Jobs::job_counter_t done;
+            Jobs::job_system_t jobs(workers);
+
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            for (uint32_t job = 0; job < job_count; ++job)
+            {
+                jobs.submit([&points, &heights, job]()
+                {
+                    Noise::noise_params_t params = {};
+                    params.seed = job;
+                    params.frequency = 8.0f;
+                    Noise::evaluate(params, points, heights.data() + points.size() * job);
+                }, &done);
+            }
+            while (!done.is_done()) std::this_thread::yield();
+            const auto t1 = std::chrono::high_resolution_clock::now();
+
+            const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            if (workers == 1) single_ms = ms;
+            printf("%8u %10.2f %10.0f %10.2f %10llu\n", workers, ms, job_count / (ms * 1e-3), single_ms / ms,
+                static_cast<unsigned long long>(jobs.get_stats().stolen));
+        }
+
+        // dependency stress: three dependent fan-outs, the last one spawning and waiting on nested jobs
+        Jobs::job_system_t jobs;
+        const int iterations = 200;
+        const int fan_out = 64;
+        const int nested = 4;
+        std::atomic<int> errors = 0;
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            Jobs::job_counter_t a, b, c;
+            std::atomic<int> na = 0, nb = 0, nc = 0, nested_runs = 0;
+
+            for (int i = 0; i < fan_out; ++i) jobs.submit([&na]() { ++na; }, &a);
+            for (int i = 0; i < fan_out; ++i)
+            {
+                jobs.submit_after(a, [&]()
+                {
+                    if (na.load() != fan_out) ++errors;
+                    ++nb;
+                }, &b);
+            }
+            for (int i = 0; i < fan_out; ++i)
+            {
+                jobs.submit_after(b, [&]()
+                {
+                    if (nb.load() != fan_out) ++errors;
+                    Jobs::job_counter_t children;
+                    for (int n = 0; n < nested; ++n) jobs.submit([&nested_runs]() { ++nested_runs; }, &children);
+                    jobs.wait(children);
+                    ++nc;
+                }, &c);
+            }
+            jobs.wait(c);
+
+            // a dependency that has already completed releases the continuation immediately
+            Jobs::job_counter_t late;
+            jobs.submit_after(a, [&]() { if (nc.load() != fan_out) ++errors; }, &late);
+            jobs.wait(late);
+
+            if (nc.load() != fan_out || nested_runs.load() != fan_out * nested) ++errors;
+        }
+        printf("dependency stress: %d iterations on %u workers, errors=%d\n", iterations, jobs.get_worker_count(), errors.load());
+        return errors.load() == 0 ? 0 : 1;
+    }
+
+    static int bench_uniforms(void)
+    {
+        using namespace Continuum::Graphics;
+        using namespace Continuum::Graphics::UniformLiterals;
+
+        // lookup cost only, the glUniform* call itself is identical for all three paths
+        static constexpr uniform_name_t names[] = {
+            "view"_uniform, "proj"_uniform, "model"_uniform, "cam_pos"_uniform,
+            "grid_size"_uniform, "grid_cell_size"_uniform, "grid_color_thin"_uniform, "grid_color_thick"_uniform,
+            "planet_radius"_uniform, "patch_origin"_uniform, "patch_scale"_uniform, "height_min_max"_uniform,
+            "sun_direction"_uniform, "sun_intensity"_uniform, "exposure"_uniform, "time"_uniform,
+        };
+        const uint32_t name_count = sizeof(names) / sizeof(names[0]);
+        const uint32_t sets_per_frame = 10000;
+        const uint32_t frames = 200;
+
+        std::map<std::string, GLint> old_locations;
+        uniform_table_t table;
+        std::vector<GLint> slots;
+        for (uint32_t i = 0; i < name_count; ++i)
+        {
+            old_locations[names[i].name] = GLint(i);
+            table.insert(names[i].hash, GLint(i));
+            slots.push_back(GLint(i));
+        }
+
+        volatile GLint sink = 0;
+        double ms[3] = {};
+
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            for (uint32_t i = 0; i < sets_per_frame; ++i)
+            {
+                // what glsl_program_t::get_uniform_location used to do: std::string from the name, then a tree walk
+                const auto it = old_locations.find(names[i % name_count].name);
+                sink = sink + it->second;
+            }
+        }
+        auto t1 = std::chrono::high_resolution_clock::now();
+        ms[0] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        t0 = std::chrono::high_resolution_clock::now();
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            for (uint32_t i = 0; i < sets_per_frame; ++i)
+            {
+                GLint loc = -1;
+                table.find(names[i % name_count].hash, loc);
+                sink = sink + loc;
+            }
+        }
+        t1 = std::chrono::high_resolution_clock::now();
+        ms[1] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        t0 = std::chrono::high_resolution_clock::now();
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            for (uint32_t i = 0; i < sets_per_frame; ++i)
+            {
+                sink = sink + slots[i % name_count];
+            }
+        }
+        t1 = std::chrono::high_resolution_clock::now();
+        ms[2] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        const char* paths[3] = { "string map (old)", "hashed literal", "uniform_t handle" };
+        printf("%u uniform sets per frame, %u frames\n", sets_per_frame, frames);
+        printf("%-18s %12s %12s\n", "path", "ms/frame", "ns/set");
+        for (int i = 0; i < 3; ++i)
+        {
+            printf("%-18s %12.4f %12.2f\n", paths[i], ms[i] / frames, ms[i] * 1e6 / (double(frames) * sets_per_frame));
+        }
+        return 0;
+    }
+
+    static int bench_culling(void)
+    {
+        using namespace Continuum;
+
+        const int frame_count = 600;
+        const int repeats = 20;
+        const float viewport_width = 1200.0f;
+        const float viewport_height = 800.0f;
+
+        Terrain::cube_sphere_quadtree_t quadtree;
+        const float planet_radius = quadtree.get_settings().planet_radius;
+
+        // the main loop projection refines the quadtree; culling needs a far plane that reaches past the horizon
+        const glm::mat4 p = glm::perspective(45.0f, viewport_width / viewport_height, 0.1f, 1000.0f);
+        const glm::mat4 cull_proj = glm::perspective(45.0f, viewport_width / viewport_height, 1.0f, 8.0f * planet_radius);
+
+        Camera::OrbCameraPositioner positioner;
+        Camera::camera_t camera(positioner);
+
+        Graphics::bounding_spheres_t spheres;
+        std::vector<uint32_t> visible_scalar;
+        std::vector<uint32_t> visible_simd;
+        const Simd::SimdLevel levels[2] = { Simd::SimdLevel::SCALAR, Simd::detect() };
+        double ns_total[2] = { 0.0, 0.0 };
+        uint64_t tested = 0, visible = 0, frustum_culled = 0, horizon_culled = 0;
+        int mismatches = 0;
+
+        for (int frame = 0; frame < frame_count; ++frame)
+        {
+            const glm::vec3 pos = scripted_camera_position(frame, frame_count, planet_radius);
+            positioner.look_at(pos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            quadtree.update(camera.get_position(), p, viewport_height);
+
+            spheres.clear();
+            for (const Terrain::quadtree_patch_t& patch : quadtree.get_patches()) spheres.push_back(patch.center, patch.radius);
+
+            Graphics::horizon_occluder_t horizon;
+            horizon.camera_pos = camera.get_position();
+            horizon.planet_radius = planet_radius;
+            const Graphics::frustum_t frustum = Graphics::frustum_t::from_matrix(cull_proj * camera.get_view_matrix());
+
+            Graphics::cull_stats_t stats[2];
+            for (int l = 0; l < 2; ++l)
+            {
+                std::vector<uint32_t>& out = l == 0 ? visible_scalar : visible_simd;
+                for (int r = 0; r < repeats; ++r)
+                {
+                    Graphics::cull_spheres(spheres, frustum, &horizon, out, &stats[l], levels[l]);
+                    ns_total[l] += stats[l].ns_per_sphere;
+                }
+            }
+            if (visible_scalar != visible_simd) ++mismatches;
+
+            tested += stats[1].tested;
+            visible += stats[1].visible;
+            frustum_culled += stats[1].frustum_culled;
+            horizon_culled += stats[1].horizon_culled;
+        }
+
+        const double samples = double(frame_count) * repeats;
+        printf("culling: frames=%d patches=%llu visible=%llu frustum_culled=%llu horizon_culled=%llu\n", frame_count,
+            (unsigned long long)tested, (unsigned long long)visible, (unsigned long long)frustum_culled, (unsigned long long)horizon_culled);
+        printf("culling: scalar %.2f ns/patch, %s %.2f ns/patch, mismatching frames=%d\n",
+            ns_total[0] / samples, Simd::get_level_name(levels[1]), ns_total[1] / samples, mismatches);
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    static int bench_profiler(void)
+    {
+#if CONTINUUM_PROFILER
+        const int scope_count = 1 << 22;
+        const int thread_count = 4;
+
+        // the first scope registers the thread buffer, keep it out of the measurement
+        {
+            CONTINUUM_PROFILE_SCOPE("warmup");
+        }
+
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < scope_count; ++i)
+        {
+            CONTINUUM_PROFILE_SCOPE("bench_scope");
+        }
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        const double ns_per_scope = std::chrono::duration<double, std::nano>(t1 - t0).count() / scope_count;
+
+        // every thread owns its buffer, so adding threads should not change the cost a thread pays per scope;
+        // each thread times its own loop, wall time over all threads would divide the cost by the core count
+        std::vector<std::thread> threads;
+        std::vector<double> thread_ns(thread_count, 0.0);
+        for (int t = 0; t < thread_count; ++t)
+        {
+            threads.emplace_back([scope_count, thread_count, t, &thread_ns]() {
+                CONTINUUM_PROFILE_THREAD("bench worker");
+                const auto start = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < scope_count / thread_count; ++i)
+                {
+                    CONTINUUM_PROFILE_SCOPE("bench_thread_scope");
+                }
+                thread_ns[t] = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+        double threaded_ns_per_scope = 0.0;
+        for (const double ns : thread_ns) threaded_ns_per_scope = std::max(threaded_ns_per_scope, ns / (scope_count / thread_count));
+
+        // two timestamps per scope are the floor of any timing scheme and a virtualised TSC read alone can cost
+        // 25+ ns, so the budget is held against what the profiler adds on top of them
+        const auto t4 = std::chrono::high_resolution_clock::now();
+        const uint64_t first_tick = Continuum::Profiler::now_ticks();
+        uint64_t last_tick = first_tick;
+        for (int i = 0; i < scope_count; ++i) last_tick = Continuum::Profiler::now_ticks();
+        const auto t5 = std::chrono::high_resolution_clock::now();
+        const double tick_loop_ns = std::chrono::duration<double, std::nano>(t5 - t4).count();
+        const double ns_per_tick_read = tick_loop_ns / scope_count;
+        const double ticks_per_ns = double(last_tick - first_tick) / tick_loop_ns;
+        const double overhead_ns = ns_per_scope - 2.0 * ns_per_tick_read;
+
+        const char* trace_path = "profiler_bench_trace.json";
+        const auto t6 = std::chrono::high_resolution_clock::now();
+        const int64_t events = CONTINUUM_PROFILE_EXPORT(trace_path);
+        const auto t7 = std::chrono::high_resolution_clock::now();
+        remove(trace_path);
+
+        const double budget_ns = 50.0;
+        // with fewer cores than threads the per-thread time also counts the slices the other threads ran in
+        printf("profiler: %.2f ns/scope single thread, %.2f ns/scope on the slowest of %d threads over %u cores\n",
+            ns_per_scope, threaded_ns_per_scope, thread_count, std::thread::hardware_concurrency());
+        printf("profiler: timestamp read %.2f ns (%.3f ticks/ns), so %.2f ns/scope are spent outside the clock (budget %.0f ns)\n",
+            ns_per_tick_read, ticks_per_ns, overhead_ns, budget_ns);
+        printf("profiler: exported %lld events in %.2f ms\n", static_cast<long long>(events),
+            std::chrono::duration<double, std::milli>(t7 - t6).count());
+        if (overhead_ns > budget_ns) printf("profiler: FAILED, a scope adds more than the %.0f ns budget to its timestamps\n", budget_ns);
+        return events > 0 && overhead_ns <= budget_ns ? 0 : 1;
+#else
+        printf("profiler: compiled out (configure with -DCONTINUUM_ENABLE_PROFILER=ON)\n");
+        return 0;
+#endif
+    }
+
+    // CPU-only checks of the suballocator logic: no GL context, frees retire by frame count
+    static int bench_suballocator(void)
+    {
+        using namespace Continuum::Graphics;
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+
+        // live ranges keyed by (arena, offset), an insert overlapping a neighbour is an allocator bug
+        std::map<uint64_t, uint64_t> live;
+        const auto insert_range = [&live](const uint64_t key, const uint64_t size) {
+            std::map<uint64_t, uint64_t>::iterator next = live.lower_bound(key);
+            if (next != live.end() && next->first < key + size) return false;
+            if (next != live.begin())
+            {
+                std::map<uint64_t, uint64_t>::iterator prev = std::prev(next);
+                if (prev->first + prev->second > key) return false;
+            }
+            live.emplace(key, size);
+            return true;
+        };
+
+        // 1. TLSF against random churn
+        {
+            const uint32_t capacity = 1 << 16;
+            tlsf_allocator_t tlsf(capacity);
+            std::vector<uint32_t> blocks;
+            uint32_t rng = 12345;
+            const auto next_random = [&rng]() { rng = rng * 1664525u + 1013904223u; return rng >> 8; };
+            bool no_overlap = true;
+            uint64_t live_granules = 0;
+
+            live.clear();
+            for (int op = 0; op < 200000; ++op)
+            {
+                if (blocks.empty() || next_random() % 100 < 55)
+                {
+                    const uint32_t size = 1 + (next_random() % 64) * (next_random() % 8 + 1);
+                    const uint32_t block = tlsf.allocate(size);
+                    if (block == tlsf_allocator_t::k_invalid) continue;
+                    no_overlap = no_overlap && tlsf.get_size(block) >= size && tlsf.get_offset(block) + tlsf.get_size(block) <= capacity;
+                    no_overlap = no_overlap && insert_range(tlsf.get_offset(block), tlsf.get_size(block));
+                    live_granules += tlsf.get_size(block);
+                    blocks.push_back(block);
+                }
+                else
+                {
+                    const size_t pick = next_random() % blocks.size();
+                    const uint32_t block = blocks[pick];
+                    live.erase(tlsf.get_offset(block));
+                    live_granules -= tlsf.get_size(block);
+                    tlsf.free(block);
+                    blocks[pick] = blocks.back();
+                    blocks.pop_back();
+                }
+            }
+            check(no_overlap, "tlsf blocks stay in bounds and never overlap");
+            check(tlsf.get_free() == capacity - live_granules, "tlsf free count matches live blocks");
+            for (const uint32_t block : blocks) tlsf.free(block);
+            check(tlsf.get_free_block_count() == 1 && tlsf.get_largest_free() == capacity, "tlsf coalesces back into one block");
+        }
+
+        buffer_suballocator_settings_t settings;
+        settings.cpu_only = true;
+        settings.arena_size = 4 * 1024 * 1024;
+        settings.max_arenas = 4;
+        const uint64_t patch_bytes = settings.slab_slot_size;
+
+        // 2. slab allocations and fence-deferred frees
+        {
+            buffer_suballocator_t allocator(settings);
+            std::vector<gpu_allocation_t> patches;
+            bool no_overlap = true;
+            live.clear();
+            for (int i = 0; i < 200; ++i)
+            {
+                const gpu_allocation_t allocation = allocator.allocate(patch_bytes);
+                no_overlap = no_overlap && allocation.is_valid() && allocation.slot != UINT32_MAX;
+                no_overlap = no_overlap && insert_range((uint64_t(allocation.arena) << 40) | allocation.offset, allocation.size);
+                patches.push_back(allocation);
+            }
+            buffer_suballocator_stats_t stats = allocator.get_stats();
+            check(no_overlap, "patch-sized requests come from distinct slab slots");
+            check(stats.slab_slots_used == 200 && stats.slabs == (200 + 63) / 64, "slab occupancy");
+
+            for (const gpu_allocation_t& allocation : patches) allocator.free(allocation);
+            allocator.end_frame();
+            bool held = true;
+            for (uint32_t frame = 1; frame < settings.frames_in_flight; ++frame)
+            {
+                allocator.begin_frame();
+                held = held && allocator.get_stats().pending_frees == 200;
+                allocator.end_frame();
+            }
+            check(held, "frees are held while their frame may still be in flight");
+            allocator.begin_frame();
+            stats = allocator.get_stats();
+            check(stats.pending_frees == 0 && stats.requested_bytes == 0 && stats.slabs == 0, "frees retire after frames_in_flight frames");
+            check(stats.free_bytes == stats.arena_bytes && stats.free_blocks == stats.arenas, "empty slabs return to the arena");
+        }
+
+        // 3. exhaustion and growth
+        {
+            buffer_suballocator_t allocator(settings);
+            std::vector<gpu_allocation_t> blocks;
+            while (true)
+            {
+                const gpu_allocation_t allocation = allocator.allocate(1024 * 1024);
+                if (!allocation.is_valid()) break;
+                blocks.push_back(allocation);
+            }
+            buffer_suballocator_stats_t stats = allocator.get_stats();
+            check(blocks.size() == 16 && stats.arenas == 4 && stats.failed_allocations == 1, "arenas grow up to max_arenas, then allocation fails");
+            for (const gpu_allocation_t& allocation : blocks) allocator.free(allocation);
+            for (uint32_t frame = 0; frame <= settings.frames_in_flight; ++frame)
+            {
+                allocator.end_frame();
+                allocator.begin_frame();
+            }
+            stats = allocator.get_stats();
+            check(stats.free_bytes == stats.arena_bytes && stats.free_blocks == stats.arenas, "arenas fully coalesce after release");
+        }
+
+        // 4. streaming churn: patches and odd-sized buffers in and out every frame
+        {
+            settings.arena_size = 32 * 1024 * 1024;
+            buffer_suballocator_t allocator(settings);
+            std::vector<gpu_allocation_t> resident;
+            uint32_t rng = 777;
+            const auto next_random = [&rng]() { rng = rng * 1664525u + 1013904223u; return rng >> 8; };
+            uint64_t operations = 0;
+            uint64_t peak_allocated = 0;
+            double max_fragmentation = 0.0;
+
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            for (int frame = 0; frame < 2000; ++frame)
+            {
+                allocator.begin_frame();
+                const uint32_t target = 600 + static_cast<uint32_t>(300.0 * std::sin(frame * 0.01));
+                // a few percent of the resident set streams out every frame, plus whatever exceeds the target
+                size_t evict = resident.size() / 20;
+                if (resident.size() > target) evict += resident.size() - target;
+                for (size_t i = 0; i < evict && !resident.empty(); ++i)
+                {
+                    const size_t pick = next_random() % resident.size();
+                    allocator.free(resident[pick]);
+                    resident[pick] = resident.back();
+                    resident.pop_back();
+                    ++operations;
+                }
+                while (resident.size() < target)
+                {
+                    const uint64_t size = next_random() % 4 != 0 ? patch_bytes : 1024 + next_random() % (256 * 1024);
+                    const gpu_allocation_t allocation = allocator.allocate(size);
+                    if (!allocation.is_valid()) break;
+                    resident.push_back(allocation);
+                    ++operations;
+                }
+                allocator.end_frame();
+
+                if (frame % 50 == 0)
+                {
+                    const buffer_suballocator_stats_t stats = allocator.get_stats();
+                    peak_allocated = std::max(peak_allocated, stats.allocated_bytes);
+                    max_fragmentation = std::max(max_fragmentation, stats.fragmentation);
+                }
+            }
+            const auto t1 = std::chrono::high_resolution_clock::now();
+
+            const buffer_suballocator_stats_t stats = allocator.get_stats();
+            check(stats.failed_allocations == 0, "churn fits in the arena budget");
+            printf("suballocator churn: %llu ops, %.1f ns/op, %u arenas, peak %.1f MB allocated, requested/allocated %.3f, max fragmentation %.3f\n",
+                static_cast<unsigned long long>(operations), std::chrono::duration<double, std::nano>(t1 - t0).count() / double(operations),
+                stats.arenas, double(peak_allocated) / (1024.0 * 1024.0),
+                stats.allocated_bytes > 0 ? double(stats.requested_bytes) / double(stats.allocated_bytes) : 1.0, max_fragmentation);
+            printf("suballocator final: %u slabs (%u/%u slots), %u free blocks, largest free %.1f MB of %.1f MB free, %u frees pending\n",
+                stats.slabs, stats.slab_slots_used, stats.slab_slots_total, stats.free_blocks,
+                double(stats.largest_free_block) / (1024.0 * 1024.0), double(stats.free_bytes) / (1024.0 * 1024.0), stats.pending_frees);
+        }
+
+        printf("suballocator: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_tilecache(void)
+    {
+        using namespace Continuum;
+        using namespace Continuum::Terrain;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+
+        const std::filesystem::path root = std::filesystem::temp_directory_path() / "continuum_tile_cache_bench";
+        std::error_code ec = {};
+        std::filesystem::remove_all(root, ec);
+
+        heightfield_settings_t heightfield = {};
+        heightfield.noise.frequency = 8.0f;
+        tile_cache_settings_t settings = {};
+        settings.directory = root.string();
+
+        // 1. generate vs load, and the round trip through the file
+        {
+            const uint32_t tile_count = 256;
+            std::vector<patch_key_t> keys;
+            for (uint32_t i = 0; i < tile_count; ++i)
+            {
+                patch_key_t key = {};
+                key.face = static_cast<uint8_t>(i % CubeFace::COUNT);
+                key.level = 6;
+                key.x = i % 16;
+                key.y = i / 16;
+                keys.push_back(key);
+            }
+
+            std::vector<heightfield_tile_t> generated(tile_count);
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < tile_count; ++i) generate_heightfield(heightfield, keys[i], generated[i]);
+            const auto t1 = std::chrono::high_resolution_clock::now();
+
+            {
+                tile_cache_t cache(heightfield, settings);
+                for (uint32_t i = 0; i < tile_count; ++i)
+                {
+                    heightfield_tile_t copy = generated[i];
+                    cache.store(std::move(copy));
+                }
+            }
+
+            // a fresh cache, every tile comes from its mapped file
+            tile_cache_t cache(heightfield, settings);
+            std::vector<std::shared_ptr<const heightfield_tile_t>> loaded(tile_count);
+            const auto t2 = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < tile_count; ++i) loaded[i] = cache.load(keys[i]);
+            const auto t3 = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < tile_count; ++i) loaded[i] = cache.load(keys[i]);
+            const auto t4 = std::chrono::high_resolution_clock::now();
+
+            float max_error = 0.0f;
+            bool within_bound = true;
+            for (uint32_t i = 0; i < tile_count; ++i)
+            {
+                if (loaded[i] == NULL) { within_bound = false; continue; }
+                const heightfield_tile_t& a = generated[i];
+                const heightfield_tile_t& b = *loaded[i];
+                // half a quantization step, plus float rounding of the decode
+                const float bound = (a.max_height - a.min_height) / 65535.0f * 0.5f + a.max_height * 1e-6f;
+                for (size_t s = 0; s < a.heights.size(); ++s)
+                {
+                    const float error = std::abs(a.heights[s] - b.heights[s]);
+                    max_error = std::max(max_error, error);
+                    within_bound &= error <= bound;
+                }
+            }
+            const tile_cache_stats_t stats = cache.get_stats();
+            check(stats.disk_hits == tile_count && stats.memory_hits == tile_count, "second pass hits memory, first pass the files");
+            check(within_bound, "decoded heights stay within half a quantization step");
+
+            const double generate_us = std::chrono::duration<double, std::micro>(t1 - t0).count() / tile_count;
+            const double disk_us = std::chrono::duration<double, std::micro>(t3 - t2).count() / tile_count;
+            const double memory_us = std::chrono::duration<double, std::micro>(t4 - t3).count() / tile_count;
+            printf("tilecache: %ux%u tiles, %zu bytes on disk, generate %.1f us, load (mmap) %.1f us, memory hit %.3f us, speedup %.1fx\n",
+                heightfield.resolution, heightfield.resolution, sizeof(tile_file_header_t) + generated[0].heights.size() * sizeof(uint16_t),
+                generate_us, disk_us, memory_us, generate_us / disk_us);
+            printf("tilecache: max quantization error %.4f m, memory lookups %s\n", max_error,
+                stats.lock_free_lookups ? "lock-free" : "behind the atomic shared_ptr's internal lock");
+
+            // a tile cached under other settings, and a damaged one, both read as misses
+            heightfield_settings_t other = heightfield;
+            other.noise.seed += 1;
+            tile_cache_settings_t other_settings = settings;
+            tile_cache_t other_cache(other, other_settings);
+            check(other_cache.load(keys[0]) == NULL, "tiles of other settings are not visible");
+
+            std::filesystem::resize_file(cache.get_tile_path(keys[1]), 100, ec);
+            tile_cache_t damaged(heightfield, settings);
+            check(damaged.load(keys[1]) == NULL && damaged.get_stats().rejected == 1, "truncated tiles are rejected");
+            check(damaged.get_or_generate(keys[1]) != NULL && damaged.get_stats().misses == 1, "rejected tiles regenerate");
+        }
+
+        // 2. scripted flight: visible patches look their tile up every frame, misses load or generate on the job system
+        const auto fly = [&](const char* label, const size_t budget) {
+            const int frame_count = 600;
+            const float viewport_width = 1200.0f;
+            const float viewport_height = 800.0f;
+            const glm::mat4 p = glm::perspective(45.0f, viewport_width / viewport_height, 0.1f, 1000.0f);
+
+            // streaming granularity, finer levels would be refined from these tiles on the GPU
+            quadtree_settings_t quadtree_settings = {};
+            quadtree_settings.planet_radius = heightfield.planet_radius;
+            quadtree_settings.max_level = 12;
+            cube_sphere_quadtree_t quadtree(quadtree_settings);
+            const glm::mat4 cull_proj = glm::perspective(45.0f, viewport_width / viewport_height, 1.0f, 8.0f * quadtree_settings.planet_radius);
+            Graphics::bounding_spheres_t spheres;
+            std::vector<uint32_t> visible;
+            Camera::OrbCameraPositioner positioner;
+            Camera::camera_t camera(positioner);
+
+            tile_cache_settings_t flight_settings = settings;
+            flight_settings.memory_budget = budget;
+            tile_cache_t cache(heightfield, flight_settings);
+            Jobs::job_system_t jobs;
+
+            uint64_t lookups = 0;
+            uint64_t frame_misses = 0;
+            double worst_frame_ms = 0.0;
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            for (int frame = 0; frame < frame_count; ++frame)
+            {
+                const glm::vec3 pos = scripted_camera_position(frame, frame_count, quadtree_settings.planet_radius);
+                positioner.look_at(pos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                quadtree.update(camera.get_position(), p, viewport_height);
+
+                const std::vector<quadtree_patch_t>& patches = quadtree.get_patches();
+                spheres.clear();
+                for (const quadtree_patch_t& patch : patches) spheres.push_back(patch.center, patch.radius);
+                Graphics::horizon_occluder_t horizon;
+                horizon.camera_pos = camera.get_position();
+                horizon.planet_radius = quadtree_settings.planet_radius;
+                Graphics::cull_spheres(spheres, Graphics::frustum_t::from_matrix(cull_proj * camera.get_view_matrix()), &horizon, visible, NULL);
+
+                const auto f0 = std::chrono::high_resolution_clock::now();
+                Jobs::job_counter_t done;
+                for (const uint32_t index : visible)
+                {
+                    const quadtree_patch_t& patch = patches[index];
+                    ++lookups;
+                    if (cache.find(patch.key) != NULL) continue;
+                    ++frame_misses;
+                    const patch_key_t key = patch.key;
+                    jobs.submit([&cache, key]() { cache.get_or_generate(key); }, &done);
+                }
+                jobs.wait(done);
+                const auto f1 = std::chrono::high_resolution_clock::now();
+                worst_frame_ms = std::max(worst_frame_ms, std::chrono::duration<double, std::milli>(f1 - f0).count());
+            }
+            const auto t1 = std::chrono::high_resolution_clock::now();
+
+            // find() counts the frame lookups that hit, disk hits and misses come from the jobs
+            const tile_cache_stats_t stats = cache.get_stats();
+            const uint64_t frame_hits = lookups - frame_misses;
+            printf("tilecache %s: budget %.0f MB, %llu lookups, memory hit rate %.2f%%, disk %llu, generated %llu, evicted %llu, resident %u (%.1f MB), %.1f ms total, worst frame %.2f ms\n",
+                label, double(budget) / (1024.0 * 1024.0), static_cast<unsigned long long>(lookups), 100.0 * double(frame_hits) / double(std::max<uint64_t>(lookups, 1)),
+                static_cast<unsigned long long>(stats.disk_hits), static_cast<unsigned long long>(stats.misses), static_cast<unsigned long long>(stats.evictions),
+                stats.resident_tiles, double(stats.memory_bytes) / (1024.0 * 1024.0), std::chrono::duration<double, std::milli>(t1 - t0).count(), worst_frame_ms);
+            check(stats.memory_bytes <= budget, "resident tiles stay within the budget");
+            return stats;
+        };
+
+        std::filesystem::remove_all(root, ec);
+        const tile_cache_stats_t cold = fly("cold", 64ull * 1024 * 1024);
+        const tile_cache_stats_t warm = fly("warm", 64ull * 1024 * 1024);
+        fly("small", 2ull * 1024 * 1024);
+        check(cold.misses > 0 && warm.misses == 0 && warm.disk_hits == cold.misses, "a second flight loads every tile from disk");
+
+        std::filesystem::remove_all(root, ec);
+        printf("tilecache: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_patchgen(void)
+    {
+        using namespace Continuum;
+        using namespace Continuum::Terrain;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+
+        heightfield_settings_t settings = {};
+        settings.noise.frequency = 8.0f;
+        const uint32_t patch_count = 256;
+        const int runs = 5;
+        const size_t patch_vertices = size_t(settings.resolution) * settings.resolution;
+
+        std::vector<patch_key_t> keys;
+        for (uint32_t i = 0; i < patch_count; ++i)
+        {
+            patch_key_t key = {};
+            key.face = static_cast<uint8_t>(i % CubeFace::COUNT);
+            key.level = 8;
+            key.x = 100 + i % 16;
+            key.y = 100 + i / 16;
+            keys.push_back(key);
+        }
+
+        // 1. neighbours agree along their shared edge, the border samples make the normals continuous
+        {
+            patch_key_t left = keys[0];
+            patch_key_t right = left;
+            right.x += 1;
+            std::vector<terrain_vertex_t> a(patch_vertices), b(patch_vertices);
+            build_patch_vertices(settings, left, a.data());
+            build_patch_vertices(settings, right, b.data());
+            const glm::dvec3 origin_a = patch_origin(settings, left);
+            const glm::dvec3 origin_b = patch_origin(settings, right);
+
+            float max_position_error = 0.0f;
+            float min_normal_dot = 1.0f;
+            for (uint32_t j = 0; j < settings.resolution; ++j)
+            {
+                const terrain_vertex_t& va = a[size_t(j) * settings.resolution + settings.resolution - 1];
+                const terrain_vertex_t& vb = b[size_t(j) * settings.resolution];
+                const glm::dvec3 pa = origin_a + glm::dvec3(va.position[0], va.position[1], va.position[2]);
+                const glm::dvec3 pb = origin_b + glm::dvec3(vb.position[0], vb.position[1], vb.position[2]);
+                max_position_error = std::max(max_position_error, float(glm::length(pa - pb)));
+                min_normal_dot = std::min(min_normal_dot, glm::dot(glm::vec3(va.normal[0], va.normal[1], va.normal[2]), glm::vec3(vb.normal[0], vb.normal[1], vb.normal[2])));
+            }
+            printf("patchgen: shared edge max position error %.3f m, min normal dot %.6f\n", max_position_error, min_normal_dot);
+            check(max_position_error < 2.0f && min_normal_dot > 0.999f, "neighbouring patches agree along their shared edge");
+        }
+
+        Jobs::job_system_t jobs;
+        gl_context_t context;
+        Graphics::buffer_suballocator_settings_t buffer_settings = {};
+        buffer_settings.cpu_only = !context.is_valid();
+        Graphics::buffer_suballocator_t buffers(buffer_settings);
+        patch_generator_t generator(settings, buffers, &jobs);
+        const bool gpu = context.is_valid() && generator.init_gpu(bench_shader_root);
+        if (!context.is_valid()) printf("patchgen: no OpenGL 4.5 context, GPU backend skipped\n");
+        else printf("patchgen: %s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+        std::vector<patch_request_t> requests[2];
+        for (int backend = 0; backend < 2; ++backend)
+        {
+            for (const patch_key_t& key : keys)
+            {
+                patch_request_t request = {};
+                request.key = key;
+                request.vertices = buffers.allocate(generator.get_patch_bytes());
+                requests[backend].push_back(request);
+            }
+        }
+
+        // 2. patches per millisecond, including the upload and, on the GPU, the completed dispatches
+        const PatchBackend::PatchBackendType backends[2] = { PatchBackend::CPU, PatchBackend::GPU };
+        const char* names[2] = { "cpu", "gpu" };
+        for (int backend = 0; backend < 2; ++backend)
+        {
+            if (backends[backend] == PatchBackend::GPU && !gpu) continue;
+            generator.set_backend(backends[backend]);
+            generator.generate(requests[backend]);
+            if (context.is_valid()) glFinish();
+
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            for (int run = 0; run < runs; ++run) generator.generate(requests[backend]);
+            if (context.is_valid()) glFinish();
+            const auto t1 = std::chrono::high_resolution_clock::now();
+
+            const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            printf("patchgen %s: %u patches of %ux%u, %.3f ms/patch, %.2f patches/ms (%u workers)\n", names[backend], patch_count,
+                settings.resolution, settings.resolution, ms / (patch_count * runs), (patch_count * runs) / ms, jobs.get_worker_count());
+        }
+
+        // 3. both backends against the CPU reference, read back from the vertex buffers
+        if (context.is_valid())
+        {
+            std::vector<terrain_vertex_t> reference(patch_vertices);
+            std::vector<terrain_vertex_t> readback(patch_vertices);
+            for (int backend = 0; backend < 2; ++backend)
+            {
+                if (backends[backend] == PatchBackend::GPU && !gpu) continue;
+                float max_height_error = 0.0f;
+                float max_position_error = 0.0f;
+                float min_normal_dot = 1.0f;
+                bool outward = true;
+                for (const patch_request_t& request : requests[backend])
+                {
+                    build_patch_vertices(settings, request.key, reference.data());
+                    glGetNamedBufferSubData(request.vertices.buffer, GLintptr(request.vertices.offset), GLsizeiptr(generator.get_patch_bytes()), readback.data());
+                    const glm::vec3 origin = glm::vec3(patch_origin(settings, request.key));
+                    for (size_t v = 0; v < patch_vertices; ++v)
+                    {
+                        const terrain_vertex_t& r = reference[v];
+                        const terrain_vertex_t& g = readback[v];
+                        const glm::vec3 rp = glm::vec3(r.position[0], r.position[1], r.position[2]);
+                        const glm::vec3 gp = glm::vec3(g.position[0], g.position[1], g.position[2]);
+                        const glm::vec3 gn = glm::vec3(g.normal[0], g.normal[1], g.normal[2]);
+                        max_height_error = std::max(max_height_error, std::abs(r.height - g.height));
+                        max_position_error = std::max(max_position_error, glm::length(rp - gp));
+                        min_normal_dot = std::min(min_normal_dot, glm::dot(glm::vec3(r.normal[0], r.normal[1], r.normal[2]), gn));
+                        outward &= glm::dot(gn, origin + gp) > 0.0f;
+                    }
+                }
+                printf("patchgen %s vs reference: max height error %.4f m, max position error %.4f m, min normal dot %.6f\n",
+                    names[backend], max_height_error, max_position_error, min_normal_dot);
+                check(max_height_error < 0.5f && max_position_error < 2.0f && min_normal_dot > 0.995f, "backend matches the CPU reference within tolerance");
+                check(outward, "normals point away from the planet centre");
+            }
+        }
+
+        // 4. the PACKED format: encoding error bounds, then both backends decoded and compared with the reference
+        {
+            // half a step, plus float rounding at the magnitude of the patch's heights
+            const auto height_bound = [](const float h, const float min_height, const float step) {
+                const float magnitude = std::max({ std::abs(h), std::abs(min_height), std::abs(min_height + VertexPacking::k_height_steps * step) });
+                return 0.5f * step + 2.0f * (std::nextafter(magnitude, INFINITY) - magnitude);
+            };
+            uint32_t rng = 7;
+            const auto next_signed = [&rng]() { rng = rng * 1664525u + 1013904223u; return float(rng >> 8) / float(1u << 23) - 1.0f; };
+            float max_normal_degrees = 0.0f;
+            float max_height_steps = 0.0f;
+            bool heights_bounded = true;
+            for (int n = 0; n < 100000; ++n)
+            {
+                const glm::vec3 v = glm::vec3(next_signed(), next_signed(), next_signed());
+                if (glm::length(v) < 1e-3f) continue;
+                const glm::vec3 normal = glm::normalize(v);
+                int8_t encoded[2];
+                VertexPacking::oct_encode(normal, encoded);
+                const float d = std::min(glm::dot(VertexPacking::oct_decode(encoded), normal), 1.0f);
+                max_normal_degrees = std::max(max_normal_degrees, glm::degrees(std::acos(d)));
+
+                const float min_height = next_signed() * 5000.0f;
+                const float max_height = min_height + 1.0f + (next_signed() + 1.0f) * 2000.0f;
+                const float step = VertexPacking::height_step(min_height, max_height);
+                const float h = min_height + (next_signed() * 0.5f + 0.5f) * (max_height - min_height);
+                const float error = std::abs(VertexPacking::dequantize_height(VertexPacking::quantize_height(h, min_height, step), min_height, step) - h);
+                max_height_steps = std::max(max_height_steps, error / step);
+                heights_bounded &= error <= height_bound(h, min_height, step);
+            }
+            printf("patchgen packed encoding: max normal error %.3f deg, max height error %.3f steps\n", max_normal_degrees, max_height_steps);
+            check(max_normal_degrees < 1.0f, "octahedral normals decode within a degree");
+            check(heights_bounded, "heights decode within half a quantization step");
+
+            patch_generator_t packed_generator(settings, buffers, &jobs, PatchVertexFormat::PACKED);
+            const bool packed_gpu = context.is_valid() && packed_generator.init_gpu(bench_shader_root);
+            printf("patchgen packed: %llu bytes per patch instead of %llu (%.1fx smaller)\n", static_cast<unsigned long long>(packed_generator.get_patch_bytes()),
+                static_cast<unsigned long long>(generator.get_patch_bytes()), double(generator.get_patch_bytes()) / double(packed_generator.get_patch_bytes()));
+            check(packed_generator.get_patch_bytes() * 7 < generator.get_patch_bytes(), "packed patches are over 7x smaller");
+            check(!gpu || packed_gpu, "packed generator program compiles");
+
+            std::vector<terrain_vertex_t> reference(patch_vertices);
+            std::vector<packed_terrain_vertex_t> readback(packed_generator.get_patch_bytes() / sizeof(packed_terrain_vertex_t));
+            for (int backend = 0; context.is_valid() && backend < 2; ++backend)
+            {
+                if (backends[backend] == PatchBackend::GPU && !packed_gpu) continue;
+                std::vector<patch_request_t> packed_requests;
+                for (const patch_key_t& key : keys)
+                {
+                    patch_request_t request = {};
+                    request.key = key;
+                    request.vertices = buffers.allocate(packed_generator.get_patch_bytes());
+                    packed_requests.push_back(request);
+                }
+                packed_generator.set_backend(backends[backend]);
+                packed_generator.generate(packed_requests);
+                glFinish();
+
+                const auto t0 = std::chrono::high_resolution_clock::now();
+                for (int run = 0; run < runs; ++run) packed_generator.generate(packed_requests);
+                glFinish();
+                const auto t1 = std::chrono::high_resolution_clock::now();
+                const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+                float max_height_error = 0.0f;
+                float max_step_error = 0.0f;
+                bool heights_bounded_cpu = true;
+                float max_position_error = 0.0f;
+                float min_normal_dot = 1.0f;
+                for (const patch_request_t& request : packed_requests)
+                {
+                    build_patch_vertices(settings, request.key, reference.data());
+                    glGetNamedBufferSubData(request.vertices.buffer, GLintptr(request.vertices.offset), GLsizeiptr(packed_generator.get_patch_bytes()), readback.data());
+                    packed_patch_header_t header = {};
+                    memcpy(&header, readback.data(), sizeof(header));
+                    const packed_terrain_vertex_t* packed = readback.data() + packed_patch_header_t::k_vertices;
+                    for (uint32_t j = 0; j < settings.resolution; ++j)
+                    {
+                        for (uint32_t i = 0; i < settings.resolution; ++i)
+                        {
+                            const size_t v = size_t(j) * settings.resolution + i;
+                            const terrain_vertex_t& r = reference[v];
+                            const bool edge = VertexPacking::is_edge_vertex(i, j, settings.resolution);
+                            const float min_height = edge ? 0.0f : header.min_height;
+                            const float step = edge ? VertexPacking::height_step(0.0f, settings.max_height) : header.height_step;
+                            const float h = unpack_patch_height(settings, readback.data(), i, j);
+                            const glm::vec3 position = unpack_patch_position(settings, request.key, i, j, h);
+                            const glm::vec3 normal = VertexPacking::oct_decode(packed[v].normal);
+                            max_height_error = std::max(max_height_error, std::abs(r.height - h));
+                            max_step_error = std::max(max_step_error, std::abs(r.height - h) / std::max(step, 1e-6f));
+                            heights_bounded_cpu &= std::abs(r.height - h) <= height_bound(r.height, min_height, step);
+                            max_position_error = std::max(max_position_error, glm::length(glm::vec3(r.position[0], r.position[1], r.position[2]) - position));
+                            min_normal_dot = std::min(min_normal_dot, glm::dot(glm::vec3(r.normal[0], r.normal[1], r.normal[2]), normal));
+                        }
+                    }
+                }
+                printf("patchgen packed %s: %.3f ms/patch, vs reference: max height error %.4f m (%.2f steps), max position error %.4f m, min normal dot %.6f\n",
+                    names[backend], ms / (patch_count * runs), max_height_error, max_step_error, max_position_error, min_normal_dot);
+                check(max_height_error < 0.5f && max_position_error < 2.0f && min_normal_dot > 0.995f, "packed backend matches the CPU reference within tolerance");
+                if (backends[backend] == PatchBackend::CPU) check(heights_bounded_cpu, "packed CPU heights are within half a step of the reference");
+
+                // neighbours have their own height ranges, their shared edge must still decode identically
+                std::vector<patch_request_t> pair(2);
+                pair[0].key = keys[0];
+                pair[1].key = keys[0];
+                pair[1].key.x += 1;
+                for (patch_request_t& request : pair) request.vertices = buffers.allocate(packed_generator.get_patch_bytes());
+                packed_generator.generate(pair);
+                std::vector<packed_terrain_vertex_t> neighbour(readback.size());
+                glGetNamedBufferSubData(pair[0].vertices.buffer, GLintptr(pair[0].vertices.offset), GLsizeiptr(packed_generator.get_patch_bytes()), readback.data());
+                glGetNamedBufferSubData(pair[1].vertices.buffer, GLintptr(pair[1].vertices.offset), GLsizeiptr(packed_generator.get_patch_bytes()), neighbour.data());
+                bool shared_edge_matches = true;
+                for (uint32_t j = 0; j < settings.resolution; ++j)
+                {
+                    shared_edge_matches &= unpack_patch_height(settings, readback.data(), settings.resolution - 1, j) == unpack_patch_height(settings, neighbour.data(), 0, j);
+                }
+                check(shared_edge_matches, "packed neighbours with different ranges decode the same heights along their shared edge");
+                for (const patch_request_t& request : pair) buffers.free(request.vertices);
+                for (const patch_request_t& request : packed_requests) buffers.free(request.vertices);
+            }
+        }
+
+        for (int backend = 0; backend < 2; ++backend)
+        {
+            for (const patch_request_t& request : requests[backend]) buffers.free(request.vertices);
+        }
+        printf("patchgen: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_terrain(void)
+    {
+        using namespace Continuum;
+        using namespace Continuum::Terrain;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+
+        gl_context_t context;
+        if (!context.is_valid())
+        {
+            printf("terrain: no OpenGL 4.5 context, skipped\n");
+            return 0;
+        }
+        printf("terrain: %s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+        const int frame_count = 200;
+        const GLsizei width = 640;
+        const GLsizei height = 360;
+        terrain_renderer_settings_t settings = {};
+        settings.heightfield.noise.frequency = 8.0f;
+
+        GLuint framebuffer = 0;
+        GLuint renderbuffers[2] = {};
+        glCreateRenderbuffers(2, renderbuffers);
+        glNamedRenderbufferStorage(renderbuffers[0], GL_RGBA8, width, height);
+        glNamedRenderbufferStorage(renderbuffers[1], GL_DEPTH_COMPONENT24, width, height);
+        glCreateFramebuffers(1, &framebuffer);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        check(glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "offscreen framebuffer is complete");
+
+        // the scripted flight, kept 1 km above the terrain under the camera so that it never ends up inside a mountain
+        const auto camera_position = [&settings](const int frame) {
+            const glm::vec3 pos = scripted_camera_position(frame, frame_count, settings.heightfield.planet_radius);
+            const glm::vec3 dir = glm::normalize(pos);
+            float noise = 0.0f;
+            Noise::evaluate(settings.heightfield.noise, &dir.x, &dir.y, &dir.z, &noise, 1);
+            return dir * (glm::length(pos) + settings.heightfield.to_height(noise));
+        };
+
+        struct mode_totals_t
+        {
+            double nodes = 0.0;
+            uint32_t max_nodes = 0;
+            double drawn = 0.0;
+            double triangles = 0.0;
+            double geometry_bytes = 0.0;
+            uint64_t max_geometry_bytes = 0;
+            double frame_ms = 0.0;
+            double max_frame_ms = 0.0;
+            double update_ms = 0.0;
+            uint64_t generated = 0;
+            uint64_t hole_pixels = 0;
+            uint32_t checked_frames = 0;
+        } totals[3];
+
+        const TerrainMode::TerrainModeType modes[3] = { TerrainMode::QUADTREE, TerrainMode::QUADTREE, TerrainMode::TESSELLATION };
+        const PatchVertexFormat::PatchVertexFormatType formats[3] = { PatchVertexFormat::FULL, PatchVertexFormat::PACKED, PatchVertexFormat::PACKED };
+        const char* names[3] = { "quadtree", "quadtree packed", "tessellation" };
+        std::vector<uint8_t> pixels(size_t(width) * height * 4);
+        Jobs::job_system_t jobs;
+        for (int m = 0; m < 3; ++m)
+        {
+            Graphics::buffer_suballocator_t buffers;
+            terrain_renderer_settings_t mode_settings = settings;
+            mode_settings.vertex_format = formats[m];
+            terrain_renderer_t renderer(mode_settings, buffers, &jobs);
+            if (!renderer.init(bench_shader_root))
+            {
+                check(false, "terrain programs compile");
+                break;
+            }
+            renderer.set_mode(modes[m]);
+            if (renderer.get_mode() != modes[m])
+            {
+                check(false, "tessellation mode is available");
+                continue;
+            }
+
+            Camera::OrbCameraPositioner positioner;
+            Camera::camera_t camera(positioner);
+            mode_totals_t& total = totals[m];
+            printf("%s\n%6s %14s %8s %8s %10s %10s %9s\n", names[m], "frame", "altitude_m", "nodes", "drawn", "triangles", "geometry_mb", "frame_ms");
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, width, height);
+            glEnable(GL_DEPTH_TEST);
+
+            for (int frame = 0; frame < frame_count; ++frame)
+            {
+                const glm::vec3 pos = camera_position(frame);
+                positioner.look_at(pos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                const float altitude = glm::length(pos) - settings.heightfield.planet_radius;
+                const glm::mat4 p = glm::perspective(45.0f, float(width) / float(height), std::clamp(altitude * 0.01f, 1.0f, 1e5f),
+                    altitude + 2.0f * settings.heightfield.planet_radius);
+
+                const auto t0 = std::chrono::high_resolution_clock::now();
+                buffers.begin_frame();
+                // magenta marks every pixel no triangle covered
+                glClearColor(1.0f, 0.0f, 1.0f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                renderer.update(camera.get_world_position(), camera.get_view_rotation(), p, float(height));
+                renderer.draw();
+                buffers.end_frame();
+                glFinish();
+                const auto t1 = std::chrono::high_resolution_clock::now();
+
+                const terrain_renderer_stats_t& stats = renderer.get_stats();
+                const double frame_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+                total.nodes += stats.nodes;
+                total.max_nodes = std::max(total.max_nodes, stats.nodes);
+                total.drawn += stats.drawn_patches;
+                total.triangles += double(stats.triangles);
+                total.geometry_bytes += double(stats.geometry_bytes);
+                total.max_geometry_bytes = std::max(total.max_geometry_bytes, stats.geometry_bytes);
+                total.frame_ms += frame_ms;
+                total.max_frame_ms = std::max(total.max_frame_ms, frame_ms);
+                total.update_ms += stats.update_ms;
+                total.generated += stats.generated_patches;
+                if (frame % 50 == 0)
+                {
+                    printf("%6d %14.1f %8u %8u %10llu %10.2f %9.2f\n", frame, altitude, stats.nodes, stats.drawn_patches,
+                        static_cast<unsigned long long>(stats.triangles), double(stats.geometry_bytes) / (1024.0 * 1024.0), frame_ms);
+                }
+
+                // skimming 1 km above the ground and looking straight down, every pixel is terrain
+                if (frame > frame_count / 2 && frame % 10 == 0)
+                {
+                    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+                    for (size_t i = 0; i < pixels.size(); i += 4)
+                    {
+                        total.hole_pixels += pixels[i] == 255 && pixels[i + 1] == 0 && pixels[i + 2] == 255 ? 1 : 0;
+                    }
+                    ++total.checked_frames;
+                }
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            printf("terrain %s: %d frames at %dx%d, nodes avg %.0f max %u, drawn patches %.0f, triangles %.0f, geometry %.2f MB avg %.2f MB peak, "
+                "patches generated %llu, update %.3f ms, frame %.2f ms avg %.2f ms max, hole pixels %llu in %u frames\n",
+                names[m], frame_count, width, height, total.nodes / frame_count, total.max_nodes, total.drawn / frame_count,
+                total.triangles / frame_count, total.geometry_bytes / frame_count / (1024.0 * 1024.0), double(total.max_geometry_bytes) / (1024.0 * 1024.0),
+                static_cast<unsigned long long>(total.generated), total.update_ms / frame_count, total.frame_ms / frame_count, total.max_frame_ms,
+                static_cast<unsigned long long>(total.hole_pixels), total.checked_frames);
+        }
+
+        if (totals[1].checked_frames > 0)
+        {
+            const mode_totals_t& q = totals[0];
+            const mode_totals_t& p = totals[1];
+            printf("terrain packed vs full vertices: %.1fx less geometry memory, %.2fx the frame time\n",
+                q.geometry_bytes / std::max(p.geometry_bytes, 1.0), p.frame_ms / std::max(q.frame_ms, 1e-9));
+            check(p.hole_pixels <= q.hole_pixels, "packed vertices open no cracks the full ones do not have");
+            check(p.geometry_bytes * 7.0 < q.geometry_bytes, "packed vertices take over 7x less geometry memory");
+        }
+
+        if (totals[2].checked_frames > 0)
+        {
+            const mode_totals_t& q = totals[0];
+            const mode_totals_t& t = totals[2];
+            printf("terrain tessellation vs quadtree: %.1fx fewer nodes, %.1fx less geometry memory, %.2fx the triangles, %.2fx the frame time\n",
+                q.nodes / std::max(t.nodes, 1.0), q.geometry_bytes / std::max(t.geometry_bytes, 1.0),
+                t.triangles / std::max(q.triangles, 1.0), t.frame_ms / std::max(q.frame_ms, 1e-9));
+            check(t.hole_pixels == 0, "tessellated terrain has no cracks");
+            check(t.nodes < q.nodes && t.geometry_bytes < q.geometry_bytes, "tessellation keeps fewer nodes and less geometry");
+        }
+
+        // Floating origin: fly 6000 km along a great circle, then creep a few centimetres per frame. Patches are
+        // stored relative to their own double origin and placed relative to the double camera, so the creep
+        // only rebuilds the few nodes whose LOD changes and a surface point must move smoothly on screen.
+        {
+            Graphics::buffer_suballocator_t buffers;
+            terrain_renderer_t renderer(settings, buffers, &jobs);
+            if (!renderer.init(bench_shader_root)) check(false, "terrain programs compile");
+
+            const double radius = settings.heightfield.planet_radius;
+            const double altitude = 300.0;
+            const double flight_distance = 6.0e6;
+            const int flight_frames = 120;
+            const int max_settle_frames = 400;
+            const int creep_frames = 60;
+            const double creep_step = 0.05;
+            const glm::dvec3 start = glm::normalize(glm::dvec3(0.3, 0.8, 0.5));
+            const glm::dvec3 side = glm::normalize(glm::cross(start, glm::dvec3(0.0, 0.0, 1.0)));
+            const auto ground = [&settings](const glm::dvec3& dir) {
+                const glm::vec3 d = glm::vec3(dir);
+                float noise = 0.0f;
+                Noise::evaluate(settings.heightfield.noise, &d.x, &d.y, &d.z, &noise, 1);
+                return double(settings.heightfield.to_height(noise));
+            };
+            const auto direction_at = [&](const double distance) {
+                const double angle = distance / radius;
+                return std::cos(angle) * start + std::sin(angle) * side;
+            };
+
+            Camera::OrbCameraPositioner positioner;
+            Camera::camera_t camera(positioner);
+            const glm::mat4 p = glm::perspective(45.0f, float(width) / float(height), 1.0f, 1e7f);
+            bool world_position_kept = true;
+            // looks ahead along the track and 45 degrees down; height above the ground, or above the track's end
+            const auto frame_at = [&](const double distance, const double fixed_height) {
+                const glm::dvec3 dir = direction_at(distance);
+                const glm::dvec3 tangent = glm::normalize(direction_at(distance + 1.0) - dir);
+                const glm::dvec3 pos = dir * (fixed_height > 0.0 ? fixed_height : radius + ground(dir) + altitude);
+                positioner.look_at(pos, pos + tangent * 1000.0 - dir * 1000.0, glm::vec3(dir));
+                world_position_kept &= camera.get_world_position() == pos;
+                buffers.begin_frame();
+                renderer.update(camera.get_world_position(), camera.get_view_rotation(), p, float(height));
+                buffers.end_frame();
+                return pos;
+            };
+
+            uint64_t flight_generated = 0;
+            for (int frame = 0; frame < flight_frames; ++frame)
+            {
+                frame_at(flight_distance * frame / (flight_frames - 1), 0.0);
+                flight_generated += renderer.get_stats().generated_patches;
+            }
+            // the quadtree splits a limited number of nodes per update, it is given time to converge before the creep
+            const double end_height = radius + ground(direction_at(flight_distance)) + altitude;
+            int settle_frames = 0;
+            do
+            {
+                frame_at(flight_distance, end_height);
+            } while (renderer.get_stats().generated_patches > 0 && ++settle_frames < max_settle_frames);
+
+            uint64_t creep_generated = 0;
+            std::vector<glm::dvec2> relative_screen, absolute_screen;
+            for (int frame = 1; frame <= creep_frames; ++frame)
+            {
+                const glm::dvec3 pos = frame_at(flight_distance + creep_step * frame, end_height);
+                creep_generated += renderer.get_stats().generated_patches;
+
+                // a ground point ahead, stored like a patch vertex: a float offset from a double patch origin
+                const glm::dvec3 point_dir = direction_at(flight_distance + 800.0);
+                const glm::dvec3 point = point_dir * (radius + ground(point_dir));
+                const glm::dvec3 origin = glm::dvec3(glm::vec3(point_dir)) * radius;
+                const glm::vec3 offset = glm::vec3(point - origin);
+                const glm::vec4 relative = p * camera.get_view_rotation() * glm::vec4(glm::vec3(origin - pos) + offset, 1.0f);
+                // the same point with everything in float, the way the renderer worked before
+                const glm::vec4 absolute = p * camera.get_view_matrix() * glm::vec4(glm::vec3(point), 1.0f);
+                const glm::dvec2 half = glm::dvec2(width, height) * 0.5;
+                relative_screen.push_back(glm::dvec2(relative.x / relative.w, relative.y / relative.w) * half);
+                absolute_screen.push_back(glm::dvec2(absolute.x / absolute.w, absolute.y / absolute.w) * half);
+            }
+
+            // constant camera velocity, so the screen motion is smooth where the second difference stays small
+            const auto max_jerk = [](const std::vector<glm::dvec2>& screen) {
+                double jerk = 0.0;
+                for (size_t i = 2; i < screen.size(); ++i) jerk = std::max(jerk, glm::length(screen[i] - 2.0 * screen[i - 1] + screen[i - 2]));
+                return jerk;
+            };
+            const double relative_jerk = max_jerk(relative_screen);
+            const double absolute_jerk = max_jerk(absolute_screen);
+            printf("terrain floating origin: %.0f km flown in %d frames, %llu patches generated, settled in %d frames; %d frames creeping %.0f cm each "
+                "at %.0f m: %llu patches rebuilt, %u drawn, screen jitter %.5f px camera-relative vs %.3f px all-float\n",
+                flight_distance / 1000.0, flight_frames, static_cast<unsigned long long>(flight_generated), settle_frames, creep_frames, creep_step * 100.0,
+                altitude, static_cast<unsigned long long>(creep_generated), renderer.get_stats().drawn_patches, relative_jerk, absolute_jerk);
+            check(world_position_kept, "the camera keeps its world position in double");
+            check(settle_frames < max_settle_frames, "the quadtree converges at the end of the flight");
+            check(renderer.get_stats().drawn_patches > 0 && creep_generated * 1000 < renderer.get_stats().drawn_patches, "moving the camera only rebuilds patches that change LOD");
+            check(relative_jerk < 0.01, "camera-relative surface points move smoothly 6000 km from the start");
+        }
+
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+        printf("terrain: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_atmosphere(void)
+    {
+        using namespace Continuum;
+        using namespace Continuum::Atmosphere;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+
+        const std::filesystem::path root = std::filesystem::temp_directory_path() / "continuum_atmosphere_bench";
+        std::error_code ec = {};
+        std::filesystem::remove_all(root, ec);
+
+        atmosphere_renderer_settings_t settings = {};
+        settings.cache_directory = root.string();
+        const atmosphere_params_t& params = settings.params;
+        Jobs::job_system_t jobs;
+
+        // 1. bake, store, load back
+        atmosphere_tables_t tables;
+        atmosphere_bake_stats_t bake = {};
+        bake_tables(params, tables, &jobs, &bake);
+        printf("atmosphere bake on %u workers: transmittance %.1f ms, multiple scattering %.1f ms, scattering %.1f ms, irradiance %.1f ms, total %.1f ms\n",
+            jobs.get_worker_count(), bake.transmittance_ms, bake.multiple_scattering_ms, bake.scattering_ms, bake.irradiance_ms, bake.total_ms);
+
+        // stored under the key the renderer looks up, so that its init() below loads instead of baking again
+        const std::string path = atmosphere_renderer_t(settings).get_cache_path();
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        check(save_tables(path, params, tables), "tables are stored");
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        atmosphere_tables_t loaded;
+        check(load_tables(path, params, loaded), "stored tables load back");
+        const auto t2 = std::chrono::high_resolution_clock::now();
+        const double store_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        const double load_ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        printf("atmosphere cache: %.2f MB, store %.1f ms, load %.1f ms (%.0fx faster than baking)\n",
+            double(tables.get_bytes()) / (1024.0 * 1024.0), store_ms, load_ms, bake.total_ms / std::max(load_ms, 1e-6));
+        check(loaded.scattering.size() == tables.scattering.size()
+            && memcmp(loaded.scattering.data(), tables.scattering.data(), tables.scattering.size() * sizeof(glm::vec4)) == 0
+            && memcmp(loaded.transmittance.data(), tables.transmittance.data(), tables.transmittance.size() * sizeof(glm::vec4)) == 0,
+            "tables round-trip bit-exact");
+
+        atmosphere_params_t other = params;
+        other.mie_phase_g = 0.76f;
+        check(other.hash() != params.hash(), "parameter change changes the cache key");
+        check(!load_tables(path, other, loaded), "tables baked for other parameters are rejected");
+        {
+            const std::string corrupt_path = (root / "corrupt.catm").string();
+            std::filesystem::copy_file(path, corrupt_path, ec);
+            std::fstream file(corrupt_path, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(std::streamoff(sizeof(atmosphere_file_header_t) + 1000));
+            file.put('\x7f');
+            file.close();
+            check(!load_tables(corrupt_path, params, loaded), "corrupt payload is rejected");
+        }
+
+        // 2. table lookups against the brute-force ray march, cameras on the ground, in the stratosphere and in orbit
+        // with the sun high, low and setting
+        const float R = params.bottom_radius;
+        const glm::vec3 cameras[] = { glm::vec3(0.0f, R + 10.0f, 0.0f), glm::vec3(0.0f, R + 30000.0f, 0.0f), glm::vec3(0.0f, R + 500000.0f, 0.0f) };
+        const float sun_elevations[] = { 60.0f, 15.0f, 3.0f };
+        double error_sum = 0.0, error_max = 0.0;
+        uint32_t error_count = 0;
+        for (const glm::vec3& camera : cameras)
+        {
+            for (const float sun_elevation : sun_elevations)
+            {
+                const float s = glm::radians(sun_elevation);
+                const glm::vec3 sun = glm::vec3(std::cos(s), std::sin(s), 0.0f);
+                for (int e = -2; e <= 8; ++e)
+                {
+                    for (int a = 0; a < 8; ++a)
+                    {
+                        const float elevation = glm::radians(e * 10.0f + 1.0f);
+                        const float azimuth = glm::radians(a * 45.0f + 10.0f);
+                        const glm::vec3 view = glm::vec3(std::cos(elevation) * std::cos(azimuth), std::sin(elevation), std::cos(elevation) * std::sin(azimuth));
+                        const glm::vec3 lut = sky_radiance(params, tables, camera, view, sun);
+                        const glm::vec3 reference = sky_radiance_reference(params, tables, camera, view, sun, 256, 64);
+                        const double luminance_ref = 0.2126 * reference.x + 0.7152 * reference.y + 0.0722 * reference.z;
+                        const double luminance_lut = 0.2126 * lut.x + 0.7152 * lut.y + 0.0722 * lut.z;
+                        // relative to the brightest of the two, dark ground and space pixels should not dominate
+                        if (luminance_ref < 1e-3) continue;
+                        const double error = std::abs(luminance_lut - luminance_ref) / luminance_ref;
+                        error_sum += error;
+                        error_max = std::max(error_max, error);
+                        ++error_count;
+                    }
+                }
+            }
+        }
+        const double error_mean = error_sum / std::max(error_count, 1u);
+        printf("atmosphere lookup vs ray march: %u directions, luminance error mean %.2f%% max %.2f%%\n", error_count, error_mean * 100.0, error_max * 100.0);
+        check(error_count > 0 && error_mean < 0.05, "table lookups match the ray-marched reference on average");
+        check(error_max < 0.25, "table lookups stay close to the reference everywhere");
+
+        // 3. CPU cost per pixel
+        {
+            const int samples = 4096;
+            const glm::vec3 sun = glm::normalize(glm::vec3(1.0f, 0.3f, 0.0f));
+            float sink = 0.0f;
+            const auto c0 = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < samples; ++i)
+            {
+                const float t = float(i) / samples;
+                const glm::vec3 view = glm::normalize(glm::vec3(std::cos(t * 6.2831f), 0.05f + t, std::sin(t * 6.2831f)));
+                sink += sky_radiance(params, tables, cameras[0], view, sun).y;
+            }
+            const auto c1 = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < samples; ++i)
+            {
+                const float t = float(i) / samples;
+                const glm::vec3 view = glm::normalize(glm::vec3(std::cos(t * 6.2831f), 0.05f + t, std::sin(t * 6.2831f)));
+                sink += sky_radiance_reference(params, tables, cameras[0], view, sun, 32, 16).y;
+            }
+            const auto c2 = std::chrono::high_resolution_clock::now();
+            const double lut_ns = std::chrono::duration<double, std::nano>(c1 - c0).count() / samples;
+            const double reference_ns = std::chrono::duration<double, std::nano>(c2 - c1).count() / samples;
+            printf("atmosphere CPU per pixel: lookup %.0f ns, ray march 32x16 %.0f ns (%.0fx)%s\n", lut_ns, reference_ns, reference_ns / lut_ns, sink < 0.0f ? " " : "");
+        }
+
+        // 4. GPU: load through the renderer, then the cost per pixel of both passes
+        gl_context_t context;
+        if (!context.is_valid())
+        {
+            printf("atmosphere: no OpenGL 4.5 context, GPU part skipped\n");
+        }
+        else
+        {
+            printf("atmosphere: %s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+            atmosphere_renderer_t renderer(settings, &jobs);
+            if (!renderer.init(bench_shader_root))
+            {
+                check(false, "sky program compiles");
+            }
+            else
+            {
+                const atmosphere_renderer_stats_t& stats = renderer.get_stats();
+                check(stats.loaded_from_cache, "renderer loads the cached tables instead of baking");
+                printf("atmosphere init: load %.1f ms, upload %.1f ms, %.2f MB of textures\n",
+                    stats.load_ms, stats.upload_ms, double(stats.texture_bytes) / (1024.0 * 1024.0));
+
+                const GLsizei width = 640;
+                const GLsizei height = 360;
+                GLuint framebuffer = 0;
+                GLuint color = 0;
+                GLuint depth = 0;
+                glCreateRenderbuffers(1, &color);
+                glNamedRenderbufferStorage(color, GL_RGBA8, width, height);
+                glCreateTextures(GL_TEXTURE_2D, 1, &depth);
+                glTextureStorage2D(depth, 1, GL_DEPTH_COMPONENT24, width, height);
+                glCreateFramebuffers(1, &framebuffer);
+                glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+                glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depth, 0);
+                check(glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "offscreen framebuffer is complete");
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                glViewport(0, 0, width, height);
+
+                struct view_t { const char* name; glm::vec3 camera; glm::vec3 forward; float sun_elevation; };
+                const view_t views[] = {
+                    { "ground noon", glm::vec3(0.0f, R + 10.0f, 0.0f), glm::vec3(1.0f, 0.3f, 0.0f), 45.0f },
+                    { "ground sunset", glm::vec3(0.0f, R + 10.0f, 0.0f), glm::vec3(1.0f, 0.05f, 0.0f), 2.0f },
+                    { "orbit", glm::vec3(0.0f, R + 800000.0f, 3.0f * R), glm::vec3(0.0f, -0.3f, -1.0f), 20.0f },
+                };
+                const int repeats = 5;
+                const glm::mat4 proj = glm::perspective(glm::radians(60.0f), float(width) / float(height), 1.0f, 1e7f);
+                std::vector<uint8_t> lut_pixels(size_t(width) * height * 4), reference_pixels(size_t(width) * height * 4);
+                double sky_ms = 0.0, aerial_ms = 0.0, reference_ms = 0.0, difference_sum = 0.0;
+                for (const view_t& v : views)
+                {
+                    // only the rotation is used, built at the origin where camera + forward does not round away
+                    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), v.forward, glm::vec3(0.0f, 1.0f, 0.0f));
+                    const float s = glm::radians(v.sun_elevation);
+                    const glm::vec3 sun = glm::vec3(std::cos(s), std::sin(s), 0.0f);
+                    const auto time_pass = [&](const auto& pass) {
+                        pass();
+                        glFinish();
+                        const auto p0 = std::chrono::high_resolution_clock::now();
+                        for (int i = 0; i < repeats; ++i) pass();
+                        glFinish();
+                        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - p0).count() / repeats;
+                    };
+
+                    // depth 1 everywhere: the sky path; depth 0.5: aerial perspective over every pixel
+                    const double view_sky_ms = time_pass([&]() {
+                        glClearNamedFramebufferfi(framebuffer, GL_DEPTH_STENCIL, 0, 1.0f, 0);
+                        renderer.draw(v.camera, view, proj, sun, depth);
+                    });
+                    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, lut_pixels.data());
+                    const double view_aerial_ms = time_pass([&]() {
+                        const float half = 0.5f;
+                        glClearNamedFramebufferfv(framebuffer, GL_DEPTH, 0, &half);
+                        renderer.draw(v.camera, view, proj, sun, depth);
+                    });
+                    const double view_reference_ms = time_pass([&]() { renderer.draw_reference(v.camera, view, proj, sun); });
+                    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, reference_pixels.data());
+
+                    double difference = 0.0;
+                    for (size_t i = 0; i < lut_pixels.size(); i += 4)
+                    {
+                        for (size_t c = 0; c < 3; ++c) difference += std::abs(int(lut_pixels[i + c]) - int(reference_pixels[i + c]));
+                    }
+                    difference /= double(width) * height * 3;
+                    printf("atmosphere %-14s sky %7.2f ms, aerial perspective %7.2f ms, ray march 32x16 %8.2f ms, mean difference %.2f/255\n",
+                        v.name, view_sky_ms, view_aerial_ms, view_reference_ms, difference);
+                    sky_ms += view_sky_ms;
+                    aerial_ms += view_aerial_ms;
+                    reference_ms += view_reference_ms;
+                    difference_sum += difference;
+                }
+                const double pixels = double(width) * height * (sizeof(views) / sizeof(views[0]));
+                printf("atmosphere GPU per pixel: sky %.1f ns, aerial perspective %.1f ns, ray march %.1f ns (%.1fx the sky pass)\n",
+                    sky_ms * 1e6 / pixels, aerial_ms * 1e6 / pixels, reference_ms * 1e6 / pixels, reference_ms / std::max(sky_ms, 1e-9));
+                check(difference_sum / (sizeof(views) / sizeof(views[0])) < 6.0, "sky pass matches the ray-marched pass on screen");
+                check(sky_ms < reference_ms, "table lookups are cheaper than the ray march");
+
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glDeleteFramebuffers(1, &framebuffer);
+                glDeleteRenderbuffers(1, &color);
+                glDeleteTextures(1, &depth);
+            }
+        }
+
+        std::filesystem::remove_all(root, ec);
+        printf("atmosphere: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_ocean(void)
+    {
+        using namespace Continuum;
+        using namespace Continuum::Ocean;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+
+        uint32_t rng = 0x2545f491u;
+        const auto random_grid = [&rng](complex_grid_t& grid, const uint32_t size) {
+            grid.resize(size);
+            for (size_t i = 0; i < grid.re.size(); ++i)
+            {
+                rng = rng * 1664525u + 1013904223u;
+                grid.re[i] = float(rng >> 8) / 8388608.0f - 1.0f;
+                rng = rng * 1664525u + 1013904223u;
+                grid.im[i] = float(rng >> 8) / 8388608.0f - 1.0f;
+            }
+        };
+        // largest difference relative to the largest magnitude of b
+        const auto max_error = [](const complex_grid_t& a, const complex_grid_t& b, const float scale) {
+            float peak = 0.0f;
+            float err = 0.0f;
+            for (size_t i = 0; i < b.re.size(); ++i)
+            {
+                peak = std::max(peak, std::hypot(b.re[i], b.im[i]));
+                err = std::max(err, std::hypot(a.re[i] * scale - b.re[i], a.im[i] * scale - b.im[i]));
+            }
+            return peak > 0.0f ? err / peak : err;
+        };
+
+        // 1. every kernel against the direct sums, odd and even powers of two so both pass types are covered
+        const Simd::SimdLevel best = Simd::detect();
+        const float tolerance = 1e-5f;
+        printf("cpu: %s\n", Simd::get_level_name(best));
+        printf("%-6s %-8s %14s %14s %14s\n", "size", "kernel", "forward_err", "inverse_err", "roundtrip_err");
+        for (uint32_t size = 2; size <= 64; size *= 2)
+        {
+            complex_grid_t input;
+            random_grid(input, size);
+            complex_grid_t forward_ref;
+            complex_grid_t inverse_ref;
+            dft_2d(input, forward_ref, FftDirection::FORWARD);
+            dft_2d(input, inverse_ref, FftDirection::INVERSE);
+            for (int level = Simd::SimdLevel::SCALAR; level <= best; ++level)
+            {
+                const Simd::SimdLevel simd_level = static_cast<Simd::SimdLevel>(level);
+                complex_grid_t forward = input;
+                fft_2d(forward, FftDirection::FORWARD, simd_level);
+                complex_grid_t inverse = input;
+                fft_2d(inverse, FftDirection::INVERSE, simd_level);
+                complex_grid_t roundtrip = forward;
+                fft_2d(roundtrip, FftDirection::INVERSE, simd_level);
+
+                const float forward_err = max_error(forward, forward_ref, 1.0f);
+                const float inverse_err = max_error(inverse, inverse_ref, 1.0f);
+                const float roundtrip_err = max_error(roundtrip, input, 1.0f / float(size * size));
+                const bool ok = forward_err < tolerance && inverse_err < tolerance && roundtrip_err < tolerance;
+                printf("%-6u %-8s %14.3g %14.3g %14.3g%s\n", size, Simd::get_level_name(simd_level), forward_err, inverse_err, roundtrip_err, ok ? "" : "  FAILED");
+                check(ok, "fft matches the direct transform");
+            }
+        }
+        bool threw = false;
+        try
+        {
+            complex_grid_t odd;
+            odd.resize(12);
+            fft_2d(odd, FftDirection::FORWARD);
+        }
+        catch (const FftException&)
+        {
+            threw = true;
+        }
+        check(threw, "non power of two sizes are rejected");
+
+        // 2. throughput per cascade resolution, 5 N^2 log2(N^2) flops per 2D transform by convention
+        printf("%-6s %-8s %12s %12s\n", "size", "kernel", "ms", "GFLOPS");
+        for (uint32_t size = 64; size <= 512; size *= 2)
+        {
+            complex_grid_t grid;
+            random_grid(grid, size);
+            const int passes = std::max(4, int((1u << 22) / (size * size)));
+            for (int level = Simd::SimdLevel::SCALAR; level <= best; ++level)
+            {
+                const Simd::SimdLevel simd_level = static_cast<Simd::SimdLevel>(level);
+                fft_2d(grid, FftDirection::FORWARD, simd_level);
+                const auto t0 = std::chrono::high_resolution_clock::now();
+                for (int pass = 0; pass < passes; ++pass) fft_2d(grid, (pass & 1) ? FftDirection::INVERSE : FftDirection::FORWARD, simd_level);
+                const double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count() / passes;
+                const double n2 = double(size) * size;
+                printf("%-6u %-8s %12.3f %12.2f\n", size, Simd::get_level_name(simd_level), ms, 5.0 * n2 * std::log2(n2) / (ms * 1e6));
+                // keep the values bounded between passes
+                for (size_t i = 0; i < grid.re.size(); ++i)
+                {
+                    grid.re[i] /= float(size);
+                    grid.im[i] /= float(size);
+                }
+            }
+        }
+
+        // 3. the maps against the direct sums over each cascade's spectrum
+        Jobs::job_system_t jobs;
+        ocean_settings_t settings = {};
+        {
+            ocean_t ocean(settings, &jobs);
+            ocean.update(1.5f);
+            ocean.finish();
+            check(ocean.has_maps(), "finish() publishes the simulation");
+            const uint32_t n = ocean.get_resolution();
+            for (uint32_t c = 0; c < ocean.get_cascade_count(); ++c)
+            {
+                const ocean_maps_t& maps = ocean.get_maps(c);
+                const float texel = ocean.get_tile_length(c) / float(n);
+                double variance = 0.0;
+                double jacobian = 0.0;
+                float peak = 0.0f;
+                for (size_t i = 0; i < maps.displacement.size(); ++i)
+                {
+                    variance += double(maps.displacement[i].y) * maps.displacement[i].y;
+                    jacobian += maps.slopes[i].z;
+                    peak = std::max(peak, std::fabs(maps.displacement[i].y));
+                }
+                variance /= double(maps.displacement.size());
+                jacobian /= double(maps.displacement.size());
+
+                float displacement_err = 0.0f;
+                float slope_err = 0.0f;
+                const uint32_t texels[][2] = { { 0, 0 }, { 1, 0 }, { 0, n - 1 }, { n / 3, n / 5 }, { n - 7, n / 2 }, { n / 2 + 3, n - 2 } };
+                for (const auto& t : texels)
+                {
+                    const size_t i = size_t(t[1]) * n + t[0];
+                    glm::vec4 reference_slopes;
+                    const glm::vec4 reference = ocean.sample_reference(c, float(t[0]) * texel, float(t[1]) * texel, maps.time, &reference_slopes);
+                    displacement_err = std::max(displacement_err, glm::length(glm::vec3(maps.displacement[i] - reference)));
+                    slope_err = std::max(slope_err, glm::length(glm::vec3(maps.slopes[i] - reference_slopes)));
+                }
+                printf("cascade %u: tile %.0f m, significant wave height %.3f m, peak %.3f m, mean jacobian %.4f, max error displacement %.3g m, slopes %.3g\n",
+                    c, ocean.get_tile_length(c), 4.0 * std::sqrt(variance), peak, jacobian, displacement_err, slope_err);
+                check(variance > 0.0, "every cascade carries waves");
+                check(displacement_err < 1e-4f * std::max(peak, 1.0f), "displacement matches the direct sum");
+                check(slope_err < 1e-3f, "slopes and jacobian match the direct sum");
+                check(std::fabs(jacobian - 1.0) < 0.1, "the jacobian averages to about 1");
+            }
+
+            // the synchronous path computes the same maps
+            ocean_t serial(settings);
+            serial.update(1.5f);
+            bool same = serial.has_maps();
+            for (uint32_t c = 0; c < ocean.get_cascade_count() && same; ++c)
+            {
+                same = memcmp(serial.get_maps(c).displacement.data(), ocean.get_maps(c).displacement.data(), ocean.get_maps(c).displacement.size() * sizeof(glm::vec4)) == 0 &&
+                    memcmp(serial.get_maps(c).slopes.data(), ocean.get_maps(c).slopes.data(), ocean.get_maps(c).slopes.size() * sizeof(glm::vec4)) == 0;
+            }
+            check(same, "the job and the single thread paths agree");
+        }
+
+        // 4. per resolution: the frame loop polls, the simulation runs behind it on the jobs; 64 texels cannot
+        // resolve the default cascade bands
+        gl_context_t context;
+        if (!context.is_valid()) printf("ocean: no OpenGL 4.5 context, texture uploads skipped\n");
+        printf("%-6s %12s %12s %12s %12s %10s %10s\n", "size", "simulate_ms", "latency_ms", "update_max", "upload_ms", "published", "skipped");
+        for (uint32_t size = 128; size <= 512; size *= 2)
+        {
+            settings.resolution = size;
+            ocean_t ocean(settings, &jobs);
+            if (context.is_valid()) ocean.create_textures();
+            // the first upload pays for the driver's warm-up
+            ocean.update(0.0f);
+            ocean.finish();
+
+            const uint32_t frames = 60;
+            double update_max = 0.0;
+            float last_time = -1.0f;
+            bool monotonic = true;
+            for (uint32_t frame = 0; frame < frames; ++frame)
+            {
+                ocean.update(float(frame + 1) / 60.0f);
+                update_max = std::max(update_max, ocean.get_stats().update_ms);
+                if (ocean.has_maps())
+                {
+                    monotonic = monotonic && ocean.get_maps(0).time >= last_time;
+                    last_time = ocean.get_maps(0).time;
+                }
+                // the rest of the frame
+                std::this_thread::sleep_for(std::chrono::milliseconds(4));
+            }
+            ocean.finish();
+            const ocean_stats_t& stats = ocean.get_stats();
+            printf("%-6u %12.2f %12.2f %12.2f %12.2f %10llu %10llu\n", size, stats.simulate_ms, stats.latency_ms, update_max, stats.upload_ms,
+                static_cast<unsigned long long>(stats.completed), static_cast<unsigned long long>(stats.skipped));
+            check(stats.completed > 1, "simulations are published while the frame loop runs");
+            check(monotonic, "published maps never go back in time");
+            check(stats.completed + stats.skipped == frames + 1, "every update() either starts a simulation or skips");
+            if (context.is_valid())
+            {
+                GLint width = 0;
+                glGetTextureLevelParameteriv(ocean.get_displacement_texture(0), 0, GL_TEXTURE_WIDTH, &width);
+                check(glGetError() == GL_NO_ERROR && uint32_t(width) == size, "cascade textures are allocated");
+            }
+        }
+
+        printf("ocean: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_sim(void)
+    {
+        using namespace Continuum;
+        using namespace Continuum::Sim;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+        const auto elapsed_ms = [](const std::chrono::steady_clock::time_point t0) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        };
+
+        // 1. the triple buffer never hands out a torn or an older value
+        {
+            struct payload_t
+            {
+                uint64_t sequence = 0;
+                uint64_t words[15] = {};
+            };
+            triple_buffer_t<payload_t> buffer;
+            const uint64_t count = 200000;
+            std::atomic<bool> done = false;
+            std::thread writer([&]() {
+                for (uint64_t sequence = 1; sequence <= count; ++sequence)
+                {
+                    payload_t& payload = buffer.get_back();
+                    payload.sequence = sequence;
+                    for (uint64_t& word : payload.words) word = sequence * 0x9E3779B97F4A7C15ull;
+                    buffer.publish();
+                    // lets the reader in on one CPU machines
+                    if (sequence % 64 == 0) std::this_thread::yield();
+                }
+                done = true;
+            });
+            uint64_t last = 0;
+            uint64_t acquired = 0;
+            bool torn = false;
+            bool backwards = false;
+            while (true)
+            {
+                const bool finished = done.load();
+                if (buffer.acquire())
+                {
+                    const payload_t& payload = buffer.get_front();
+                    for (const uint64_t word : payload.words) torn |= word != payload.sequence * 0x9E3779B97F4A7C15ull;
+                    backwards |= payload.sequence <= last;
+                    last = payload.sequence;
+                    ++acquired;
+                }
+                if (finished && !buffer.acquire()) break;
+                std::this_thread::yield();
+            }
+            writer.join();
+            printf("sim triple buffer: %llu published, %llu acquired, last %llu\n", static_cast<unsigned long long>(count),
+                static_cast<unsigned long long>(acquired), static_cast<unsigned long long>(last));
+            check(!torn, "the reader never sees a partially written value");
+            check(!backwards && last == count, "values arrive in order and the last one is never lost");
+        }
+
+        // 2. REALTIME ticks follow the clock on their own thread, a slow tick does not hold up the renderer
+        {
+            struct state_t
+            {
+                uint64_t tick_count = 0;
+                float previous = 0.0f;
+                float current = 0.0f;
+                double input_time = 0.0;
+            };
+            const float speed = 10.0f;
+            const double timestep = 1.0 / 120.0;
+            const double tick_work_ms = 3.0;
+            triple_buffer_t<double> inputs;
+            triple_buffer_t<state_t> states;
+            const std::thread::id main_thread = std::this_thread::get_id();
+            bool own_thread = true;
+            bool consecutive = true;
+            uint64_t expected_tick = 0;
+            float position = 0.0f;
+
+            sim_thread_settings_t settings;
+            settings.timestep = timestep;
+            const auto t0 = std::chrono::steady_clock::now();
+            sim_thread_t sim(settings, [&](const uint64_t tick, const double step) {
+                own_thread &= std::this_thread::get_id() != main_thread;
+                consecutive &= tick == expected_tick++;
+                inputs.acquire();
+                // stands in for heavy simulation work; sleeping, so that the frame loop keeps a core on one CPU machines
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(tick_work_ms));
+                state_t& state = states.get_back();
+                state.tick_count = tick + 1;
+                state.previous = position;
+                position += speed * float(step);
+                state.current = position;
+                state.input_time = inputs.get_front();
+                states.publish();
+            });
+            sim.start();
+
+            // irregular frame pacing; the old loop advanced the camera by the previous frame's delta
+            const int frame_count = 240;
+            const double frame_sleeps_ms[4] = { 4.0, 11.0, 7.0, 15.0 };
+            // per frame: when the input was sampled, and where each loop showed the camera
+            std::vector<double> sample_times;
+            std::vector<double> sim_shown, variable_shown;
+            double max_frame_ms = 0.0;
+            double latency_ms = 0.0;
+            double max_latency_ms = 0.0;
+            float variable_position = 0.0f;
+            double previous_frame_time = 0.0;
+            double previous_delta = 0.0;
+            for (int frame = 0; frame < frame_count; ++frame)
+            {
+                const auto f0 = std::chrono::steady_clock::now();
+                const double now = elapsed_ms(t0) * 1e-3;
+                inputs.get_back() = now;
+                inputs.publish();
+                states.acquire();
+                const state_t& state = states.get_front();
+                const float alpha = float(sim.get_interpolation(state.tick_count));
+                const float shown = state.previous + (state.current - state.previous) * alpha;
+
+                variable_position += speed * float(previous_delta);
+                previous_delta = now - previous_frame_time;
+                previous_frame_time = now;
+                max_frame_ms = std::max(max_frame_ms, elapsed_ms(f0));
+
+                // stands in for rendering
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(frame_sleeps_ms[frame % 4]));
+                const double present = elapsed_ms(t0) * 1e-3;
+                if (frame >= 20 && state.tick_count > 0)
+                {
+                    sample_times.push_back(now);
+                    sim_shown.push_back(shown);
+                    variable_shown.push_back(variable_position);
+                    const double latency = (present - state.input_time) * 1000.0;
+                    latency_ms += latency;
+                    max_latency_ms = std::max(max_latency_ms, latency);
+                }
+            }
+            sim.stop();
+            const double seconds = elapsed_ms(t0) * 1e-3;
+
+            // RMS of how far each frame's camera step is off the distance covered since the previous frame
+            const auto step_error = [&](const std::vector<double>& shown) {
+                double sum = 0.0;
+                for (size_t i = 1; i < shown.size(); ++i)
+                {
+                    const double error = (shown[i] - shown[i - 1]) - speed * (sample_times[i] - sample_times[i - 1]);
+                    sum += error * error;
+                }
+                return std::sqrt(sum / double(std::max<size_t>(shown.size(), 2) - 1));
+            };
+            const sim_thread_stats_t stats = sim.get_stats();
+            const double expected_ticks = seconds / timestep;
+            const double sim_jitter = step_error(sim_shown);
+            const double variable_jitter = step_error(variable_shown);
+            printf("sim realtime: %llu ticks in %.3f s (%.0f expected), %llu dropped, tick %.3f ms avg %.3f ms max, frame loop %.3f ms max\n",
+                static_cast<unsigned long long>(stats.ticks), seconds, expected_ticks, static_cast<unsigned long long>(stats.dropped_ticks),
+                stats.average_tick_ms, stats.max_tick_ms, max_frame_ms);
+            printf("sim camera step error at %.0f m/s: fixed tick + interpolation %.4f m, previous frame delta %.4f m (%.1fx)\n",
+                speed, sim_jitter, variable_jitter, variable_jitter / std::max(sim_jitter, 1e-9));
+            printf("sim input to present: %.2f ms avg, %.2f ms max (tick %.2f ms)\n", latency_ms / double(std::max<size_t>(sample_times.size(), 1)),
+                max_latency_ms, timestep * 1000.0);
+            check(own_thread && consecutive, "ticks run in order on the simulation thread");
+            check(std::abs(double(stats.ticks + stats.dropped_ticks) - expected_ticks) < 3.0, "ticks follow the clock");
+            check(max_frame_ms < tick_work_ms, "the frame loop never waits for a tick");
+            check(sim_jitter < variable_jitter, "interpolated fixed ticks move more evenly than the previous frame's delta");
+        }
+
+        // 3. LOCKSTEP runs exactly the requested ticks and is deterministic
+        {
+            const auto run = [](const uint64_t ticks, uint64_t& ran) {
+                double value = 1.0;
+                sim_thread_settings_t settings;
+                settings.pacing = SimPacing::LOCKSTEP;
+                sim_thread_t sim(settings, [&](const uint64_t tick, const double step) { value = value * 1.0001 + std::sin(double(tick) * step); });
+                sim.start();
+                for (uint64_t tick = 1; tick <= ticks; ++tick) sim.run_until(tick);
+                sim.stop();
+                ran = sim.get_tick_count();
+                return value;
+            };
+            uint64_t ran_a = 0, ran_b = 0;
+            const double a = run(500, ran_a);
+            const double b = run(500, ran_b);
+            printf("sim lockstep: %llu ticks, final value %.9f\n", static_cast<unsigned long long>(ran_a), a);
+            check(ran_a == 500 && ran_b == 500, "lockstep runs exactly the requested ticks");
+            check(a == b, "lockstep runs are deterministic");
+        }
+
+        printf("sim: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_commands(void)
+    {
+        using namespace Continuum::Graphics;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+        const auto elapsed_ms = [](const std::chrono::high_resolution_clock::time_point t0) {
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+        };
+
+        // 1. keys order by pass, program, material, then depth
+        {
+            check(SortKey::make(1, 0, 0, 0.0f) > SortKey::make(0, 0xfff, 0xffff, 1.0f), "the pass outranks everything else");
+            check(SortKey::make(0, 2, 0, 0.0f) > SortKey::make(0, 1, 0xffff, 1.0f), "the program outranks material and depth");
+            check(SortKey::make(0, 1, 2, 0.0f) > SortKey::make(0, 1, 1, 1.0f), "the material outranks depth");
+            check(SortKey::make(0, 1, 1, 0.25f) < SortKey::make(0, 1, 1, 0.2500001f), "depth keeps float resolution");
+            const uint64_t key = SortKey::make(RenderPass::TRANSLUCENT, 77, 1234, 0.5f);
+            check(SortKey::get_pass(key) == RenderPass::TRANSLUCENT && SortKey::get_program(key) == 77 && SortKey::get_material(key) == 1234,
+                "fields read back from the key");
+        }
+
+        // 2. the radix sort gives the order std::stable_sort gives, equal keys stay in recording order
+        {
+            const uint32_t count = 200000;
+            uint32_t rng = 2024;
+            const auto next_random = [&rng]() { rng = rng * 1664525u + 1013904223u; return rng >> 8; };
+            std::vector<uint64_t> keys(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                // few programs and materials, coarse depth so that equal keys occur
+                keys[i] = SortKey::make(next_random() % 3, 1 + next_random() % 8, next_random() % 200, float(next_random() % 1000) / 1000.0f);
+            }
+
+            render_command_list_t list;
+            render_packet_t packet;
+            double radix_ms = 0.0, std_ms = 0.0;
+            const int repeats = 10;
+            for (int repeat = 0; repeat < repeats; ++repeat)
+            {
+                list.clear();
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    packet.first = i;
+                    list.add(keys[i], packet);
+                }
+                const auto t0 = std::chrono::high_resolution_clock::now();
+                list.sort();
+                radix_ms += elapsed_ms(t0);
+            }
+
+            std::vector<std::pair<uint64_t, uint32_t>> reference;
+            for (int repeat = 0; repeat < repeats; ++repeat)
+            {
+                reference.clear();
+                for (uint32_t i = 0; i < count; ++i) reference.push_back({ keys[i], i });
+                const auto t0 = std::chrono::high_resolution_clock::now();
+                std::stable_sort(reference.begin(), reference.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+                std_ms += elapsed_ms(t0);
+            }
+
+            bool same_order = list.size() == count;
+            for (uint32_t i = 0; same_order && i < count; ++i)
+            {
+                same_order = list.get_key(i) == reference[i].first && list.get_packet(i).first == reference[i].second;
+            }
+            printf("commands sort: %u keys, radix %.3f ms, std::stable_sort %.3f ms (%.1fx)\n",
+                count, radix_ms / repeats, std_ms / repeats, std_ms / std::max(radix_ms, 1e-6));
+            check(same_order, "radix sort matches std::stable_sort");
+        }
+
+        gl_context_t context;
+        if (!context.is_valid())
+        {
+            printf("commands: no OpenGL 4.5 context, skipped the GPU half\n");
+            printf("commands: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+            return failures == 0 ? 0 : 1;
+        }
+
+        // 3. one point per pixel in random program and material order: four programs that swizzle the material
+        // colour differently, every other one alpha blended, material and position in UBO ranges
+        const GLsizei width = 128;
+        const GLsizei height = 128;
+        const uint32_t draw_count = uint32_t(width) * uint32_t(height);
+        const uint32_t program_count = 4;
+        const uint32_t material_count = 64;
+        const char* swizzles[program_count] = { "rgb", "gbr", "brg", "bgr" };
+        const uint32_t swizzle_channels[program_count][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+
+        glsl_program_t programs[program_count];
+        for (uint32_t p = 0; p < program_count; ++p)
+        {
+            const std::string vertex =
+                "#version 450 core\n"
+                "layout(std140, binding = 1) uniform DrawData { vec4 position; };\n"
+                "void main() { gl_Position = vec4(position.xy, 0.0, 1.0); }\n";
+            const std::string fragment = std::string(
+                "#version 450 core\n"
+                "layout(std140, binding = 0) uniform Material { vec4 color; };\n"
+                "layout(location = 0) out vec4 out_color;\n"
+                "void main() { out_color = vec4(color.") + swizzles[p] + ", 1.0); }\n";
+            programs[p].compile_shader(vertex, GLSLShader::VERTEX, "commands.vert");
+            programs[p].compile_shader(fragment, GLSLShader::FRAGMENT, "commands.frag");
+            programs[p].link();
+        }
+
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        const GLsizeiptr stride = std::max<GLsizeiptr>(alignment, sizeof(glm::vec4));
+
+        std::vector<uint8_t> material_data(size_t(stride) * material_count);
+        uint8_t material_colors[material_count][3];
+        for (uint32_t m = 0; m < material_count; ++m)
+        {
+            material_colors[m][0] = uint8_t(m * 4);
+            material_colors[m][1] = uint8_t(m * 37 + 11);
+            material_colors[m][2] = uint8_t(m * 101 + 50);
+            const glm::vec4 color = glm::vec4(float(material_colors[m][0]), float(material_colors[m][1]), float(material_colors[m][2]), 255.0f) / 255.0f;
+            memcpy(material_data.data() + size_t(stride) * m, &color, sizeof(color));
+        }
+
+        uint32_t rng = 77;
+        const auto next_random = [&rng]() { rng = rng * 1664525u + 1013904223u; return rng >> 8; };
+        std::vector<uint32_t> draw_program(draw_count), draw_material(draw_count);
+        std::vector<uint8_t> draw_data(size_t(stride) * draw_count);
+        std::vector<uint8_t> expected(size_t(draw_count) * 4);
+        for (uint32_t i = 0; i < draw_count; ++i)
+        {
+            draw_program[i] = next_random() % program_count;
+            draw_material[i] = next_random() % material_count;
+            const uint32_t x = i % uint32_t(width);
+            const uint32_t y = i / uint32_t(width);
+            const glm::vec4 position = glm::vec4((float(x) + 0.5f) / float(width) * 2.0f - 1.0f, (float(y) + 0.5f) / float(height) * 2.0f - 1.0f, 0.0f, 1.0f);
+            memcpy(draw_data.data() + size_t(stride) * i, &position, sizeof(position));
+
+            uint8_t* pixel = &expected[size_t(i) * 4];
+            for (uint32_t channel = 0; channel < 3; ++channel) pixel[channel] = material_colors[draw_material[i]][swizzle_channels[draw_program[i]][channel]];
+            pixel[3] = 255;
+        }
+
+        GLuint buffers[2] = {};
+        glCreateBuffers(2, buffers);
+        glNamedBufferStorage(buffers[0], GLsizeiptr(material_data.size()), material_data.data(), 0);
+        glNamedBufferStorage(buffers[1], GLsizeiptr(draw_data.size()), draw_data.data(), 0);
+        GLuint vao = 0;
+        glCreateVertexArrays(1, &vao);
+
+        GLuint framebuffer = 0;
+        GLuint color = 0;
+        glCreateRenderbuffers(1, &color);
+        glNamedRenderbufferStorage(color, GL_RGBA8, width, height);
+        glCreateFramebuffers(1, &framebuffer);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        check(glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "offscreen framebuffer is complete");
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+
+        const auto blend_of = [](const uint32_t program) { return program & 1 ? blend_state_t::alpha() : blend_state_t::opaque(); };
+
+        // what every draw did before: all of its state, every time
+        const auto draw_direct = [&]() {
+            for (uint32_t i = 0; i < draw_count; ++i)
+            {
+                const blend_state_t blend = blend_of(draw_program[i]);
+                glUseProgram(programs[draw_program[i]].get_handle());
+                glBindVertexArray(vao);
+                if (blend.enabled)
+                {
+                    glEnable(GL_BLEND);
+                    glBlendFunc(blend.src, blend.dst);
+                }
+                else
+                {
+                    glDisable(GL_BLEND);
+                }
+                glBindBufferRange(GL_UNIFORM_BUFFER, 0, buffers[0], stride * draw_material[i], sizeof(glm::vec4));
+                glBindBufferRange(GL_UNIFORM_BUFFER, 1, buffers[1], stride * i, sizeof(glm::vec4));
+                glDrawArraysInstancedBaseInstance(GL_POINTS, 0, 1, 1, 0);
+            }
+        };
+
+        render_command_list_t list;
+        render_state_tracker_t state;
+        const auto draw_commands = [&]() {
+            list.clear();
+            render_packet_t packet;
+            packet.vao = vao;
+            packet.mode = GL_POINTS;
+            packet.count = 1;
+            for (uint32_t i = 0; i < draw_count; ++i)
+            {
+                packet.program = programs[draw_program[i]].get_handle();
+                packet.blend = blend_of(draw_program[i]);
+                const buffer_binding_t bindings[2] = {
+                    { GL_UNIFORM_BUFFER, 0, buffers[0], stride * draw_material[i], sizeof(glm::vec4) },
+                    { GL_UNIFORM_BUFFER, 1, buffers[1], stride * i, sizeof(glm::vec4) },
+                };
+                list.add(SortKey::make(RenderPass::SOLID, draw_program[i], draw_material[i], 0.0f), packet, bindings, 2);
+            }
+            list.sort();
+            // the direct path bound state behind the tracker's back
+            state.invalidate();
+            state.reset_stats();
+            list.execute(state);
+        };
+
+        std::vector<uint8_t> direct_pixels(expected.size()), command_pixels(expected.size());
+        const float clear_color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        const int frames = 20;
+        double direct_ms = 0.0, command_ms = 0.0;
+        for (int frame = 0; frame <= frames; ++frame)
+        {
+            glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clear_color);
+            glFinish();
+            auto t0 = std::chrono::high_resolution_clock::now();
+            draw_direct();
+            if (frame > 0) direct_ms += elapsed_ms(t0);
+            glFinish();
+            if (frame == 0) glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, direct_pixels.data());
+
+            glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clear_color);
+            glFinish();
+            t0 = std::chrono::high_resolution_clock::now();
+            draw_commands();
+            if (frame > 0) command_ms += elapsed_ms(t0);
+            glFinish();
+            if (frame == 0) glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, command_pixels.data());
+        }
+
+        // the calls the tracker has to issue: every state change along the sorted order
+        uint32_t expected_issued = 0;
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            // program, VAO, blend and both bindings for the first draw
+            if (i == 0)
+            {
+                expected_issued += 5;
+                continue;
+            }
+            const uint64_t key = list.get_key(i);
+            const uint64_t previous = list.get_key(i - 1);
+            // neighbouring programs differ in blending
+            if (SortKey::get_program(key) != SortKey::get_program(previous)) expected_issued += 2;
+            if (SortKey::get_material(key) != SortKey::get_material(previous)) expected_issued += 1;
+            // the draw's own position range
+            expected_issued += 1;
+        }
+
+        const render_state_stats_t& stats = state.get_stats();
+        const uint32_t direct_calls = draw_count * 5;
+        printf("commands: %u draws, %u programs, %u materials; direct %u state calls %.3f ms/frame, sorted %u issued %u elided %.3f ms/frame "
+            "(record + sort + execute, %.2fx)\n", draw_count, program_count, material_count, direct_calls, direct_ms / frames,
+            stats.issued, stats.elided, command_ms / frames, direct_ms / std::max(command_ms, 1e-6));
+        check(direct_pixels == expected, "direct draws produce the expected image");
+        check(command_pixels == expected, "sorted draws through the state tracker produce the same image");
+        check(stats.draws == draw_count && stats.issued + stats.elided == direct_calls, "every state call is either issued or elided");
+        check(stats.issued == expected_issued, "only state changes along the sorted order reach GL");
+        check(stats.issued * 4 < direct_calls * 2, "sorting removes more than half of the state calls");
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(2, buffers);
+
+        printf("commands: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_shaders(void)
+    {
+        using namespace Continuum;
+        using namespace Continuum::Graphics;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+
+        // 1. permutations are sets: the order of the defines does not matter, values and names do
+        {
+            shader_permutation_t a, b, c;
+            a.define("SHADOWS").define("OCTAVE_COUNT", 8u).define("SCALE", 0.1f);
+            b.define("SCALE", 0.1f).define("OCTAVE_COUNT", 8u).define("SHADOWS");
+            c.define("SHADOWS").define("OCTAVE_COUNT", 9u).define("SCALE", 0.1f);
+            check(a == b && a.get_hash() == b.get_hash(), "equal sets hash and compare equal in any order");
+            check(!(a == c) && a.get_hash() != c.get_hash(), "a different value is a different permutation");
+            check(a.size() == 3 && b.define("SHADOWS").size() == 3, "redefining a name replaces it");
+
+            const std::string source = "#version 450 core\nvoid main() {}\n";
+            const std::string applied = a.apply(source);
+            check(applied.compare(0, 18, "#version 450 core\n") == 0, "the defines go after #version");
+            check(applied.find("#define OCTAVE_COUNT 8u\n") != std::string::npos && applied.find("#define SCALE 0.1\n") != std::string::npos,
+                "uints keep their suffix, floats their shortest form");
+            check(applied.find("#line 2\n") != std::string::npos, "the source's own line numbers are restored");
+            check(shader_permutation_t().apply(source) == source, "an empty permutation leaves the source alone");
+        }
+
+        gl_context_t context;
+        if (!context.is_valid())
+        {
+            printf("shaders: no OpenGL 4.5 context, skipped the GPU half\n");
+            printf("shaders: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+            return failures == 0 ? 0 : 1;
+        }
+        printf("shaders: %s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+        // 2. compile errors point at the same line with and without injected defines
+        {
+            const std::string broken = "#version 450 core\nlayout(local_size_x = 1) in;\nvoid main()\n{\n\tundeclared = 1;\n}\n";
+            shader_permutation_t permutation;
+            permutation.define("A", 1).define("B", 2).define("C");
+            std::string plain_log, permuted_log;
+            try { glsl_program_t program; program.compile_shader(broken, GLSLShader::COMPUTE); }
+            catch (const GLSLProgramException& e) { plain_log = e.what(); }
+            try { glsl_program_t program; program.compile_shader(broken, GLSLShader::COMPUTE, permutation); }
+            catch (const GLSLProgramException& e) { permuted_log = e.what(); }
+            check(!plain_log.empty() && plain_log == permuted_log, "compile errors keep their line numbers");
+        }
+
+        // 3. the registry shares identical requests and compiles nothing before get()
+        {
+            shader_variant_registry_t registry;
+            const std::vector<std::string> patch = { bench_shader_root + "/terrain/terrain_patch_packed.vert", bench_shader_root + "/terrain/terrain.frag" };
+            Terrain::heightfield_settings_t fbm = {}, ridged = {};
+            ridged.noise.type = Noise::NoiseType::RIDGED;
+            const shader_variant_t v0 = registry.request(patch, Terrain::make_noise_permutation(fbm));
+            const shader_variant_t v1 = registry.request(patch, Terrain::make_noise_permutation(fbm));
+            const shader_variant_t v2 = registry.request(patch, Terrain::make_noise_permutation(ridged));
+            const shader_variant_t v3 = registry.request(patch);
+            check(v0.index == v1.index && v0.index != v2.index && v2.index != v3.index, "identical requests share one variant");
+            check(registry.get_stats().variants == 3 && registry.get_stats().shared == 1, "three distinct variants out of four requests");
+            check(registry.get_stats().compiled == 0 && !registry.is_compiled(v0), "nothing is compiled before it is used");
+
+            const GLint handle = registry.get(v0).get_handle();
+            check(registry.get(v1).get_handle() == handle && registry.get_stats().compiled == 1, "shared variants compile once");
+            check(registry.is_compiled(v0) && !registry.is_compiled(v2), "only the used variant is compiled");
+            printf("shaders: registry %u requests, %u variants, %u compiled in %.2f ms\n", registry.get_stats().requests,
+                registry.get_stats().variants, registry.get_stats().compiled, registry.get_stats().compile_ms);
+        }
+
+        // 4. the planet noise with its settings baked in against the generic one reading NoiseParams:
+        // same heights, the octave loop unrolled and the ridged branch folded away
+        std::string planet;
+        if (!GLSLUtils::read_file((bench_shader_root + "/terrain/planet.glsl").c_str(), planet))
+        {
+            printf("FAILED: shader/terrain/planet.glsl not found\n");
+            return 1;
+        }
+        const std::string source = "#version 450 core\nlayout(local_size_x = 64) in;\n" + planet +
+            "layout(std430, binding = 4) restrict writeonly buffer Heights { float heights[]; };\n"
+            "uniform uint side;\n"
+            "void main()\n"
+            "{\n"
+            "\tuint i = gl_GlobalInvocationID.x;\n"
+            "\tif (i >= side * side) return;\n"
+            "\tvec2 uv = (vec2(i % side, i / side) + 0.5) / float(side);\n"
+            "\theights[i] = terrain_height(face_to_sphere(0u, uv));\n"
+            "}\n";
+
+        const uint32_t side = 256;
+        const uint32_t samples = side * side;
+        const int runs = 10;
+        GLuint buffers[2];
+        glCreateBuffers(2, buffers);
+        glNamedBufferStorage(buffers[1], GLsizeiptr(samples * sizeof(float)), NULL, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, buffers[0]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, buffers[1]);
+
+        const Noise::NoiseType::NoiseTypeType types[2] = { Noise::NoiseType::FBM, Noise::NoiseType::RIDGED };
+        const char* type_names[2] = { "fbm", "ridged" };
+        for (int t = 0; t < 2; ++t)
+        {
+            Terrain::heightfield_settings_t settings = {};
+            settings.noise.type = types[t];
+            settings.noise.octaves = 8;
+            const Terrain::gpu_noise_params_t params = Terrain::make_gpu_noise_params(settings);
+            glDeleteBuffers(1, &buffers[0]);
+            glCreateBuffers(1, &buffers[0]);
+            glNamedBufferStorage(buffers[0], sizeof(params), &params, 0);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, buffers[0]);
+
+            glsl_program_t programs[2];
+            const shader_permutation_t permutations[2] = { shader_permutation_t(), Terrain::make_noise_permutation(settings) };
+            double compile_ms[2], dispatch_ms[2];
+            std::vector<float> heights[2];
+            for (int p = 0; p < 2; ++p)
+            {
+                const auto t0 = std::chrono::high_resolution_clock::now();
+                programs[p].compile_shader(source, GLSLShader::COMPUTE, permutations[p]);
+                programs[p].link();
+                compile_ms[p] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+
+                programs[p].use();
+                programs[p].set_uniform("side", GLuint(side));
+                glDispatchCompute((samples + 63) / 64, 1, 1);
+                glFinish();
+                const auto t1 = std::chrono::high_resolution_clock::now();
+                for (int run = 0; run < runs; ++run) glDispatchCompute((samples + 63) / 64, 1, 1);
+                glFinish();
+                dispatch_ms[p] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t1).count() / runs;
+
+                heights[p].resize(samples);
+                glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+                glGetNamedBufferSubData(buffers[1], 0, GLsizeiptr(samples * sizeof(float)), heights[p].data());
+            }
+
+            float max_error = 0.0f;
+            for (uint32_t i = 0; i < samples; ++i) max_error = std::max(max_error, std::abs(heights[0][i] - heights[1][i]));
+            printf("shaders %s: %u octaves, %u samples, generic %.3f ms, specialised %.3f ms (%.2fx), compiled in %.1f / %.1f ms, max difference %.4f m\n",
+                type_names[t], params.octave_count, samples, dispatch_ms[0], dispatch_ms[1], dispatch_ms[0] / std::max(dispatch_ms[1], 1e-6),
+                compile_ms[0], compile_ms[1], max_error);
+            check(max_error <= 1e-4f * settings.max_height, "the specialised noise gives the generic one's heights");
+
+            // both programs put "side" in slot 0, a handle resolved on one must still be ignored by the other
+            if (t == 0)
+            {
+                using namespace Continuum::Graphics::UniformLiterals;
+                const uniform_t<GLuint> foreign = programs[0].get_uniform<GLuint>("side"_uniform);
+                programs[1].use();
+                programs[1].set_uniform(foreign, GLuint(side + 1));
+                GLuint value = 0;
+                glGetUniformuiv(programs[1].get_handle(), glGetUniformLocation(programs[1].get_handle(), "side"), &value);
+                check(value == side, "a uniform handle from another program is ignored");
+            }
+        }
+        glDeleteBuffers(2, buffers);
+
+        // 5. hot reload: an edit is rebuilt in the background and swapped in once linked, a broken one keeps the
+        // program; without parallel shader compile the link runs on the compiler's thread in a context sharing this one
+        {
+            const std::filesystem::path root = std::filesystem::temp_directory_path() / "continuum_shader_reload_bench";
+            std::error_code ec = {};
+            std::filesystem::remove_all(root, ec);
+            std::filesystem::create_directories(root, ec);
+            const std::string file = (root / "reload.cs").string();
+            const std::string include = (root / "value.glsl").string();
+            const auto write_shader = [&file](const char* body) {
+                std::ofstream(file, std::ios::out | std::ios::trunc) << "#version 450 core\n#include \"value.glsl\"\nlayout(local_size_x = 1) in;\n"
+                    "layout(std430, binding = 0) buffer Result { uint value; };\nvoid main() { " << body << " }\n";
+            };
+            const auto write_include = [&include](const char* value) {
+                std::ofstream(include, std::ios::out | std::ios::trunc) << "#define VALUE " << value << "\n";
+            };
+            write_include("1u");
+            write_shader("value = VALUE;");
+
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            GLFWwindow* link_window = glfwCreateWindow(1, 1, "Continuum bench link", NULL, context.window);
+            shader_link_context_t link_context;
+            if (link_window != NULL)
+            {
+                link_context.make_current = [link_window]() { glfwMakeContextCurrent(link_window); };
+                link_context.release_current = []() { glfwMakeContextCurrent(NULL); };
+            }
+
+            GLuint result = 0;
+            glCreateBuffers(1, &result);
+            glNamedBufferStorage(result, sizeof(GLuint), NULL, GL_DYNAMIC_STORAGE_BIT);
+            glsl_program_t program;
+            program.compile_shader(file.c_str());
+            program.link();
+            const GLint original = program.get_handle();
+            const auto run = [&]() {
+                const GLuint zero = 0;
+                glNamedBufferSubData(result, 0, sizeof(GLuint), &zero);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, result);
+                program.use();
+                glDispatchCompute(1, 1, 1);
+                glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+                GLuint value = 0;
+                glGetNamedBufferSubData(result, 0, sizeof(GLuint), &value);
+                return value;
+            };
+            check(run() == 1, "the original program runs");
+
+            {
+                async_shader_compiler_t compiler(NULL, link_context);
+                compiler.watch_program(program, { file });
+                double longest_update_ms = 0.0;
+                uint32_t updates = 0;
+                // one update() per frame until the build is out, with a generous cap
+                const auto pump = [&]() {
+                    const auto start = std::chrono::high_resolution_clock::now();
+                    while (compiler.get_in_flight() > 0 && std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() < 30.0)
+                    {
+                        const auto t0 = std::chrono::high_resolution_clock::now();
+                        compiler.update();
+                        longest_update_ms = std::max(longest_update_ms, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count());
+                        ++updates;
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
+                };
+
+                // only the included file changes, the watch follows the #include
+                write_include("2u");
+                compiler.notify_file_changed(include);
+                pump();
+                check(compiler.get_stats().completed == 1 && program.get_handle() != original && run() == 2, "an edited include rebuilds the program");
+
+                write_shader("value = undeclared;");
+                compiler.notify_file_changed(file);
+                pump();
+                check(compiler.get_stats().failed == 1 && run() == 2, "a broken edit keeps the previous program");
+
+                printf("shaders reload: %s, %u built, %u failed over %u updates, longest update() %.3f ms\n",
+                    compiler.has_parallel_compile() ? "parallel shader compile" : compiler.has_link_thread() ? "link thread" : "blocking link status",
+                    compiler.get_stats().completed, compiler.get_stats().failed, updates, longest_update_ms);
+                check(compiler.has_parallel_compile() || compiler.has_link_thread(), "update() never waits for a link");
+            }
+
+            glDeleteBuffers(1, &result);
+            if (link_window != NULL) glfwDestroyWindow(link_window);
+            std::filesystem::remove_all(root, ec);
+        }
+
+        printf("shaders: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_occlusion(void)
+    {
+        using namespace Continuum;
+        using namespace Continuum::Graphics;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+        const auto count_differences = [](const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+            size_t differences = 0;
+            for (size_t i = 0; i < a.size(); i += 4) differences += memcmp(&a[i], &b[i], 4) != 0 ? 1 : 0;
+            return differences;
+        };
+
+        // 1. every pyramid texel holds the farthest depth of the pixels it covers, odd sizes included
+        {
+            const uint32_t width = 203;
+            const uint32_t height = 117;
+            uint32_t rng = 5;
+            const auto next_random = [&rng]() { rng = rng * 1664525u + 1013904223u; return float(rng >> 8) / float(1 << 24); };
+            std::vector<float> depth(size_t(width) * height);
+            for (float& d : depth) d = next_random();
+
+            hiz_pyramid_t pyramid;
+            pyramid.build(depth.data(), width, height);
+            bool exact = pyramid.get_level_count() == 8 && pyramid.get_level_width(7) == 1 && pyramid.get_level_height(7) == 1;
+            for (uint32_t level = 0; exact && level < pyramid.get_level_count(); ++level)
+            {
+                const uint32_t level_width = pyramid.get_level_width(level);
+                const uint32_t level_height = pyramid.get_level_height(level);
+                std::vector<float> expected(size_t(level_width) * level_height, 0.0f);
+                for (uint32_t y = 0; y < height; ++y)
+                {
+                    for (uint32_t x = 0; x < width; ++x)
+                    {
+                        float& texel = expected[size_t(std::min(y >> level, level_height - 1)) * level_width + std::min(x >> level, level_width - 1)];
+                        texel = std::max(texel, depth[size_t(y) * width + x]);
+                    }
+                }
+                exact = expected == pyramid.levels[level];
+            }
+            check(exact, "pyramid texels are the farthest depth of the pixels they cover");
+        }
+
+        // 2. a wall 10 m away with a window onto the sky and a pillar 4 m away; spheres scattered around it.
+        // The reference test reads every pixel under the sphere's box: the pyramid may keep fewer spheres
+        // hidden, never more.
+        {
+            const uint32_t width = 320;
+            const uint32_t height = 181;
+            const glm::mat4 proj = glm::perspective(glm::radians(60.0f), float(width) / float(height), 0.1f, 100.0f);
+            const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            const glm::mat4 view_proj = proj * view;
+            const auto window_depth = [&proj](const float z) { return (proj[2][2] * z + proj[3][2]) / -z * 0.5f + 0.5f; };
+
+            std::vector<float> depth(size_t(width) * height);
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    const bool window = x >= 200 && x < 260 && y >= 40 && y < 100;
+                    const bool pillar = x >= 60 && x < 110;
+                    depth[size_t(y) * width + x] = pillar ? window_depth(-4.0f) : window ? 1.0f : window_depth(-10.0f);
+                }
+            }
+            hiz_pyramid_t pyramid;
+            pyramid.build(depth.data(), width, height);
+
+            const auto reference_occluded = [&](const glm::vec3& center, const float radius) {
+                glm::vec3 lo = glm::vec3(FLT_MAX), hi = glm::vec3(-FLT_MAX);
+                for (uint32_t c = 0; c < 8; ++c)
+                {
+                    const glm::vec4 clip = view_proj * glm::vec4(center + radius * glm::vec3((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f), 1.0f);
+                    if (clip.w <= 0.0f || clip.z < -clip.w) return false;
+                    lo = glm::min(lo, glm::vec3(clip) / clip.w);
+                    hi = glm::max(hi, glm::vec3(clip) / clip.w);
+                }
+                if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f) return false;
+                const int32_t x0 = std::clamp(int32_t(std::floor((lo.x * 0.5f + 0.5f) * float(width))), 0, int32_t(width) - 1);
+                const int32_t x1 = std::clamp(int32_t(std::floor((hi.x * 0.5f + 0.5f) * float(width))), 0, int32_t(width) - 1);
+                const int32_t y0 = std::clamp(int32_t(std::floor((lo.y * 0.5f + 0.5f) * float(height))), 0, int32_t(height) - 1);
+                const int32_t y1 = std::clamp(int32_t(std::floor((hi.y * 0.5f + 0.5f) * float(height))), 0, int32_t(height) - 1);
+                float farthest = 0.0f;
+                for (int32_t y = y0; y <= y1; ++y)
+                {
+                    for (int32_t x = x0; x <= x1; ++x) farthest = std::max(farthest, depth[size_t(y) * width + x]);
+                }
+                return lo.z * 0.5f + 0.5f > farthest;
+            };
+
+            const uint32_t count = 100000;
+            uint32_t rng = 9;
+            const auto next_random = [&rng]() { rng = rng * 1664525u + 1013904223u; return float(rng >> 8) / float(1 << 24); };
+            bounding_spheres_t spheres;
+            spheres.reserve(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const float z = -1.0f - 29.0f * next_random();
+                spheres.push_back(glm::vec3((next_random() - 0.5f) * -z * 1.6f, (next_random() - 0.5f) * -z * 0.9f, z), 0.05f + 1.45f * next_random() * next_random());
+            }
+
+            uint32_t reference_hidden = 0, pyramid_hidden = 0, wrongly_hidden = 0;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const glm::vec3 center = glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]);
+                const bool reference = reference_occluded(center, spheres.radius[i]);
+                const bool occluded = hiz_occluded(pyramid, view_proj, center, spheres.radius[i]);
+                reference_hidden += reference ? 1 : 0;
+                pyramid_hidden += occluded ? 1 : 0;
+                wrongly_hidden += occluded && !reference ? 1 : 0;
+            }
+
+            std::vector<uint32_t> visible(count);
+            for (uint32_t i = 0; i < count; ++i) visible[i] = i;
+            cull_stats_t stats;
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            cull_occluded(spheres, pyramid, view_proj, visible, &stats);
+            const double cull_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+
+            printf("occlusion cpu: %u spheres, %u hidden per pixel, %u by the pyramid (%.1f%%), %.1f ns/sphere\n", count, reference_hidden,
+                pyramid_hidden, 100.0 * double(pyramid_hidden) / double(std::max(reference_hidden, 1u)), cull_ms * 1e6 / double(count));
+            check(reference_hidden > count / 4, "the wall hides a good share of the spheres");
+            check(wrongly_hidden == 0, "the pyramid never hides a sphere that is visible per pixel");
+            check(pyramid_hidden * 10 >= reference_hidden * 7, "the pyramid finds most of the hidden spheres");
+            check(stats.occlusion_culled == pyramid_hidden && visible.size() == count - pyramid_hidden
+                && std::is_sorted(visible.begin(), visible.end()), "cull_occluded drops exactly the hidden spheres, in order");
+        }
+
+        gl_context_t context;
+        if (!context.is_valid())
+        {
+            printf("occlusion: no OpenGL 4.5 context, skipped the GPU half\n");
+            printf("occlusion: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+            return failures == 0 ? 0 : 1;
+        }
+
+        hiz_culler_t culler;
+        if (!culler.init(bench_shader_root))
+        {
+            check(false, "Hi-Z programs compile");
+            printf("occlusion: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+            return 1;
+        }
+
+        // odd on purpose, the pyramid folds the last row and column
+        const GLsizei width = 641;
+        const GLsizei height = 361;
+        GLuint framebuffer = 0;
+        GLuint renderbuffers[2] = {};
+        glCreateRenderbuffers(2, renderbuffers);
+        glNamedRenderbufferStorage(renderbuffers[0], GL_RGBA8, width, height);
+        glNamedRenderbufferStorage(renderbuffers[1], GL_DEPTH_COMPONENT24, width, height);
+        glCreateFramebuffers(1, &framebuffer);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        check(glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "offscreen framebuffer is complete");
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+        glEnable(GL_DEPTH_TEST);
+        const float clear_color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        const auto clear = [&]() {
+            glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clear_color);
+            glClearNamedFramebufferfi(framebuffer, GL_DEPTH_STENCIL, 0, 1.0f, 0);
+        };
+
+        // 3. the city from street level: mesh.vert without gl_BaseInstance, which 4.5 only has as an extension,
+        // shaded by world position so that the image does not depend on the order the culler compacts instances in
+        glsl_program_t program;
+        program.compile_shader(
+            "#version 450 core\n"
+            "#extension GL_ARB_shader_draw_parameters : require\n"
+            "struct Vertex { float p[3]; float n[3]; float tc[2]; };\n"
+            "layout(std430, binding = 1) restrict readonly buffer Vertices { Vertex in_Vertices[]; };\n"
+            "layout(std430, binding = 2) restrict readonly buffer Matrices { mat4 in_ModelMatrices[]; };\n"
+            "uniform mat4 view_proj;\n"
+            "layout(location = 0) out vec3 out_world_pos;\n"
+            "void main() {\n"
+            "    Vertex v = in_Vertices[gl_VertexID];\n"
+            "    vec4 world_pos = in_ModelMatrices[gl_BaseInstanceARB + gl_InstanceID] * vec4(v.p[0], v.p[1], v.p[2], 1.0);\n"
+            "    out_world_pos = world_pos.xyz;\n"
+            "    gl_Position = view_proj * world_pos;\n"
+            "}\n", GLSLShader::VERTEX, "occlusion.vert");
+        program.compile_shader(
+            "#version 450 core\n"
+            "layout(location = 0) in vec3 in_world_pos;\n"
+            "layout(location = 0) out vec4 out_color;\n"
+            "void main() { out_color = vec4(fract(in_world_pos * vec3(3.1, 7.3, 5.7)), 1.0); }\n", GLSLShader::FRAGMENT, "occlusion.frag");
+        program.link();
+
+        mesh_pool_t pool;
+        draw_list_t city;
+        DemoScene::build_city(pool, 48, city);
+        pool.commit();
+        indirect_renderer_t renderer;
+        render_command_list_t commands;
+        render_state_tracker_t state;
+
+        // standing at a crossing, looking down the blocks at an angle
+        const glm::mat4 proj = glm::perspective(glm::radians(60.0f), float(width) / float(height), 0.01f, 100.0f);
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.02f, -0.42f, 0.03f), glm::vec3(20.0f, -0.45f, 7.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 view_proj = proj * view;
+        const uint64_t key = SortKey::make(RenderPass::SOLID, 1, 0, 0.0f);
+
+        const auto draw_city = [&](const bool culled) {
+            renderer.begin_frame();
+            culler.begin_frame();
+            clear();
+            program.use();
+            program.set_uniform("view_proj", view_proj);
+            if (culled)
+            {
+                commands.clear();
+                renderer.record_culled(commands, key, program.get_handle(), pool, city, culler, view_proj);
+                state.invalidate();
+                commands.execute(state);
+            }
+            else
+            {
+                pool.bind();
+                renderer.draw(pool, city, DrawPath::MULTI_DRAW_INDIRECT);
+            }
+            renderer.end_frame();
+        };
+
+        std::vector<uint8_t> all_pixels(size_t(width) * height * 4), culled_pixels(all_pixels.size());
+        std::vector<float> depth(size_t(width) * height);
+        draw_city(false);
+        glFinish();
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, all_pixels.data());
+        glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+        culler.build(uint32_t(width), uint32_t(height), view_proj, glm::dvec3(0.0));
+
+        // the depth copy may convert 24-bit depth a rounding apart from glReadPixels, the reduction above it has to be exact
+        std::vector<float> gpu_level0(depth.size());
+        glGetTextureImage(culler.get_pyramid_texture(), 0, GL_RED, GL_FLOAT, GLsizei(gpu_level0.size() * sizeof(float)), gpu_level0.data());
+        float max_depth_error = 0.0f;
+        for (size_t i = 0; i < depth.size(); ++i) max_depth_error = std::max(max_depth_error, std::abs(gpu_level0[i] - depth[i]));
+        check(max_depth_error <= 1e-6f, "pyramid level 0 holds the depth buffer");
+
+        hiz_pyramid_t pyramid;
+        pyramid.build(gpu_level0.data(), uint32_t(width), uint32_t(height));
+        bool same_pyramid = culler.get_level_count() == pyramid.get_level_count();
+        std::vector<float> level_texels;
+        for (uint32_t level = 1; same_pyramid && level < pyramid.get_level_count(); ++level)
+        {
+            level_texels.resize(pyramid.levels[level].size());
+            glGetTextureImage(culler.get_pyramid_texture(), GLint(level), GL_RED, GL_FLOAT, GLsizei(level_texels.size() * sizeof(float)), level_texels.data());
+            same_pyramid = level_texels == pyramid.levels[level];
+        }
+        check(same_pyramid, "the GPU pyramid matches the CPU reference texel for texel");
+
+        // the same camera a frame later: the draw only sees what the pyramid could not hide
+        draw_city(true);
+        glFinish();
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, culled_pixels.data());
+        // counters come back two begin_frame() calls late, the finish lets the second one find the fence signalled
+        culler.begin_frame();
+        glFinish();
+        culler.begin_frame();
+        const hiz_cull_stats_t gpu = culler.get_stats();
+
+        // the CPU reference on the spheres record_culled() builds
+        std::vector<draw_elements_indirect_command_t> list_commands;
+        std::vector<glm::mat4> list_matrices;
+        std::vector<uint32_t> list_meshes;
+        city.build(pool, list_commands, list_matrices, &list_meshes);
+        bounding_spheres_t spheres;
+        for (size_t c = 0; c < list_commands.size(); ++c)
+        {
+            const glm::vec4 bounds = pool.get_mesh(list_meshes[c]).bounds;
+            for (uint32_t i = list_commands[c].base_instance; i < list_commands[c].base_instance + list_commands[c].instance_count; ++i)
+            {
+                const glm::mat4& model = list_matrices[i];
+                const float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+                spheres.push_back(glm::vec3(model * glm::vec4(glm::vec3(bounds), 1.0f)), bounds.w * scale);
+            }
+        }
+        std::vector<uint32_t> visible;
+        cull_stats_t cpu;
+        cull_spheres(spheres, frustum_t::from_matrix(view_proj), NULL, visible, &cpu);
+        cull_stats_t cpu_occlusion;
+        cull_occluded(spheres, pyramid, view_proj, visible, &cpu_occlusion);
+
+        const size_t differences = count_differences(all_pixels, culled_pixels);
+        const uint32_t tolerance = 2 + gpu.tested / 1000;
+        printf("occlusion city: %u instances, %u outside the frustum, %u occluded (cpu %u, %u), %u drawn; pyramid built in %.3f ms, %zu pixels differ\n",
+            gpu.tested, gpu.frustum_culled, gpu.occlusion_culled, cpu.frustum_culled, cpu_occlusion.occlusion_culled, gpu.visible, culler.get_stats().build_ms,
+            differences);
+        check(gpu.tested == city.size() && gpu.visible + gpu.frustum_culled + gpu.occlusion_culled == gpu.tested, "every instance is counted once");
+        check(uint32_t(std::abs(int64_t(gpu.frustum_culled) - int64_t(cpu.frustum_culled))) <= tolerance, "GPU frustum test agrees with the CPU one");
+        check(uint32_t(std::abs(int64_t(gpu.occlusion_culled) - int64_t(cpu_occlusion.occlusion_culled))) <= tolerance, "GPU occlusion test agrees with the CPU reference");
+        check(gpu.occlusion_culled * 2 > gpu.tested - gpu.frustum_culled, "buildings hide most of the street level view");
+        check(differences * 1000 <= all_pixels.size() / 4, "culled draws produce the unculled image");
+
+        // 4. GPU time of the whole city against cull + surviving instances
+        const int frames = 10;
+        double all_ms = 0.0, culled_ms = 0.0;
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            draw_city(false);
+            glFinish();
+            all_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+            culler.build(uint32_t(width), uint32_t(height), view_proj, glm::dvec3(0.0));
+            glFinish();
+            t0 = std::chrono::high_resolution_clock::now();
+            draw_city(true);
+            glFinish();
+            culled_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+        }
+        printf("occlusion city: all instances %.3f ms/frame, culled %.3f ms/frame (%.2fx)\n", all_ms / frames, culled_ms / frames,
+            all_ms / std::max(culled_ms, 1e-6));
+
+        // 5. terrain seen from a valley floor, looking at the steepest slope around: the patches behind it are hidden
+        {
+            using namespace Continuum::Terrain;
+            terrain_renderer_settings_t settings = {};
+            settings.heightfield.noise.frequency = 200.0f;
+            Graphics::buffer_suballocator_t buffers;
+            Jobs::job_system_t jobs;
+            terrain_renderer_t terrain(settings, buffers, &jobs);
+            if (!terrain.init(bench_shader_root))
+            {
+                check(false, "terrain programs compile");
+            }
+            else
+            {
+                const float radius = settings.heightfield.planet_radius;
+                const auto height_at = [&settings](const glm::vec3& p) {
+                    const glm::vec3 dir = glm::normalize(p);
+                    float noise = 0.0f;
+                    Noise::evaluate(settings.heightfield.noise, &dir.x, &dir.y, &dir.z, &noise, 1);
+                    return settings.heightfield.to_height(noise);
+                };
+                const glm::vec3 up = glm::normalize(glm::vec3(0.3f, 0.2f, 1.0f));
+                const glm::vec3 east = glm::normalize(glm::cross(up, glm::vec3(0.0f, 1.0f, 0.0f)));
+                const glm::vec3 north = glm::cross(east, up);
+                const float ground = height_at(up);
+                glm::vec3 heading = east;
+                float steepest = -FLT_MAX;
+                for (int h = 0; h < 16; ++h)
+                {
+                    const float angle = float(h) * glm::radians(22.5f);
+                    const glm::vec3 candidate = east * std::cos(angle) + north * std::sin(angle);
+                    for (float distance = 1000.0f; distance <= 20000.0f; distance += 1000.0f)
+                    {
+                        const float rise = (height_at(up + candidate * (distance / radius)) - ground) / distance;
+                        if (rise <= steepest) continue;
+                        steepest = rise;
+                        heading = candidate;
+                    }
+                }
+
+                const glm::dvec3 camera_world = glm::dvec3(up) * double(radius + ground + 20.0f);
+                Camera::OrbCameraPositioner positioner;
+                positioner.look_at(camera_world, camera_world + glm::dvec3(heading), up);
+                const glm::mat4 rotation = positioner.get_view_rotation();
+                const glm::mat4 terrain_proj = glm::perspective(glm::radians(60.0f), float(width) / float(height), 1.0f, 2e5f);
+
+                const auto draw_terrain = [&]() {
+                    buffers.begin_frame();
+                    culler.begin_frame();
+                    clear();
+                    terrain.update(camera_world, rotation, terrain_proj, float(height));
+                    terrain.draw();
+                    buffers.end_frame();
+                    glFinish();
+                };
+
+                // until the quadtree has settled and every patch is resident
+                terrain.set_occlusion_culler(NULL);
+                uint32_t previous_nodes = 0;
+                for (int frame = 0; frame < 100; ++frame)
+                {
+                    draw_terrain();
+                    const terrain_renderer_stats_t& stats = terrain.get_stats();
+                    const bool settled = stats.generated_patches == 0 && stats.nodes == previous_nodes;
+                    previous_nodes = stats.nodes;
+                    if (settled) break;
+                }
+                glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, all_pixels.data());
+                culler.reset();
+                culler.build(uint32_t(width), uint32_t(height), terrain_proj * rotation, camera_world);
+
+                terrain.set_occlusion_culler(&culler);
+                draw_terrain();
+                glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, culled_pixels.data());
+                culler.begin_frame();
+                glFinish();
+                culler.begin_frame();
+                const hiz_cull_stats_t patches = culler.get_stats();
+                const size_t terrain_differences = count_differences(all_pixels, culled_pixels);
+                printf("occlusion terrain: slope %.3f, %u patches, %u outside the frustum, %u occluded, %zu pixels differ\n", steepest, patches.tested,
+                    patches.frustum_culled, patches.occlusion_culled, terrain_differences);
+                check(patches.tested == terrain.get_stats().drawn_patches && patches.visible + patches.frustum_culled + patches.occlusion_culled == patches.tested,
+                    "every terrain patch is counted once");
+                check(patches.occlusion_culled > 0, "the slope hides the patches behind it");
+                check(terrain_differences * 1000 <= all_pixels.size() / 4, "culled terrain produces the unculled image");
+                terrain.set_occlusion_culler(NULL);
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+
+        printf("occlusion: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_scatter(void)
+    {
+        using namespace Continuum;
+        using namespace Continuum::Graphics;
+        using namespace Continuum::Terrain;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+
+        // rugged terrain so that the slope and height filters have something to reject
+        heightfield_settings_t heightfield = {};
+        heightfield.noise.frequency = 200.0f;
+        const float radius = heightfield.planet_radius;
+
+        // meshes 0 and 1 are the near and far tree, 2 the box rocks and buildings share
+        scatter_settings_t settings = {};
+        settings.cell_level = 14;
+        settings.max_cells_per_update = 256;
+        scatter_layer_t trees = {};
+        trees.spacing = 12.0f;
+        trees.max_slope = 0.5f;
+        trees.max_height = 7000.0f;
+        trees.min_scale = 8.0f;
+        trees.max_scale = 16.0f;
+        trees.band_count = 2;
+        trees.band_distances[0] = 250.0f;
+        trees.band_distances[1] = 800.0f;
+        trees.band_meshes[0] = 0;
+        trees.band_meshes[1] = 1;
+        trees.seed = 1;
+        scatter_layer_t rocks = {};
+        rocks.spacing = 30.0f;
+        rocks.max_slope = 10.0f;
+        rocks.min_scale = 1.0f;
+        rocks.max_scale = 3.0f;
+        rocks.band_distances[0] = 300.0f;
+        rocks.band_meshes[0] = 2;
+        rocks.seed = 2;
+        scatter_layer_t buildings = {};
+        buildings.spacing = 80.0f;
+        buildings.max_slope = 0.15f;
+        buildings.max_height = 4500.0f;
+        buildings.min_scale = 10.0f;
+        buildings.max_scale = 20.0f;
+        buildings.band_distances[0] = 1200.0f;
+        buildings.band_meshes[0] = 2;
+        buildings.seed = 3;
+        settings.layers = { trees, rocks, buildings };
+
+        const auto height_at = [&heightfield](const glm::vec3& dir) {
+            float noise = 0.0f;
+            Noise::evaluate(heightfield.noise, &dir.x, &dir.y, &dir.z, &noise, 1);
+            return heightfield.to_height(noise);
+        };
+        const auto same_instances = [](const scatter_cell_t& a, const scatter_cell_t& b) {
+            return a.instances.size() == b.instances.size() && a.candidates == b.candidates
+                && (a.instances.empty() || memcmp(a.instances.data(), b.instances.data(), a.instances.size() * sizeof(scatter_instance_t)) == 0);
+        };
+
+        // a camera standing on the ground; the cell under it is the one checked in detail
+        const glm::vec3 up = glm::normalize(glm::vec3(0.3f, 0.2f, 1.0f));
+        quadtree_settings_t quadtree_settings = {};
+        cube_sphere_quadtree_t quadtree(quadtree_settings);
+        const float viewport_height = 360.0f;
+        const float aspect = 640.0f / 360.0f;
+        const glm::mat4 proj = glm::perspective(glm::radians(60.0f), aspect, 1.0f, 2e5f);
+
+        const glm::dvec3 camera_world = glm::dvec3(up) * double(radius + height_at(up) + 30.0f);
+        const glm::vec3 east = glm::normalize(glm::cross(up, glm::vec3(0.0f, 1.0f, 0.0f)));
+        Camera::OrbCameraPositioner positioner;
+        positioner.look_at(camera_world, camera_world + glm::dvec3(east - up * 0.1f), up);
+        const glm::mat4 view_proj = proj * positioner.get_view_rotation();
+
+        const auto settle = [&](const glm::dvec3& camera) {
+            for (int frame = 0; frame < 64; ++frame)
+            {
+                quadtree.update(glm::vec3(camera), proj, viewport_height);
+                if (quadtree.get_stats().splits == 0 && quadtree.get_stats().merges == 0) break;
+            }
+        };
+        settle(camera_world);
+
+        patch_key_t key = {};
+        float nearest = FLT_MAX;
+        for (const quadtree_patch_t& patch : quadtree.get_patches())
+        {
+            const float distance = glm::length(patch.center - glm::vec3(camera_world));
+            if (patch.key.level < settings.cell_level || distance >= nearest) continue;
+            nearest = distance;
+            const uint32_t shift = patch.key.level - settings.cell_level;
+            key.face = patch.key.face;
+            key.level = uint8_t(settings.cell_level);
+            key.x = patch.key.x >> shift;
+            key.y = patch.key.y >> shift;
+        }
+        check(nearest < FLT_MAX, "the quadtree reaches the scatter cell level under the camera");
+
+
+        // 1. one cell: deterministic, Poisson spacing and filters hold
+        {
+            scatter_cell_t first, second;
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            place_scatter_cell(heightfield, settings, key, first);
+            const double cell_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+            place_scatter_cell(heightfield, settings, key, second);
+            check(!first.instances.empty() && same_instances(first, second), "placing a cell twice gives the same instances");
+
+            uint32_t per_layer[3] = {};
+            float closest[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+            bool heights_ok = true, scales_ok = true, bounds_ok = true;
+            for (size_t a = 0; a < first.instances.size(); ++a)
+            {
+                const scatter_instance_t& i = first.instances[a];
+                const scatter_layer_t& layer = settings.layers[i.layer];
+                ++per_layer[i.layer];
+                const glm::vec3 p = glm::vec3(i.position[0], i.position[1], i.position[2]);
+                const double height = glm::length(first.origin + glm::dvec3(p)) - double(radius);
+                heights_ok = heights_ok && height >= double(layer.min_height) - 1.0 && height <= double(layer.max_height) + 1.0;
+                scales_ok = scales_ok && i.scale >= layer.min_scale && i.scale <= layer.max_scale;
+                bounds_ok = bounds_ok && glm::length(p - glm::vec3(first.bounds)) <= first.bounds.w + 0.01f;
+                for (size_t b = a + 1; b < first.instances.size(); ++b)
+                {
+                    const scatter_instance_t& j = first.instances[b];
+                    if (j.layer != i.layer) continue;
+                    closest[i.layer] = std::min(closest[i.layer], glm::length(p - glm::vec3(j.position[0], j.position[1], j.position[2])));
+                }
+            }
+            printf("scatter cell: %u candidates, %u trees, %u rocks, %u buildings, closest %.1f/%.1f/%.1f m, placed in %.3f ms\n", first.candidates,
+                per_layer[0], per_layer[1], per_layer[2], per_layer[0] > 1 ? closest[0] : 0.0f, per_layer[1] > 1 ? closest[1] : 0.0f,
+                per_layer[2] > 1 ? closest[2] : 0.0f, cell_ms);
+            for (uint32_t l = 0; l < 3; ++l)
+            {
+                // half a metre of float rounding in the positions
+                if (per_layer[l] > 1) check(closest[l] >= settings.layers[l].spacing - 0.5f, "instances of a layer keep the Poisson spacing");
+            }
+            check(heights_ok, "instances lie within their layer's height range");
+            check(scales_ok, "scales lie within their layer's range");
+            check(bounds_ok, "the cell bounds hold every instance");
+            check(first.candidates > uint32_t(first.instances.size()), "the slope and height filters reject candidates");
+
+            // a flat-enough cutoff: every tree stands where the terrain rises less than max_slope over a few metres
+            const glm::dvec3 origin = first.origin;
+            uint32_t steep = 0, trees_checked = 0;
+            for (const scatter_instance_t& i : first.instances)
+            {
+                if (i.layer != 0 || trees_checked >= 200) continue;
+                ++trees_checked;
+                const glm::vec3 dir = glm::vec3(glm::normalize(origin + glm::dvec3(i.position[0], i.position[1], i.position[2])));
+                const glm::vec3 tangent = glm::normalize(glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), dir));
+                const glm::vec3 bitangent = glm::cross(dir, tangent);
+                const float step = 8.0f;
+                const float h = height_at(dir);
+                const float de = (height_at(glm::normalize(dir + tangent * (step / radius))) - h) / step;
+                const float dn = (height_at(glm::normalize(dir + bitangent * (step / radius))) - h) / step;
+                if (std::sqrt(de * de + dn * dn) > settings.layers[0].max_slope * 1.5f) ++steep;
+            }
+            check(steep * 20 <= trees_checked, "trees stand on gentle slopes");
+        }
+
+        // 2. the cells around a camera standing on the ground, threaded placement and the cache
+        Jobs::job_system_t jobs;
+        scatter_system_t system(heightfield, settings, &jobs);
+        system.update(quadtree, camera_world, view_proj);
+        const scatter_stats_t first = system.get_stats();
+        system.update(quadtree, camera_world, view_proj);
+        const scatter_stats_t second = system.get_stats();
+        printf("scatter: %u cells in range, %u visible, %u placed in %.3f ms (%.3f ms/cell on one thread, %u workers), %u instances/frame (%u/%u/%u per band), update %.3f ms\n",
+            first.cells, first.visible_cells, first.placed_cells, first.placement_ms, first.placement_ms_per_cell, jobs.get_worker_count(),
+            second.instances, second.band_instances[0], second.band_instances[1], second.band_instances[2], second.update_ms);
+        check(first.cells > 4 && first.placed_cells == first.cells && first.cached_cells == first.cells, "the first update places every cell in range");
+        check(second.placed_cells == 0 && second.cached_cells == first.cells, "the second update places nothing, the cells are cached");
+        check(second.instances > 0 && second.instances == first.instances && second.instances == uint32_t(system.get_draw_list().size()),
+            "both updates queue the same instances");
+
+        const scatter_cell_t* cached = system.find_cell(key);
+        scatter_cell_t direct;
+        place_scatter_cell(heightfield, settings, key, direct);
+        check(cached != NULL && same_instances(*cached, direct), "cells placed on the workers match the single-threaded placement");
+
+        // every instance lies within its band, with the band's mesh
+        {
+            mesh_pool_t pool;
+            const mesh_vertex_t vertex = {};
+            const uint32_t index = 0;
+            for (int mesh = 0; mesh < 3; ++mesh) pool.add_mesh(&vertex, 1, &index, 1);
+            std::vector<draw_elements_indirect_command_t> commands;
+            std::vector<glm::mat4> matrices;
+            std::vector<uint32_t> meshes;
+            system.get_draw_list().build(pool, commands, matrices, &meshes);
+            float farthest[3] = {};
+            for (size_t c = 0; c < commands.size(); ++c)
+            {
+                for (uint32_t i = commands[c].base_instance; i < commands[c].base_instance + commands[c].instance_count; ++i)
+                    farthest[meshes[c]] = std::max(farthest[meshes[c]], glm::length(glm::vec3(matrices[i][3])));
+            }
+            printf("scatter bands: farthest near tree %.0f m, far tree %.0f m, box %.0f m\n", farthest[0], farthest[1], farthest[2]);
+            check(farthest[0] < trees.band_distances[0] && farthest[1] < trees.band_distances[1] && farthest[2] < buildings.band_distances[0],
+                "instances stay within their bands");
+            check(second.band_instances[0] > 0 && second.band_instances[1] > 0, "both tree bands are used");
+        }
+
+        // a small cache keeps only the cells in use, a camera kilometres away replaces them
+        {
+            scatter_settings_t small_settings = settings;
+            small_settings.max_cached_cells = 1;
+            scatter_system_t small(heightfield, small_settings, &jobs);
+            small.update(quadtree, camera_world, view_proj);
+            const uint32_t near_cells = small.get_stats().cells;
+            const glm::vec3 away = glm::normalize(up + east * (5000.0f / radius));
+            const glm::dvec3 away_world = glm::dvec3(away) * double(radius + height_at(away) + 30.0f);
+            settle(away_world);
+            small.update(quadtree, away_world, view_proj);
+            check(small.get_stats().cached_cells == small.get_stats().cells && small.get_stats().placed_cells == small.get_stats().cells,
+                "cells out of use are evicted past the cache size");
+            check(near_cells > 0 && small.find_cell(key) == NULL, "the cells left behind are gone");
+            settle(camera_world);
+        }
+
+        gl_context_t context;
+        if (!context.is_valid())
+        {
+            printf("scatter: no OpenGL 4.5 context, skipped the GPU half\n");
+            printf("scatter: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+            return failures == 0 ? 0 : 1;
+        }
+
+        const GLsizei width = 640;
+        const GLsizei height = 360;
+        GLuint framebuffer = 0;
+        GLuint renderbuffers[2] = {};
+        glCreateRenderbuffers(2, renderbuffers);
+        glNamedRenderbufferStorage(renderbuffers[0], GL_RGBA8, width, height);
+        glNamedRenderbufferStorage(renderbuffers[1], GL_DEPTH_COMPONENT24, width, height);
+        glCreateFramebuffers(1, &framebuffer);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        check(glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "offscreen framebuffer is complete");
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+        glEnable(GL_DEPTH_TEST);
+        const float clear_color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+        // 3. the scatter through the in_ModelMatrices layout of grid.vert and mesh.vert, camera-relative
+        glsl_program_t program;
+        program.compile_shader(
+            "#version 450 core\n"
+            "#extension GL_ARB_shader_draw_parameters : require\n"
+            "struct Vertex { float p[3]; float n[3]; float tc[2]; };\n"
+            "layout(std430, binding = 1) restrict readonly buffer Vertices { Vertex in_Vertices[]; };\n"
+            "layout(std430, binding = 2) restrict readonly buffer Matrices { mat4 in_ModelMatrices[]; };\n"
+            "uniform mat4 view_proj;\n"
+            "layout(location = 0) out vec3 out_normal;\n"
+            "void main() {\n"
+            "    Vertex v = in_Vertices[gl_VertexID];\n"
+            "    mat4 model = in_ModelMatrices[gl_BaseInstanceARB + gl_InstanceID];\n"
+            "    out_normal = normalize(mat3(model) * vec3(v.n[0], v.n[1], v.n[2]));\n"
+            "    gl_Position = view_proj * model * vec4(v.p[0], v.p[1], v.p[2], 1.0);\n"
+            "}\n", GLSLShader::VERTEX, "scatter.vert");
+        program.compile_shader(
+            "#version 450 core\n"
+            "layout(location = 0) in vec3 in_normal;\n"
+            "layout(location = 0) out vec4 out_color;\n"
+            "void main() { out_color = vec4(in_normal * 0.5 + 0.5, 1.0); }\n", GLSLShader::FRAGMENT, "scatter.frag");
+        program.link();
+
+        // cones standing on the origin, a smooth one near and a four-sided one far
+        mesh_pool_t pool;
+        const auto add_cone = [&pool](const uint32_t sides) {
+            std::vector<mesh_vertex_t> vertices;
+            std::vector<uint32_t> indices;
+            const glm::vec3 apex = glm::vec3(0.0f, 1.0f, 0.0f);
+            for (uint32_t side = 0; side < sides; ++side)
+            {
+                const float a0 = float(side) / float(sides) * 6.2831853f;
+                const float a1 = float(side + 1) / float(sides) * 6.2831853f;
+                const glm::vec3 p0 = glm::vec3(std::cos(a0), 0.0f, -std::sin(a0)) * 0.4f;
+                const glm::vec3 p1 = glm::vec3(std::cos(a1), 0.0f, -std::sin(a1)) * 0.4f;
+                const glm::vec3 n = glm::normalize(glm::cross(p1 - p0, apex - p0));
+                const uint32_t base = uint32_t(vertices.size());
+                for (const glm::vec3& p : { p0, p1, apex }) vertices.push_back({ { p.x, p.y, p.z }, { n.x, n.y, n.z }, { 0.0f, 0.0f } });
+                indices.insert(indices.end(), { base, base + 1, base + 2 });
+            }
+            return pool.add_mesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+        };
+        const auto add_box = [&pool]() {
+            std::vector<mesh_vertex_t> vertices;
+            std::vector<uint32_t> indices;
+            const glm::vec3 normals[6] = {
+                glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+            };
+            for (const glm::vec3& n : normals)
+            {
+                const glm::vec3 t = std::abs(n.y) > 0.5f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                const glm::vec3 b = glm::cross(n, t);
+                const uint32_t base = uint32_t(vertices.size());
+                for (const glm::vec2& c : { glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f) })
+                {
+                    const glm::vec3 p = (n + t * c.x + b * c.y) * 0.5f + glm::vec3(0.0f, 0.5f, 0.0f);
+                    vertices.push_back({ { p.x, p.y, p.z }, { n.x, n.y, n.z }, { 0.0f, 0.0f } });
+                }
+                indices.insert(indices.end(), { base, base + 1, base + 2, base + 2, base + 3, base });
+            }
+            return pool.add_mesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+        };
+        check(add_cone(12) == 0 && add_cone(4) == 1 && add_box() == 2, "scatter meshes get the ids the layers use");
+        pool.commit();
+
+        indirect_renderer_t renderer;
+        const auto draw_scatter = [&](const DrawPath::DrawPathType path) {
+            renderer.begin_frame();
+            glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clear_color);
+            glClearNamedFramebufferfi(framebuffer, GL_DEPTH_STENCIL, 0, 1.0f, 0);
+            program.use();
+            program.set_uniform("view_proj", view_proj);
+            pool.bind();
+            renderer.draw(pool, system.get_draw_list(), path);
+            renderer.end_frame();
+            glFinish();
+        };
+
+        std::vector<uint8_t> mdi_pixels(size_t(width) * height * 4), per_instance_pixels(mdi_pixels.size());
+        draw_scatter(DrawPath::MULTI_DRAW_INDIRECT);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, mdi_pixels.data());
+        const draw_submit_stats_t mdi = renderer.get_frame_stats();
+        draw_scatter(DrawPath::PER_INSTANCE);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, per_instance_pixels.data());
+        const draw_submit_stats_t per_instance = renderer.get_frame_stats();
+        size_t covered = 0;
+        for (size_t i = 0; i < mdi_pixels.size(); i += 4) covered += (mdi_pixels[i] | mdi_pixels[i + 1] | mdi_pixels[i + 2]) != 0 ? 1 : 0;
+        check(mdi.instances == second.instances && mdi.draw_calls <= 3, "the scatter is one instanced command per mesh");
+        check(per_instance.draw_calls == second.instances, "the baseline draws every instance on its own");
+        check(mdi_pixels == per_instance_pixels, "both paths produce the same image");
+        check(covered > 0, "the scatter is on screen");
+
+        const int frames = 10;
+        double mdi_ms = 0.0, per_instance_ms = 0.0;
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            draw_scatter(DrawPath::MULTI_DRAW_INDIRECT);
+            mdi_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+            t0 = std::chrono::high_resolution_clock::now();
+            draw_scatter(DrawPath::PER_INSTANCE);
+            per_instance_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+        }
+        printf("scatter draw: %u instances in %u commands %.3f ms/frame, per instance %.3f ms/frame, %zu pixels covered\n", mdi.instances, mdi.draw_calls,
+            mdi_ms / frames, per_instance_ms / frames, covered);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+
+        printf("scatter: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    static int bench_impostors(void)
+    {
+        using namespace Continuum;
+        using namespace Continuum::Graphics;
+
+        int failures = 0;
+        const auto check = [&failures](const bool condition, const char* what) {
+            if (!condition)
+            {
+                printf("FAILED: %s\n", what);
+                ++failures;
+            }
+        };
+
+        // 1. octahedral mapping: directions survive the round trip and every view gets an orthonormal frame
+        {
+            uint32_t rng = 11;
+            const auto next_random = [&rng]() { rng = rng * 1664525u + 1013904223u; return float(rng >> 8) / float(1 << 24); };
+            std::vector<glm::vec3> directions = {
+                glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+            };
+            for (int i = 0; i < 100000; ++i)
+            {
+                const float y = next_random() * 2.0f - 1.0f;
+                const float phi = next_random() * 6.2831853f;
+                const float r = std::sqrt(std::max(0.0f, 1.0f - y * y));
+                directions.push_back(glm::normalize(glm::vec3(r * std::cos(phi), y, r * std::sin(phi))));
+            }
+            float max_direction_error = 0.0f;
+            float max_frame_error = 0.0f;
+            bool in_unit_square = true;
+            for (const glm::vec3& d : directions)
+            {
+                const glm::vec2 uv = Octahedral::encode(d);
+                in_unit_square = in_unit_square && uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f;
+                max_direction_error = std::max(max_direction_error, glm::length(Octahedral::decode(uv) - d));
+                glm::vec3 right, up;
+                Octahedral::frame_basis(d, right, up);
+                const float frame_error = std::max({ std::abs(glm::dot(right, d)), std::abs(glm::dot(up, d)), std::abs(glm::dot(right, up)),
+                    std::abs(glm::length(right) - 1.0f), std::abs(glm::length(up) - 1.0f), glm::length(glm::cross(right, up) - d) });
+                max_frame_error = std::max(max_frame_error, frame_error);
+            }
+            printf("impostors octahedral: %zu directions, max round trip error %.2e, max frame error %.2e\n", directions.size(),
+                max_direction_error, max_frame_error);
+            check(in_unit_square, "directions encode into the unit square");
+            check(max_direction_error < 1e-5f, "directions decode back");
+            check(max_frame_error < 1e-5f, "view frames are orthonormal and right-handed");
+        }
+
+        const std::filesystem::path root = std::filesystem::temp_directory_path() / "continuum_impostor_bench";
+        std::error_code ec = {};
+        std::filesystem::remove_all(root, ec);
+
+        // 2. the disk cache: bit-exact round trip, anything else is rejected
+        {
+            impostor_atlas_t atlas;
+            atlas.key = 0x0123456789abcdefull;
+            atlas.grid = 4;
+            atlas.view_size = 8;
+            atlas.bounds = glm::vec4(0.1f, 0.2f, 0.3f, 1.5f);
+            const size_t bytes = size_t(atlas.get_size()) * atlas.get_size() * 4;
+            uint32_t rng = 3;
+            for (std::vector<uint8_t>* payload : { &atlas.albedo, &atlas.normal_depth })
+            {
+                payload->resize(bytes);
+                for (uint8_t& byte : *payload) byte = uint8_t((rng = rng * 1664525u + 1013904223u) >> 24);
+            }
+
+            const std::string path = (root / "synthetic.bin").string();
+            check(save_impostor(path, atlas), "atlas is stored");
+            impostor_atlas_t loaded;
+            check(load_impostor(path, atlas.key, loaded) && loaded.grid == atlas.grid && loaded.view_size == atlas.view_size
+                && loaded.bounds == atlas.bounds && loaded.albedo == atlas.albedo && loaded.normal_depth == atlas.normal_depth,
+                "stored atlas loads back bit-exact");
+            check(!load_impostor(path, atlas.key + 1, loaded), "atlas of another key is rejected");
+
+            const std::string damaged_path = (root / "damaged.bin").string();
+            const auto damage = [&](const std::function<void(void)>& edit) {
+                std::filesystem::copy_file(path, damaged_path, std::filesystem::copy_options::overwrite_existing, ec);
+                edit();
+                return !load_impostor(damaged_path, atlas.key, loaded);
+            };
+            check(damage([&]() {
+                std::fstream file(damaged_path, std::ios::in | std::ios::out | std::ios::binary);
+                file.seekp(std::streamoff(sizeof(impostor_file_header_t) + bytes + 100));
+                file.put(char(atlas.normal_depth[100] ^ 0xff));
+            }), "corrupt payload is rejected");
+            check(damage([&]() { std::filesystem::resize_file(damaged_path, std::filesystem::file_size(damaged_path) - 1, ec); }), "truncated file is rejected");
+            check(damage([&]() { std::ofstream(damaged_path, std::ios::out | std::ios::binary | std::ios::app).put('\0'); }), "trailing bytes are rejected");
+            check(damage([&]() {
+                // the largest atlas the header limits allow, 16 GB of payload the file does not have
+                std::fstream file(damaged_path, std::ios::in | std::ios::out | std::ios::binary);
+                const uint32_t grid = 64, view_size = 1024;
+                file.seekp(std::streamoff(offsetof(impostor_file_header_t, grid)));
+                file.write(reinterpret_cast<const char*>(&grid), sizeof(grid));
+                file.seekp(std::streamoff(offsetof(impostor_file_header_t, view_size)));
+                file.write(reinterpret_cast<const char*>(&view_size), sizeof(view_size));
+            }), "a header claiming more payload than the file holds is rejected");
+        }
+
+        gl_context_t context;
+        if (!context.is_valid())
+        {
+            std::filesystem::remove_all(root, ec);
+            printf("impostors: no OpenGL 4.5 context, skipped the GPU half\n");
+            printf("impostors: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+            return failures == 0 ? 0 : 1;
+        }
+
+        // the demo's three city meshes, the same settings the demo bakes them with
+        mesh_pool_t pool;
+        draw_list_t city;
+        DemoScene::build_city(pool, 48, city);
+        pool.commit();
+        const uint32_t city_meshes = pool.get_mesh_count();
+        std::vector<uint32_t> meshes;
+        for (uint32_t mesh = 0; mesh < city_meshes; ++mesh) meshes.push_back(mesh);
+        const impostor_settings_t settings;
+        const uint32_t box = 1;
+
+        // 3. bake once, then load from the cache
+        impostor_set_t impostors;
+        if (!impostors.init(bench_shader_root))
+        {
+            check(false, "impostor programs compile");
+            printf("impostors: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+            return 1;
+        }
+        impostors.build(pool, meshes, settings, root.string());
+        const impostor_stats_t baked = impostors.get_stats();
+        {
+            mesh_pool_t cached_pool;
+            draw_list_t cached_city;
+            DemoScene::build_city(cached_pool, 48, cached_city);
+            cached_pool.commit();
+            impostor_set_t cached;
+            cached.init(bench_shader_root);
+            cached.build(cached_pool, meshes, settings, root.string());
+            const impostor_stats_t loaded = cached.get_stats();
+            printf("impostors cache: %u meshes baked in %.2f ms, loaded in %.2f ms (%.0fx faster)\n", baked.baked, baked.bake_ms, loaded.load_ms,
+                baked.bake_ms / std::max(loaded.load_ms, 1e-6));
+            check(baked.baked == city_meshes && baked.loaded == 0, "an empty cache bakes every mesh");
+            check(loaded.loaded == city_meshes && loaded.baked == 0, "a warm cache loads every mesh");
+            bool same = true;
+            for (uint32_t mesh = 0; mesh < city_meshes; ++mesh)
+            {
+                const impostor_atlas_t& a = impostors.get_atlas(uint32_t(impostors.get_layer(mesh)));
+                const impostor_atlas_t& b = cached.get_atlas(uint32_t(cached.get_layer(mesh)));
+                same = same && a.key == b.key && a.albedo == b.albedo && a.normal_depth == b.normal_depth;
+            }
+            check(same, "loaded atlases are the baked ones");
+            impostor_settings_t coarser = settings;
+            coarser.grid = 4;
+            check(impostor_key(pool, box, coarser) != impostor_key(pool, box, settings) && impostor_key(pool, 0, settings) != impostor_key(pool, box, settings),
+                "settings and geometry change the cache key");
+        }
+
+        // every view of the box sees it, and only inside the bounding sphere's disc
+        {
+            const impostor_atlas_t& atlas = impostors.get_atlas(uint32_t(impostors.get_layer(box)));
+            uint32_t empty_views = 0;
+            for (uint32_t view = 0; view < atlas.grid * atlas.grid; ++view)
+            {
+                const uint32_t vx = view % atlas.grid, vy = view / atlas.grid;
+                uint32_t covered = 0;
+                for (uint32_t y = 0; y < atlas.view_size; ++y)
+                {
+                    for (uint32_t x = 0; x < atlas.view_size; ++x)
+                    {
+                        covered += atlas.albedo[(size_t(vy * atlas.view_size + y) * atlas.get_size() + vx * atlas.view_size + x) * 4 + 3] > 127 ? 1 : 0;
+                    }
+                }
+                empty_views += covered == 0 ? 1 : 0;
+            }
+            check(empty_views == 0, "every baked view covers the mesh");
+        }
+
+        // 4. rendering: the frame data mesh.vert and impostor.vert read, and an offscreen target
+        const GLsizei width = 256;
+        const GLsizei height = 256;
+        GLuint framebuffer = 0;
+        GLuint renderbuffers[2] = {};
+        glCreateRenderbuffers(2, renderbuffers);
+        glNamedRenderbufferStorage(renderbuffers[0], GL_RGBA8, width, height);
+        glNamedRenderbufferStorage(renderbuffers[1], GL_DEPTH_COMPONENT24, width, height);
+        glCreateFramebuffers(1, &framebuffer);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        check(glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "offscreen framebuffer is complete");
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+        glEnable(GL_DEPTH_TEST);
+        const float clear_color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+        struct per_frame_t
+        {
+            glm::mat4 view;
+            glm::mat4 proj;
+            glm::vec4 cam_pos;
+        };
+        GLuint per_frame = 0;
+        glCreateBuffers(1, &per_frame);
+        glNamedBufferStorage(per_frame, sizeof(per_frame_t), NULL, GL_DYNAMIC_STORAGE_BIT);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 0, per_frame);
+
+        shader_variant_registry_t variants;
+        shader_permutation_t fade_permutation;
+        fade_permutation.define("IMPOSTOR_FADE");
+        const std::vector<std::string> mesh_files = { bench_shader_root + "/mesh/mesh.vert", bench_shader_root + "/mesh/mesh.frag" };
+        const shader_variant_t plain_variant = variants.request(mesh_files);
+        const shader_variant_t fade_variant = variants.request(mesh_files, fade_permutation);
+        glsl_program_t* plain_program = NULL;
+        glsl_program_t* fade_program = NULL;
+        try
+        {
+            plain_program = &variants.get(plain_variant);
+            fade_program = &variants.get(fade_variant);
+        }
+        catch (const GLSLProgramException& e)
+        {
+            printf("impostors: %s\n", e.what());
+        }
+        check(plain_program != NULL && fade_program != NULL, "mesh programs compile with and without IMPOSTOR_FADE");
+
+        indirect_renderer_t renderer;
+        std::vector<uint8_t> pixels(size_t(width) * height * 4);
+        std::vector<float> depth(size_t(width) * height);
+        // meshes and impostors of one view; returns the covered pixels in order
+        const auto draw = [&](const per_frame_t& frame, glsl_program_t* mesh_program, const draw_list_t& mesh_list, const draw_list_t& impostor_list) {
+            glNamedBufferSubData(per_frame, 0, sizeof(per_frame_t), &frame);
+            glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clear_color);
+            glClearNamedFramebufferfi(framebuffer, GL_DEPTH_STENCIL, 0, 1.0f, 0);
+            renderer.begin_frame();
+            pool.bind();
+            if (mesh_list.size() > 0)
+            {
+                mesh_program->use();
+                renderer.draw(pool, mesh_list, DrawPath::MULTI_DRAW_INDIRECT);
+            }
+            if (impostor_list.size() > 0)
+            {
+                impostors.get_program().use();
+                impostors.bind();
+                renderer.draw(pool, impostor_list, DrawPath::MULTI_DRAW_INDIRECT);
+            }
+            renderer.end_frame();
+        };
+        const auto read_coverage = [&](std::vector<bool>& covered) {
+            glFinish();
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+            covered.resize(depth.size());
+            for (size_t i = 0; i < covered.size(); ++i) covered[i] = depth[i] < 1.0f;
+        };
+        const auto intersection_over_union = [](const std::vector<bool>& a, const std::vector<bool>& b) {
+            size_t both = 0, either = 0;
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                both += a[i] && b[i] ? 1 : 0;
+                either += a[i] || b[i] ? 1 : 0;
+            }
+            return either > 0 ? double(both) / double(either) : 0.0;
+        };
+
+        if (plain_program != NULL && fade_program != NULL)
+        {
+            // 5. one tall box seen along a baked direction from far away with a narrow lens, close to the bake's
+            // orthographic views: the impostor covers what the mesh covers, at the mesh's depth
+            const glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.3f, -0.2f, 0.1f)), glm::vec3(0.4f, 1.2f, 0.4f));
+            const glm::vec4 bounds = pool.get_mesh(box).bounds;
+            const glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(bounds), 1.0f));
+            const float grid = float(settings.grid);
+            const glm::vec3 direction = glm::normalize(glm::mat3(model) * Octahedral::decode((glm::vec2(3.0f, 2.0f) + 0.5f) / grid));
+            const float distance = 40.0f;
+            per_frame_t frame = {};
+            frame.cam_pos = glm::vec4(center + direction * distance, 1.0f);
+            frame.view = glm::lookAt(glm::vec3(frame.cam_pos), center, std::abs(direction.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f));
+            frame.proj = glm::perspective(glm::radians(3.0f), float(width) / float(height), 30.0f, 50.0f);
+
+            draw_list_t single;
+            single.add(box, model);
+            draw_list_t near_list, far_list;
+            std::vector<bool> mesh_coverage, impostor_coverage, faded_coverage;
+            draw(frame, plain_program, single, draw_list_t());
+            read_coverage(mesh_coverage);
+            const std::vector<float> mesh_depth = depth;
+
+            impostor_lod_t all_impostors;
+            all_impostors.distance = 0.0f;
+            all_impostors.fade = 0.0f;
+            impostors.split(pool, single, glm::vec3(frame.cam_pos), all_impostors, near_list, far_list);
+            check(near_list.size() == 0 && far_list.size() == 1, "beyond the distance only the impostor is drawn");
+            draw(frame, fade_program, near_list, far_list);
+            read_coverage(impostor_coverage);
+            // depth difference in metres where both cover, the far plane spans 20 m
+            double depth_error = 0.0;
+            size_t both = 0;
+            for (size_t i = 0; i < depth.size(); ++i)
+            {
+                if (!mesh_coverage[i] || !impostor_coverage[i]) continue;
+                const auto linear = [](const float d) { const double z = double(d) * 2.0 - 1.0; return 2.0 * 30.0 * 50.0 / (50.0 + 30.0 - z * (50.0 - 30.0)); };
+                depth_error += std::abs(linear(depth[i]) - linear(mesh_depth[i]));
+                ++both;
+            }
+            depth_error /= double(std::max<size_t>(both, 1));
+            const double iou = intersection_over_union(mesh_coverage, impostor_coverage);
+
+            // halfway through the fade both are drawn, each into the other's dither holes
+            impostor_lod_t halfway;
+            halfway.distance = distance - 1.0f;
+            halfway.fade = 2.0f;
+            impostors.split(pool, single, glm::vec3(frame.cam_pos), halfway, near_list, far_list);
+            check(near_list.size() == 1 && far_list.size() == 1 && impostors.get_stats().faded_instances == 1, "inside the fade both are drawn");
+            draw(frame, fade_program, near_list, far_list);
+            read_coverage(faded_coverage);
+            const double faded_iou = intersection_over_union(mesh_coverage, faded_coverage);
+            size_t mesh_pixels = 0;
+            for (const bool c : mesh_coverage) mesh_pixels += c ? 1 : 0;
+            printf("impostors box: %zu pixels, impostor coverage IoU %.3f, mean depth error %.4f m (radius %.3f m), cross-fade coverage IoU %.3f\n",
+                mesh_pixels, iou, depth_error, bounds.w * 1.2f, faded_iou);
+            check(mesh_pixels > 1000, "the box fills a good part of the view");
+            check(iou > 0.9, "the impostor covers the mesh's pixels");
+            check(depth_error < 0.05 * bounds.w * 1.2, "the impostor writes the mesh's depth");
+            check(faded_iou > 0.85, "the cross-fade keeps the mesh's coverage");
+
+            // 6. the dense city from above one corner: impostors on and off
+            per_frame_t city_frame = {};
+            city_frame.cam_pos = glm::vec4(-26.0f, 3.0f, -26.0f, 1.0f);
+            city_frame.view = glm::lookAt(glm::vec3(city_frame.cam_pos), glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            city_frame.proj = glm::perspective(glm::radians(60.0f), float(width) / float(height), 0.05f, 200.0f);
+            const impostor_lod_t lod;
+            impostors.split(pool, city, glm::vec3(city_frame.cam_pos), lod, near_list, far_list);
+            const impostor_stats_t split = impostors.get_stats();
+            check(split.mesh_instances + split.impostor_instances - split.faded_instances == city.size()
+                && near_list.size() == split.mesh_instances && far_list.size() == split.impostor_instances, "every instance is split once");
+            check(split.triangles == near_list.count_triangles(pool) + far_list.count_triangles(pool), "split counts the triangles it queues");
+
+            const int frames = 10;
+            double mesh_ms = 0.0, impostor_ms = 0.0;
+            std::vector<bool> mesh_city, impostor_city;
+            for (int f = 0; f < frames; ++f)
+            {
+                auto t0 = std::chrono::high_resolution_clock::now();
+                draw(city_frame, plain_program, city, draw_list_t());
+                glFinish();
+                mesh_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+                t0 = std::chrono::high_resolution_clock::now();
+                impostors.split(pool, city, glm::vec3(city_frame.cam_pos), lod, near_list, far_list);
+                draw(city_frame, fade_program, near_list, far_list);
+                glFinish();
+                impostor_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+            }
+            draw(city_frame, plain_program, city, draw_list_t());
+            read_coverage(mesh_city);
+            draw(city_frame, fade_program, near_list, far_list);
+            read_coverage(impostor_city);
+            const uint64_t mesh_triangles = city.count_triangles(pool);
+            const double city_iou = intersection_over_union(mesh_city, impostor_city);
+            printf("impostors city: %zu instances, %u meshes, %u impostors, %u fading; %llu triangles without impostors, %llu with (%.1fx fewer)\n",
+                city.size(), split.mesh_instances, split.impostor_instances, split.faded_instances, static_cast<unsigned long long>(mesh_triangles),
+                static_cast<unsigned long long>(split.triangles), double(mesh_triangles) / double(std::max<uint64_t>(split.triangles, 1)));
+            printf("impostors city: meshes %.3f ms/frame, impostors %.3f ms/frame (%.2fx), coverage IoU %.3f\n", mesh_ms / frames, impostor_ms / frames,
+                mesh_ms / std::max(impostor_ms, 1e-6), city_iou);
+            check(split.impostor_instances * 2 > city.size(), "most of the city is far enough for impostors");
+            check(split.triangles * 4 < mesh_triangles, "impostors cut the triangle count");
+            check(city_iou > 0.9, "the city keeps its silhouette");
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+        glDeleteBuffers(1, &per_frame);
+
+        std::filesystem::remove_all(root, ec);
+        printf("impostors: %s\n", failures == 0 ? "all checks passed" : "checks FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+
+    struct bench_entry_t
+    {
+        const char* name;
+        int (*fn)(void);
+    };
+
+    static const bench_entry_t benches[] = {
+        { "quadtree", bench_quadtree },
+        { "culling", bench_culling },
+        { "noise", bench_noise },
+        { "jobs", bench_jobs },
+        { "uniforms", bench_uniforms },
+        { "profiler", bench_profiler },
+        { "suballocator", bench_suballocator },
+        { "tilecache", bench_tilecache },
+        { "patchgen", bench_patchgen },
+        { "terrain", bench_terrain },
+        { "atmosphere", bench_atmosphere },
+        { "ocean", bench_ocean },
+        { "sim", bench_sim },
+        { "commands", bench_commands },
+        { "shaders", bench_shaders },
+        { "occlusion", bench_occlusion },
+        { "scatter", bench_scatter },
+        { "impostors", bench_impostors },
+    };
+
+    int run(const char* name, const std::string& shader_root)
+    {
+        bench_shader_root = shader_root;
+        const bool run_all = strcmp(name, "all") == 0;
+        int result = 0;
+        bool found = false;
+        for (const bench_entry_t& bench : benches)
+        {
+            if (!run_all && strcmp(name, bench.name) != 0) continue;
+            found = true;
+            printf("== %s ==\n", bench.name);
+            result |= bench.fn();
+        }
+        if (!found)
+        {
+            fprintf(stderr, "Unknown benchmark: %s\nAvailable: all", name);
+            for (const bench_entry_t& bench : benches) fprintf(stderr, " %s", bench.name);
+            fprintf(stderr, "\n");
+            return 1;
+        }
+        return result;
+    }
+
+}
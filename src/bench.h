@@ -0,0 +1,14 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+
+namespace Bench {
+
+    // Headless benchmarks, selected with `game --bench <name> [--shader-root <dir>]`.
+    // GPU benchmarks open a hidden window of their own and load their shaders from shader_root.
+    // Returns the process exit code, non-zero when a benchmark's self-check fails.
+    int run(const char* name, const std::string& shader_root);
+
+}
+#endif
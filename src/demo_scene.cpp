@@ -0,0 +1,143 @@
+#include "demo_scene.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+namespace DemoScene {
+
+    using Continuum::Graphics::mesh_vertex_t;
+
+    static mesh_vertex_t make_vertex(const glm::vec3& p, const glm::vec3& n, const glm::vec2& tc)
+    {
+        return { { p.x, p.y, p.z }, { n.x, n.y, n.z }, { tc.x, tc.y } };
+    }
+
+    static uint32_t add_ground_tile(Continuum::Graphics::mesh_pool_t& pool, const uint32_t resolution)
+    {
+        std::vector<mesh_vertex_t> vertices;
+        std::vector<uint32_t> indices;
+        for (uint32_t y = 0; y <= resolution; ++y)
+        {
+            for (uint32_t x = 0; x <= resolution; ++x)
+            {
+                const glm::vec2 uv = glm::vec2(float(x), float(y)) / float(resolution);
+                vertices.push_back(make_vertex(glm::vec3(uv.x - 0.5f, 0.0f, uv.y - 0.5f), glm::vec3(0.0f, 1.0f, 0.0f), uv));
+            }
+        }
+        const uint32_t row = resolution + 1;
+        for (uint32_t y = 0; y < resolution; ++y)
+        {
+            for (uint32_t x = 0; x < resolution; ++x)
+            {
+                const uint32_t i = y * row + x;
+                indices.insert(indices.end(), { i, i + row, i + 1, i + 1, i + row, i + row + 1 });
+            }
+        }
+        return pool.add_mesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    // unit box standing on the origin: [-0.5, 0.5] x [0, 1] x [-0.5, 0.5]
+    static uint32_t add_box(Continuum::Graphics::mesh_pool_t& pool)
+    {
+        std::vector<mesh_vertex_t> vertices;
+        std::vector<uint32_t> indices;
+        const glm::vec3 normals[6] = {
+            glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+        };
+        for (const glm::vec3& n : normals)
+        {
+            // two tangents spanning the face, wound counter-clockwise seen from outside
+            const glm::vec3 t = std::abs(n.y) > 0.5f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            const glm::vec3 b = glm::cross(n, t);
+            const uint32_t base = static_cast<uint32_t>(vertices.size());
+            const glm::vec2 corners[4] = { glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f) };
+            for (const glm::vec2& c : corners)
+            {
+                const glm::vec3 p = (n + t * c.x + b * c.y) * 0.5f + glm::vec3(0.0f, 0.5f, 0.0f);
+                vertices.push_back(make_vertex(p, n, c * 0.5f + 0.5f));
+            }
+            indices.insert(indices.end(), { base, base + 1, base + 2, base + 2, base + 3, base });
+        }
+        return pool.add_mesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    // four-sided pyramid roof on the origin, unit footprint and height
+    static uint32_t add_roof(Continuum::Graphics::mesh_pool_t& pool)
+    {
+        std::vector<mesh_vertex_t> vertices;
+        std::vector<uint32_t> indices;
+        const glm::vec3 apex = glm::vec3(0.0f, 1.0f, 0.0f);
+        const glm::vec3 corners[4] = {
+            glm::vec3(-0.5f, 0.0f, 0.5f), glm::vec3(0.5f, 0.0f, 0.5f), glm::vec3(0.5f, 0.0f, -0.5f), glm::vec3(-0.5f, 0.0f, -0.5f)
+        };
+        for (uint32_t side = 0; side < 4; ++side)
+        {
+            const glm::vec3& a = corners[side];
+            const glm::vec3& b = corners[(side + 1) % 4];
+            const glm::vec3 n = glm::normalize(glm::cross(b - a, apex - a));
+            const uint32_t base = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(make_vertex(a, n, glm::vec2(0.0f, 0.0f)));
+            vertices.push_back(make_vertex(b, n, glm::vec2(1.0f, 0.0f)));
+            vertices.push_back(make_vertex(apex, n, glm::vec2(0.5f, 1.0f)));
+            indices.insert(indices.end(), { base, base + 1, base + 2 });
+        }
+        return pool.add_mesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    static uint32_t hash_u32(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static float hash_unit(const uint32_t x)
+    {
+        return float(hash_u32(x) >> 8) / float(1 << 24);
+    }
+
+    void build_city(Continuum::Graphics::mesh_pool_t& pool, const uint32_t blocks_per_side, Continuum::Graphics::draw_list_t& list)
+    {
+        const uint32_t ground = add_ground_tile(pool, 16);
+        const uint32_t box = add_box(pool);
+        const uint32_t roof = add_roof(pool);
+
+        const float block_size = 1.0f;
+        const float ground_height = -0.5f;
+        const float origin = -0.5f * block_size * float(blocks_per_side);
+
+        for (uint32_t by = 0; by < blocks_per_side; ++by)
+        {
+            for (uint32_t bx = 0; bx < blocks_per_side; ++bx)
+            {
+                const glm::vec3 block_center = glm::vec3(origin + (float(bx) + 0.5f) * block_size, ground_height, origin + (float(by) + 0.5f) * block_size);
+                list.add(ground, glm::scale(glm::translate(glm::mat4(1.0f), block_center), glm::vec3(block_size)));
+
+                // 2x2 lots per block, some left empty
+                for (uint32_t lot = 0; lot < 4; ++lot)
+                {
+                    const uint32_t seed = (by * blocks_per_side + bx) * 4 + lot;
+                    if (hash_unit(seed * 3) < 0.2f) continue;
+
+                    const float height = 0.1f + 0.9f * hash_unit(seed * 3 + 1) * hash_unit(seed * 3 + 1);
+                    const float width = 0.2f + 0.15f * hash_unit(seed * 3 + 2);
+                    const glm::vec3 lot_center = block_center + glm::vec3((float(lot & 1) - 0.5f) * 0.45f, 0.0f, (float(lot >> 1) - 0.5f) * 0.45f) * block_size;
+
+                    const glm::mat4 footprint = glm::translate(glm::mat4(1.0f), lot_center);
+                    list.add(box, glm::scale(footprint, glm::vec3(width, height, width) * block_size));
+                    if (height < 0.35f)
+                    {
+                        const glm::mat4 roof_base = glm::translate(footprint, glm::vec3(0.0f, height * block_size, 0.0f));
+                        list.add(roof, glm::scale(roof_base, glm::vec3(width, 0.1f, width) * block_size));
+                    }
+                }
+            }
+        }
+    }
+
+}
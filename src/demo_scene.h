@@ -0,0 +1,16 @@
+#ifndef DEMO_SCENE_H
+#define DEMO_SCENE_H
+
+#include "core/graphics/ogl_fw/indirect_draw.h"
+
+#include <stdint.h>
+
+namespace DemoScene {
+
+    // Procedural city block grid: ground tiles plus boxes and roofs of varying height, all from three
+    // meshes so that the multi-draw path has many instances per command. Deterministic for a given size.
+    // Adds its meshes to the pool (commit() is left to the caller) and queues every instance in list.
+    void build_city(Continuum::Graphics::mesh_pool_t& pool, const uint32_t blocks_per_side, Continuum::Graphics::draw_list_t& list);
+
+}
+#endif
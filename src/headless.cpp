@@ -0,0 +1,287 @@
+#include "headless.h"
+
+#include "core/file_io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+#ifndef CONTINUUM_DEFAULT_SHADER_ROOT
+#define CONTINUUM_DEFAULT_SHADER_ROOT "shader"
+#endif
+
+namespace Headless {
+
+    static const char* k_camera_path_magic = "continuum-camera-path";
+    static const int k_camera_path_version = 1;
+
+    bool parse_options(int argc, char** argv, options_t& options)
+    {
+        const char* env_root = getenv("CONTINUUM_SHADER_ROOT");
+        options.shader_root = env_root != NULL && env_root[0] != '\0' ? env_root : CONTINUUM_DEFAULT_SHADER_ROOT;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const char* arg = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+            const bool takes_value = strcmp(arg, "--shader-root") == 0 || strcmp(arg, "--frames") == 0 || strcmp(arg, "--warmup") == 0 ||
+                strcmp(arg, "--timestep") == 0 || strcmp(arg, "--camera-path") == 0 || strcmp(arg, "--record-camera") == 0 || strcmp(arg, "--report") == 0 ||
+                strcmp(arg, "--draw-path") == 0 || strcmp(arg, "--occlusion") == 0 ||
+                strcmp(arg, "--impostors") == 0;
+
+            if (strcmp(arg, "--headless") == 0)
+            {
+                options.headless = true;
+                continue;
+            }
+            if (!takes_value)
+            {
+                fprintf(stderr, "Unknown option: %s\n", arg);
+                return false;
+            }
+            if (value == NULL)
+            {
+                fprintf(stderr, "Missing value for %s\n", arg);
+                return false;
+            }
+            ++i;
+
+            if (strcmp(arg, "--shader-root") == 0) options.shader_root = value;
+            else if (strcmp(arg, "--frames") == 0) options.frames = static_cast<uint32_t>(strtoul(value, NULL, 10));
+            else if (strcmp(arg, "--warmup") == 0) options.warmup = static_cast<uint32_t>(strtoul(value, NULL, 10));
+            else if (strcmp(arg, "--timestep") == 0) options.timestep = strtod(value, NULL);
+            else if (strcmp(arg, "--camera-path") == 0) options.camera_path = value;
+            else if (strcmp(arg, "--record-camera") == 0) options.record_camera = value;
+            else if (strcmp(arg, "--report") == 0) options.report = value;
+            else if (strcmp(arg, "--draw-path") == 0)
+            {
+                if (strcmp(value, "mdi") != 0 && strcmp(value, "instance") != 0)
+                {
+                    fprintf(stderr, "--draw-path must be mdi or instance\n");
+                    return false;
+                }
+                options.multi_draw = strcmp(value, "mdi") == 0;
+            }
+            else if (strcmp(arg, "--occlusion") == 0)
+            {
+                if (strcmp(value, "on") != 0 && strcmp(value, "off") != 0)
+                {
+                    fprintf(stderr, "--occlusion must be on or off\n");
+                    return false;
+                }
+                options.occlusion = strcmp(value, "on") == 0;
+            }
+            else if (strcmp(arg, "--impostors") == 0)
+            {
+                if (strcmp(value, "on") != 0 && strcmp(value, "off") != 0)
+                {
+                    fprintf(stderr, "--impostors must be on or off\n");
+                    return false;
+                }
+                options.impostors = strcmp(value, "on") == 0;
+            }
+        }
+
+        while (!options.shader_root.empty() && (options.shader_root.back() == '/' || options.shader_root.back() == '\\'))
+        {
+            options.shader_root.pop_back();
+        }
+        if (options.frames == 0 || !(options.timestep > 0.0))
+        {
+            fprintf(stderr, "--frames and --timestep must be positive\n");
+            return false;
+        }
+        return true;
+    }
+
+    camera_path_t camera_path_t::scripted(const uint32_t frame_count)
+    {
+        // thirds: push forward while panning, strafe while pitching, climb back out at speed
+        camera_path_t path;
+        for (uint32_t frame = 0; frame < frame_count; ++frame)
+        {
+            const float t = float(frame) / float(std::max(frame_count, 1u));
+            camera_input_t input;
+            input.mouse_pressed = true;
+            input.mouse_pos = glm::vec2(0.5f + 0.15f * std::sin(t * 6.2831853f), 0.5f + 0.05f * std::sin(t * 12.5663706f));
+            input.movement.forward_ = t < 0.34f;
+            input.movement.right_ = t >= 0.34f && t < 0.67f;
+            input.movement.backward_ = t >= 0.67f;
+            input.movement.up_ = t >= 0.67f;
+            input.movement.fast_speed_ = t >= 0.67f;
+            path.push(input);
+        }
+        return path;
+    }
+
+    bool camera_path_t::load(const std::string& path)
+    {
+        FILE* file = fopen(path.c_str(), "r");
+        if (file == NULL) return false;
+
+        char magic[64] = {};
+        int version = 0;
+        unsigned long count = 0;
+        bool ok = fscanf(file, "%63s %d %lu", magic, &version, &count) == 3 && strcmp(magic, k_camera_path_magic) == 0 && version == k_camera_path_version;
+
+        this->frames_.clear();
+        for (unsigned long i = 0; ok && i < count; ++i)
+        {
+            camera_input_t input;
+            int pressed = 0;
+            unsigned int bits = 0;
+            ok = fscanf(file, "%f %f %d %x", &input.mouse_pos.x, &input.mouse_pos.y, &pressed, &bits) == 4;
+            input.mouse_pressed = pressed != 0;
+            input.movement.forward_ = (bits & 0x01) != 0;
+            input.movement.backward_ = (bits & 0x02) != 0;
+            input.movement.left_ = (bits & 0x04) != 0;
+            input.movement.right_ = (bits & 0x08) != 0;
+            input.movement.up_ = (bits & 0x10) != 0;
+            input.movement.down_ = (bits & 0x20) != 0;
+            input.movement.fast_speed_ = (bits & 0x40) != 0;
+            this->frames_.push_back(input);
+        }
+        fclose(file);
+        return ok && !this->frames_.empty();
+    }
+
+    bool camera_path_t::save(const std::string& path) const
+    {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == NULL) return false;
+
+        fprintf(file, "%s %d %lu\n", k_camera_path_magic, k_camera_path_version, static_cast<unsigned long>(this->frames_.size()));
+        for (const camera_input_t& input : this->frames_)
+        {
+            const unsigned int bits = (input.movement.forward_ ? 0x01 : 0) | (input.movement.backward_ ? 0x02 : 0) |
+                (input.movement.left_ ? 0x04 : 0) | (input.movement.right_ ? 0x08 : 0) | (input.movement.up_ ? 0x10 : 0) |
+                (input.movement.down_ ? 0x20 : 0) | (input.movement.fast_speed_ ? 0x40 : 0);
+            // %.9g round-trips floats exactly, replays stay bit-identical
+            fprintf(file, "%.9g %.9g %d %x\n", input.mouse_pos.x, input.mouse_pos.y, input.mouse_pressed ? 1 : 0, bits);
+        }
+        // buffered output can still fail to reach the file while it is closed
+        const bool ok = ferror(file) == 0;
+        return fclose(file) == 0 && ok;
+    }
+
+    const camera_input_t& camera_path_t::get(const uint32_t frame) const
+    {
+        static const camera_input_t idle = {};
+        if (this->frames_.empty()) return idle;
+        return this->frames_[std::min<size_t>(frame, this->frames_.size() - 1)];
+    }
+
+    frame_report_t::frame_report_t(const std::vector<std::string>& stages)
+        : stages_(stages), stage_ms_(stages.size())
+    {
+    }
+
+    void frame_report_t::add_stage_ms(const uint32_t stage, const double ms)
+    {
+        this->stage_ms_[stage].push_back(ms);
+    }
+
+    void frame_report_t::end_frame(const double frame_ms)
+    {
+        this->frame_ms_.push_back(frame_ms);
+    }
+
+    void frame_report_t::set_value(const std::string& name, const double value)
+    {
+        for (std::pair<std::string, double>& entry : this->values_)
+        {
+            if (entry.first == name)
+            {
+                entry.second = value;
+                return;
+            }
+        }
+        this->values_.emplace_back(name, value);
+    }
+
+    struct summary_t
+    {
+        double mean = 0.0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    static summary_t summarize(std::vector<double> samples)
+    {
+        summary_t summary;
+        if (samples.empty()) return summary;
+
+        std::sort(samples.begin(), samples.end());
+        // nearest-rank percentiles
+        const auto rank = [&](const double p) { return samples[std::min(samples.size() - 1, static_cast<size_t>(std::ceil(p * samples.size())) - 1)]; };
+        double sum = 0.0;
+        for (const double sample : samples) sum += sample;
+        summary.mean = sum / double(samples.size());
+        summary.p50 = rank(0.50);
+        summary.p95 = rank(0.95);
+        summary.p99 = rank(0.99);
+        summary.max = samples.back();
+        return summary;
+    }
+
+    static void write_summary(FILE* file, const summary_t& summary)
+    {
+        fprintf(file, "{ \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+    }
+
+    bool frame_report_t::write_json(const std::string& path, const options_t& options, const char* renderer, const char* camera_source) const
+    {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == NULL) return false;
+
+        fprintf(file, "{\n  \"renderer\": ");
+        Continuum::FileIO::write_json_string(file, renderer);
+        fprintf(file, ",\n  \"camera_path\": ");
+        Continuum::FileIO::write_json_string(file, camera_source);
+        fprintf(file, ",\n  \"frames\": %lu,\n  \"warmup_frames\": %u,\n  \"timestep\": %.9g,\n  \"frame_ms\": ",
+            static_cast<unsigned long>(this->frame_ms_.size()), options.warmup, options.timestep);
+        write_summary(file, summarize(this->frame_ms_));
+        fprintf(file, ",\n  \"stages_ms\": {");
+        for (size_t i = 0; i < this->stages_.size(); ++i)
+        {
+            fprintf(file, "%s\n    ", i > 0 ? "," : "");
+            Continuum::FileIO::write_json_string(file, this->stages_[i].c_str());
+            fprintf(file, ": ");
+            write_summary(file, summarize(this->stage_ms_[i]));
+        }
+        fprintf(file, "\n  },\n  \"values\": {");
+        for (size_t i = 0; i < this->values_.size(); ++i)
+        {
+            fprintf(file, "%s\n    ", i > 0 ? "," : "");
+            Continuum::FileIO::write_json_string(file, this->values_[i].first.c_str());
+            fprintf(file, ": %.6g", this->values_[i].second);
+        }
+        fprintf(file, "\n  }\n}\n");
+
+        // buffered output can still fail to reach the file while it is closed
+        const bool ok = ferror(file) == 0;
+        return fclose(file) == 0 && ok;
+    }
+
+    void frame_report_t::print_summary(void) const
+    {
+        const summary_t frame = summarize(this->frame_ms_);
+        printf("%lu frames: p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n", static_cast<unsigned long>(this->frame_ms_.size()),
+            frame.p50, frame.p95, frame.p99, frame.max);
+        for (size_t i = 0; i < this->stages_.size(); ++i)
+        {
+            const summary_t stage = summarize(this->stage_ms_[i]);
+            printf("  %-14s p50 %.3f ms, p99 %.3f ms\n", this->stages_[i].c_str(), stage.p50, stage.p99);
+        }
+        for (const std::pair<std::string, double>& entry : this->values_)
+        {
+            printf("  %-14s %.6g\n", entry.first.c_str(), entry.second);
+        }
+    }
+
+}
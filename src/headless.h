@@ -0,0 +1,87 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "core/graphics/camera.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace Headless {
+
+    // Command line of the game executable:
+    //   --shader-root <dir>      shader directory (else $CONTINUUM_SHADER_ROOT, else the source tree's shader/)
+    //   --headless               hidden window, fixed timestep, exits after --frames and writes --report
+    //   --frames <n>             measured frames in headless mode (default 600)
+    //   --warmup <n>             frames rendered before measuring (default 30)
+    //   --timestep <seconds>     simulation tick, replays hold one camera path entry per tick (default 1/60)
+    //   --camera-path <file>     replay recorded camera input instead of the scripted flight
+    //   --record-camera <file>   record the interactive camera input for later replays
+    //   --report <file>          JSON report path (default benchmark_report.json)
+    //   --draw-path <mdi|instance>  one multi-draw per material (default) or one draw per instance
+    //   --occlusion <on|off>     Hi-Z occlusion culling of the multi-draw path (default on)
+    //   --impostors <on|off>     baked impostors for distant buildings (default on)
+    struct options_t
+    {
+        std::string shader_root;
+        bool headless = false;
+        uint32_t frames = 600;
+        uint32_t warmup = 30;
+        double timestep = 1.0 / 60.0;
+        std::string camera_path;
+        std::string record_camera;
+        std::string report = "benchmark_report.json";
+        bool multi_draw = true;
+        bool occlusion = true;
+        bool impostors = true;
+    };
+
+    // Returns false and prints the problem on bad arguments.
+    bool parse_options(int argc, char** argv, options_t& options);
+
+    // One frame of camera input, exactly what OrbCameraPositioner::update() consumes.
+    struct camera_input_t
+    {
+        glm::vec2 mouse_pos = glm::vec2(0.0f);
+        bool mouse_pressed = false;
+        Continuum::Camera::OrbCameraPositioner::movement_t movement = {};
+    };
+
+    class camera_path_t
+    {
+    public:
+        // Deterministic flight used when no recording is given: sweeps the view and flies a loop.
+        static camera_path_t scripted(const uint32_t frame_count);
+        bool load(const std::string& path);
+        bool save(const std::string& path) const;
+    public:
+        inline void push(const camera_input_t& input) { this->frames_.push_back(input); }
+        // Past the end the last input is held.
+        const camera_input_t& get(const uint32_t frame) const;
+        inline size_t size(void) const { return this->frames_.size(); }
+    private:
+        std::vector<camera_input_t> frames_;
+    };
+
+    // Per-frame CPU stage timings, summarised as percentiles.
+    class frame_report_t
+    {
+    public:
+        explicit frame_report_t(const std::vector<std::string>& stages);
+    public:
+        void add_stage_ms(const uint32_t stage, const double ms);
+        void end_frame(const double frame_ms);
+        // Run-wide figures written as-is, e.g. draw calls per frame.
+        void set_value(const std::string& name, const double value);
+        bool write_json(const std::string& path, const options_t& options, const char* renderer, const char* camera_source) const;
+        void print_summary(void) const;
+    private:
+        std::vector<std::string> stages_;
+        std::vector<double> frame_ms_;
+        std::vector<std::vector<double>> stage_ms_;
+        std::vector<std::pair<std::string, double>> values_;
+    };
+
+}
+#endif
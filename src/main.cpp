@@ -1,8 +1,15 @@
 ﻿// game.cpp : Defines the entry point for the application.
 //
 #include "core/ccore.h"
+#include "bench.h"
+#include "headless.h"
+#include "demo_scene.h"
 
 #include <iostream>
+#include <algorithm>
+#include <string.h>
+#include <string>
+#include <vector>
 
 static const char* vertex_shader_text = R"GLSL(
 		#version 330 core
@@ -35,13 +42,18 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 
 struct GlobalState {
     GLFWwindow* window = NULL;
+    // owned by the simulation thread once it started, the input callbacks only write movement and up_resets
     Continuum::Camera::OrbCameraPositioner positioner;
+    Continuum::Camera::OrbCameraPositioner::movement_t movement;
+    // SPACE presses, the simulation levels the camera once per new press
+    uint32_t up_resets = 0;
     struct mouse_state_t
     {
         glm::vec2 pos = glm::vec2(0.0f);
         bool pressed_left = false;
         bool pressed_right = false;
     } mouse_state;
+    Continuum::Graphics::DrawPath::DrawPathType draw_path = Continuum::Graphics::DrawPath::MULTI_DRAW_INDIRECT;
 } app;
 
 namespace Renderer {
@@ -55,8 +67,46 @@ namespace Renderer {
 
 }
 
+namespace Simulation {
+
+    // what the main thread hands the simulation thread, once per frame
+    struct input_state_t
+    {
+        Headless::camera_input_t camera;
+        uint32_t up_resets = 0;
+        // glfwGetTime() when the input was sampled
+        double sample_time = 0.0;
+    };
+
+    // what every tick publishes: the camera before and after it, so that the renderer can interpolate
+    struct world_state_t
+    {
+        uint64_t tick_count = 0;
+        Continuum::Camera::OrbCameraPositioner previous;
+        Continuum::Camera::OrbCameraPositioner current;
+        // sample_time of the input the tick consumed
+        double input_time = 0.0;
+    };
+
+}
+
 int main(int argc, char** argv)
 {
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0)
+    {
+        // options after the benchmark name, GPU benchmarks read --shader-root
+        Headless::options_t bench_options;
+        if (!Headless::parse_options(argc - 2, argv + 2, bench_options)) exit(EXIT_FAILURE);
+        return Bench::run(argv[2], bench_options.shader_root);
+    }
+
+    Headless::options_t options;
+    if (!Headless::parse_options(argc, argv, options))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    CONTINUUM_PROFILE_THREAD("main");
 
     glfwSetErrorCallback(error_callback);
 
@@ -66,9 +116,17 @@ int main(int argc, char** argv)
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // headless runs still need a context, a hidden window works on Mesa llvmpipe under Xvfb
+    glfwWindowHint(GLFW_VISIBLE, options.headless ? GLFW_FALSE : GLFW_TRUE);
 
     app.window = glfwCreateWindow(1200, 800, "Continuum Engine", NULL, NULL);
     if (!app.window)
+    {
+        // llvmpipe and older drivers top out at 4.5, which has everything the renderer uses
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        app.window = glfwCreateWindow(1200, 800, "Continuum Engine", NULL, NULL);
+    }
+    if (!app.window)
     {
         glfwTerminate();
         exit(EXIT_FAILURE);
@@ -77,7 +135,7 @@ int main(int argc, char** argv)
     glfwSetKeyCallback(app.window, key_callback);
 
     glfwMakeContextCurrent(app.window);
-    glfwSwapInterval(1);
+    glfwSwapInterval(options.headless ? 0 : 1);
 
     GLenum err = glewInit();
     if (GLEW_OK != err)
@@ -87,35 +145,113 @@ int main(int argc, char** argv)
         return -1;
     }
 
+    CONTINUUM_PROFILE_GPU_INIT();
+
     app.positioner = Continuum::Camera::OrbCameraPositioner(
         glm::vec3(0.0f, 0.5f, -2.0f),
         glm::vec3(0.0f, 0.0f, -1.0f),
         glm::vec3(0.0f, 1.0f, 0.0f)
     );
 
-    Continuum::Camera::camera_t camera(app.positioner);
+    // the renderer's copy of the simulated camera: interpolated between ticks, with late mouse look on top
+    Continuum::Camera::OrbCameraPositioner view_positioner = app.positioner;
+    Continuum::Camera::camera_t camera(view_positioner);
 
-    const GLsizeiptr k_uniform_buffer_size = sizeof(Renderer::PerFrameData);
+    // per-frame and per-draw uniforms, one region per frame in flight
+    const GLsizeiptr k_uniform_region_size = 64 * 1024;
+    const uint32_t k_frames_in_flight = 3;
 
-    GLuint per_frame_data_buffer;
-    glCreateBuffers(1, &per_frame_data_buffer);
-    glNamedBufferStorage(per_frame_data_buffer, k_uniform_buffer_size, NULL, GL_DYNAMIC_STORAGE_BIT);
-    glBindBufferRange(GL_UNIFORM_BUFFER, 0, per_frame_data_buffer, 0, k_uniform_buffer_size);
+    Continuum::Graphics::streaming_buffer_t per_frame_uniforms(GL_UNIFORM_BUFFER, k_uniform_region_size, k_frames_in_flight);
 
     GLuint vao;
     glCreateVertexArrays(1, &vao);
     glBindVertexArray(vao);
 
-    Continuum::Graphics::glsl_program_t grid_prog = Continuum::Graphics::glsl_program_t();
+    // linked programs are cached on disk, a warm start skips compiling and linking
+    Continuum::Graphics::glsl_program_t::set_binary_cache_directory("shader_cache");
+    const double shader_time_stamp = glfwGetTime();
+
+    const std::string shader_root = options.shader_root;
 
-    grid_prog.compile_shader("C:/work/dev/game/shader/grid/grid.vert");
-    grid_prog.compile_shader("C:/work/dev/game/shader/grid/grid.frag");
-    grid_prog.link();
+    // edits under the shader root are rebuilt in the background and swapped in once linked
+    Continuum::Jobs::job_system_t jobs;
+    // drivers without parallel shader compile link on the compiler's thread, in a hidden context sharing this one
+    GLFWwindow* link_window = NULL;
+    Continuum::Graphics::shader_link_context_t link_context;
+    if (!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        link_window = glfwCreateWindow(1, 1, "Continuum shader link", NULL, app.window);
+        if (link_window != NULL)
+        {
+            link_context.make_current = [link_window]() { glfwMakeContextCurrent(link_window); };
+            link_context.release_current = []() { glfwMakeContextCurrent(NULL); };
+        }
+    }
+    Continuum::Graphics::async_shader_compiler_t shader_compiler(&jobs, link_context);
+    Continuum::file_watcher_t shader_watcher(shader_root);
+
+    // programs are shared per (files, defines) and compiled on first get(), compiled ones are watched for edits
+    Continuum::Graphics::shader_variant_registry_t shader_variants(&shader_compiler);
+
+    // the grid's look is baked into its program instead of living in mutable shader globals
+    Continuum::Graphics::shader_permutation_t grid_permutation;
+    grid_permutation.define("GRID_SIZE", 10.0f);
+    grid_permutation.define("GRID_CELL_SIZE", 0.0025f);
+    grid_permutation.define("GRID_MIN_PIXELS_BETWEEN_CELLS", 2.0f);
+    grid_permutation.define("GRID_COLOR_THIN", glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+    grid_permutation.define("GRID_COLOR_THICK", glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    const Continuum::Graphics::shader_variant_t grid_variant = shader_variants.request({ shader_root + "/grid/grid.vert", shader_root + "/grid/grid.frag" }, grid_permutation);
+    // with impostors the meshes dither out over the distance their impostors dither in
+    Continuum::Graphics::shader_permutation_t mesh_permutation;
+    if (options.impostors) mesh_permutation.define("IMPOSTOR_FADE");
+    const Continuum::Graphics::shader_variant_t mesh_variant = shader_variants.request({ shader_root + "/mesh/mesh.vert", shader_root + "/mesh/mesh.frag" }, mesh_permutation);
+
+    // both are drawn in the first frame, compiling them here keeps that frame's timing clean
+    Continuum::Graphics::glsl_program_t& grid_prog = shader_variants.get(grid_variant);
     grid_prog.validate();
+    Continuum::Graphics::glsl_program_t& mesh_prog = shader_variants.get(mesh_variant);
+    mesh_prog.validate();
+
+    const Continuum::Graphics::program_binary_cache_stats_t& cache_stats = Continuum::Graphics::glsl_program_t::get_binary_cache_stats();
+    const Continuum::Graphics::shader_variant_stats_t& variant_stats = shader_variants.get_stats();
+    printf("Shader programs ready in %.2f ms (%s start: %u cached, %u compiled, %u rejected; %u variants, %u compiled in %.2f ms)\n",
+        (glfwGetTime() - shader_time_stamp) * 1000.0, cache_stats.misses == 0 ? "warm" : "cold",
+        cache_stats.hits, cache_stats.misses, cache_stats.rejected, variant_stats.variants, variant_stats.compiled, variant_stats.compile_ms);
+
+    // every mesh lives in one shared vertex/index buffer, a material is a single multi-draw
+    Continuum::Graphics::mesh_pool_t mesh_pool;
+    Continuum::Graphics::draw_list_t city_draws;
+    DemoScene::build_city(mesh_pool, 48, city_draws);
+    mesh_pool.commit();
+
+    // distant buildings are drawn as billboards of views baked once and cached next to the shader cache
+    Continuum::Graphics::impostor_set_t impostors;
+    const bool impostors_enabled = options.impostors && impostors.init(shader_root);
+    if (impostors_enabled)
+    {
+        const uint32_t city_meshes = mesh_pool.get_mesh_count();
+        std::vector<uint32_t> meshes;
+        for (uint32_t mesh = 0; mesh < city_meshes; ++mesh) meshes.push_back(mesh);
+        impostors.build(mesh_pool, meshes, Continuum::Graphics::impostor_settings_t(), "impostor_cache");
+        const Continuum::Graphics::impostor_stats_t& impostor_stats = impostors.get_stats();
+        printf("Impostors ready: %u baked in %.2f ms, %u loaded in %.2f ms\n", impostor_stats.baked, impostor_stats.bake_ms, impostor_stats.loaded, impostor_stats.load_ms);
+    }
+    const Continuum::Graphics::impostor_lod_t impostor_lod;
+    Continuum::Graphics::draw_list_t near_draws;
+    Continuum::Graphics::draw_list_t far_draws;
+
+    Continuum::Graphics::indirect_renderer_t mesh_renderer;
+    // every draw of a frame is recorded, sorted by key and issued through the state tracker
+    Continuum::Graphics::render_command_list_t frame_commands;
+    Continuum::Graphics::render_state_tracker_t gl_state;
+    // buildings hidden behind others are culled on the GPU against the depth of the previous frame
+    Continuum::Graphics::hiz_culler_t occlusion;
+    const bool occlusion_culling = options.occlusion && occlusion.init(shader_root);
+    app.draw_path = options.multi_draw ? Continuum::Graphics::DrawPath::MULTI_DRAW_INDIRECT : Continuum::Graphics::DrawPath::PER_INSTANCE;
 
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_DEPTH_TEST);
 
     glfwSetCursorPosCallback(
         app.window,
@@ -148,31 +284,159 @@ int main(int argc, char** argv)
             const bool pressed = action != GLFW_RELEASE;
             if (key == GLFW_KEY_ESCAPE && pressed) glfwSetWindowShouldClose(window, GLFW_TRUE);
             // Proc Camera Movement
-            if (key == GLFW_KEY_W) app.positioner.MOVEMENT_.forward_ = pressed;
-            if (key == GLFW_KEY_S) app.positioner.MOVEMENT_.backward_ = pressed;
-            if (key == GLFW_KEY_A) app.positioner.MOVEMENT_.left_ = pressed;
-            if (key == GLFW_KEY_D) app.positioner.MOVEMENT_.right_ = pressed;
-            if (key == GLFW_KEY_1) app.positioner.MOVEMENT_.up_ = pressed;
-            if (key == GLFW_KEY_2) app.positioner.MOVEMENT_.down_ = pressed;
-            if (mods & GLFW_MOD_SHIFT) app.positioner.MOVEMENT_.fast_speed_ = pressed;
-            if (key == GLFW_KEY_SPACE) app.positioner.set_up_vector(glm::vec3(0.0f, 1.0f, 0.0f));
+            if (key == GLFW_KEY_W) app.movement.forward_ = pressed;
+            if (key == GLFW_KEY_S) app.movement.backward_ = pressed;
+            if (key == GLFW_KEY_A) app.movement.left_ = pressed;
+            if (key == GLFW_KEY_D) app.movement.right_ = pressed;
+            if (key == GLFW_KEY_1) app.movement.up_ = pressed;
+            if (key == GLFW_KEY_2) app.movement.down_ = pressed;
+            if (mods & GLFW_MOD_SHIFT) app.movement.fast_speed_ = pressed;
+            if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) ++app.up_resets;
+            if (key == GLFW_KEY_M && action == GLFW_PRESS)
+            {
+                app.draw_path = app.draw_path == Continuum::Graphics::DrawPath::MULTI_DRAW_INDIRECT
+                    ? Continuum::Graphics::DrawPath::PER_INSTANCE : Continuum::Graphics::DrawPath::MULTI_DRAW_INDIRECT;
+                printf("Mesh draw path: %s\n", app.draw_path == Continuum::Graphics::DrawPath::MULTI_DRAW_INDIRECT ? "multi-draw indirect" : "per instance");
+            }
+            if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+            {
+                const int64_t events = CONTINUUM_PROFILE_EXPORT("frame_trace.json");
+                if (events >= 0) printf("Wrote %lld trace events to frame_trace.json\n", static_cast<long long>(events));
+                else printf("Trace export unavailable (profiler disabled or file not writable)\n");
+            }
         }
     );
 
-    double time_stamp = glfwGetTime();
-    float delta_seconds = 0.0f;
+    // replays and headless runs drive the camera from recorded input, one tick per entry
+    Headless::camera_path_t camera_path;
+    const char* camera_source = "interactive";
+    if (!options.camera_path.empty())
+    {
+        if (!camera_path.load(options.camera_path))
+        {
+            fprintf(stderr, "Error: cannot read camera path %s\n", options.camera_path.c_str());
+            glfwTerminate();
+            exit(EXIT_FAILURE);
+        }
+        camera_source = options.camera_path.c_str();
+    }
+    else if (options.headless)
+    {
+        camera_path = Headless::camera_path_t::scripted(options.warmup + options.frames);
+        camera_source = "scripted";
+    }
+    const bool replaying = camera_path.size() > 0;
+
+    Headless::camera_path_t recorded_path;
+    // the latencies are not part of the frame: input sampled for the simulation, and for the late mouse look, to present
+    enum { STAGE_SHADER_RELOAD, STAGE_CAMERA, STAGE_RENDER, STAGE_MESH_SUBMIT, STAGE_PRESENT, STAGE_INPUT_LATENCY, STAGE_LOOK_LATENCY };
+    Headless::frame_report_t report({ "shader_reload", "camera", "render", "mesh_submit", "present", "input_latency", "look_latency" });
+    uint32_t frame_index = 0;
+
+    // per draw path: frames, draw calls, submit time and GL state calls, reported at exit
+    struct draw_path_totals_t
+    {
+        uint64_t frames = 0;
+        uint64_t draw_calls = 0;
+        double submit_ms = 0.0;
+        uint64_t state_calls_issued = 0;
+        uint64_t state_calls_elided = 0;
+        uint64_t occlusion_culled = 0;
+        uint64_t triangles = 0;
+        uint64_t impostor_instances = 0;
+    } draw_path_totals[2];
+
+    struct latency_totals_t
+    {
+        uint64_t frames = 0;
+        double input_ms = 0.0;
+        double look_ms = 0.0;
+    } latency_totals;
 
     app.positioner.max_speed_ = 0.4 * app.positioner.max_speed_;
     app.positioner.acceleration_ = 10.f;
     app.positioner.fast_coef_ = 1.5f; 
 
-    while (!glfwWindowShouldClose(app.window)) 
+    // The camera is simulated on its own thread at the fixed timestep, the frame rate no longer changes
+    // its motion and a slow tick does not hold up a frame. Headless runs tick in lockstep with the frames.
+    Continuum::Sim::triple_buffer_t<Simulation::input_state_t> input_states;
+    Continuum::Sim::triple_buffer_t<Simulation::world_state_t> world_states;
+    {
+        Simulation::world_state_t& initial = world_states.get_back();
+        initial.previous = app.positioner;
+        initial.current = app.positioner;
+        initial.input_time = glfwGetTime();
+        world_states.publish();
+        world_states.acquire();
+    }
+    Continuum::Sim::sim_thread_settings_t sim_settings;
+    sim_settings.timestep = options.timestep;
+    sim_settings.pacing = options.headless ? Continuum::Sim::SimPacing::LOCKSTEP : Continuum::Sim::SimPacing::REALTIME;
+    Continuum::Camera::OrbCameraPositioner previous_camera = app.positioner;
+    uint32_t applied_up_resets = 0;
+    Continuum::Sim::sim_thread_t sim(sim_settings, [&](const uint64_t tick, const double timestep)
+        {
+            input_states.acquire();
+            const Simulation::input_state_t& input = input_states.get_front();
+            const Headless::camera_input_t& camera_input = replaying ? camera_path.get(static_cast<uint32_t>(tick)) : input.camera;
+            if (input.up_resets != applied_up_resets)
+            {
+                app.positioner.set_up_vector(glm::vec3(0.0f, 1.0f, 0.0f));
+                applied_up_resets = input.up_resets;
+            }
+            app.positioner.MOVEMENT_ = camera_input.movement;
+            app.positioner.update(timestep, camera_input.mouse_pos, camera_input.mouse_pressed);
+            if (!options.record_camera.empty()) recorded_path.push(camera_input);
+
+            Simulation::world_state_t& state = world_states.get_back();
+            state.tick_count = tick + 1;
+            state.previous = previous_camera;
+            state.current = app.positioner;
+            // replayed input has no sample time, it counts from the tick that consumed it
+            state.input_time = replaying ? glfwGetTime() : input.sample_time;
+            world_states.publish();
+            previous_camera = app.positioner;
+        }
+    );
+    sim.start();
+
+    while (!glfwWindowShouldClose(app.window) && !(options.headless && frame_index >= options.warmup + options.frames))
     {
-        app.positioner.update(delta_seconds, app.mouse_state.pos, app.mouse_state.pressed_left);
+        CONTINUUM_PROFILE_SCOPE("frame");
+        CONTINUUM_PROFILE_GPU_FRAME();
 
-        const double new_time_stamp = glfwGetTime();
-        delta_seconds = static_cast<float>(new_time_stamp - time_stamp);
-        time_stamp = new_time_stamp;
+        const double frame_start = glfwGetTime();
+        {
+            CONTINUUM_PROFILE_SCOPE("shader_reload");
+            for (const std::string& path : shader_watcher.poll()) shader_compiler.notify_file_changed(path);
+            shader_compiler.update();
+        }
+        const double shader_reload_end = glfwGetTime();
+
+        // input is sampled as late as possible, right before the view is built
+        double input_sample_time = 0.0;
+        {
+            CONTINUUM_PROFILE_SCOPE("camera");
+            glfwPollEvents();
+            input_sample_time = glfwGetTime();
+            Simulation::input_state_t& input = input_states.get_back();
+            input.camera = { app.mouse_state.pos, app.mouse_state.pressed_left, app.movement };
+            input.up_resets = app.up_resets;
+            input.sample_time = input_sample_time;
+            input_states.publish();
+            if (options.headless) sim.run_until(frame_index + 1);
+            world_states.acquire();
+
+            // positions are interpolated a tick behind the simulation; interactive mouse look starts from the
+            // latest tick and adds the mouse movement since, replays interpolate the orientation as well
+            const Simulation::world_state_t& state = world_states.get_front();
+            const float alpha = static_cast<float>(sim.get_interpolation(state.tick_count));
+            view_positioner = state.current;
+            view_positioner.set_world_position(glm::mix(state.previous.get_world_position(), state.current.get_world_position(), double(alpha)));
+            if (replaying) view_positioner.set_orientation(glm::slerp(state.previous.get_orientation(), state.current.get_orientation(), alpha));
+            else view_positioner.update(0.0, app.mouse_state.pos, app.mouse_state.pressed_left);
+        }
+        const double camera_end = glfwGetTime();
 
         int width, height;
         glfwGetFramebufferSize(app.window, &width, &height);
@@ -184,24 +448,176 @@ int main(int argc, char** argv)
         const glm::mat4 p = glm::perspective(45.0f, ratio, 0.1f, 1000.0f);
         const glm::mat4 view = camera.get_view_matrix();
 
-        const Renderer::PerFrameData per_frame_data = { .view = view, .proj = p, .cam_pos = glm::vec4(camera.get_position(), 1.0f) };
-        glNamedBufferSubData(per_frame_data_buffer, 0, k_uniform_buffer_size, &per_frame_data);
+        {
+            CONTINUUM_PROFILE_SCOPE("render");
+            CONTINUUM_PROFILE_GPU_SCOPE("render");
+
+            per_frame_uniforms.begin_frame();
+
+            const Renderer::PerFrameData per_frame_data = { .view = view, .proj = p, .cam_pos = glm::vec4(camera.get_position(), 1.0f) };
+            per_frame_uniforms.bind_range(0, per_frame_uniforms.push(per_frame_data));
+
+            {
+                CONTINUUM_PROFILE_GPU_SCOPE("scene");
+                using namespace Continuum::Graphics;
+                mesh_renderer.begin_frame();
+                frame_commands.clear();
+                const uint64_t mesh_key = SortKey::make(RenderPass::SOLID, mesh_prog.get_handle(), 0, 0.0f);
+                const bool cull_meshes = occlusion_culling && app.draw_path == DrawPath::MULTI_DRAW_INDIRECT;
+                if (occlusion_culling) occlusion.begin_frame();
+                const draw_list_t* mesh_draws = &city_draws;
+                if (impostors_enabled)
+                {
+                    impostors.split(mesh_pool, city_draws, camera.get_position(), impostor_lod, near_draws, far_draws);
+                    mesh_draws = &near_draws;
+                    // impostors are not occlusion culled, a quad is cheaper to draw than to test
+                    glsl_program_t& impostor_prog = impostors.get_program();
+                    const uint64_t impostor_key = SortKey::make(RenderPass::SOLID, impostor_prog.get_handle(), 0, 0.0f);
+                    mesh_renderer.record(frame_commands, impostor_key, impostor_prog.get_handle(), mesh_pool, far_draws, app.draw_path);
+                }
+                if (cull_meshes) mesh_renderer.record_culled(frame_commands, mesh_key, mesh_prog.get_handle(), mesh_pool, *mesh_draws, occlusion, p * view);
+                else mesh_renderer.record(frame_commands, mesh_key, mesh_prog.get_handle(), mesh_pool, *mesh_draws, app.draw_path);
+
+                render_packet_t grid;
+                grid.program = grid_prog.get_handle();
+                grid.vao = vao;
+                grid.blend = blend_state_t::alpha();
+                grid.count = 6;
+                frame_commands.add(SortKey::make(RenderPass::TRANSLUCENT, grid.program, 0, 0.0f), grid);
+
+                frame_commands.sort();
+                gl_state.reset_stats();
+                // the culls and last frame's pyramid build used GL behind the tracker's back
+                if (occlusion_culling) gl_state.invalidate();
+                if (impostors_enabled) impostors.bind();
+                frame_commands.execute(gl_state, RenderPass::SOLID, RenderPass::SKY);
+                // only opaque depth may hide anything, the pyramid is built before the translucent passes
+                if (occlusion_culling)
+                {
+                    occlusion.build(uint32_t(width), uint32_t(height), p * view, glm::dvec3(0.0));
+                    gl_state.invalidate();
+                }
+                frame_commands.execute(gl_state, RenderPass::TRANSLUCENT, RenderPass::OVERLAY);
+                mesh_renderer.end_frame();
+            }
 
-        grid_prog.use();
-        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, 1, 0);
+            const Continuum::Graphics::draw_submit_stats_t& submit_stats = mesh_renderer.get_frame_stats();
+            const Continuum::Graphics::render_state_stats_t& state_stats = gl_state.get_stats();
+            draw_path_totals_t& totals = draw_path_totals[app.draw_path];
+            ++totals.frames;
+            totals.draw_calls += submit_stats.draw_calls;
+            totals.submit_ms += submit_stats.submit_ms;
+            totals.state_calls_issued += state_stats.issued;
+            totals.state_calls_elided += state_stats.elided;
+            totals.triangles += impostors_enabled ? impostors.get_stats().triangles : city_draws.count_triangles(mesh_pool);
+            totals.impostor_instances += impostors_enabled ? impostors.get_stats().impostor_instances : 0;
+            // counted two frames late, as read back by begin_frame() once the GPU is done with them
+            if (occlusion_culling && app.draw_path == Continuum::Graphics::DrawPath::MULTI_DRAW_INDIRECT) totals.occlusion_culled += occlusion.get_stats().occlusion_culled;
+
+            per_frame_uniforms.end_frame();
+        }
+        const double render_end = glfwGetTime();
 
-        glfwSwapBuffers(app.window);
-        glfwPollEvents();
+        {
+            CONTINUUM_PROFILE_SCOPE("present");
+            glfwSwapBuffers(app.window);
+            // without vsync the driver would queue frames, finishing keeps each frame's GPU work in its own sample
+            if (options.headless) glFinish();
+        }
+        const double present_end = glfwGetTime();
+        const double input_latency_ms = (present_end - world_states.get_front().input_time) * 1000.0;
+        const double look_latency_ms = (present_end - input_sample_time) * 1000.0;
+        ++latency_totals.frames;
+        latency_totals.input_ms += input_latency_ms;
+        latency_totals.look_ms += look_latency_ms;
+
+        if (options.headless && frame_index >= options.warmup)
+        {
+            report.add_stage_ms(STAGE_SHADER_RELOAD, (shader_reload_end - frame_start) * 1000.0);
+            report.add_stage_ms(STAGE_CAMERA, (camera_end - shader_reload_end) * 1000.0);
+            report.add_stage_ms(STAGE_RENDER, (render_end - camera_end) * 1000.0);
+            report.add_stage_ms(STAGE_MESH_SUBMIT, mesh_renderer.get_frame_stats().submit_ms);
+            report.add_stage_ms(STAGE_PRESENT, (present_end - render_end) * 1000.0);
+            report.add_stage_ms(STAGE_INPUT_LATENCY, input_latency_ms);
+            report.add_stage_ms(STAGE_LOOK_LATENCY, look_latency_ms);
+            report.end_frame((present_end - frame_start) * 1000.0);
+        }
+        ++frame_index;
+    }
+    sim.stop();
+
+    const Continuum::Sim::sim_thread_stats_t sim_stats = sim.get_stats();
+    printf("Simulation: %llu ticks of %.2f ms (%.3f ms avg, %.3f ms max), %llu dropped; input to present %.2f ms, mouse look to present %.2f ms avg over %llu frames\n",
+        static_cast<unsigned long long>(sim_stats.ticks), options.timestep * 1000.0, sim_stats.average_tick_ms, sim_stats.max_tick_ms,
+        static_cast<unsigned long long>(sim_stats.dropped_ticks), latency_totals.input_ms / double(std::max<uint64_t>(latency_totals.frames, 1)),
+        latency_totals.look_ms / double(std::max<uint64_t>(latency_totals.frames, 1)), static_cast<unsigned long long>(latency_totals.frames));
+
+    for (int path = 0; path < 2; ++path)
+    {
+        const draw_path_totals_t& totals = draw_path_totals[path];
+        if (totals.frames == 0) continue;
+        const char* name = path == Continuum::Graphics::DrawPath::MULTI_DRAW_INDIRECT ? "multi-draw indirect" : "per instance";
+        printf("Meshes (%s): %u instances, %.1f draw calls/frame, %.3f ms CPU submit/frame, GL state calls %.1f issued %.1f elided/frame, "
+            "%.1f occlusion culled/frame, %.0f triangles and %.1f impostors/frame over %llu frames\n", name,
+            static_cast<unsigned>(city_draws.size()), double(totals.draw_calls) / double(totals.frames), totals.submit_ms / double(totals.frames),
+            double(totals.state_calls_issued) / double(totals.frames), double(totals.state_calls_elided) / double(totals.frames),
+            double(totals.occlusion_culled) / double(totals.frames), double(totals.triangles) / double(totals.frames),
+            double(totals.impostor_instances) / double(totals.frames), static_cast<unsigned long long>(totals.frames));
+    }
+
+    int exit_code = EXIT_SUCCESS;
+    if (options.headless)
+    {
+        const draw_path_totals_t& totals = draw_path_totals[app.draw_path];
+        report.set_value("mesh_instances", double(city_draws.size()));
+        report.set_value("draw_calls_per_frame", totals.frames > 0 ? double(totals.draw_calls) / double(totals.frames) : 0.0);
+        report.set_value("multi_draw", app.draw_path == Continuum::Graphics::DrawPath::MULTI_DRAW_INDIRECT ? 1.0 : 0.0);
+        report.set_value("state_calls_issued_per_frame", totals.frames > 0 ? double(totals.state_calls_issued) / double(totals.frames) : 0.0);
+        report.set_value("state_calls_elided_per_frame", totals.frames > 0 ? double(totals.state_calls_elided) / double(totals.frames) : 0.0);
+        report.set_value("occlusion_culling", occlusion_culling ? 1.0 : 0.0);
+        report.set_value("occlusion_culled_per_frame", totals.frames > 0 ? double(totals.occlusion_culled) / double(totals.frames) : 0.0);
+        report.set_value("impostors", impostors_enabled ? 1.0 : 0.0);
+        report.set_value("impostor_instances_per_frame", totals.frames > 0 ? double(totals.impostor_instances) / double(totals.frames) : 0.0);
+        report.set_value("triangles_per_frame", totals.frames > 0 ? double(totals.triangles) / double(totals.frames) : 0.0);
+        report.print_summary();
+        const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        if (report.write_json(options.report, options, renderer != NULL ? renderer : "unknown", camera_source))
+        {
+            printf("Wrote %s\n", options.report.c_str());
+        }
+        else
+        {
+            fprintf(stderr, "Error: cannot write %s\n", options.report.c_str());
+            exit_code = EXIT_FAILURE;
+        }
+    }
+    if (!options.record_camera.empty() && !recorded_path.save(options.record_camera))
+    {
+        fprintf(stderr, "Error: cannot write camera path %s\n", options.record_camera.c_str());
+        exit_code = EXIT_FAILURE;
     }
 
-    glDeleteBuffers(1, &per_frame_data_buffer);
+    const Continuum::Graphics::streaming_buffer_stats_t& ring_stats = per_frame_uniforms.get_stats();
+    printf("Uniform ring: %llu frames, %llu fence waits (%.3f ms), peak %lld of %lld bytes per region\n",
+        static_cast<unsigned long long>(ring_stats.frames), static_cast<unsigned long long>(ring_stats.fence_waits),
+        ring_stats.fence_wait_ms, static_cast<long long>(ring_stats.peak_region_usage), static_cast<long long>(per_frame_uniforms.get_region_size()));
+
+    per_frame_uniforms.~streaming_buffer_t();
+    mesh_renderer.~indirect_renderer_t();
+    occlusion.~hiz_culler_t();
+    impostors.~impostor_set_t();
+    mesh_pool.~mesh_pool_t();
+    shader_compiler.~async_shader_compiler_t();
+    if (link_window != NULL) glfwDestroyWindow(link_window);
+    jobs.~job_system_t();
     glDeleteVertexArrays(1, &vao);
 
-    grid_prog.~glsl_program_t();
+    shader_variants.~shader_variant_registry_t();
+    CONTINUUM_PROFILE_GPU_SHUTDOWN();
 
     glfwDestroyWindow(app.window);
 
     glfwTerminate();
 
-    exit(EXIT_SUCCESS);
+    exit(exit_code);
 }
\ No newline at end of file